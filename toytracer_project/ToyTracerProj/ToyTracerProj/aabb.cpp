@@ -8,6 +8,8 @@
 * expand the box, transform it, compute its surface area, etc.             *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Branchless slab test using the ray's cached reciprocals.   *
+*   10/18/2026  Ray-box test can report the interval within the box.       *
 *   12/11/2004  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -50,66 +52,42 @@ AABB operator*( const Mat3x3 &M, const AABB &box )
 
 bool Hit( const Ray &ray, const AABB &A, double max_dist )
     {
-    Vec3 R = ray.direction;
-    Vec3 Q = ray.origin;
-    double r, s, t;
-    double min = 0.0;
-    double max = max_dist;
-
-    if( R.x > 0 ) // Looking down positive X-axis.
-        {
-        if( Q.x > A.X.max ) return false;
-        r = 1.0 / R.x;
-        s = ( A.X.min - Q.x ) * r; if( s > min ) min = s;
-        t = ( A.X.max - Q.x ) * r; if( t < max ) max = t;
-        }
-    else if( R.x < 0.0 ) // Looking down negative X-axis.
-        {
-        if( Q.x < A.X.min ) return false;
-        r = 1.0 / R.x;
-        s = ( A.X.max - Q.x ) * r; if( s > min ) min = s;
-        t = ( A.X.min - Q.x ) * r; if( t < max ) max = t;
-        }
-    else if( Q.x < A.X.min || Q.x > A.X.max ) return false;
+    Interval I;
+    return Hit( ray, A, I, max_dist );
+    }
 
-    if( min > max ) return false; // Degenerate interval.
+// Clip the interval [min,max] to the part of the ray within the slab S along one
+// axis, given the origin q, the reciprocal direction inv, and its sign (see
+// Ray::Prepare).  The sign selects the near plane and the far plane of the slab
+// without branching, as min and max are consecutive within the interval.  If
+// the ray is parallel to the slab, both distances are infinite, or NaN if the
+// origin is on a plane, in which case the comparisons leave [min,max] alone.
 
-    if( R.y > 0 ) // Looking down positive Y-axis.
-        {
-        if( Q.y > A.Y.max ) return false;
-        r = 1.0 / R.y;
-        s = ( A.Y.min - Q.y ) * r; if( s > min ) min = s;
-        t = ( A.Y.max - Q.y ) * r; if( t < max ) max = t;
-        }
-    else if( R.y < 0 ) // Looking down negative Y-axis.
-        {
-        if( Q.y < A.Y.min ) return false;
-        r = 1.0 / R.y;
-        s = ( A.Y.max - Q.y ) * r; if( s > min ) min = s;
-        t = ( A.Y.min - Q.y ) * r; if( t < max ) max = t;
-        }
-    else if( Q.y < A.Y.min || Q.y > A.Y.max ) return false;
+static inline void Clip( const Interval &S, double q, double inv, int sign, double &min, double &max )
+    {
+    const real *planes = &S.min;
+    const double s = ( planes[    sign ] - q ) * inv;
+    const double t = ( planes[ 1 - sign ] - q ) * inv;
+    if( s > min ) min = s;
+    if( t < max ) max = t;
+    }
 
-    if( min > max ) return false; // Degenerate interval.
+// As above, but also report the interval of distances along the ray, clipped
+// to [0,max_dist], for which the ray is within the box.  This is the slab test,
+// using the reciprocal direction cached in the ray.
 
-    if( R.z > 0 ) // Looking down positive Z-axis.
-        {
-        if( Q.z > A.Z.max ) return false;
-        r = 1.0 / R.z;
-        s = ( A.Z.min - Q.z ) * r; if( s > min ) min = s;
-        t = ( A.Z.max - Q.z ) * r; if( t < max ) max = t;
-        }
-    else if( R.z < 0 ) // Looking down negative Z-axis.
-        {
-        if( Q.z < A.Z.min ) return false;
-        r = 1.0 / R.z;
-        s = ( A.Z.max - Q.z ) * r; if( s > min ) min = s;
-        t = ( A.Z.min - Q.z ) * r; if( t < max ) max = t;
-        }
-    else if( Q.z < A.Z.min || Q.z > A.Z.max ) return false;
+bool Hit( const Ray &ray, const AABB &A, Interval &I, double max_dist )
+    {
+    STAT_COUNT( stat_box_tests );
+    double min = 0.0;
+    double max = max_dist;
+    Clip( A.X, ray.origin.x, ray.inv_dir[0], ray.sign[0], min, max );
+    Clip( A.Y, ray.origin.y, ray.inv_dir[1], ray.sign[1], min, max );
+    Clip( A.Z, ray.origin.z, ray.inv_dir[2], ray.sign[2], min, max );
 
     // There is a hit if and only if the intersection interval [min,max]
     // is not degenerate.
+    I = Interval( min, max );
     return min <= max;
     }
 
@@ -6,6 +6,7 @@
 * such as those that translate or expand the box.                          *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Ray-box test can report the interval within the box.       *
 *   12/10/2004  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -92,6 +93,13 @@ extern bool Hit(   // Does the ray r intersect the box A?
     double max_dist = Infinity
     );
 
+extern bool Hit(   // As above, also returning the part of the ray within A.
+    const Ray &r,
+    const AABB &A,
+    Interval &I,
+    double max_dist = Infinity
+    );
+
 extern bool Inside(  // Is the point P inside (or on) the box A?
     const Vec3 &P,
     const AABB &A
@@ -7,38 +7,95 @@
 * ordering of the objects.  That is, the hierarchy depends upon the order  *
 * in which the objects are inserted.                                       *
 *                                                                          *
+* When its children move (as in an animation), the hierarchy is refit:     *
+* the boxes are recomputed bottom-up, keeping the same tree.  The expected *
+* cost of the tree grows as the boxes drift apart, so once it exceeds the  *
+* cost of the last full build by the given ratio, the tree is built anew.  *
+* Usage:                                                                   *
+*                                                                          *
+*    begin abvh [unpacked] [refit R]                                       *
+*                                                                          *
+* where R defaults to 1.3, and zero means always to build anew.            *
+*                                                                          *
 * History:                                                                 *
+*   10/18/2026  Batches keep their scratch indices on the stack.           *
+*   10/18/2026  The hierarchy is freed with the abvh.                      *
+*   10/18/2026  Rebuild refits the boxes unless the tree has degraded.     *
+*   10/18/2026  Added Rebuild, for children that have moved.               *
+*   10/18/2026  Packets use the reciprocal directions cached in the rays.  *
+*   10/18/2026  Cost is now the expected cost of a ray that hits the box.  *
+*   10/18/2026  Leaves hold spheres & triangles packed four at a time.     *
+*   10/18/2026  Coherent batches are traversed as packets of rays.         *
+*   10/18/2026  Added batched intersection.                                *
 *   10/09/2005  Ported from a previous ray tracer.                         *
 *                                                                          *
 ***************************************************************************/
 #include "toytracer.h"
 #include "util.h"
 #include "params.h"
+#include "packed.h"
+#include "trace.h"
 
 struct node;  // The building-block of the hierarchy.
 
+// Rays of a batch are traversed in packets of this many.  When fewer than a
+// quarter of a packet survive a box test, the survivors finish the sub-tree
+// one at a time.
+static const unsigned packet_size = 16;
+
+// Batches keep one packet of indices per level of the hierarchy on the
+// stack.  The rare hierarchy deeper than this is traced one ray at a time.
+static const unsigned max_batch_depth = 64;
+
+static unsigned Depth( const node * );
+static void Delete( node * );
+static void Refit( node * );
+
+// By default, the tree is built anew when refitting has raised its expected
+// cost by 30 percent.
+static const double default_refit = 1.3;
+
 struct abvh : public Aggregate { 
-    abvh() { root = NULL; }
-   ~abvh() {}
+    abvh( bool pack = true, double refit = default_refit ) { root = NULL; depth = 0; packed = pack; refit_ratio = refit; built_cost = 0.0; }
+   ~abvh() { Delete( root ); }
     virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual void IntersectBatch( const RayBatch &, const unsigned *, unsigned, HitInfo * ) const;
     virtual bool Inside( const Vec3 & ) const;
     virtual Interval GetSlab( const Vec3 & ) const;
     virtual Plugin *ReadString( const string &params );
     virtual string MyName() const { return "abvh"; }
     virtual void Close();
+    virtual void Rebuild();
     virtual double Cost() const;
     static bool Branch_and_Bound( node*, node*, node*&, double& ); 
     void Insert( const Object *, double relative_cost = 1.0 );
+    void Build();
     node *root;
+    unsigned depth; // Depth of the hierarchy; the root alone has depth 1.
+    bool packed;    // Pack spheres & triangles for SIMD intersection.
+    double refit_ratio; // Largest growth in cost allowed by refitting.
+    double built_cost;  // Cost of the tree when it was last built.
     };
 
 REGISTER_PLUGIN( abvh );
 
 Plugin *abvh::ReadString( const string &params )
     {
-    // The abvh aggregate object needs no parameters.
+    // The parameter "unpacked" puts each primitive in a leaf of its own
+    // rather than packing nearby spheres & triangles together.
     ParamReader get( params );
-    if( get["begin"] && get[MyName()] ) return new abvh();
+    if( get["begin"] && get[MyName()] )
+        {
+        bool   pack  = true;
+        double refit = default_refit;
+        for(;;)
+            {
+            if( get["unpacked"] ) { pack = false; continue; }
+            if( get["refit"] && get[refit] ) continue;
+            break;
+            }
+        return new abvh( pack, refit );
+        }
     return NULL;
     }
 
@@ -49,6 +106,15 @@ Plugin *abvh::ReadString( const string &params )
 void abvh::Close()
     {
     // Should "randomize" here...
+    if( packed ) PackPrimitives( children );
+    Build();
+    }
+
+// Insert all the children into an empty hierarchy.
+void abvh::Build()
+    {
+    Delete( root );
+    root = NULL;
     for( unsigned i = 0; i < NumChildren(); i++ )
         {
         const Object *obj = GetChild(i);
@@ -56,6 +122,25 @@ void abvh::Close()
         // this object as we insert it into the existing bvh.
         Insert( obj, obj->Cost() );
         }
+    depth = Depth( root );
+    built_cost = Cost();
+    }
+
+// Some of the children have moved.  Refitting the boxes takes time linear
+// in the size of the tree, and keeps its structure, which was chosen for
+// where the children were when it was built.  Once the expected cost shows
+// that the structure no longer suits them, the tree is built anew.  The
+// children were packed when the object was closed, and stay packed.
+void abvh::Rebuild()
+    {
+    if( root != NULL && refit_ratio > 0.0 )
+        {
+        TraceSpan span( "refit abvh", "build" );
+        Refit( root );
+        if( Cost() <= refit_ratio * built_cost ) return;
+        }
+    TraceSpan span( "build abvh", "build" );
+    Build();
     }
 
 // The node struct forms all of the nodes in the bounding volume hierarchy,
@@ -116,6 +201,235 @@ inline const node *node_iterator::Next()
     return curr;
     }
 
+// Return the number of levels in the hierarchy rooted at n.
+static unsigned Depth( const node *n )
+    {
+    if( n == NULL ) return 0;
+    unsigned deepest = 0;
+    for( const node *c = n->child; c != NULL; c = c->sibling )
+        {
+        const unsigned d = Depth( c );
+        if( d > deepest ) deepest = d;
+        }
+    return deepest + 1;
+    }
+
+// Recompute the boxes of the hierarchy rooted at n from those of the objects
+// in its leaves, along with the costs that depend upon their areas.  The
+// external costs do not depend on the boxes, so they are left as they are.
+static void Refit( node *n )
+    {
+    if( n->Leaf() )
+        {
+        n->bbox = GetBox( *n->object );
+        n->SA   = SurfaceArea( n->bbox );
+        n->AIC  = n->SEC_ * n->SA; // The relative cost of the object.
+        return;
+        }
+    n->bbox = AABB::Null();
+    n->SAIC = 0.0;
+    for( node *c = n->child; c != NULL; c = c->sibling )
+        {
+        Refit( c );
+        n->bbox << c->bbox;
+        n->SAIC += c->AIC;
+        }
+    n->SA  = SurfaceArea( n->bbox );
+    n->AIC = n->SA * n->SEC_ + n->SAIC;
+    }
+
+// Free the hierarchy rooted at n, but not the objects in its leaves.
+static void Delete( node *n )
+    {
+    if( n == NULL ) return;
+    node *c = n->child;
+    while( c != NULL )
+        {
+        node *next = c->sibling;
+        Delete( c );
+        c = next;
+        }
+    delete n;
+    }
+
+// Intersect the active rays of a batch with the sub-tree rooted at n.  Rays
+// that miss the bounding box of an internal node are dropped from the batch
+// before descending, so each box is visited once per batch rather than once
+// per ray.  The surviving indices of each level are written into "scratch",
+// which has room for one batch per level of the hierarchy.
+static void IntersectNode( const node *n, const RayBatch &batch, const unsigned *active, unsigned count,
+                           HitInfo *hits, unsigned *scratch )
+    {
+    if( n->Leaf() )
+        {
+        n->object->IntersectBatch( batch, active, count, hits );
+        return;
+        }
+    STAT_COUNT( stat_node_visits );
+    unsigned live = 0;
+    for( unsigned k = 0; k < count; k++ )
+        {
+        const unsigned i = active[k];
+        if( Hit( batch.rays[i], n->bbox, hits[i].distance ) ) scratch[ live++ ] = i;
+        }
+    if( live == 0 ) return;
+    for( const node *c = n->child; c != NULL; c = c->sibling )
+        IntersectNode( c, batch, scratch, live, hits, scratch + live );
+    }
+
+// Intersect a single ray with the sub-tree rooted at n.  This is used for the
+// rays of a packet that has diverged.
+static void IntersectSubtree( const node *n, const Ray &ray, HitInfo &hitinfo )
+    {
+    if( n->Leaf() )
+        {
+        n->object->Intersect( ray, hitinfo );
+        return;
+        }
+    STAT_COUNT( stat_node_visits );
+    if( Hit( ray, n->bbox, hitinfo.distance ) )
+        {
+        for( const node *c = n->child; c != NULL; c = c->sibling )
+            IntersectSubtree( c, ray, hitinfo );
+        }
+    }
+
+// A ray_packet bounds a group of rays using interval arithmetic: the origins
+// of all the rays lie within the box "org", and the reciprocals of their
+// direction components lie within the intervals of "inv".  The packet is
+// coherent only if the rays agree on the sign of each direction component,
+// which is what keeps the reciprocals bounded.
+struct ray_packet {
+    Interval org[3];
+    Interval inv[3];
+    bool coherent;
+    };
+
+static void MakePacket( const RayBatch &batch, const unsigned *active, unsigned count, ray_packet &packet )
+    {
+    const vector<double> *Q[] = { &batch.Qx, &batch.Qy, &batch.Qz };
+    const vector<double> *R[] = { &batch.Rx, &batch.Ry, &batch.Rz };
+    packet.coherent = true;
+    for( int a = 0; a < 3; a++ )
+        {
+        packet.org[a] = Interval::Null();
+        packet.inv[a] = Interval::Null();
+        const double sign = (*R[a])[ active[0] ];
+        for( unsigned k = 0; k < count; k++ )
+            {
+            const unsigned i = active[k];
+            const double r = (*R[a])[i];
+            if( r == 0.0 || ( r > 0.0 ) != ( sign > 0.0 ) ) packet.coherent = false;
+            else packet.inv[a] << batch.rays[i].inv_dir[a];
+            packet.org[a] << (*Q[a])[i];
+            }
+        }
+    }
+
+// The product of two intervals.
+static inline Interval Product( const Interval &A, const Interval &B )
+    {
+    const double a = A.min * B.min, b = A.min * B.max;
+    const double c = A.max * B.min, d = A.max * B.max;
+    return Interval( min( min( a, b ), min( c, d ) ), max( max( a, b ), max( c, d ) ) );
+    }
+
+// Determine whether every ray of a coherent packet misses the box (or hits it
+// beyond max_dist).  Along each axis the parametric distances to the near and
+// far planes are bounded by interval arithmetic; if the latest possible entry
+// exceeds the earliest possible exit, no ray of the packet can hit the box.
+static bool Miss( const ray_packet &packet, const AABB &box, double max_dist )
+    {
+    STAT_COUNT( stat_box_tests );
+    const Interval *slab[] = { &box.X, &box.Y, &box.Z };
+    double t_min = 0.0;
+    double t_max = max_dist;
+    for( int a = 0; a < 3; a++ )
+        {
+        const bool positive = packet.inv[a].min > 0.0;
+        const double near_plane = positive ? slab[a]->min : slab[a]->max;
+        const double far_plane  = positive ? slab[a]->max : slab[a]->min;
+        const Interval &O = packet.org[a];
+        const Interval t_near( Product( Interval( near_plane - O.max, near_plane - O.min ), packet.inv[a] ) );
+        const Interval t_far ( Product( Interval( far_plane  - O.max, far_plane  - O.min ), packet.inv[a] ) );
+        if( t_near.min > t_min ) t_min = t_near.min;
+        if( t_far .max < t_max ) t_max = t_far .max;
+        if( t_min > t_max ) return true;
+        }
+    return false;
+    }
+
+// Intersect a coherent packet of rays with the sub-tree rooted at n.  If the
+// first active ray hits the box of a node, the entire packet descends without
+// testing the other rays.  Otherwise the packet as a whole is tested against
+// the box, and only if that fails to cull it are the rays tested individually.
+// Rays that survive are written into "scratch", which has room for one packet
+// per level of the hierarchy.
+static void IntersectPacket( const node *n, const RayBatch &batch, const ray_packet &packet,
+                             const unsigned *active, unsigned count, HitInfo *hits, unsigned *scratch )
+    {
+    if( n->Leaf() )
+        {
+        n->object->IntersectBatch( batch, active, count, hits );
+        return;
+        }
+    STAT_COUNT( stat_node_visits );
+    const unsigned first = active[0];
+    if( !Hit( batch.rays[first], n->bbox, hits[first].distance ) )
+        {
+        double max_dist = 0.0;
+        for( unsigned k = 1; k < count; k++ ) max_dist = max( max_dist, hits[ active[k] ].distance );
+        if( Miss( packet, n->bbox, max_dist ) ) return;
+        unsigned live = 0;
+        for( unsigned k = 1; k < count; k++ )
+            {
+            const unsigned i = active[k];
+            if( Hit( batch.rays[i], n->bbox, hits[i].distance ) ) scratch[ live++ ] = i;
+            }
+        if( live == 0 ) return;
+        if( live < packet_size / 4 )
+            {
+            // The packet has diverged; finish the sub-tree one ray at a time.
+            for( unsigned k = 0; k < live; k++ )
+                {
+                const unsigned i = scratch[k];
+                for( const node *c = n->child; c != NULL; c = c->sibling )
+                    IntersectSubtree( c, batch.rays[i], hits[i] );
+                }
+            return;
+            }
+        active = scratch;
+        count  = live;
+        }
+    for( const node *c = n->child; c != NULL; c = c->sibling )
+        IntersectPacket( c, batch, packet, active, count, hits, scratch + packet_size );
+    }
+
+// The active rays are split into packets of consecutive rays; the caller
+// should therefore order the batch so that neighbouring rays are coherent
+// (e.g. the rays of small square blocks of pixels).  Packets whose rays do
+// not agree in direction are culled ray-by-ray instead.
+void abvh::IntersectBatch( const RayBatch &batch, const unsigned *active, unsigned n, HitInfo *hits ) const
+    {
+    if( root == NULL || n == 0 ) return;
+    if( depth > max_batch_depth )
+        {
+        for( unsigned k = 0; k < n; k++ )
+            IntersectSubtree( root, batch.rays[ active[k] ], hits[ active[k] ] );
+        return;
+        }
+    unsigned scratch[ packet_size * max_batch_depth ];
+    ray_packet packet;
+    for( unsigned k = 0; k < n; k += packet_size )
+        {
+        const unsigned count = min( packet_size, n - k );
+        MakePacket( batch, active + k, count, packet );
+        if( packet.coherent )
+             IntersectPacket( root, batch, packet, active + k, count, hits, scratch );
+        else IntersectNode  ( root, batch, active + k, count, hits, scratch );
+        }
+    }
+
 bool abvh::Intersect( const Ray &ray, HitInfo &hitinfo ) const
     {
     // Walk the bounding volume hierarchy intersecting, descending down a
@@ -135,8 +449,12 @@ bool abvh::Intersect( const Ray &ray, HitInfo &hitinfo ) const
                 }
             iter.Next();
             }
-        else if( Hit( ray, iter.Curr()->bbox, closest_hit ) ) iter.Next();
-        else iter.SkipChildren();
+        else
+            {
+            STAT_COUNT( stat_node_visits );
+            if( Hit( ray, iter.Curr()->bbox, closest_hit ) ) iter.Next();
+            else iter.SkipChildren();
+            }
         }
     return found_a_hit;
     }
@@ -203,11 +521,15 @@ void abvh::Insert( const Object *obj, double relative_cost )
     insert_here->AddChild( n );
     }
 
-// Estimate the average cost of intersecting a ray with this object.
+// Estimate the average cost of intersecting a ray with this object.  The
+// adjusted internal cost of the root weights the cost of each node by its
+// surface area, so dividing by the area of the root gives the expected cost
+// for a ray that hits the root box.
 double abvh::Cost() const
     {
     if( root == NULL ) return 1.0;
-    return root->EC + root->SA * root->AIC;
+    if( root->SA <= 0.0 ) return root->EC + root->SEC_;
+    return root->EC + root->AIC / root->SA;
     }
 
 // Initialize all the fields of the new abvh object.
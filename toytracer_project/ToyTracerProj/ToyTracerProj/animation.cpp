@@ -0,0 +1,358 @@
+/***************************************************************************
+* animation.cpp                                                            *
+*                                                                          *
+* Keyframed animation of the camera and of named transforms, and the       *
+* rendering of a numbered sequence of frames from a scene built once.      *
+* The scene is shared by all the frames, so that only the camera and the   *
+* transforms change, and the aggregates enclosing moved transforms are     *
+* rebuilt in place.  See animation.h for the format of the keys.           *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include "toytracer.h"
+#include "params.h"
+#include "util.h"
+#include "trace.h"
+#include "animation.h"
+
+// Is the line blank, or only a comment?
+static bool Skip( const string &line )
+    {
+    for( unsigned i = 0; i < line.size() && line[i] != '#'; i++ )
+        {
+        if( line[i] != ' ' && line[i] != '\t' && line[i] != '\r' ) return false;
+        }
+    return true;
+    }
+
+// Find the motions' transforms within the object, recording the aggregates
+// that enclose each.  Prototypes are skipped, as their geometry is shared
+// by all their instances.
+static void Find( Object *obj, vector<Aggregate*> &path, Animation &anim )
+    {
+    Aggregate *agg = dynamic_cast<Aggregate*>( obj );
+    if( agg == NULL || agg->Prototype() ) return;
+    transform *t = dynamic_cast<transform*>( obj );
+    if( t != NULL && !t->name.empty() )
+        {
+        for( unsigned m = 0; m < anim.motions.size(); m++ )
+            {
+            if( anim.motions[m].name != t->name ) continue;
+            anim.motions[m].object = t;
+            anim.motions[m].base   = t->matrix;
+            anim.motions[m].enclosing.assign( path.rbegin(), path.rend() );
+            }
+        }
+    path.push_back( agg );
+    if( t != NULL ) Find( t->object, path, anim );
+    else for( unsigned i = 0; i < agg->NumChildren(); i++ )
+        Find( const_cast<Object*>( agg->GetChild(i) ), path, anim );
+    path.pop_back();
+    }
+
+bool ReadAnimation( const string &file_name, const Camera &camera, const Scene &scene, Animation &anim )
+    {
+    std::ifstream fin( file_name.c_str() );
+    if( fin.fail() )
+        {
+        cerr << "Error: Could not open file " << file_name << endl;
+        return false;
+        }
+    cout << "Reading " << file_name << "... ";
+    cout.flush();
+
+    // Each key starts from the one before it, so the keys of the camera, and
+    // of each transform, must come in order of frame.
+    string line;
+    unsigned line_num = 0;
+    while( std::getline( fin, line ) )
+        {
+        line_num++;
+        if( Skip( line ) ) continue;
+        ParamReader get( line + " " );
+        unsigned frame = 0;
+        string name;
+        bool known = true;
+        if( get["frames"] && get[anim.frames] ) {}
+        else if( get["camera"] && get[frame] )
+            {
+            camera_key key;
+            key.frame  = frame;
+            key.camera = anim.cameras.empty() ? camera : anim.cameras.back().camera;
+            if( !anim.cameras.empty() && frame <= anim.cameras.back().frame )
+                {
+                cerr << "Error: Keys out of order.  Line " << line_num << ": " << line << endl;
+                return false;
+                }
+            for(;;)
+                {
+                if( get["eye"]    && get[key.camera.eye]    ) continue;
+                if( get["lookat"] && get[key.camera.lookat] ) continue;
+                if( get["up"]     && get[key.camera.up]     ) continue;
+                if( get["vpdist"] && get[key.camera.vpdist] ) continue;
+                break;
+                }
+            anim.cameras.push_back( key );
+            }
+        else if( get["transform"] && get.Word( name ) && get[frame] )
+            {
+            unsigned m = 0;
+            while( m < anim.motions.size() && anim.motions[m].name != name ) m++;
+            if( m == anim.motions.size() )
+                {
+                motion mo;
+                mo.name   = name;
+                mo.object = NULL;
+                anim.motions.push_back( mo );
+                }
+            motion &mo = anim.motions[m];
+            motion_key key;
+            if( mo.keys.empty() )
+                {
+                key.translate = Vec3( 0, 0, 0 );
+                key.axis      = Vec3( 0, 0, 1 );
+                key.angle     = 0.0;
+                key.scale     = 1.0;
+                }
+            else if( frame > mo.keys.back().frame ) key = mo.keys.back();
+            else
+                {
+                cerr << "Error: Keys out of order.  Line " << line_num << ": " << line << endl;
+                return false;
+                }
+            key.frame = frame;
+            for(;;)
+                {
+                if( get["translate"] && get[key.translate] ) continue;
+                if( get["rotate"]    && get[key.axis] && get[key.angle] ) continue;
+                if( get["scale"]     && get[key.scale]     ) continue;
+                break;
+                }
+            mo.keys.push_back( key );
+            }
+        else known = false;
+
+        // Anything left over was not understood.
+        if( !known || get.Word( name ) )
+            {
+            cerr << "Error: Unrecognized key.  Line " << line_num << ": " << line << endl;
+            return false;
+            }
+        }
+    cout << "done." << endl;
+
+    // With no camera keys, the camera stays where the sdf file put it.  The
+    // animation runs to the last key, unless told otherwise.
+    if( anim.cameras.empty() )
+        {
+        camera_key key;
+        key.frame  = 0;
+        key.camera = camera;
+        anim.cameras.push_back( key );
+        }
+    if( anim.frames == 0 )
+        {
+        anim.frames = anim.cameras.back().frame + 1;
+        for( unsigned m = 0; m < anim.motions.size(); m++ )
+            anim.frames = max( anim.frames, anim.motions[m].keys.back().frame + 1 );
+        }
+
+    // Find the transforms, and gather the aggregates to be rebuilt when they
+    // move.  An aggregate must be rebuilt after everything nested within it,
+    // so they are ordered by depth, deepest first.
+    vector<Aggregate*> path;
+    Find( scene.object, path, anim );
+    vector< std::pair<unsigned,Aggregate*> > stale;
+    for( unsigned m = 0; m < anim.motions.size(); m++ )
+        {
+        const motion &mo = anim.motions[m];
+        if( mo.object == NULL )
+            {
+            cerr << "Error: There is no transform named " << mo.name << " in the scene." << endl;
+            return false;
+            }
+        for( unsigned k = 0; k < mo.enclosing.size(); k++ )
+            stale.push_back( std::make_pair( unsigned( mo.enclosing.size() - k ), mo.enclosing[k] ) );
+        }
+    std::sort( stale.rbegin(), stale.rend() );
+    anim.stale.clear();
+    for( unsigned i = 0; i < stale.size(); i++ )
+        {
+        if( std::find( anim.stale.begin(), anim.stale.end(), stale[i].second ) == anim.stale.end() )
+            anim.stale.push_back( stale[i].second );
+        }
+    return true;
+    }
+
+// Find the keys either side of the frame, and how far it is from the first
+// to the second.  Before the first key and after the last, the nearest key
+// is used alone.
+static unsigned Segment( const vector<unsigned> &frames, unsigned frame, double &t )
+    {
+    const unsigned n = frames.size();
+    t = 0.0;
+    if( frame <= frames[0] ) return 0;
+    if( frame >= frames[n-1] ) return n - 1;
+    unsigned k = 0;
+    while( frames[k+1] <= frame ) k++;
+    t = double( frame - frames[k] ) / double( frames[k+1] - frames[k] );
+    return k;
+    }
+
+// The Catmull-Rom spline from P1 (at t = 0) to P2 (at t = 1), with tangents
+// taken from the points either side.
+static Vec3 CatmullRom( const Vec3 &P0, const Vec3 &P1, const Vec3 &P2, const Vec3 &P3, double t )
+    {
+    const double t2 = t * t;
+    const double t3 = t * t2;
+    return 0.5 * ( 2.0 * P1
+                 + t  * ( P2 - P0 )
+                 + t2 * ( 2.0 * P0 - 5.0 * P1 + 4.0 * P2 - P3 )
+                 + t3 * ( 3.0 * P1 - P0 - 3.0 * P2 + P3 ) );
+    }
+
+static Vec3 Lerp( const Vec3 &A, const Vec3 &B, double t )
+    {
+    return ( 1.0 - t ) * A + t * B;
+    }
+
+static double Lerp( double a, double b, double t )
+    {
+    return ( 1.0 - t ) * a + t * b;
+    }
+
+// Rotation by the angle (in radians) about the unit axis, by Rodrigues' formula.
+static Mat3x3 Rotation( const Vec3 &u, double angle )
+    {
+    const double c = cos( angle );
+    const double s = sin( angle );
+    const double d = 1.0 - c;
+    Mat3x3 R;
+    R(0,0) = c + d * u.x * u.x;        R(0,1) = d * u.x * u.y - s * u.z;  R(0,2) = d * u.x * u.z + s * u.y;
+    R(1,0) = d * u.y * u.x + s * u.z;  R(1,1) = c + d * u.y * u.y;        R(1,2) = d * u.y * u.z - s * u.x;
+    R(2,0) = d * u.z * u.x - s * u.y;  R(2,1) = d * u.z * u.y + s * u.x;  R(2,2) = c + d * u.z * u.z;
+    return R;
+    }
+
+Camera CameraAt( const Animation &anim, unsigned frame )
+    {
+    const vector<camera_key> &keys = anim.cameras;
+    const unsigned n = keys.size();
+    vector<unsigned> frames( n );
+    for( unsigned k = 0; k < n; k++ ) frames[k] = keys[k].frame;
+    double t;
+    const unsigned k = Segment( frames, frame, t );
+    const Camera &C0 = keys[ k > 0 ? k - 1 : k ].camera;
+    const Camera &C1 = keys[ k ].camera;
+    const Camera &C2 = keys[ min( k + 1, n - 1 ) ].camera;
+    const Camera &C3 = keys[ min( k + 2, n - 1 ) ].camera;
+    Camera cam( C1 );
+    cam.eye    = CatmullRom( C0.eye,    C1.eye,    C2.eye,    C3.eye,    t );
+    cam.lookat = CatmullRom( C0.lookat, C1.lookat, C2.lookat, C3.lookat, t );
+    cam.up     = Lerp( C1.up,     C2.up,     t );
+    cam.vpdist = Lerp( C1.vpdist, C2.vpdist, t );
+    return cam;
+    }
+
+void PoseScene( const Animation &anim, unsigned frame )
+    {
+    for( unsigned m = 0; m < anim.motions.size(); m++ )
+        {
+        const motion &mo = anim.motions[m];
+        const unsigned n = mo.keys.size();
+        vector<unsigned> frames( n );
+        for( unsigned k = 0; k < n; k++ ) frames[k] = mo.keys[k].frame;
+        double t;
+        const unsigned k = Segment( frames, frame, t );
+        const motion_key &K0 = mo.keys[ k > 0 ? k - 1 : k ];
+        const motion_key &K1 = mo.keys[ k ];
+        const motion_key &K2 = mo.keys[ min( k + 1, n - 1 ) ];
+        const motion_key &K3 = mo.keys[ min( k + 2, n - 1 ) ];
+        const Vec3   translate = CatmullRom( K0.translate, K1.translate, K2.translate, K3.translate, t );
+        const Vec3   axis      = Lerp( K1.axis, K2.axis, t );
+        const double angle     = Lerp( K1.angle, K2.angle, t ) * ( Pi / 180.0 );
+        const double s         = Lerp( K1.scale, K2.scale, t );
+        const Mat3x3 R( LengthSquared( axis ) > 0.0 ? Rotation( Unit( axis ), angle ) : Mat3x3::Identity() );
+        mo.object->SetMatrix( Mat3x4( R * Scale( s, s, s ) * mo.base.mat, mo.base.vec + translate ) );
+        }
+    for( unsigned i = 0; i < anim.stale.size(); i++ ) anim.stale[i]->Rebuild();
+    }
+
+// Everything the rendering threads need to know, along with the shared
+// counter from which they draw the next frame to render.
+struct animation_job {
+    const Animation *anim;
+    const Scene     *scene;
+    string           output;
+    unsigned         last;
+    std::atomic<unsigned> next_frame;
+    std::atomic<bool>     failed;
+    };
+
+static string FrameName( const string &output, unsigned frame )
+    {
+    std::stringstream name;
+    name << output << "_" << std::setw( 4 ) << std::setfill( '0' ) << frame;
+    return name.str();
+    }
+
+static void RenderFrames( animation_job *job )
+    {
+    const Animation &anim = *job->anim;
+    const Scene &scene = *job->scene;
+    for(;;)
+        {
+        const unsigned frame = job->next_frame++;
+        if( frame > job->last ) break;
+        TraceSpan span( "frame", "animation", frame );
+        if( !anim.motions.empty() )
+            {
+            TraceSpan pose( "pose scene", "animation", frame );
+            PoseScene( anim, frame );
+            }
+        if( !scene.rasterize->Rasterize( FrameName( job->output, frame ), CameraAt( anim, frame ), scene, scene, false ) )
+            job->failed = true;
+        }
+    }
+
+bool RenderAnimation( const string &output, const Animation &anim, const Scene &scene,
+                      unsigned first, unsigned last, unsigned jobs )
+    {
+    if( first > last ) return true;
+
+    // Moving transforms rebuilds aggregates that the other frames would be
+    // tracing, so then the frames are rendered one at a time.
+    if( !anim.motions.empty() ) jobs = 1;
+    else if( jobs == 0 )
+        {
+        const unsigned cores = std::thread::hardware_concurrency();
+        jobs = max( 1.0, double( cores / scene.rasterize->Threads() ) );
+        }
+    if( jobs > last - first + 1 ) jobs = last - first + 1;
+
+    cout << "Rendering frames " << first << " to " << last << ", "
+         << jobs << " at a time, as " << FrameName( output, first ) << ".ppm..." << endl;
+
+    animation_job job;
+    job.anim   = &anim;
+    job.scene  = &scene;
+    job.output = output;
+    job.last   = last;
+    job.next_frame = first;
+    job.failed     = false;
+
+    // The calling thread renders frames too.
+    vector<std::thread> pool;
+    for( unsigned t = 1; t < jobs; t++ ) pool.push_back( std::thread( RenderFrames, &job ) );
+    RenderFrames( &job );
+    for( unsigned t = 0; t < pool.size(); t++ ) pool[t].join();
+    return !job.failed;
+    }
@@ -0,0 +1,109 @@
+/***************************************************************************
+* animation.h                                                              *
+*                                                                          *
+* Renders a sequence of frames from a scene that is built only once.  The  *
+* camera, and any transforms given names in the sdf file, are moved from   *
+* frame to frame by interpolating between keyframes, which are read from   *
+* an animation file such as this:                                          *
+*                                                                          *
+*    frames 48                                                             *
+*    camera 0   eye (5,-2,2.8) lookat (0,1.1,0.25)                         *
+*    camera 24  eye (-2,5,2.8)                                             *
+*    camera 47  eye (5,-2,2.8)                                             *
+*    transform arm 0   rotate (0,0,1) 0                                    *
+*    transform arm 47  rotate (0,0,1) 90  translate (0,0,1)  scale 1.5     *
+*                                                                          *
+* A camera key may set the eye, lookat, up and vpdist; a transform key may *
+* set a translation, a rotation (an axis & an angle in degrees) and a      *
+* uniform scale factor.  Whatever a key leaves out is carried over from    *
+* the key before it, or from the sdf file.  Positions follow Catmull-Rom   *
+* splines through the keys, while directions, angles and scales are        *
+* interpolated linearly.  A transform is rotated & scaled about the origin *
+* of its own space, then translated, all on top of its matrix in the sdf.  *
+*                                                                          *
+* The frames are written as OUTPUT_0000.ppm, OUTPUT_0001.ppm, and so on.   *
+* If only the camera moves, several frames are rendered at once on cores   *
+* that the rasterizer leaves idle; if transforms move, the aggregates that *
+* hold them are rebuilt before each frame (an abvh just refits its boxes,  *
+* unless that has made it much worse), and frames are rendered one at a    *
+* time.  See main.cpp for the options.                                     *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Notes that an abvh is refit rather than rebuilt.           *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#ifndef __ANIMATION_INCLUDED__
+#define __ANIMATION_INCLUDED__
+
+#include "toytracer.h"
+#include "transform.h"
+
+struct camera_key {
+    unsigned frame;
+    Camera   camera;
+    };
+
+struct motion_key {
+    unsigned frame;
+    Vec3     translate;
+    Vec3     axis;
+    double   angle;   // In degrees.
+    double   scale;
+    };
+
+// The keys of one named transform, along with the matrix it was given in
+// the sdf file and the aggregates that enclose it, innermost first.
+struct motion {
+    string     name;
+    transform *object;
+    Mat3x4     base;
+    vector<motion_key> keys;
+    vector<Aggregate*> enclosing;
+    };
+
+struct Animation {
+    Animation() { frames = 0; }
+    unsigned frames;
+    vector<camera_key> cameras;  // Sorted by frame.
+    vector<motion>     motions;
+    vector<Aggregate*> stale;    // Aggregates to rebuild after moving, innermost first.
+    };
+
+// Read the animation file, finding the named transforms within the scene.
+// The camera supplies whatever the first camera key leaves out.  Returns
+// false if the file could not be read or names a transform that is not in
+// the scene.
+extern bool ReadAnimation(
+    const string &file_name,
+    const Camera &camera,
+    const Scene &scene,
+    Animation &anim
+    );
+
+// The camera at the given frame.
+extern Camera CameraAt(
+    const Animation &anim,
+    unsigned frame
+    );
+
+// Move the named transforms to where they are at the given frame, and bring
+// the aggregates above them up to date.
+extern void PoseScene(
+    const Animation &anim,
+    unsigned frame
+    );
+
+// Render frames "first" through "last" with the scene's rasterizer, running
+// up to "jobs" frames at once (zero picks the number from the cores left idle
+// by the rasterizer).  Returns false if any frame could not be rendered.
+extern bool RenderAnimation(
+    const string &output,
+    const Animation &anim,
+    const Scene &scene,
+    unsigned first,
+    unsigned last,
+    unsigned jobs
+    );
+
+#endif
@@ -6,6 +6,9 @@
 * for defining some fundamental structures and constants.                  *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Added an error code for bad command-line arguments.        *
+*   10/18/2026  Added an error code for failed image comparisons.          *
+*   10/18/2026  Added the "real" type & the single-precision option.       *
 *   12/11/2004  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -48,6 +51,24 @@ struct Scene;      // The camera, lights, object(s), etc.
 struct Rasterizer; // The function that casts primary rays & creates an image.
 struct Builder;    // Builds the scene, usually by reading a file (e.g. sdf).
 
+// The precision in which points, vectors, colors, intervals and matrices
+// are stored, and hence the precision of all geometry and acceleration
+// structures.  Define TOYTRACER_SINGLE_PRECISION (e.g. in the preprocessor
+// definitions of the project) to halve their size.  Computations that need
+// more precision to be robust, such as solving the quartic for the torus
+// or inverting the matrix of a transform, are carried out in double
+// precision regardless.  RayEps is the distance by which rays cast from a
+// surface are offset, or within which hits are ignored, which must exceed the
+// round-off in a point of intersection.
+
+#ifdef TOYTRACER_SINGLE_PRECISION
+typedef float  real;
+static const double RayEps = 1.0E-4; // Offset of rays leaving a surface.
+#else
+typedef double real;
+static const double RayEps = 1.0E-6; // Offset of rays leaving a surface.
+#endif
+
 // Miscellaneous numerical constants.
 
 static const double 
@@ -75,7 +96,9 @@ enum toytracer_error {
     error_no_builder,
     error_building_scene,
     error_no_rasterizer,
-    error_rasterizing_image
+    error_rasterizing_image,
+    error_images_differ,       // An image comparison failed its thresholds.
+    error_bad_arguments        // The command line could not be parsed.
     };
 
 #endif
@@ -5,6 +5,10 @@
 * description of a scene and the camera.                                   *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Materials are recorded in the scene, so it can be freed.   *
+*   10/18/2026  Each scene starts with no prototypes defined.              *
+*   10/18/2026  Reading & closing aggregates are timed by trace spans.     *
+*   10/18/2026  Prototypes are not added to the scene; only instances are. *
 *   04/23/2006  The reader is now a "Builder" plugin.                      *
 *   09/29/2005  Updated for 2005 class.                                    *
 *   10/23/2004  Changed handling of default colors.                        *
@@ -17,6 +21,8 @@
 #include "toytracer.h"
 #include "util.h"
 #include "params.h"
+#include "trace.h"
+#include "transform.h"
 
 struct basic_builder : public Builder {
     basic_builder() {}
@@ -45,12 +51,37 @@ static bool Skip( char *line )
     return true;
     }
 
-static Material *Copy( Material* &mat, const Material &material )
+// Is the given aggregate a prototype, or nested within one?  Prototypes are
+// not part of the scene themselves, so neither are the emitters within them.
+static bool InPrototype( const Aggregate *agg )
     {
-    if( mat == NULL || !(*mat == material) ) mat = new Material( material );
+    for( ; agg != NULL; agg = agg->parent )
+        {
+        if( agg->Prototype() ) return true;
+        }
+    return false;
+    }
+
+// Every material made is recorded in the scene, as an aggregate's material
+// is replaced by those of its children, leaving some materials unused.
+static Material *Copy( Material* &mat, const Material &material, Scene &scene )
+    {
+    if( mat == NULL || !(*mat == material) )
+        {
+        mat = new Material( material );
+        scene.materials.push_back( mat );
+        }
     return mat;
     }
 
+// Most aggregates build their hierarchy when they are closed, so the time
+// taken is recorded in the trace.
+static void Close( Aggregate *agg )
+    {
+    TraceSpan span( "close " + agg->MyName(), "build" );
+    agg->Close();
+    }
+
 // This is a very minimal scene description reader.  It assumes that
 // each line contains a complete entity: an object definition, or
 // a camera parameter, or a material parameter, etc.  (Blank lines, and
@@ -74,6 +105,7 @@ bool basic_builder::BuildScene( string file_name, Camera &camera, Scene &scene )
     scene.object    = NULL;
     scene.envmap    = NULL;
     scene.rasterize = NULL;
+    ForgetPrototypes(); // Instances may refer only to prototypes of this scene.
 
     // Attempt to open the input file.
 
@@ -87,6 +119,7 @@ bool basic_builder::BuildScene( string file_name, Camera &camera, Scene &scene )
         }
     cout << "Reading " << file_name << "... ";
     cout.flush();
+    TraceSpan span( "read " + file_name, "build" );
 
     // Set some defaults.
 
@@ -134,7 +167,7 @@ bool basic_builder::BuildScene( string file_name, Camera &camera, Scene &scene )
                     obj = (Object*)plg;
                     obj->shader   = shd;
                     obj->envmap   = env;
-                    obj->material = Copy( mat, material );
+                    obj->material = Copy( mat, material, scene );
                     obj->parent   = agg;
                     if( Emitter( material ) )
                         {
@@ -147,9 +180,9 @@ bool basic_builder::BuildScene( string file_name, Camera &camera, Scene &scene )
                         {
                         // agg->AddChild( obj );
                         // Do not add aggregates as children until they are complete.
-                        agg->material = Copy( mat, material );
+                        agg->material = Copy( mat, material, scene );
                         }
-                    else if( scene.object == NULL ) scene.object = obj;
+                    else if( scene.object == NULL && !((Aggregate *)obj)->Prototype() ) scene.object = obj;
 	            agg = (Aggregate *)obj;
                     break;
 
@@ -157,13 +190,13 @@ bool basic_builder::BuildScene( string file_name, Camera &camera, Scene &scene )
                     obj = (Object*)plg;
                     obj->shader   = shd;
                     obj->envmap   = env;
-                    obj->material = Copy( mat, material );
+                    obj->material = Copy( mat, material, scene );
                     obj->parent   = agg;
-                    if( Emitter( material ) ) scene.lights.push_back( obj );
+                    if( Emitter( material ) && !InPrototype( agg ) ) scene.lights.push_back( obj );
                     if( agg != NULL )
                         {
                         agg->AddChild( obj );
-                        agg->material = Copy( mat, material );
+                        agg->material = Copy( mat, material, scene );
                         }
                     else if( scene.object == NULL ) scene.object = obj;
                     break;
@@ -234,8 +267,8 @@ bool basic_builder::BuildScene( string file_name, Camera &camera, Scene &scene )
             
             // Go back to adding objects to the parent object (if there is one).
 
-            agg->Close(); // Signal the aggregate that it is now complete.
-            Object *closed_agg = agg;
+            Close( agg ); // Signal the aggregate that it is now complete.
+            Aggregate *closed_agg = agg;
             agg = agg->parent;
             if( agg != NULL )
                 {
@@ -243,7 +276,9 @@ bool basic_builder::BuildScene( string file_name, Camera &camera, Scene &scene )
                 mat = agg->material;
                 shd = agg->shader;
                 env = agg->envmap;
-                agg->AddChild( closed_agg ); // Add the agg that just ended.
+                // Add the agg that just ended, unless it is a prototype, which
+                // appears in the scene only by way of its instances.
+                if( !closed_agg->Prototype() ) agg->AddChild( closed_agg );
                 }
             continue;
             }
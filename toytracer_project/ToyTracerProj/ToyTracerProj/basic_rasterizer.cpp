@@ -5,9 +5,20 @@
 * create an image, filling in the resulting matrix of color values (i.e.   *
 * the "raster"), and saving the results as an image file.  This "basic"    *
 * rasterizer simply casts a single ray per pixel and saves the result as   *
-* a PPM image.  It does no anti-aliasing.                                  *
+* a PPM image.  It does no anti-aliasing unless asked to.  Usage:          *
+*                                                                          *
+*    rasterizer basic_rasterizer [samples N] [dof N]                       *
+*                                                                          *
+* where "samples" is the number of jittered rays per pixel, and "dof" the  *
+* number of jittered eye positions per ray, for depth of field (both 1 by  *
+* default).                                                                *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Reports its progress to the caller, row by row.            *
+*   10/18/2026  Parameters it does not take are rejected.                  *
+*   10/18/2026  The numbers of rays per pixel are now parameters.          *
+*   10/18/2026  Writing the image is timed by a trace span.                *
+*   10/18/2026  ToneMap moved to util.cpp so other rasterizers can use it. *
 *   10/03/2005  Made rasterizer a plugin.  Line numbers written in place.  *
 *   12/19/2004  Initial coding.                                            *
 *                                                                          *
@@ -16,23 +27,28 @@
 #include "ppm_image.h"
 #include "params.h"
 #include "util.h"
+#include "trace.h"
 
 /*
 *Deciding on how many rays is tricky. Too few and there is not much anti-aliasing.
 *	Too many and it takes too long to compute. 
 *2000 is a good number once you can wait a while. It should be lowered to 20 though
 *	when you are testing the code. 
+*These are the defaults; "samples" and "dof" override them.
 */
-static const double numRaysAntiAliasing = 1;
-static const double numRaysDepthOfField = 1;
+static const unsigned defaultRaysAntiAliasing = 1;
+static const unsigned defaultRaysDepthOfField = 1;
 
 struct basic_rasterizer : public Rasterizer {
-    basic_rasterizer() {}
+    basic_rasterizer() { numRaysAntiAliasing = defaultRaysAntiAliasing; numRaysDepthOfField = defaultRaysDepthOfField; }
+    basic_rasterizer( unsigned aa, unsigned dof ) { numRaysAntiAliasing = aa; numRaysDepthOfField = dof; }
     virtual ~basic_rasterizer() {}
-    virtual bool Rasterize( string fname, const Camera &, const Scene & , const Scene &, const bool &doMotionBlur) const;
+    virtual bool Rasterize( string fname, const Camera &, const Scene & , const Scene &, const bool &doMotionBlur, RenderProgress * = NULL ) const;
     virtual Plugin *ReadString( const string &params );
     virtual string MyName() const { return "basic_rasterizer"; }
     virtual bool Default() const { return true; }
+    unsigned numRaysAntiAliasing; // Jittered rays per pixel.
+    unsigned numRaysDepthOfField; // Jittered eye positions per ray.
     };
 
 REGISTER_PLUGIN( basic_rasterizer );
@@ -40,31 +56,29 @@ REGISTER_PLUGIN( basic_rasterizer );
 Plugin *basic_rasterizer::ReadString( const string &params ) 
     {
     ParamReader p( params );
-    if( p["rasterizer"] && p[MyName()] ) return new basic_rasterizer();
+    if( p["rasterizer"] && p[MyName()] )
+        {
+        unsigned aa  = defaultRaysAntiAliasing;
+        unsigned dof = defaultRaysDepthOfField;
+        for(;;)
+            {
+            if( p["samples"] && p[aa]  ) continue;
+            if( p["dof"]     && p[dof] ) continue;
+            break;
+            }
+        string extra;
+        if( p.Word( extra ) ) return NULL; // A parameter it does not take.
+        if( aa  == 0 ) aa  = 1;
+        if( dof == 0 ) dof = 1;
+        return new basic_rasterizer( aa, dof );
+        }
     return NULL;
     }
 
-// This is a trivial tone mapper; it merely maps values that are
-// in [0,1] and maps them to integers between 0 and 255.  If the
-// real value is above 1, it merely truncates.  A true tone mapper
-// would attempt to handle very large values nicely, without
-// truncation; that is, it would try to compensate for the fact that
-// displays have a very limited dynamic range.
-static Pixel ToneMap( const Color &color )
-    {
-    int red   = (int)floor( 256 * color.red   );
-    int green = (int)floor( 256 * color.green );
-    int blue  = (int)floor( 256 * color.blue  );
-    channel r = (channel)( red   >= 255 ? 255 : red   ); 
-    channel g = (channel)( green >= 255 ? 255 : green ); 
-    channel b = (channel)( blue  >= 255 ? 255 : blue  );
-    return Pixel( r, g, b );
-    }
-
 // Rasterize casts all the initial rays starting from the eye.
 // This trivial version simply casts one ray per pixel, in raster
 // order, then writes the pixels out to a file.
-bool basic_rasterizer::Rasterize( string file_name, const Camera &cam, const Scene &scene, const Scene &scene2, const bool &doMotionBlur ) const
+bool basic_rasterizer::Rasterize( string file_name, const Camera &cam, const Scene &scene, const Scene &scene2, const bool &doMotionBlur, RenderProgress *progress ) const
     {
     file_name += ".ppm";
 
@@ -129,7 +143,7 @@ bool basic_rasterizer::Rasterize( string file_name, const Camera &cam, const Sce
 				currentColor = Color();
 
 				//shoots multiple rays in the pixel window
-				for(int rayNum = 0; rayNum < numRaysAntiAliasing; rayNum++){
+				for(unsigned rayNum = 0; rayNum < numRaysAntiAliasing; rayNum++){
 
 					//generates a random pair in [0,1]x[0,1] to be used as the current ray
 					if(numRaysAntiAliasing > 1){ //in case we are not doing anti-aliasing
@@ -143,7 +157,7 @@ bool basic_rasterizer::Rasterize( string file_name, const Camera &cam, const Sce
 					imagePlanePoint = cam.eye + focalLength*ray.direction;
 
 					//shoot the ray from different origin points for depth of field effect
-					for(int dofNum = 0; dofNum < numRaysDepthOfField; dofNum++){
+					for(unsigned dofNum = 0; dofNum < numRaysDepthOfField; dofNum++){
 
 						if(numRaysDepthOfField > 1){ //in case there is no depth of field
 							randomDU = (double)rand() / RAND_MAX;
@@ -157,6 +171,7 @@ bool basic_rasterizer::Rasterize( string file_name, const Camera &cam, const Sce
 						ray.direction = Unit(imagePlanePoint - ray.origin);
 
 						
+						STAT_ADD( stat_primary_rays, doMotionBlur ? 2 : 1 );
 						if(doMotionBlur){
 							currentColor = currentColor + 0.15*scene.Trace(ray) + 0.85*scene2.Trace(ray);
 						}else{
@@ -168,16 +183,18 @@ bool basic_rasterizer::Rasterize( string file_name, const Camera &cam, const Sce
 				}
 
 				//blends the colors together of the found rays
-				currentColor = currentColor/(numRaysAntiAliasing*numRaysDepthOfField);
+				currentColor = currentColor/double(numRaysAntiAliasing*numRaysDepthOfField);
 
 				I(i,j) = ToneMap(currentColor);
             }
+        if( progress != NULL ) progress->Report( i + 1, cam.y_res, "rows" );
         }
 
     // Thus far the image exists only in memory.  Now write it out to a file.
 
     cout << "\nWriting image file " << file_name << "... ";
     cout.flush();
+    TraceSpan span( "write image" );
     I.Write( file_name );
     cout << "done." << endl;
     return true;
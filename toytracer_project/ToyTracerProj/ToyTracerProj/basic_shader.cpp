@@ -6,7 +6,25 @@
 * from the origin of the ray that hit the surface, taking into account the *
 * surface material, light sources, and other objects in the scene.         *                          *
 *                                                                          *
+* Indirect diffuse lighting is optional; it is enabled by appending        *
+* "indirect" to the shader line, optionally followed by the number of      *
+* hemisphere rays per irradiance record and the cache accuracy, e.g.       *
+*                                                                          *
+*     shader basic_shader indirect 64 0.2                                  *
+*                                                                          *
+* The irradiance is then interpolated from an irradiance cache, so the     *
+* hemisphere is only sampled where no cached record applies.               *
+*                                                                          *
+* Its shadow rays may be cast in batches by the rasterizer (see            *
+* Shader::ShadowRay), and so may its reflected & refracted rays (see       *
+* Shader::SecondaryRays).  A refracted ray is first cast through the       *
+* object here, and only the ray leaving it is left to the rasterizer.      *
+*                                                                          *
 * History:                                                                 *
+*   10/18/2026  Reflected & refracted rays may be traced by rasterizers.   *
+*   10/18/2026  Shadow rays start just off the surface they leave.         *
+*   10/18/2026  Shadow rays can be cast in batches by the rasterizer.      *
+*   10/18/2026  Added optional indirect diffuse via an irradiance cache.   *
 *   10/03/2005  Updated for Fall 2005 class.                               *
 *   09/29/2004  Updated for Fall 2004 class.                               *
 *   04/14/2003  Point lights are now point objects with emission.          *
@@ -15,16 +33,45 @@
 ***************************************************************************/
 #include "toytracer.h"
 #include "util.h"
+#include <mutex>
 #include "params.h"
+#include "irradiance_cache.h"
+
+static const unsigned default_indirect_samples  = 64;
+static const double   default_indirect_accuracy = 0.2;
+static const int      numRaysSoftShadows = 1; // Shadow rays per light; more give soft shadows.
+
+// The parts of the color of a hit: the color of the surface, lit by the
+// lights, and the reflected & refracted rays, which are traced only if
+// "reflect" & "refract" are set.  The color of the hit is then
+// (1 - t) * ( lit + r * reflected color ) + t * refracted color.
+struct basic_parts {
+    Color lit;
+    Color r;
+    Color t;
+    Ray   reflected;
+    Ray   refracted; // The ray leaving the object, once through it.
+    bool  reflect;
+    bool  refract;
+    };
 
 struct basic_shader : public Shader {
-    basic_shader() {}
-   ~basic_shader() {}
+    basic_shader() { indirect_samples = 0; indirect_accuracy = 0.0; cache = NULL; }
+    basic_shader( unsigned samples, double accuracy );
+   ~basic_shader() { delete cache; }
     virtual Color Shade( const Scene &, const HitInfo & ) const;
+    virtual bool ShadowRay( const Scene &, const HitInfo &, unsigned light, Ray & ) const;
+    virtual bool SecondaryRays( const Scene &, const HitInfo &, Color &, vector<Ray> &, vector<Color> & ) const;
+    void Parts( const Scene &, const HitInfo &, basic_parts & ) const;
     virtual Plugin *ReadString( const string &params );
     virtual string MyName() const { return "basic_shader"; }
     virtual bool Default() const { return true; }
 	virtual Vec3 RefractionDirection(double n_1, double n_2, Vec3 incomingVector,Vec3 normalVector) const;
+    unsigned indirect_samples;  // Hemisphere rays per irradiance record; zero for none.
+    double   indirect_accuracy; // Accuracy "a" of the irradiance cache.
+    IrradianceCache *Cache( const Scene & ) const;
+    mutable IrradianceCache *cache; // Created on first use, once the scene is known.
+    mutable std::mutex cache_lock;  // Guards the creation of the cache.
     };
 
 REGISTER_PLUGIN( basic_shader );
@@ -32,12 +79,99 @@ REGISTER_PLUGIN( basic_shader );
 Plugin *basic_shader::ReadString( const string &params ) 
     {
     ParamReader get( params );
-    if( get["shader"] && get[MyName()] ) return new basic_shader();
+    if( get["shader"] && get[MyName()] )
+        {
+        if( !get["indirect"] ) return new basic_shader();
+        unsigned samples  = default_indirect_samples;
+        double   accuracy = default_indirect_accuracy;
+        if( get[samples] ) get[accuracy];
+        return new basic_shader( samples, accuracy );
+        }
     return NULL;
     }
 
+basic_shader::basic_shader( unsigned samples, double accuracy )
+    {
+    indirect_samples  = samples;
+    indirect_accuracy = accuracy;
+    cache = NULL;
+    }
+
+// Return the irradiance cache of this shader, creating it on first use.  The
+// octree of the cache must enclose the entire scene, which is not known until
+// the first point is shaded.
+IrradianceCache *basic_shader::Cache( const Scene &scene ) const
+    {
+    std::lock_guard<std::mutex> guard( cache_lock );
+    if( cache == NULL )
+        {
+        AABB box = GetBox( *scene.object );
+        const double pad = 1.0E-3 * Length( box.MaxCorner() - box.MinCorner() );
+        box << ( box.MinCorner() - Vec3( pad, pad, pad ) );
+        box << ( box.MaxCorner() + Vec3( pad, pad, pad ) );
+        cache = new IrradianceCache( box, indirect_samples, indirect_accuracy );
+        }
+    return cache;
+    }
+
+// The shadow ray that Shade would cast toward the light, if it casts just
+// one.  Emitters are not lit, so none are cast from them.
+bool basic_shader::ShadowRay( const Scene &scene, const HitInfo &hit, unsigned light, Ray &ray ) const
+    {
+    if( numRaysSoftShadows > 1 || Emitter( hit.object ) ) return false;
+    Vec3 P = hit.point;
+    Vec3 N = hit.normal;
+    if( hit.object->Inside( P ) ) P = P + RayEps * N; // As in Shade.
+    if( ( hit.ray.origin - P ) * N < 0.0 ) N = -N;
+    ray.origin    = P + RayEps * N;
+    ray.direction = Unit( Center( GetBox( *scene.GetLight( light ) ) ) - P );
+    return true;
+    }
 
 Color basic_shader::Shade( const Scene &scene, const HitInfo &hit ) const
+    {
+    if( Emitter( hit.object ) ) return hit.object->material->emission;
+    basic_parts parts;
+    Parts( scene, hit, parts );
+	Color reflectedColor;
+	Color refractedColor;
+	if( parts.refract ) refractedColor = scene.Trace( parts.refracted );
+	if( parts.reflect ) reflectedColor = scene.Trace( parts.reflected );
+
+	//now combine calculated color with reflected color
+	return (-1*parts.t + Color(1.0,1.0,1.0))*(parts.lit + parts.r*reflectedColor) + parts.t*refractedColor;
+    }
+
+// The color of the hit is that of the surface plus weighted colors seen along
+// the reflected & refracted rays, so the rasterizer may trace those rays
+// itself, in batches.
+bool basic_shader::SecondaryRays( const Scene &scene, const HitInfo &hit, Color &color, vector<Ray> &rays, vector<Color> &weights ) const
+    {
+    if( Emitter( hit.object ) )
+        {
+        color = hit.object->material->emission;
+        return true;
+        }
+    basic_parts parts;
+    Parts( scene, hit, parts );
+    const Color opaque( -1*parts.t + Color(1.0,1.0,1.0) );
+    color = opaque * parts.lit;
+    if( parts.refract )
+        {
+        rays.push_back( parts.refracted );
+        weights.push_back( parts.t );
+        }
+    if( parts.reflect )
+        {
+        rays.push_back( parts.reflected );
+        weights.push_back( opaque * parts.r );
+        }
+    return true;
+    }
+
+// Light the surface, and find the reflected & refracted rays, casting the
+// refracted ray through the object to the point where it leaves.
+void basic_shader::Parts( const Scene &scene, const HitInfo &hit, basic_parts &parts ) const
     {
     Ray ray;
 	Ray reflectionRay;
@@ -46,8 +180,7 @@ Color basic_shader::Shade( const Scene &scene, const HitInfo &hit ) const
 
     HitInfo otherhit;
 	HitInfo refractionHit;
-    static const double epsilon = 1.0E-6;
-    if( Emitter( hit.object ) ) return hit.object->material->emission;
+    static const double epsilon = RayEps;
 
     Material *mat   = hit.object->material;
     Color  diffuse  = mat->diffuse;
@@ -69,6 +202,13 @@ Color basic_shader::Shade( const Scene &scene, const HitInfo &hit ) const
 
     if( E * N < 0.0 ) N = -N;  // Flip the normal if necessary.
 
+	// Add the indirect diffuse light, interpolated from the irradiance cache.  Rays
+	// that are themselves gathering irradiance do not recurse any further.
+	if( indirect_samples > 0 && hit.ray.type != indirect_ray && scene.object != NULL )
+		{
+		color += ( 1.0 / Pi ) * ( diffuse * Cache( scene )->Irradiance( scene, P, N, hit.ray ) );
+		}
+
 	//get the attentuation
 	//	A = 1/(a + b*r + c*r^2)
 	double attenuation_a = 0.0;
@@ -81,10 +221,7 @@ Color basic_shader::Shade( const Scene &scene, const HitInfo &hit ) const
 	double specularFactor;
 	Color diffuseColor = Color();
 	Color specularColor = Color();
-	Color finalColor;
 	Color colorWithLighting;
-	Color reflectedColor;
-	Color refractedColor;
 	Vec3 currentR;
 	bool objectWasHit = false;
 
@@ -104,21 +241,21 @@ Color basic_shader::Shade( const Scene &scene, const HitInfo &hit ) const
 		attenuation = 1/(attenuation_a + attenuation_b*lightDistance + attenuation_c*lightDistance*lightDistance);
 
 		//light ray to case to determine occulsion
-		ray.origin = P;
+		ray.origin = P + epsilon*N; // Off the surface, so that it cannot shadow itself.
 		ray.direction = lightVector;
 		HitInfo objectHit;
 		//objectHit.ignore = NULL;
 		objectHit.distance = Infinity;
 
-		const int numRaysSoftShadows = 1;
 		double shadowFactor = 0;
 		double randomLightDeltaY;
 		double randomLightDeltaZ;
 		Vec3 deltaVector;
 		Vec3 currentLightVector;
 
-		//calculate the soft shadow
-		for(int rayIndex = 0; rayIndex < numRaysSoftShadows; rayIndex++){
+		//calculate the soft shadow, unless the rasterizer has cast the shadow ray already
+		if( hit.blocked != NULL ) shadowFactor = hit.blocked[i];
+		else for(int rayIndex = 0; rayIndex < numRaysSoftShadows; rayIndex++){
 
 
 			if(numRaysSoftShadows > 1){
@@ -136,6 +273,7 @@ Color basic_shader::Shade( const Scene &scene, const HitInfo &hit ) const
 			//objectHit.ignore = NULL;
 			objectHit.distance = Infinity;
 
+			STAT_COUNT( stat_shadow_rays );
 			if(scene.Cast(ray,objectHit) ){
 				if(objectHit.object != NULL){
 					shadowFactor = shadowFactor + 1;
@@ -169,7 +307,7 @@ Color basic_shader::Shade( const Scene &scene, const HitInfo &hit ) const
 	reflectionRay.origin = P;
 	reflectionRay.direction = R;
 	reflectionRay.generation = hit.ray.generation + 1;
-	reflectedColor = Color();
+	parts.reflect = false;
 
 	//set variables for refraction
 
@@ -178,12 +316,13 @@ Color basic_shader::Shade( const Scene &scene, const HitInfo &hit ) const
 	Vec3 refractionDir = RefractionDirection(1.0,k,E,N);
 	refractedRay.direction = refractionDir; //for refraction
 	refractedRay.generation = hit.ray.generation + 1;
-	refractedColor = Color();
+	parts.refract = false;
  	refractionHit.distance = Infinity;
 
 	//only do refraction if the transluency is greater than zero
 	//	this is an optimization so unnecessary refractions are not calculated
 	if( (t.red + t.green + t.blue) > epsilon){
+		STAT_COUNT( stat_refraction_rays );
 		if(scene.Cast(refractedRay,refractionHit)){
 
 			bool insideMaterial = false;
@@ -202,6 +341,7 @@ Color basic_shader::Shade( const Scene &scene, const HitInfo &hit ) const
 					refractedRay.direction = Unit( ( 2.0 * ( previousRefractedDirection * currentNormal ) ) * (-1*currentNormal) + previousRefractedDirection );
 
 
+					STAT_COUNT( stat_refraction_rays );
 					if(!scene.Cast(refractedRay,refractionHit)){
 						insideMaterial = false;
 					}
@@ -219,7 +359,9 @@ Color basic_shader::Shade( const Scene &scene, const HitInfo &hit ) const
 			refractedRay.generation = hit.ray.generation + 1;
 
 			//now do refraction
-			refractedColor = scene.Trace(refractedRay);
+			STAT_COUNT( stat_refraction_rays );
+			parts.refracted = refractedRay;
+			parts.refract = true;
 
 		}
 	}
@@ -229,7 +371,9 @@ Color basic_shader::Shade( const Scene &scene, const HitInfo &hit ) const
 	//only do reflection if the reflectance is greater than zero
 	//	this is an optimization so unnecessary reflections are not calculated
 	if( (r.red + r.green + r.blue) > epsilon){
-		reflectedColor = scene.Trace(reflectionRay);
+		STAT_COUNT( stat_reflection_rays );
+		parts.reflected = reflectionRay;
+		parts.reflect = true;
 	}
 	
 	//debug code
@@ -239,10 +383,9 @@ Color basic_shader::Shade( const Scene &scene, const HitInfo &hit ) const
 	//printf("(N_1,N_2)=(%f,%f)\n\n",hit.ray.ref_index,refractedRay.ref_index);
 	
 
-	//now combine calculated color with reflected color
-	finalColor = (-1*t + Color(1.0,1.0,1.0))*(colorWithLighting + r*reflectedColor) + t*refractedColor;
-
-	return finalColor; 
+	parts.lit = colorWithLighting;
+	parts.r = r;
+	parts.t = t;
     }
 
 	/*calculate the refraction direction
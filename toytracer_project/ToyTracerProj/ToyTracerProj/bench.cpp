@@ -0,0 +1,533 @@
+/***************************************************************************
+* bench.cpp                                                                *
+*                                                                          *
+* The benchmark suite: procedural scene generators and the harness that    *
+* measures each aggregate on them.  It is run as                           *
+*                                                                          *
+*    toytracer bench [kinds k1,k2,...] [aggregates a1,a2,...]              *
+*                    [min N] [max N] [res N] [seed N] [list_max N]         *
+*                    [csv FILE]                                            *
+*                                                                          *
+* The kinds are spheres, triangles, tori, transforms and glass (all by     *
+* default).  The aggregates default to every registered aggregate that can *
+* be created from "begin NAME" alone, so new ones are benchmarked as soon  *
+* as they are linked in.  Scenes of min, 10 min, 100 min, ... objects are  *
+* generated, up to max (by default 10 to 1000000; up to 10M is possible,   *
+* given the memory).  The linear List is only run on scenes of up to       *
+* list_max objects (10000 by default), since it is hopeless beyond that.   *
+*                                                                          *
+* Each scene is written to a temporary sdf file, with all its objects in   *
+* an unpacked List, and read by the builder once; the file is removed when *
+* the run ends.  Each aggregate is then given the same objects, and the    *
+* harness measures                                                         *
+*                                                                          *
+*    build_s        the time taken by Close, which builds the hierarchy,   *
+*    memory_mb      the growth of the resident set during Close,           *
+*    cast_mrays_s   millions of primary rays cast per second (res x res),  *
+*    hit_fraction   the fraction of those rays that hit something,         *
+*    trace_s        the time to trace & shade the whole image,             *
+*    trace_mrays_s  millions of rays of all kinds per second while tracing *
+*                   (only if compiled with TOYTRACER_STATS).               *
+*                                                                          *
+* One CSV row is written per kind, size and aggregate (to bench.csv by     *
+* default), so that scaling curves can be plotted directly.  All the work  *
+* is done in a single thread, and the scenes depend only on the seed, so   *
+* runs on the same machine are comparable.                                 *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Scenes are written to a temporary file, not bench.sdf.     *
+*   10/18/2026  Scenes are freed by Scene::Destroy.                        *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include "bench.h"
+#include "params.h"
+#include "packed.h"
+#include "util.h"
+#include "trace.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment( lib, "psapi.lib" )
+#else
+#include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock bench_clock;
+
+const char *bench_scene_names[ num_bench_scenes ] = {
+    "spheres",
+    "triangles",
+    "tori",
+    "transforms",
+    "glass"
+    };
+
+static const double   bench_extent      = 5.0;     // Objects lie within [-5,5]^3.
+static const unsigned glass_layers      = 8;       // Slabs per stack of glass.
+static const unsigned default_bench_max = 1000000; // Objects in the largest scene.
+
+static double Seconds( const bench_clock::time_point &start )
+    {
+    return std::chrono::duration<double>( bench_clock::now() - start ).count();
+    }
+
+// The resident set size of the process, in bytes, or zero if unknown.
+static double ResidentBytes()
+    {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if( GetProcessMemoryInfo( GetCurrentProcess(), &pmc, sizeof( pmc ) ) ) return double( pmc.WorkingSetSize );
+    return 0.0;
+#else
+    std::ifstream statm( "/proc/self/statm" );
+    double size = 0.0, resident = 0.0;
+    if( !( statm >> size >> resident ) ) return 0.0;
+    return resident * sysconf( _SC_PAGESIZE );
+#endif
+    }
+
+// The name, without its extension, of the sdf file to hold the scenes.  It
+// is in the temporary directory, and names the process, so that runs in
+// parallel do not overwrite one another's scenes.
+static string TempSceneName()
+    {
+    std::stringstream name;
+#ifdef _WIN32
+    char dir[ MAX_PATH + 1 ];
+    if( GetTempPathA( sizeof( dir ), dir ) > 0 ) name << dir;
+    name << "toytracer_bench_" << GetCurrentProcessId();
+#else
+    const char *dir = getenv( "TMPDIR" );
+    name << ( dir != NULL && *dir != '\0' ? dir : "/tmp" ) << "/toytracer_bench_" << getpid();
+#endif
+    return name.str();
+    }
+
+// Removes the file when the run ends, however it ends.
+struct temp_file {
+    temp_file( const string &name_ ) { name = name_; }
+   ~temp_file() { remove( name.c_str() ); }
+    string name;
+    };
+
+static double Megabytes( double bytes )
+    {
+    return bytes > 0.0 ? bytes / ( 1024.0 * 1024.0 ) : 0.0;
+    }
+
+// Write a matrix in the form read by the transform plugin.
+static void WriteMatrix( ostream &out, const Mat3x4 &M )
+    {
+    out << "(";
+    for( int i = 0; i < 3; i++ )
+        {
+        out << ( i > 0 ? "; " : "" );
+        for( int j = 0; j < 3; j++ ) out << M.mat(i,j) << ", ";
+        out << ( i == 0 ? M.vec.x : i == 1 ? M.vec.y : M.vec.z );
+        }
+    out << ")";
+    }
+
+static Mat3x4 RandomRotation( bench_random &random )
+    {
+    return Mat3x4( Rotate_Z( random( 0, TwoPi ) ) * Rotate_X( random( 0, TwoPi ) ) );
+    }
+
+bool WriteBenchScene( const string &file_name, bench_scene kind, unsigned n, unsigned seed, unsigned resolution )
+    {
+    std::ofstream out( file_name.c_str() );
+    if( !out ) return false;
+    bench_random random( seed * 2654435761u + kind * 40503u + n );
+
+    // The typical distance between neighbouring objects, so that the
+    // density of every kind of scene is much the same at every size.
+    const double spacing = 2.0 * bench_extent / pow( double( n ), 1.0 / 3.0 );
+
+    out << "# " << bench_scene_names[kind] << " benchmark scene of " << n
+        << " objects, seed " << seed << ", written by \"toytracer bench\".\n\n";
+    out << "eye     (12.0, -16.0, 9.0)\n"
+        << "lookat  (0.0, 0.0, 0.0)\n"
+        << "up      (0.0, 0.0, 1.0)\n"
+        << "vpdist  2.2\n"
+        << "x_win   (-1, 1)\n"
+        << "y_win   (-1, 1)\n"
+        << "x_res   " << resolution << "\n"
+        << "y_res   " << resolution << "\n\n";
+    out << "ambient [0.2, 0.2, 0.2]\n"
+        << "shader basic_shader\n"
+        << "envmap basic_envmap [0.15, 0.25, 0.35]\n\n";
+    out << "specular     [0.5, 0.5, 0.5]\n"
+        << "Phong_exp    20\n"
+        << "ref_index    1\n";
+    if( kind == bench_glass )
+        {
+        out << "diffuse      [0.1, 0.1, 0.1]\n"
+            << "reflectivity [0.1, 0.1, 0.1]\n"
+            << "translucency [0.8, 0.8, 0.8]\n"
+            << "ref_index    1.5\n";
+        }
+    else
+        {
+        out << "diffuse      [0.6, 0.5, 0.4]\n"
+            << "reflectivity [0.2, 0.2, 0.2]\n"
+            << "translucency [0, 0, 0]\n";
+        }
+
+    out << "\nbegin List unpacked\n";
+    out << "emission [1, 1, 1]\n"
+        << "point (10, -10, 20)\n"
+        << "emission [0, 0, 0]\n";
+
+    switch( kind )
+        {
+        case bench_spheres:
+            for( unsigned i = 0; i < n; i++ )
+                {
+                const Vec3 c( random.Point( bench_extent ) );
+                out << "sphere " << c << " " << spacing * random( 0.15, 0.3 ) << "\n";
+                }
+            break;
+
+        case bench_triangles:
+            for( unsigned i = 0; i < n; i++ )
+                {
+                const Vec3 c( random.Point( bench_extent ) );
+                const Vec3 A( c + random.Point( 0.6 * spacing ) );
+                const Vec3 B( c + random.Point( 0.6 * spacing ) );
+                const Vec3 C( c + random.Point( 0.6 * spacing ) );
+                out << "triangle " << A << " " << B << " " << C << "\n";
+                }
+            break;
+
+        case bench_tori:
+            {
+            // A regular grid of canonical tori, each placed by a transform.
+            const unsigned k = unsigned( ceil( pow( double( n ), 1.0 / 3.0 ) - 1.0E-9 ) );
+            const double   d = 2.0 * bench_extent / k;
+            for( unsigned i = 0; i < n; i++ )
+                {
+                const Vec3 p( -bench_extent + d * ( i % k + 0.5 ), -bench_extent + d * ( i / k % k + 0.5 ), -bench_extent + d * ( i / ( k * k ) + 0.5 ) );
+                const Mat3x4 M( Translate( p.x, p.y, p.z ) * RandomRotation( random ) * Scale( 0.3 * d, 0.3 * d, 0.3 * d ) );
+                out << "begin transform ";
+                WriteMatrix( out, M );
+                out << "\ntorus 1 0.35\nend\n";
+                }
+            break;
+            }
+
+        case bench_transforms:
+            {
+            // Each primitive is in canonical position within three nested
+            // transforms: a translation, a rotation and a uniform scale, so that
+            // each way of applying a matrix is exercised.
+            for( unsigned i = 0; i < n; i++ )
+                {
+                const Vec3 p( random.Point( bench_extent ) );
+                const double s = spacing * random( 0.15, 0.3 );
+                out << "begin transform ";
+                WriteMatrix( out, Translate( p.x, p.y, p.z ) );
+                out << "\nbegin transform ";
+                WriteMatrix( out, RandomRotation( random ) );
+                out << "\nbegin transform ";
+                WriteMatrix( out, Mat3x4( Scale( s, s, s ) ) );
+                if( i % 2 == 0 ) out << "\nsphere (0, 0, 0) 1\n";
+                else out << "\ntriangle (-1, -1, 0) (1, -1, 0) (0, 1, 0)\n";
+                out << "end\nend\nend\n";
+                }
+            break;
+            }
+
+        case bench_glass:
+            {
+            // Stacks of thin translucent slabs on a square grid of columns.
+            const unsigned columns = ( n + glass_layers - 1 ) / glass_layers;
+            const unsigned k = unsigned( ceil( sqrt( double( columns ) ) - 1.0E-9 ) );
+            const double   d = 2.0 * bench_extent / k;
+            const double   h = 2.0 * bench_extent / glass_layers;
+            for( unsigned i = 0; i < n; i++ )
+                {
+                const unsigned c = i / glass_layers;
+                const double x = -bench_extent + d * ( c % k + 0.5 );
+                const double y = -bench_extent + d * ( c / k + 0.5 );
+                const double z = -bench_extent + h * ( i % glass_layers );
+                const double w = 0.35 * d;
+                out << "block " << Vec3( x - w, y - w, z ) << " " << Vec3( x + w, y + w, z + 0.3 * h ) << "\n";
+                }
+            break;
+            }
+
+        default:
+            break;
+        }
+
+    out << "end\n";
+    return !out.fail();
+    }
+
+// Split a comma-separated list.
+static vector<string> Split( const string &list )
+    {
+    vector<string> words;
+    std::stringstream in( list );
+    string word;
+    while( std::getline( in, word, ',' ) ) if( !word.empty() ) words.push_back( word );
+    return words;
+    }
+
+// Create an instance of the named aggregate, with its default parameters.
+static Aggregate *NewAggregate( const string &name )
+    {
+    Plugin *plg = Instance_of_Plugin( ( "begin " + name ).c_str() );
+    if( plg == NULL ) return NULL;
+    if( plg->PluginType() != aggregate_plugin || ((Aggregate *)plg)->Prototype() )
+        {
+        delete plg;
+        return NULL;
+        }
+    return (Aggregate *)plg;
+    }
+
+// The names of all registered aggregates that can stand alone.
+static vector<string> AllAggregates()
+    {
+    vector<string> names;
+    for( Plugin *plg = LookupPlugin( aggregate_plugin ); plg != NULL; plg = LookupPlugin( aggregate_plugin, plg ) )
+        {
+        Aggregate *agg = NewAggregate( plg->MyName() );
+        if( agg == NULL ) continue;
+        names.push_back( plg->MyName() );
+        delete agg;
+        }
+    return names;
+    }
+
+struct bench_result {
+    double build_s;
+    double memory_mb;
+    double cast_mrays_s;
+    double hit_fraction;
+    double trace_s;
+    double trace_mrays_s; // Negative if unknown.
+    };
+
+// Cast one primary ray through the center of every pixel, then trace them
+// all, with the same camera basis as the basic_rasterizer.
+static void Render( const Camera &cam, const Scene &scene, bench_result &result )
+    {
+    const Vec3 G ( Unit( cam.lookat - cam.eye ) );
+    const Vec3 U ( Unit( cam.up / G ) );
+    const Vec3 R ( Unit( G ^ U ) );
+    const Vec3 O ( cam.vpdist * G + cam.x_win.min * R + cam.y_win.max * U );
+    const Vec3 dR( Len( cam.x_win ) * R / cam.x_res );
+    const Vec3 dU( Len( cam.y_win ) * U / cam.y_res );
+    const double num_rays = double( cam.x_res ) * cam.y_res;
+
+    Ray ray;
+    ray.origin     = cam.eye;
+    ray.type       = primary_ray;
+    ray.generation = 1;
+
+    unsigned hits = 0;
+    bench_clock::time_point start = bench_clock::now();
+        {
+        TraceSpan span( "cast", "bench" );
+        for( unsigned i = 0; i < cam.y_res; i++ )
+        for( unsigned j = 0; j < cam.x_res; j++ )
+            {
+            HitInfo hitinfo;
+            hitinfo.ignore   = NULL;
+            hitinfo.distance = Infinity;
+            ray.direction = Unit( O + ( j + 0.5 ) * dR - ( i + 0.5 ) * dU );
+            if( scene.Cast( ray, hitinfo ) ) hits++;
+            }
+        }
+    const double cast_s = Seconds( start );
+    result.cast_mrays_s = cast_s > 0.0 ? num_rays / cast_s * 1.0E-6 : 0.0;
+    result.hit_fraction = hits / num_rays;
+
+    ResetStats();
+    srand( 1 );      // Any randomness in the shaders is the same for every aggregate.
+    SeedRandom( 1 );
+    Color sum;
+    start = bench_clock::now();
+        {
+        TraceSpan span( "trace", "bench" );
+        for( unsigned i = 0; i < cam.y_res; i++ )
+        for( unsigned j = 0; j < cam.x_res; j++ )
+            {
+            ray.direction = Unit( O + ( j + 0.5 ) * dR - ( i + 0.5 ) * dU );
+            STAT_COUNT( stat_primary_rays );
+            sum += scene.Trace( ray );
+            }
+        }
+    result.trace_s = Seconds( start );
+    result.trace_mrays_s = -1.0;
+    if( STATS_ENABLED && result.trace_s > 0.0 )
+        result.trace_mrays_s = MergedStats().Rays() / result.trace_s * 1.0E-6;
+    }
+
+int RunBenchmarks( int argc, char *argv[] )
+    {
+    // Gather the options into a single string for the ParamReader.  The
+    // trailing blank lets the last number be stripped off like the others.
+
+    string args;
+    for( int i = 0; i < argc; i++ ) args += string( argv[i] ) + " ";
+    ParamReader get( args );
+
+    unsigned min_n    = 10;
+    unsigned max_n    = default_bench_max;
+    unsigned res      = 256;
+    unsigned seed     = 1;
+    unsigned list_max = 10000;
+    string   csv_name = "bench.csv";
+    string   kind_list, agg_list;
+    for(;;)
+        {
+        if( get["kinds"]      && get.Word( kind_list ) ) continue;
+        if( get["aggregates"] && get.Word( agg_list  ) ) continue;
+        if( get["min"]        && get[min_n]    ) continue;
+        if( get["max"]        && get[max_n]    ) continue;
+        if( get["res"]        && get[res]      ) continue;
+        if( get["seed"]       && get[seed]     ) continue;
+        if( get["list_max"]   && get[list_max] ) continue;
+        if( get["csv"]        && get.Word( csv_name ) ) continue;
+        break;
+        }
+    string extra;
+    if( get.Word( extra ) || min_n == 0 || res == 0 )
+        {
+        cerr << "Usage: toytracer bench [kinds k1,k2,...] [aggregates a1,a2,...] [min N] [max N]\n"
+             << "                       [res N] [seed N] [list_max N] [csv FILE]" << endl;
+        return error_bad_arguments;
+        }
+
+    vector<bench_scene> kinds;
+    const vector<string> kind_names( Split( kind_list ) );
+    for( unsigned k = 0; k < num_bench_scenes; k++ )
+        {
+        bool wanted = kind_names.empty();
+        for( unsigned i = 0; i < kind_names.size(); i++ ) wanted |= ( kind_names[i] == bench_scene_names[k] );
+        if( wanted ) kinds.push_back( bench_scene(k) );
+        }
+    for( unsigned i = 0; i < kind_names.size(); i++ )
+        {
+        bool known = false;
+        for( unsigned k = 0; k < num_bench_scenes; k++ ) known |= ( kind_names[i] == bench_scene_names[k] );
+        if( !known ) cerr << "Warning: unknown kind of benchmark scene " << kind_names[i] << endl;
+        }
+
+    const vector<string> aggregates( agg_list.empty() ? AllAggregates() : Split( agg_list ) );
+
+    Builder *builder = (Builder *)LookupPlugin( builder_plugin );
+    if( builder == NULL )
+        {
+        cerr << "No builder plugin was found." << endl;
+        return error_no_builder;
+        }
+
+    std::ofstream csv( csv_name.c_str() );
+    if( !csv )
+        {
+        cerr << "Error: Could not open file " << csv_name << " for writing." << endl;
+        return error_opening_image_file;
+        }
+    csv << "kind,objects,aggregate,load_s,scene_mb,build_s,memory_mb,cast_mrays_s,hit_fraction,trace_s,trace_mrays_s" << endl;
+
+    cout << "Benchmarking";
+    for( unsigned a = 0; a < aggregates.size(); a++ ) cout << " " << aggregates[a];
+    cout << " at " << res << "x" << res << ", writing " << csv_name << endl;
+
+    const string scene_name = TempSceneName();
+    const temp_file scene_file( scene_name + ".sdf" );
+    for( unsigned k = 0; k < kinds.size(); k++ )
+    for( double size = min_n; size <= max_n; size *= 10.0 )
+        {
+        const unsigned n = unsigned( size );
+        TraceSpan scene_span( string( bench_scene_names[ kinds[k] ] ), "bench", n );
+        if( !WriteBenchScene( scene_name + ".sdf", kinds[k], n, seed, res ) )
+            {
+            cerr << "Error: Could not write " << scene_name << ".sdf" << endl;
+            return error_opening_input_file;
+            }
+
+        // Read the scene once; the objects end up in an unpacked List.
+
+        Scene  scene;
+        Camera camera;
+        const double before_load = ResidentBytes();
+        bench_clock::time_point start = bench_clock::now();
+        if( !builder->BuildScene( scene_name, camera, scene ) )
+            {
+            cerr << "Error encountered while building scene." << endl;
+            return error_building_scene;
+            }
+        const double load_s = Seconds( start );
+        const double scene_mb = Megabytes( ResidentBytes() - before_load );
+        Aggregate *holder = dynamic_cast<Aggregate *>( scene.object );
+        if( holder == NULL )
+            {
+            cerr << "Error: the benchmark scene has no aggregate." << endl;
+            return error_building_scene;
+            }
+
+        for( unsigned a = 0; a < aggregates.size(); a++ )
+            {
+            if( aggregates[a] == "List" && n > list_max ) continue;
+            Aggregate *agg = NewAggregate( aggregates[a] );
+            if( agg == NULL )
+                {
+                cerr << "Warning: " << aggregates[a] << " is not an aggregate that can be benchmarked." << endl;
+                continue;
+                }
+            agg->material = holder->material;
+            agg->shader   = holder->shader;
+            agg->envmap   = holder->envmap;
+            for( unsigned i = 0; i < holder->children.size(); i++ ) agg->AddChild( holder->children[i] );
+
+            cout << "    " << bench_scene_names[ kinds[k] ] << " " << n << " " << aggregates[a] << ": ";
+            cout.flush();
+
+            bench_result result;
+            const double before_build = ResidentBytes();
+            start = bench_clock::now();
+                {
+                TraceSpan span( "close " + aggregates[a], "build" );
+                agg->Close();
+                }
+            result.build_s   = Seconds( start );
+            result.memory_mb = Megabytes( ResidentBytes() - before_build );
+
+            scene.object = agg;
+            Render( camera, scene, result );
+            scene.object = holder;
+
+            // The packed objects made by the aggregate are its own; the
+            // primitives within them are the holder's.
+            const Object *prims[4];
+            for( unsigned i = 0; i < agg->children.size(); i++ )
+                if( PackedObjects( agg->children[i], prims ) > 0 ) delete agg->children[i];
+            delete agg;
+
+            cout << result.build_s << " s to build, " << result.cast_mrays_s << " Mrays/s cast, "
+                 << result.trace_s << " s to trace" << endl;
+            csv << bench_scene_names[ kinds[k] ] << "," << n << "," << aggregates[a] << ","
+                << load_s << "," << scene_mb << "," << result.build_s << "," << result.memory_mb << ","
+                << result.cast_mrays_s << "," << result.hit_fraction << "," << result.trace_s << ",";
+            if( result.trace_mrays_s >= 0.0 ) csv << result.trace_mrays_s;
+            csv << endl;
+            }
+
+        scene.Destroy();
+        }
+
+    cout << "Wrote " << csv_name << endl;
+    return no_errors;
+    }
@@ -0,0 +1,71 @@
+/***************************************************************************
+* bench.h                                                                  *
+*                                                                          *
+* A reproducible benchmark suite for the aggregates.  Scenes of several    *
+* kinds are generated procedurally, from a fixed seed, at sizes growing    *
+* by factors of ten, and each is built with every aggregate in turn.  The  *
+* build time, the memory used by the hierarchy, and the rate at which      *
+* primary rays are cast and images traced are written as CSV, one row      *
+* per scene, size and aggregate, so that scaling curves can be plotted.    *
+*                                                                          *
+* The suite is run by "toytracer bench [options]"; see bench.cpp.          *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  The random numbers are shared with the microbenchmarks.    *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#ifndef __BENCH_INCLUDED__
+#define __BENCH_INCLUDED__
+
+#include "toytracer.h"
+
+// The kinds of procedural scene.
+enum bench_scene {
+    bench_spheres,     // A random field of spheres.
+    bench_triangles,   // A soup of small random triangles.
+    bench_tori,        // A regular grid of tori, each placed by a transform.
+    bench_transforms,  // Spheres & triangles, each within three nested transforms.
+    bench_glass,       // Stacks of translucent slabs, with refraction.
+    num_bench_scenes
+    };
+
+// A small generator of pseudo-random numbers (xorshift), so that the scenes
+// and rays of the benchmarks are the same on every platform, whatever the C
+// library's rand does.
+struct bench_random {
+    bench_random( unsigned seed ) { state = seed != 0 ? seed : 1; }
+    unsigned Next()
+        {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+        }
+    double operator()( double a, double b ) { return a + ( b - a ) * ( Next() / 4294967296.0 ); }
+    Vec3 Point( double r ) { const double x = (*this)( -r, r ), y = (*this)( -r, r ); return Vec3( x, y, (*this)( -r, r ) ); }
+    unsigned state;
+    };
+
+// The name of each kind of scene, as used on the command line.
+extern const char *bench_scene_names[ num_bench_scenes ];
+
+// Write a scene of roughly n objects of the given kind as an sdf file, with
+// all the objects in a single "List unpacked" aggregate.  The same kind, n
+// and seed always produce the same file.
+extern bool WriteBenchScene(
+    const string &file_name,
+    bench_scene kind,
+    unsigned n,
+    unsigned seed,
+    unsigned resolution
+    );
+
+// Run the suite, given the arguments that follow "bench" on the command line.
+// Returns one of the error codes of main.
+extern int RunBenchmarks(
+    int argc,
+    char *argv[]
+    );
+
+#endif
@@ -6,6 +6,8 @@
 * Block (i.e. the three min coords, and the three max coords).             *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Slab test uses the reciprocal direction cached in the ray. *
+*   10/18/2026  Point & normal are now filled in by FinalizeHit.           *
 *   10/10/2004  Split off from objects.cpp file.                           *
 *                                                                          *
 ***************************************************************************/
@@ -17,6 +19,7 @@ struct Block : public Primitive {
     Block() {}
     Block( const Vec3 &Min, const Vec3 &Max );
     virtual bool Intersect( const Ray &ray, HitInfo &hitinfo ) const;
+    virtual void FinalizeHit( const Ray &ray, HitInfo &hitinfo ) const;
     virtual bool Inside( const Vec3 &P ) const;
     virtual Interval GetSlab( const Vec3 & ) const;
     virtual int GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const;
@@ -30,6 +33,7 @@ struct Block : public Primitive {
 // toytracer will automatically recognize the new objects and read them from sdf files.
 
 REGISTER_PLUGIN( Block );
+DEFINE_PRIMITIVE_STAT( tests, "block" );
 
 Block::Block( const Vec3 &Min_, const Vec3 &Max_ )
     {
@@ -68,138 +72,50 @@ Interval Block::GetSlab( const Vec3 &v ) const
     return Interval( a, b ) / ( v * v );
     }
 
+// This is the slab test, using the reciprocal direction and signs cached in
+// the ray (see Ray::Prepare).  Along each axis the ray enters the block through
+// the near face and leaves through the far face, and the sign of the direction
+// says which is which.  The ray is within the block from the latest entry to
+// the earliest exit; if the origin is inside the block, the hit is where the
+// ray leaves it.  Faces are numbered as in FinalizeHit: twice the axis, plus one
+// for the face at the max coordinate.
 bool Block::Intersect( const Ray &ray, HitInfo &hitinfo ) const
     {
-	/*
-	* With this primitive, we need to compute the intersection
-	*	with each axis.
-	* This will let us get an interval of t values for x, y, and z
-	*	The overlap of the intervals will be the regions of our box
-	*	If the final interval is in our acceptable t range, the ray
-	*		intersects the box
-	* If the intervals can't overlap, then the ray does not intersect
-	* 
-	* Here is the procedure in more detail:
-	*	(1) For x, compute t_at_xmin = (Min_x - origin_x)/(direction_x)
-	*			   compute t_at_xmax = (Max_x - origin_x)/(direction_x)
-	*	(2) if direction_x >= 0
-	*				set tx_min = t_at_xmin; tx_max=t_at_xmax
-	*		else
-	*				set tx_max = t_at_xmin; tx_min=t_at_xmax
-	*	(3) repeat (1) and (2) but for y and z
-	*	(4) set (t_min,t_max) equal to the intersection of 
-	*			(tx_min,tx_max), (ty_min,ty_max), (tz_min,tz_max)
-	*/
-	const double min_t = 1;
-	const double max_t = 20;
-
-	double t_at_xmin,t_at_xmax,t_at_ymin,t_at_ymax,t_at_zmin,t_at_zmax;
-	double tmin, tmax, tymin, tymax, tzmin, tzmax;
-	double dist;
-
-	t_at_xmin = (Min.x - ray.origin.x)/(ray.direction.x); 
-	t_at_xmax = (Max.x - ray.origin.x)/(ray.direction.x); 
-
-	if(ray.direction.x >= 0){
-		tmin = t_at_xmin;
-		tmax = t_at_xmax;
-	}else{
-		tmin = t_at_xmax;
-		tmax = t_at_xmin;
-	}
-
-	t_at_ymin = (Min.y - ray.origin.y)/(ray.direction.y); 
-	t_at_ymax = (Max.y - ray.origin.y)/(ray.direction.y); 
-
-	if(ray.direction.y >= 0){
-		tymin = t_at_ymin;
-		tymax = t_at_ymax;
-	}else{
-		tymin = t_at_ymax;
-		tymax = t_at_ymin;
-	}
-
-	if( (tmin > tymax) || (tmax < tymin) ){
-		return false;
-	}
-
-	if(tymin > tmin){
-		tmin = tymin;
-	}
-	if(tymax < tmax){
-		tmax = tymax;
-	}
-
-	t_at_zmin = (Min.z - ray.origin.z)/(ray.direction.z); 
-	t_at_zmax = (Max.z - ray.origin.z)/(ray.direction.z); 
-
-	if(ray.direction.z >= 0){
-		tzmin = t_at_zmin;
-		tzmax = t_at_zmax;
-	}else{
-		tzmin = t_at_zmax;
-		tzmax = t_at_zmin;
-	}
-
-	if( (tmin > tzmax) || (tmax < tzmin) ){
-		return false;
-	}
-
-	if(tzmin > tmin){
-		tmin = tzmin;
-	}
-	if(tzmax < tmax){
-		tmax = tzmax;
-	}
-
-	//look at tmin and tmax to see which one should be used
-	if(tmin > 0){
-		if(tmin > hitinfo.distance){
-			return false;
-		}
-		dist = tmin;
-	}else{
-		//we are either inside the block or the block is behind us
-
-		if(tmax <= 0){
-			//the block is behind us
-			return false;
-		}
-		if(tmax > hitinfo.distance){
-			return false;
-		}
-
-		//we are definitely inside the block so set the intersection point to tmax
-		dist = tmax;
-	}
-	
-	/* Knowing dist will give us the face that we are looking at
-	*	Since the faces are axis-aligned, the normals are
-	*		<0,0,1> , <0,1,0>, <1,0,0> 
-	*		<0,0,-1> , <0,-1,0>, or <-1,0,0>
-	*		depending on which face it is
-	*	We will see what face it is an use that for the normals
-	*/
-	Vec3 currentNormal = Vec3(0,0,0);
-	if(dist == t_at_xmin){
-		currentNormal = Vec3(-1,0,0);
-	}else if(dist == t_at_xmax){
-		currentNormal = Vec3(1,0,0);
-	}else if(dist == t_at_ymin){
-		currentNormal = Vec3(0,-1,0);
-	}else if(dist == t_at_ymax){
-		currentNormal = Vec3(0,1,0);
-	}else if(dist == t_at_zmin){
-		currentNormal = Vec3(0,0,-1);
-	}else if(dist == t_at_zmax){
-		currentNormal = Vec3(0,0,1);
-	}
+    STAT_PRIMITIVE_TEST( tests );
+    const double lo[] = { Min.x, Min.y, Min.z };
+    const double hi[] = { Max.x, Max.y, Max.z };
+    const double *bound[] = { lo, hi };
+    const double Q[] = { ray.origin.x, ray.origin.y, ray.origin.z };
+
+    double t_in  = -Infinity, t_out = Infinity;
+    int face_in  = -1, face_out = -1;
+    for( int a = 0; a < 3; a++ )
+        {
+        const int s = ray.sign[a];
+        const double t_near = ( bound[    s ][a] - Q[a] ) * ray.inv_dir[a];
+        const double t_far  = ( bound[ 1 - s ][a] - Q[a] ) * ray.inv_dir[a];
+        if( t_near > t_in  ) { t_in  = t_near; face_in  = 2 * a + s;     }
+        if( t_far  < t_out ) { t_out = t_far;  face_out = 2 * a + 1 - s; }
+        }
+    if( t_in > t_out || t_out <= 0.0 ) return false; // Missed, or the block is behind us.
+
+    const bool   inside = t_in <= 0.0;
+    const double dist   = inside ? t_out : t_in;
+    if( dist > hitinfo.distance ) return false;
+
+    hitinfo.distance = dist;
+    hitinfo.object   = this;
+    hitinfo.part     = inside ? face_out : face_in;
+    return true;
+    }
 
-	hitinfo.distance = dist;
-	hitinfo.point    = ray.origin + dist * ray.direction;
-	hitinfo.object   = this;
-	hitinfo.normal = currentNormal;
-	return true;
+void Block::FinalizeHit( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    static const Vec3 normals[] = {
+        Vec3(-1,0,0), Vec3(1,0,0), Vec3(0,-1,0), Vec3(0,1,0), Vec3(0,0,-1), Vec3(0,0,1)
+        };
+    hitinfo.point  = ray.origin + hitinfo.distance * ray.direction;
+    hitinfo.normal = ( hitinfo.part >= 0 ) ? normals[ hitinfo.part ] : Vec3(0,0,0);
     }
 
 int Block::GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const
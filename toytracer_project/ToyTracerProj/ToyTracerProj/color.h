@@ -7,6 +7,7 @@
 * component-wise and results in another color.                             *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Channels are reals (float or double).                      *
 *   04/01/2003  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -18,9 +19,9 @@
 struct Color {
     inline Color() { red = 0; green = 0; blue = 0; }
     inline Color( double r, double g, double b ) { red = r; green = g; blue = b; }
-    double red;
-    double green;
-    double blue;
+    real red;
+    real green;
+    real blue;
     };
 
 static const Color
@@ -0,0 +1,511 @@
+/***************************************************************************
+* compare.cpp                                                              *
+*                                                                          *
+* Image comparison, and the "compare" and "golden" commands.  See          *
+* compare.h.  The commands are run as                                      *
+*                                                                          *
+*    toytracer compare A B [diff BASE] [gain G] [tolerance T]              *
+*                          [rmse X] [psnr X] [ssim X] [max X]              *
+*                                                                          *
+* which prints the differences between images A and B, writes the          *
+* difference images BASE.ppm and BASE.pfm if asked, and fails if the RMS   *
+* error or largest difference exceeds the given threshold, or the PSNR or  *
+* SSIM falls below it.  Differences are measured on a scale where white    *
+* is 1 (255 in a PPM file); the tolerance is the difference below which    *
+* pixels are not counted as differing.  And as                             *
+*                                                                          *
+*    toytracer golden [scenes s1,s2,...] [dir DIR] [width N] [update]      *
+*                     [psnr X] [ssim X] [max X]                            *
+*                                                                          *
+* which renders each scene (all those shipped, by default) from DIR        *
+* (scenes, by default) at a width of N pixels (100 by default), keeping    *
+* its aspect ratio, as DIR/name.check.ppm, and compares it with its        *
+* golden image, DIR/name.golden.ppm.  The command fails if any scene has   *
+* drifted: if its PSNR is below 40 dB or its SSIM below 0.98 (by default), *
+* or its largest difference exceeds the given maximum, or it has no golden *
+* image.  The differences of a failing scene are written as                *
+* DIR/name.diff.ppm and .pfm.  The golden images of the shipped scenes, at *
+* the default width, are part of the source, and the default tolerances    *
+* absorb the differences between compilers & precisions.  With "update",   *
+* the renderings are saved as the golden images instead; this is for new   *
+* scenes, or for a change that is meant to alter the images, and the new   *
+* golden images of shipped scenes are then committed along with it.        *
+* Golden images of other scenes are ignored by git (see .gitignore).       *
+*                                                                          *
+* Some shipped scenes are references, rendered by the simplest means (an   *
+* unpacked List & the basic_rasterizer), and the others render the same    *
+* picture by other means: shapes_grid in a grid, shapes_edges with the     *
+* "edges" triangle kernel, and so on.  These have no golden images of      *
+* their own, but are compared with that of their reference, so that each   *
+* aggregate, kernel & rasterizer is checked against the List.  The random  *
+* numbers are restarted for each scene, so that it renders the same        *
+* picture whichever scenes are checked before it.  The scenes with an      *
+* irradiance cache are allowed a PSNR of 28 dB & an SSIM of 0.9, as its    *
+* records move with any change to the samples or the precision.            *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Scenes are compared with the golden images of references.  *
+*   10/18/2026  A scene with no golden image fails, instead of making one. *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include "compare.h"
+#include "ppm_image.h"
+#include "params.h"
+#include "util.h"
+#include "trace.h"
+
+// The scenes that ship with the toytracer, checked by "golden" by default.
+// A scene that renders the same picture as another by other means names it
+// as its reference, and is compared with the golden image of the reference.
+// The records of an irradiance cache move with any change to the samples or
+// the precision, so the scenes that use one have looser tolerances.
+struct golden_scene {
+    const char *name;
+    const char *reference; // NULL if the scene has a golden image of its own.
+    double      psnr;      // The least PSNR & SSIM allowed, or zero for the
+    double      ssim;      // defaults.
+    };
+
+static const golden_scene shipped_scenes[] = {
+    { "scene1"                     , NULL      ,  0.0, 0.0 },
+    { "scene1_withBaileysSlab"     , NULL      ,  0.0, 0.0 },
+    { "scene1_withRefractiveSphere", NULL      ,  0.0, 0.0 },
+    { "scene2"                     , NULL      ,  0.0, 0.0 },
+    { "shapes"                     , NULL      ,  0.0, 0.0 },
+    { "shapes_packed"              , "shapes"  ,  0.0, 0.0 },
+    { "shapes_grid"                , "shapes"  ,  0.0, 0.0 },
+    { "shapes_kdtree"              , "shapes"  ,  0.0, 0.0 },
+    { "shapes_abvh"                , "shapes"  ,  0.0, 0.0 },
+    { "shapes_packets"             , "shapes"  ,  0.0, 0.0 },
+    { "shapes_wavefront"           , "shapes"  ,  0.0, 0.0 },
+    { "shapes_edges"               , "shapes"  ,  0.0, 0.0 },
+    { "shapes_closed_form"         , "shapes"  ,  0.0, 0.0 },
+    { "shapes_instances"           , "shapes"  ,  0.0, 0.0 },
+    { "indirect"                   , NULL      , 28.0, 0.9 },
+    { "indirect_wavefront"         , "indirect", 28.0, 0.9 }
+    };
+
+static const unsigned num_shipped_scenes = sizeof( shipped_scenes ) / sizeof( shipped_scenes[0] );
+
+static const double default_golden_psnr = 40.0;
+static const double default_golden_ssim = 0.98;
+
+// The SSIM of each pixel is computed over a Gaussian window of this radius.
+static const int    ssim_radius = 5;
+static const double ssim_sigma  = 1.5;
+
+// The shipped scene of the given name, or NULL if there is none.
+static const golden_scene *Shipped( const string &name )
+    {
+    for( unsigned i = 0; i < num_shipped_scenes; i++ )
+        {
+        if( name == shipped_scenes[i].name ) return &shipped_scenes[i];
+        }
+    return NULL;
+    }
+
+static bool EndsWith( const string &s, const string &suffix )
+    {
+    return s.size() >= suffix.size() && s.compare( s.size() - suffix.size(), suffix.size(), suffix ) == 0;
+    }
+
+static bool ReadPFM( const string &file_name, FloatImage &image )
+    {
+    std::ifstream in( file_name.c_str(), std::ios::binary );
+    string type;
+    double scale;
+    if( !( in >> type >> image.width >> image.height >> scale ) ) return false;
+    if( type != "PF" && type != "Pf" ) return false;
+    if( image.width <= 0 || image.height <= 0 || scale >= 0.0 ) return false; // Only little-endian.
+    in.get(); // The single blank that ends the header.
+    image.channels = ( type == "PF" ? 3 : 1 );
+    const int row = image.width * image.channels;
+    image.values.resize( row * image.height );
+    for( int i = image.height - 1; i >= 0; i-- ) // The rows are stored from the bottom up.
+        in.read( (char *)&image.values[ i * row ], row * sizeof(float) );
+    return !in.fail();
+    }
+
+bool ReadImage( const string &file_name, FloatImage &image )
+    {
+    if( EndsWith( file_name, ".pfm" ) ) return ReadPFM( file_name, image );
+    PPM_Image I( 1, 1 );
+    if( !I.Read( file_name ) ) return false;
+    image.width    = I.width;
+    image.height   = I.height;
+    image.channels = 3;
+    image.values.resize( 3 * I.width * I.height );
+    for( int i = 0, k = 0; i < I.height; i++ )
+    for( int j = 0; j < I.width;  j++ )
+        {
+        const Pixel &p = I(i,j);
+        image.values[k++] = p.r / 255.0f;
+        image.values[k++] = p.g / 255.0f;
+        image.values[k++] = p.b / 255.0f;
+        }
+    return true;
+    }
+
+// The value of channel c of the pixel, or its luminance if the other image
+// has only one channel.
+static double Value( const FloatImage &A, int i, int j, int c, int channels )
+    {
+    if( A.channels == channels ) return A(i,j,c);
+    if( A.channels == 1 ) return A(i,j,0);
+    return 0.299 * A(i,j,0) + 0.587 * A(i,j,1) + 0.114 * A(i,j,2);
+    }
+
+static double Luminance( const FloatImage &A, int i, int j )
+    {
+    return Value( A, i, j, 0, 1 );
+    }
+
+// Blur the image with a Gaussian of the given weights, keeping only the
+// pixels whose whole window lies within the image.
+static vector<double> Blur( const vector<double> &x, int width, int height, const vector<double> &weight )
+    {
+    const int r  = int( weight.size() ) / 2;
+    const int w2 = width  - 2 * r;
+    const int h2 = height - 2 * r;
+    vector<double> rows( w2 * height );
+    for( int i = 0; i < height; i++ )
+    for( int j = 0; j < w2; j++ )
+        {
+        double sum = 0.0;
+        for( int k = 0; k <= 2 * r; k++ ) sum += weight[k] * x[ i * width + j + k ];
+        rows[ i * w2 + j ] = sum;
+        }
+    vector<double> out( w2 * h2 );
+    for( int i = 0; i < h2; i++ )
+    for( int j = 0; j < w2; j++ )
+        {
+        double sum = 0.0;
+        for( int k = 0; k <= 2 * r; k++ ) sum += weight[k] * rows[ ( i + k ) * w2 + j ];
+        out[ i * w2 + j ] = sum;
+        }
+    return out;
+    }
+
+// The mean structural similarity of the luminance of the two images, after
+// Wang et al. (2004), with an 11x11 Gaussian window and the usual constants
+// for a dynamic range of 1.  Images smaller than the window are treated as
+// a single window.
+static double SSIM( const FloatImage &A, const FloatImage &B )
+    {
+    const double C1 = 0.01 * 0.01;
+    const double C2 = 0.03 * 0.03;
+    const int w = A.width, h = A.height, n = w * h;
+    vector<double> x( n ), y( n ), xx( n ), yy( n ), xy( n );
+    for( int i = 0; i < h; i++ )
+    for( int j = 0; j < w; j++ )
+        {
+        const int k = i * w + j;
+        x[k] = Luminance( A, i, j );
+        y[k] = Luminance( B, i, j );
+        xx[k] = x[k] * x[k];
+        yy[k] = y[k] * y[k];
+        xy[k] = x[k] * y[k];
+        }
+
+    vector<double> weight;
+    if( w > 2 * ssim_radius && h > 2 * ssim_radius )
+        {
+        double total = 0.0;
+        for( int k = -ssim_radius; k <= ssim_radius; k++ )
+            {
+            weight.push_back( exp( -0.5 * k * k / ( ssim_sigma * ssim_sigma ) ) );
+            total += weight.back();
+            }
+        for( unsigned k = 0; k < weight.size(); k++ ) weight[k] /= total;
+        x  = Blur( x,  w, h, weight );
+        y  = Blur( y,  w, h, weight );
+        xx = Blur( xx, w, h, weight );
+        yy = Blur( yy, w, h, weight );
+        xy = Blur( xy, w, h, weight );
+        }
+    else
+        {
+        double sums[5] = { 0, 0, 0, 0, 0 };
+        for( int k = 0; k < n; k++ )
+            {
+            sums[0] += x[k]; sums[1] += y[k]; sums[2] += xx[k]; sums[3] += yy[k]; sums[4] += xy[k];
+            }
+        x .assign( 1, sums[0] / n );
+        y .assign( 1, sums[1] / n );
+        xx.assign( 1, sums[2] / n );
+        yy.assign( 1, sums[3] / n );
+        xy.assign( 1, sums[4] / n );
+        }
+
+    double sum = 0.0;
+    for( unsigned k = 0; k < x.size(); k++ )
+        {
+        const double mx = x[k], my = y[k];
+        const double vx = xx[k] - mx * mx;
+        const double vy = yy[k] - my * my;
+        const double cv = xy[k] - mx * my;
+        sum += ( ( 2.0 * mx * my + C1 ) * ( 2.0 * cv + C2 ) ) /
+               ( ( mx * mx + my * my + C1 ) * ( vx + vy + C2 ) );
+        }
+    return sum / x.size();
+    }
+
+bool CompareImages( const FloatImage &A, const FloatImage &B, ImageDifference &diff, double tolerance )
+    {
+    if( A.width != B.width || A.height != B.height || A.width == 0 || A.height == 0 ) return false;
+    const int channels = min( A.channels, B.channels );
+    double sum = 0.0;
+    diff.max_diff  = 0.0;
+    diff.differing = 0;
+    for( int i = 0; i < A.height; i++ )
+    for( int j = 0; j < A.width;  j++ )
+        {
+        bool differs = false;
+        for( int c = 0; c < channels; c++ )
+            {
+            const double d = fabs( Value( A, i, j, c, channels ) - Value( B, i, j, c, channels ) );
+            sum += d * d;
+            diff.max_diff = max( diff.max_diff, d );
+            if( d > tolerance ) differs = true;
+            }
+        if( differs ) diff.differing++;
+        }
+    diff.rmse = sqrt( sum / ( double( A.width ) * A.height * channels ) );
+    diff.psnr = diff.rmse > 0.0 ? -20.0 * log10( diff.rmse ) : Infinity;
+    diff.ssim = SSIM( A, B );
+    return true;
+    }
+
+bool WriteDifference( const string &base_name, const FloatImage &A, const FloatImage &B, double gain )
+    {
+    if( A.width != B.width || A.height != B.height ) return false;
+    const int channels = min( A.channels, B.channels );
+    PPM_Image I( A.width, A.height );
+    vector<float> values( A.width * A.height * channels );
+    for( int i = 0; i < A.height; i++ )
+    for( int j = 0; j < A.width;  j++ )
+        {
+        double d[3];
+        for( int c = 0; c < channels; c++ )
+            {
+            d[c] = fabs( Value( A, i, j, c, channels ) - Value( B, i, j, c, channels ) );
+            values[ ( i * A.width + j ) * channels + c ] = float( d[c] );
+            }
+        for( int c = channels; c < 3; c++ ) d[c] = d[0];
+        I(i,j) = Pixel(
+            channel( min( 255.0, 255.0 * gain * d[0] + 0.5 ) ),
+            channel( min( 255.0, 255.0 * gain * d[1] + 0.5 ) ),
+            channel( min( 255.0, 255.0 * gain * d[2] + 0.5 ) ) );
+        }
+    if( !I.Write( base_name + ".ppm" ) ) return false;
+
+    std::ofstream out( ( base_name + ".pfm" ).c_str(), std::ios::binary );
+    if( !out ) return false;
+    out << ( channels == 3 ? "PF" : "Pf" ) << "\n" << A.width << " " << A.height << "\n-1.0\n";
+    const int row = A.width * channels;
+    for( int i = A.height - 1; i >= 0; i-- )
+        out.write( (const char *)&values[ i * row ], row * sizeof(float) );
+    return !out.fail();
+    }
+
+static void PrintDifference( const string &name, const ImageDifference &d, unsigned pixels )
+    {
+    cout << name << ": rmse " << d.rmse << ", psnr ";
+    if( d.psnr >= Infinity ) cout << "inf"; else cout << d.psnr;
+    cout << " dB, ssim " << d.ssim << ", max " << d.max_diff
+         << ", " << d.differing << " of " << pixels << " pixels differ" << endl;
+    }
+
+int RunCompare( int argc, char *argv[] )
+    {
+    string args;
+    for( int i = 0; i < argc; i++ ) args += string( argv[i] ) + " ";
+    ParamReader get( args );
+
+    string name_a, name_b, diff_name;
+    double gain      = 10.0;
+    double tolerance = 0.0;
+    double max_rmse  = -1.0;  // Negative thresholds are not checked.
+    double min_psnr  = -1.0;
+    double min_ssim  = -2.0;
+    double max_diff  = -1.0;
+    bool ok = get.Word( name_a ) && get.Word( name_b );
+    for(;;)
+        {
+        if( get["diff"]      && get.Word( diff_name ) ) continue;
+        if( get["gain"]      && get[gain]      ) continue;
+        if( get["tolerance"] && get[tolerance] ) continue;
+        if( get["rmse"]      && get[max_rmse]  ) continue;
+        if( get["psnr"]      && get[min_psnr]  ) continue;
+        if( get["ssim"]      && get[min_ssim]  ) continue;
+        if( get["max"]       && get[max_diff]  ) continue;
+        break;
+        }
+    string extra;
+    if( !ok || get.Word( extra ) )
+        {
+        cerr << "Usage: toytracer compare A B [diff BASE] [gain G] [tolerance T]\n"
+             << "                         [rmse X] [psnr X] [ssim X] [max X]" << endl;
+        return error_bad_arguments;
+        }
+
+    FloatImage A, B;
+    if( !ReadImage( name_a, A ) ) { cerr << "Error: Could not read image " << name_a << endl; return error_reading_input_file; }
+    if( !ReadImage( name_b, B ) ) { cerr << "Error: Could not read image " << name_b << endl; return error_reading_input_file; }
+
+    ImageDifference d;
+    if( !CompareImages( A, B, d, tolerance ) )
+        {
+        cerr << "Error: " << name_a << " is " << A.width << "x" << A.height << " but "
+             << name_b << " is " << B.width << "x" << B.height << endl;
+        return error_images_differ;
+        }
+    PrintDifference( name_a + " vs " + name_b, d, A.width * A.height );
+
+    if( !diff_name.empty() && !WriteDifference( diff_name, A, B, gain ) )
+        cerr << "Error: Could not write " << diff_name << ".ppm" << endl;
+
+    bool pass = true;
+    if( max_rmse >= 0.0 && d.rmse     > max_rmse ) { cout << "FAIL: rmse exceeds " << max_rmse << endl; pass = false; }
+    if( min_psnr >= 0.0 && d.psnr     < min_psnr ) { cout << "FAIL: psnr is below " << min_psnr << endl; pass = false; }
+    if( min_ssim >= -1.0 && d.ssim    < min_ssim ) { cout << "FAIL: ssim is below " << min_ssim << endl; pass = false; }
+    if( max_diff >= 0.0 && d.max_diff > max_diff ) { cout << "FAIL: max difference exceeds " << max_diff << endl; pass = false; }
+    return pass ? no_errors : error_images_differ;
+    }
+
+// Render the scene dir/name.sdf at the given width, as dir/name.check.ppm.
+static bool RenderScene( const string &dir, const string &name, unsigned width )
+    {
+    Builder *builder = (Builder *)LookupPlugin( builder_plugin );
+    if( builder == NULL ) return false;
+    Scene  scene;
+    Camera camera;
+    if( !builder->BuildScene( dir + "/" + name, camera, scene ) ) return false;
+    camera.y_res = unsigned( max( 1.0, double( camera.y_res ) * width / camera.x_res + 0.5 ) );
+    camera.x_res = width;
+    if( scene.rasterize == NULL ) scene.rasterize = (Rasterizer *)LookupPlugin( rasterizer_plugin );
+    if( scene.rasterize == NULL ) return false;
+    TraceSpan span( "render " + name );
+    SeedRandom( 0 ); // So that a scene drawing random numbers is the same whatever came before it.
+    return scene.rasterize->Rasterize( dir + "/" + name + ".check", camera, scene, scene, false );
+    }
+
+int RunGolden( int argc, char *argv[] )
+    {
+    string args;
+    for( int i = 0; i < argc; i++ ) args += string( argv[i] ) + " ";
+    ParamReader get( args );
+
+    string   scene_list, dir = "scenes";
+    unsigned width    = 100;
+    bool     update   = false;
+    double   min_psnr = default_golden_psnr;
+    double   min_ssim = default_golden_ssim;
+    double   max_diff = -1.0;
+    bool     psnr_given = false;
+    bool     ssim_given = false;
+    for(;;)
+        {
+        if( get["scenes"] && get.Word( scene_list ) ) continue;
+        if( get["dir"]    && get.Word( dir ) ) continue;
+        if( get["width"]  && get[width]      ) continue;
+        if( get["update"] ) { update = true;   continue; }
+        if( get["psnr"]   && get[min_psnr]   ) { psnr_given = true; continue; }
+        if( get["ssim"]   && get[min_ssim]   ) { ssim_given = true; continue; }
+        if( get["max"]    && get[max_diff]   ) continue;
+        break;
+        }
+    string extra;
+    if( get.Word( extra ) || width == 0 )
+        {
+        cerr << "Usage: toytracer golden [scenes s1,s2,...] [dir DIR] [width N] [update]\n"
+             << "                        [psnr X] [ssim X] [max X]" << endl;
+        return error_bad_arguments;
+        }
+
+    vector<string> scenes;
+    std::stringstream in( scene_list );
+    for( string name; std::getline( in, name, ',' ); ) if( !name.empty() ) scenes.push_back( name );
+    if( scenes.empty() )
+        {
+        for( unsigned i = 0; i < num_shipped_scenes; i++ ) scenes.push_back( shipped_scenes[i].name );
+        }
+
+    unsigned failures = 0;
+    for( unsigned s = 0; s < scenes.size(); s++ )
+        {
+        const string base = dir + "/" + scenes[s];
+        const golden_scene *shipped = Shipped( scenes[s] );
+        const string reference = shipped != NULL && shipped->reference != NULL ? shipped->reference : scenes[s];
+        const string golden_base = dir + "/" + reference;
+        if( update && reference != scenes[s] )
+            {
+            cout << scenes[s] << " is compared with the golden image of " << reference << "." << endl;
+            continue;
+            }
+        if( !RenderScene( dir, scenes[s], width ) )
+            {
+            cerr << "Error: Could not render " << base << ".sdf" << endl;
+            failures++;
+            continue;
+            }
+
+        FloatImage check, golden;
+        if( !ReadImage( base + ".check.ppm", check ) )
+            {
+            cerr << "Error: Could not read " << base << ".check.ppm" << endl;
+            failures++;
+            continue;
+            }
+        if( !update && !ReadImage( golden_base + ".golden.ppm", golden ) )
+            {
+            cout << "FAIL: " << scenes[s] << " has no golden image " << golden_base << ".golden.ppm "
+                 << "(make one with \"update\")." << endl;
+            failures++;
+            continue;
+            }
+        if( update )
+            {
+            std::ifstream from( ( base + ".check.ppm" ).c_str(), std::ios::binary );
+            std::ofstream to( ( base + ".golden.ppm" ).c_str(), std::ios::binary );
+            if( !( to << from.rdbuf() ) )
+                {
+                cerr << "Error: Could not write " << base << ".golden.ppm" << endl;
+                failures++;
+                }
+            else cout << "Saved " << base << ".golden.ppm" << endl;
+            continue;
+            }
+
+        ImageDifference d;
+        bool pass = CompareImages( check, golden, d );
+        if( pass )
+            {
+            PrintDifference( reference == scenes[s] ? scenes[s] : scenes[s] + " vs " + reference, d, check.width * check.height );
+            const double psnr = shipped != NULL && shipped->psnr > 0.0 && !psnr_given ? shipped->psnr : min_psnr;
+            const double ssim = shipped != NULL && shipped->ssim > 0.0 && !ssim_given ? shipped->ssim : min_ssim;
+            pass = d.psnr >= psnr && d.ssim >= ssim && ( max_diff < 0.0 || d.max_diff <= max_diff );
+            }
+        else cout << scenes[s] << ": the golden image is " << golden.width << "x" << golden.height
+                  << ", not " << check.width << "x" << check.height << endl;
+        if( !pass )
+            {
+            cout << "FAIL: " << scenes[s] << " has drifted from its golden image." << endl;
+            if( check.width == golden.width && check.height == golden.height ) WriteDifference( base + ".diff", check, golden );
+            failures++;
+            }
+        }
+
+    if( failures > 0 )
+        {
+        cout << failures << " of " << scenes.size() << " scenes failed." << endl;
+        return error_images_differ;
+        }
+    cout << "All " << scenes.size() << " scenes passed." << endl;
+    return no_errors;
+    }
@@ -0,0 +1,94 @@
+/***************************************************************************
+* compare.h                                                                *
+*                                                                          *
+* Image comparison, for checking that an optimization has not changed the  *
+* pictures.  Images are read from PPM files (via PPM_Image) or from PFM    *
+* files of floats, such as those written by the heatmap_rasterizer, and    *
+* compared by their RMS error, peak signal-to-noise ratio, structural      *
+* similarity (SSIM) and largest difference.  The differences can also be   *
+* written out as images.                                                   *
+*                                                                          *
+* Two commands are built on these functions:                               *
+*                                                                          *
+*    toytracer compare A B [options]   compares two images, and fails if   *
+*                                      they differ by more than the        *
+*                                      thresholds given;                   *
+*    toytracer golden [options]        renders the shipped scenes at a low *
+*                                      resolution and compares them with   *
+*                                      the golden images that ship with    *
+*                                      them (in scenes/), or with those    *
+*                                      of the List references that they    *
+*                                      must match.                         *
+*                                                                          *
+* See compare.cpp for the options.                                         *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Scenes may be checked against reference scenes.            *
+*   10/18/2026  The golden images ship with the scenes.                    *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#ifndef __COMPARE_INCLUDED__
+#define __COMPARE_INCLUDED__
+
+#include "toytracer.h"
+
+// An image of floats, with one or three channels per pixel, stored row by
+// row from the top of the image.  The values of PPM images are scaled to
+// [0,1], so that images of either kind can be compared.
+struct FloatImage {
+    FloatImage() { width = 0; height = 0; channels = 0; }
+    float operator()( int i, int j, int c ) const { return values[ ( i * width + j ) * channels + c ]; }
+    int width;
+    int height;
+    int channels;
+    vector<float> values;
+    };
+
+struct ImageDifference {
+    double   rmse;      // Root mean square difference, over all channels.
+    double   psnr;      // Peak signal-to-noise ratio in decibels, for a peak of 1.
+    double   ssim;      // Mean structural similarity of the luminance, in [-1,1].
+    double   max_diff;  // The largest difference in any channel.
+    unsigned differing; // Pixels differing by more than the tolerance in any channel.
+    };
+
+// Read a PPM (P6) or PFM (PF or Pf) file.  Returns false if it could not be
+// read.
+extern bool ReadImage(
+    const string &file_name,
+    FloatImage &image
+    );
+
+// Compare the two images, which must be the same size.  Returns false if
+// they are not.  Single-channel images are compared with the luminance of
+// three-channel ones.
+extern bool CompareImages(
+    const FloatImage &A,
+    const FloatImage &B,
+    ImageDifference &diff,
+    double tolerance = 0.0
+    );
+
+// Write the per-pixel absolute differences, as base_name.ppm (multiplied by
+// the gain, to make small differences visible) and as base_name.pfm.
+extern bool WriteDifference(
+    const string &base_name,
+    const FloatImage &A,
+    const FloatImage &B,
+    double gain = 10.0
+    );
+
+// Run "toytracer compare" or "toytracer golden", given the arguments that
+// follow the command.  Each returns one of the error codes of main.
+extern int RunCompare(
+    int argc,
+    char *argv[]
+    );
+
+extern int RunGolden(
+    int argc,
+    char *argv[]
+    );
+
+#endif
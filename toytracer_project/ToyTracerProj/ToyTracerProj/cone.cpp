@@ -6,6 +6,7 @@
 * and no interior.                                                         *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Point & normal are now filled in by FinalizeHit.           *
 *   10/11/2005  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -17,15 +18,18 @@ struct cone : public Primitive {
     cone() {}
     cone( bool hollow_ ) { hollow = hollow_; }
     virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual void FinalizeHit( const Ray &ray, HitInfo & ) const;
     virtual bool Inside( const Vec3 &P ) const; 
     virtual Interval GetSlab( const Vec3 & ) const;
     virtual int GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const;
     virtual Plugin *ReadString( const string &params );
     virtual string MyName() const { return "cone"; }
+    enum { wall, cap }; // The parts of the cone.
     bool hollow;
     };
 
 REGISTER_PLUGIN( cone );
+DEFINE_PRIMITIVE_STAT( tests, "cone" );
 
 Plugin *cone::ReadString( const string &params )
     {
@@ -52,18 +56,18 @@ bool cone::Inside( const Vec3 &P ) const
 
 bool cone::Intersect( const Ray &ray, HitInfo &hitinfo ) const
     {
+    STAT_PRIMITIVE_TEST( tests );
     // The intersection is computed with a cone whose vertex is at the origin
     // as this simplifies the computation somewhat.  To do this we need only
-    // translate the ray origin down by one at the start, then translate the
-    // point of intersection up at the end.
+    // translate the ray origin down by one at the start.  The point of
+    // intersection is found later from the original ray, by FinalizeHit.
     const Vec3 Q( ray.origin - Vec3(0,0,1) );  // Shift the cone down by 1.
     const Vec3 R( ray.direction );
     bool hit = false;
     double z = 0.0;
     double s = Infinity;
     double s1, s2;
-    Vec3 P; // The point of intersection with the cone.
-    Vec3 N; // The normal vector at the point of intersection.
+    int part = wall; // The part of the cone that is hit.
 
     // Test for easy (vertical) reject cases.
     if( R.z >= 0.0 )
@@ -112,15 +116,6 @@ bool cone::Intersect( const Ray &ray, HitInfo &hitinfo ) const
         hit = ( -1.0 <= z && z <= 0.0 );
         }
 
-    if( hit )
-        {
-        // Fill in the point of intersection and the normal.
-        P.x = Q.x + s * R.x;
-        P.y = Q.y + s * R.y;
-        P.z = z;
-        N = Unit( P.x, P.y, sqrt( sqr(P.x) + sqr(P.y) ) ); 
-        }
-
     // Now check the end cap, provided the cone is not hollow and the ray 
     // is not parallel to the cap.
 
@@ -135,8 +130,7 @@ bool cone::Intersect( const Ray &ray, HitInfo &hitinfo ) const
             if( C.x * C.x + C.y * C.y <= 1.0 )
                 {
                 s = s_cap;
-                P = C;
-                N = Vec3( 0, 0, -1.0 );
+                part = cap;
                 hit = true;
                 }
             } 
@@ -144,15 +138,26 @@ bool cone::Intersect( const Ray &ray, HitInfo &hitinfo ) const
 
     if( !hit || s >= hitinfo.distance ) return false;
 
-    P.z = P.z + 1.0;  // Undo the earlier translation.
+    // The point and normal are filled in later by FinalizeHit, if this turns
+    // out to be the closest hit.
 
     hitinfo.distance = s;
-    hitinfo.point    = P;
-    hitinfo.normal   = N;
     hitinfo.object   = this;
+    hitinfo.part     = part;
     return true;
     }
 
+// Fill in the point of intersection and the normal.  The normal of the wall
+// depends only on x and y, so the earlier translation need not be undone.
+void cone::FinalizeHit( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    const Vec3 P( ray.origin + hitinfo.distance * ray.direction );
+    hitinfo.point = P;
+    if( hitinfo.part == wall )
+         hitinfo.normal = Unit( P.x, P.y, sqrt( sqr(P.x) + sqr(P.y) ) ); 
+    else hitinfo.normal = Vec3( 0, 0, -1.0 );
+    }
+
 int cone::GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const
     {
     // To be supplied...
@@ -6,6 +6,7 @@
 * cylinder has no end caps and no interior.                                *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Point & normal are now filled in by FinalizeHit.           *
 *   10/11/2005  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -17,15 +18,18 @@ struct cylinder : public Primitive {
     cylinder() {}
     cylinder( bool hollow_ ) { hollow = hollow_; }
     virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual void FinalizeHit( const Ray &ray, HitInfo & ) const;
     virtual bool Inside( const Vec3 &P ) const; 
     virtual Interval GetSlab( const Vec3 & ) const;
     virtual int GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const;
     virtual Plugin *ReadString( const string &params );
     virtual string MyName() const { return "cylinder"; }
+    enum { wall, cap }; // The parts of the cylinder.
     bool hollow;
     };
 
 REGISTER_PLUGIN( cylinder );
+DEFINE_PRIMITIVE_STAT( tests, "cylinder" );
 
 Plugin *cylinder::ReadString( const string &params )
     {
@@ -49,11 +53,11 @@ bool cylinder::Inside( const Vec3 &P ) const
 
 bool cylinder::Intersect( const Ray &ray, HitInfo &hitinfo ) const
     {
+    STAT_PRIMITIVE_TEST( tests );
     double s = Infinity;
     const Vec3 Q( ray.origin );
     const Vec3 R( ray.direction );
-    Vec3 P; // The point of intersection with the cylinder.
-    Vec3 N; // The normal vector at the point of intersection.
+    int part = wall; // The part of the cylinder that is hit.
 
     // Test for easy (vertical) reject cases.
     if( R.z >= 0.0 )
@@ -98,15 +102,13 @@ bool cylinder::Intersect( const Ray &ray, HitInfo &hitinfo ) const
                 {
                 // The close hit with the infinite cylinder is valid.
                 s = s_min;
-                P = Near;
-                N = Unit( P.x, P.y, 0.0 );
+                part = wall;
                 }             
             else if( -1.0 <= Far.z && Far.z <= 1.0 )
                 {
                 // The far hit with the infinite cylinder is valid.
                 s = s_max;
-                P = Far;
-                N = Unit( P.x, P.y, 0.0 );
+                part = wall;
                 }
             else if( Near.z * Far.z > 0.0 )
                 {
@@ -123,8 +125,7 @@ bool cylinder::Intersect( const Ray &ray, HitInfo &hitinfo ) const
                 {
                 // The far hit with the infinite cylinder is valid.
                 s = s_max;
-                P = Far;
-                N = Unit( P.x, P.y, 0.0 );
+                part = wall;
                 }
             }
         }
@@ -148,8 +149,7 @@ bool cylinder::Intersect( const Ray &ray, HitInfo &hitinfo ) const
             if( C.x * C.x + C.y * C.y <= 1.0 )
                 {
                 s = s_cap;
-                P = C;
-                N = Vec3( 0, 0, C.z > 0.0 ? 1.0 : -1.0 );
+                part = cap;
                 }
             // No need to consider another potential cap hit.  If the closest one
             // is outside the unit disk, and the other is inside the unit disk,
@@ -160,16 +160,25 @@ bool cylinder::Intersect( const Ray &ray, HitInfo &hitinfo ) const
 
     if( s >= hitinfo.distance ) return false;
 
-    // We have an actual hit.  Fill in all the geometric information so
-    // that the shader can shade this point.
+    // We have an actual hit.  The point and normal are filled in later by
+    // FinalizeHit, if this turns out to be the closest hit.
 
     hitinfo.distance = s;
-    hitinfo.point    = P;
-    hitinfo.normal   = N;
     hitinfo.object   = this;
+    hitinfo.part     = part;
     return true;
     }
 
+// Fill in all the geometric information so that the shader can shade this point.
+void cylinder::FinalizeHit( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    const Vec3 P( ray.origin + hitinfo.distance * ray.direction );
+    hitinfo.point = P;
+    if( hitinfo.part == wall )
+         hitinfo.normal = Unit( P.x, P.y, 0.0 );
+    else hitinfo.normal = Vec3( 0, 0, P.z > 0.0 ? 1.0 : -1.0 );
+    }
+
 int cylinder::GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const
     {
     // To be supplied...
@@ -0,0 +1,397 @@
+/***************************************************************************
+* grid.cpp   (aggregate object plugin)                                     *
+*                                                                          *
+* The "grid" object is a uniform grid of cells, each holding the children  *
+* whose bounding boxes overlap it.  A ray visits the cells it passes       *
+* through in order using 3D-DDA, and stops as soon as it finds a hit       *
+* within the current cell.  Grids are quick to build and work well when    *
+* the children are of similar size and spread fairly evenly (e.g. clouds   *
+* of particles, or terrain).  Usage:                                       *
+*                                                                          *
+*    begin grid [density D] [threads N]                                    *
+*                                                                          *
+* where "density" is the number of cells per child (default 2), and        *
+* "threads" is the number of threads used to build the grid (default: one  *
+* per hardware thread).                                                    *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  The build threads share one array of counts.               *
+*   10/18/2026  Added Rebuild, for children that have moved.               *
+*   10/18/2026  The build passes are timed by trace spans.                 *
+*   10/18/2026  Uses the reciprocal direction cached in the ray.           *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include "toytracer.h"
+#include "util.h"
+#include "params.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+static const double   default_density = 2.0;
+static const unsigned max_resolution  = 256;  // Most cells along any axis.
+static const unsigned min_build_share = 1024; // Fewest children per build thread.
+
+// A child that is tested by a ray is recorded in a small direct-mapped
+// "mailbox" so that it is not tested again when the ray reaches another
+// cell that the child overlaps.  The mailbox lives on the stack of each
+// traversal, so rays traced by different threads do not interfere.
+static const unsigned mailbox_size = 16; // Must be a power of two.
+
+struct grid : public Aggregate {
+    grid( double density = default_density, unsigned threads = 0 );
+   ~grid() {}
+    virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual bool Inside( const Vec3 & ) const;
+    virtual Interval GetSlab( const Vec3 & ) const;
+    virtual Plugin *ReadString( const string &params );
+    virtual string MyName() const { return "grid"; }
+    virtual void Close();
+    virtual void Rebuild();
+    virtual double Cost() const;
+    void Resolve( const AABB &box, unsigned lo[], unsigned hi[] ) const;
+    void Count( unsigned first, unsigned last, std::atomic<unsigned> *count ) const;
+    void Fill ( unsigned first, unsigned last, std::atomic<unsigned> *next );
+    void Sort ( unsigned first, unsigned last );
+    double   density;     // Cells per child.
+    unsigned num_threads; // Zero means one per hardware thread.
+    AABB     bbox;        // Bounds of all the bounded children.
+    unsigned res[3];      // Number of cells along each axis.
+    Vec3     cell_size;   // Dimensions of a single cell.
+    Vec3     inv_size;    // Reciprocals of the cell dimensions.
+    vector<AABB>     boxes;     // Bounding box of each child.
+    vector<unsigned> cell_start; // Cell c holds items [cell_start[c],cell_start[c+1]).
+    vector<unsigned> items;      // Indices of the children in each cell.
+    vector<unsigned> unbounded;  // Children that cannot be placed in cells.
+    };
+
+REGISTER_PLUGIN( grid );
+
+grid::grid( double density_, unsigned threads )
+    {
+    density     = density_;
+    num_threads = threads;
+    bbox        = AABB::Null();
+    res[0] = res[1] = res[2] = 0;
+    }
+
+Plugin *grid::ReadString( const string &params )
+    {
+    ParamReader get( params );
+    if( get["begin"] && get[MyName()] )
+        {
+        double   density = default_density;
+        unsigned threads = 0;
+        for(;;)
+            {
+            if( get["density"] && get[density] ) continue;
+            if( get["threads"] && get[threads] ) continue;
+            break;
+            }
+        if( density <= 0.0 ) density = default_density;
+        return new grid( density, threads );
+        }
+    return NULL;
+    }
+
+// Find the range of cells, inclusive, that overlap the given box.
+void grid::Resolve( const AABB &box, unsigned lo[], unsigned hi[] ) const
+    {
+    const double box_min [] = { box.X.min, box.Y.min, box.Z.min };
+    const double box_max [] = { box.X.max, box.Y.max, box.Z.max };
+    const double grid_min[] = { bbox.X.min, bbox.Y.min, bbox.Z.min };
+    const double inv     [] = { inv_size.x, inv_size.y, inv_size.z };
+    for( int a = 0; a < 3; a++ )
+        {
+        const double i = floor( ( box_min[a] - grid_min[a] ) * inv[a] );
+        const double j = floor( ( box_max[a] - grid_min[a] ) * inv[a] );
+        lo[a] = i < 0.0 ? 0 : ( i >= res[a] ? res[a] - 1 : unsigned(i) );
+        hi[a] = j < 0.0 ? 0 : ( j >= res[a] ? res[a] - 1 : unsigned(j) );
+        }
+    }
+
+// Count the cells overlapped by children first through last-1, adding to
+// the per-cell counts, which are shared by all the threads.
+void grid::Count( unsigned first, unsigned last, std::atomic<unsigned> *count ) const
+    {
+    TraceSpan span( "grid count", "build" );
+    unsigned lo[3], hi[3];
+    for( unsigned n = first; n < last; n++ )
+        {
+        if( IsNull( boxes[n] ) ) continue;
+        Resolve( boxes[n], lo, hi );
+        for( unsigned k = lo[2]; k <= hi[2]; k++ )
+        for( unsigned j = lo[1]; j <= hi[1]; j++ )
+        for( unsigned i = lo[0]; i <= hi[0]; i++ )
+            count[ ( k * res[1] + j ) * res[0] + i ].fetch_add( 1, std::memory_order_relaxed );
+        }
+    }
+
+// Place children first through last-1 in each cell they overlap, at the
+// positions given by "next", which are advanced as a side effect.
+void grid::Fill( unsigned first, unsigned last, std::atomic<unsigned> *next )
+    {
+    TraceSpan span( "grid fill", "build" );
+    unsigned lo[3], hi[3];
+    for( unsigned n = first; n < last; n++ )
+        {
+        if( IsNull( boxes[n] ) ) continue;
+        Resolve( boxes[n], lo, hi );
+        for( unsigned k = lo[2]; k <= hi[2]; k++ )
+        for( unsigned j = lo[1]; j <= hi[1]; j++ )
+        for( unsigned i = lo[0]; i <= hi[0]; i++ )
+            items[ next[ ( k * res[1] + j ) * res[0] + i ].fetch_add( 1, std::memory_order_relaxed ) ] = n;
+        }
+    }
+
+// Put the children of cells first through last-1 back in the order in
+// which they were added, which the threads of Fill may have mixed up.
+void grid::Sort( unsigned first, unsigned last )
+    {
+    TraceSpan span( "grid sort", "build" );
+    for( unsigned c = first; c < last; c++ )
+        std::sort( items.begin() + cell_start[c], items.begin() + cell_start[c+1] );
+    }
+
+// The grid is built once all the children are known.  The resolution is
+// chosen so that the cells are roughly cubical and there are about "density"
+// cells per child.  The children are then sorted into the cells with a
+// two-pass counting sort: each thread counts the cells overlapped by its
+// share of the children into one shared array of counts, the counts are
+// summed into the starting position of each cell, and then each thread
+// writes its children into place.  The threads claim their positions as
+// they go, so the children of each cell are finally sorted, which makes
+// the result the same regardless of the number of threads.
+void grid::Close()
+    {
+    const unsigned n = NumChildren();
+    boxes.resize( n );
+    for( unsigned i = 0; i < n; i++ )
+        {
+        AABB box( GetBox( *GetChild(i) ) );
+        if( !( Len( box.X ) < Infinity && Len( box.Y ) < Infinity && Len( box.Z ) < Infinity ) )
+            {
+            // Children that extend to infinity are tested by every ray.
+            unbounded.push_back( i );
+            box = AABB::Null();
+            }
+        else bbox << box;
+        boxes[i] = box;
+        }
+    if( IsNull( bbox ) ) return;
+
+    // Thicken the box slightly so that flat scenes and children lying on
+    // its faces still fall within the cells.
+    const Vec3 extent( bbox.MaxCorner() - bbox.MinCorner() );
+    const double pad = 1.0e-6 * max( extent.x, extent.y, extent.z ) + 1.0e-9;
+    bbox.X.min -= pad; bbox.X.max += pad;
+    bbox.Y.min -= pad; bbox.Y.max += pad;
+    bbox.Z.min -= pad; bbox.Z.max += pad;
+
+    // Choose the number of cells per unit length, k, so that there are about
+    // "density" cells per child.  An axis along which the scene is too thin
+    // to warrant more than one cell is given just one, and k is recomputed
+    // from the remaining axes.
+    const Vec3 size( bbox.MaxCorner() - bbox.MinCorner() );
+    const double dims[] = { size.x, size.y, size.z };
+    const double target = density * ( n - unbounded.size() );
+    bool thin[] = { false, false, false };
+    double k = 0.0;
+    for( int pass = 0; pass < 3; pass++ )
+        {
+        double product = 1.0;
+        int axes = 0;
+        for( int a = 0; a < 3; a++ )
+            if( !thin[a] ) { product *= dims[a]; axes++; }
+        if( axes == 0 ) break;
+        k = pow( target / product, 1.0 / axes );
+        bool changed = false;
+        for( int a = 0; a < 3; a++ )
+            if( !thin[a] && dims[a] * k < 1.0 ) { thin[a] = true; changed = true; }
+        if( !changed ) break;
+        }
+    for( int a = 0; a < 3; a++ )
+        {
+        const double r = thin[a] ? 1.0 : ceil( dims[a] * k );
+        res[a] = r < 1.0 ? 1 : ( r > max_resolution ? max_resolution : unsigned(r) );
+        }
+    cell_size = Vec3( size.x / res[0], size.y / res[1], size.z / res[2] );
+    inv_size  = Vec3( 1.0 / cell_size.x, 1.0 / cell_size.y, 1.0 / cell_size.z );
+    const unsigned num_cells = res[0] * res[1] * res[2];
+
+    unsigned threads = num_threads;
+    if( threads == 0 ) threads = std::thread::hardware_concurrency();
+    if( threads > n / min_build_share ) threads = n / min_build_share;
+    if( threads == 0 ) threads = 1;
+
+    // Thread t handles children share[t] through share[t+1]-1.
+    vector<unsigned> share( threads + 1 );
+    for( unsigned t = 0; t <= threads; t++ ) share[t] = unsigned( ( double(n) * t ) / threads );
+
+    // Pass one: count the children overlapping each cell.
+    vector< std::atomic<unsigned> > counts( num_cells );
+    for( unsigned c = 0; c < num_cells; c++ ) counts[c].store( 0, std::memory_order_relaxed );
+    vector<std::thread> pool;
+    for( unsigned t = 1; t < threads; t++ )
+        pool.push_back( std::thread( &grid::Count, this, share[t], share[t+1], &counts[0] ) );
+    Count( share[0], share[1], &counts[0] );
+    for( unsigned t = 0; t < pool.size(); t++ ) pool[t].join();
+    pool.clear();
+
+    // Turn the counts into starting positions.
+    cell_start.resize( num_cells + 1 );
+    unsigned total = 0;
+    for( unsigned c = 0; c < num_cells; c++ )
+        {
+        const unsigned count = counts[c].load( std::memory_order_relaxed );
+        cell_start[c] = total;
+        counts[c].store( total, std::memory_order_relaxed );
+        total += count;
+        }
+    cell_start[ num_cells ] = total;
+
+    // Pass two: write the children into their cells.
+    items.resize( total );
+    for( unsigned t = 1; t < threads; t++ )
+        pool.push_back( std::thread( &grid::Fill, this, share[t], share[t+1], &counts[0] ) );
+    Fill( share[0], share[1], &counts[0] );
+    for( unsigned t = 0; t < pool.size(); t++ ) pool[t].join();
+    pool.clear();
+
+    // A single thread fills each cell in order; otherwise sort the cells,
+    // with each thread taking an equal share of them.
+    if( threads > 1 )
+        {
+        for( unsigned t = 0; t <= threads; t++ ) share[t] = unsigned( ( double(num_cells) * t ) / threads );
+        for( unsigned t = 1; t < threads; t++ )
+            pool.push_back( std::thread( &grid::Sort, this, share[t], share[t+1] ) );
+        Sort( share[0], share[1] );
+        for( unsigned t = 0; t < pool.size(); t++ ) pool[t].join();
+        }
+    vector<AABB>().swap( boxes ); // The boxes are no longer needed.
+    }
+
+// Some of the children have moved, so place them in new cells from scratch.
+void grid::Rebuild()
+    {
+    bbox = AABB::Null();
+    cell_start.clear();
+    items.clear();
+    unbounded.clear();
+    Close();
+    }
+
+bool grid::Intersect( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    bool found_a_hit = false;
+    for( unsigned i = 0; i < unbounded.size(); i++ )
+        {
+        const Object *obj = GetChild( unbounded[i] );
+        if( obj != hitinfo.ignore && obj->Intersect( ray, hitinfo ) ) found_a_hit = true;
+        }
+
+    Interval I;
+    if( cell_start.empty() || !Hit( ray, bbox, I, hitinfo.distance ) ) return found_a_hit;
+
+    // Find the cell containing the point where the ray enters the grid, and
+    // set up the 3D-DDA.  Along each axis, "next" is the distance at which
+    // the ray crosses into the next cell, and "delta" is the distance between
+    // successive crossings.
+    const double Q[] = { ray.origin.x, ray.origin.y, ray.origin.z };
+    const double R[] = { ray.direction.x, ray.direction.y, ray.direction.z };
+    const double grid_min[] = { bbox.X.min, bbox.Y.min, bbox.Z.min };
+    const double cell[] = { cell_size.x, cell_size.y, cell_size.z };
+    const double inv [] = { inv_size.x,  inv_size.y,  inv_size.z  };
+    int    index[3], step[3], stop[3];
+    double next [3], delta[3];
+    for( int a = 0; a < 3; a++ )
+        {
+        const double x = ( Q[a] + I.min * R[a] - grid_min[a] ) * inv[a];
+        int i = int( floor( x ) );
+        if( i < 0 ) i = 0;
+        if( i >= int(res[a]) ) i = res[a] - 1;
+        index[a] = i;
+        if( R[a] > 0.0 )
+            {
+            step [a] = 1;
+            stop [a] = res[a];
+            next [a] = ( grid_min[a] + ( i + 1 ) * cell[a] - Q[a] ) * ray.inv_dir[a];
+            delta[a] = cell[a] * ray.inv_dir[a];
+            }
+        else if( R[a] < 0.0 )
+            {
+            step [a] = -1;
+            stop [a] = -1;
+            next [a] = ( grid_min[a] + i * cell[a] - Q[a] ) * ray.inv_dir[a];
+            delta[a] = -cell[a] * ray.inv_dir[a];
+            }
+        else
+            {
+            step [a] = 0;
+            stop [a] = -1;
+            next [a] = Infinity;
+            delta[a] = Infinity;
+            }
+        }
+
+    unsigned mailbox[ mailbox_size ];
+    for( unsigned m = 0; m < mailbox_size; m++ ) mailbox[m] = ~0u;
+
+    for(;;)
+        {
+        const unsigned c = ( index[2] * res[1] + index[1] ) * res[0] + index[0];
+        STAT_COUNT( stat_node_visits );
+        for( unsigned k = cell_start[c]; k < cell_start[c+1]; k++ )
+            {
+            const unsigned i = items[k];
+            unsigned &slot = mailbox[ i & ( mailbox_size - 1 ) ];
+            if( slot == i ) continue; // Already tested in a previous cell.
+            slot = i;
+            const Object *obj = GetChild(i);
+            if( obj != hitinfo.ignore && obj->Intersect( ray, hitinfo ) ) found_a_hit = true;
+            }
+
+        // Step to whichever neighbouring cell the ray reaches first.  A hit
+        // that lies within the current cell cannot be beaten by anything in
+        // the cells beyond it.
+        const int a = next[0] < next[1] ? ( next[0] < next[2] ? 0 : 2 ) : ( next[1] < next[2] ? 1 : 2 );
+        if( hitinfo.distance <= next[a] || next[a] > I.max ) break;
+        index[a] += step[a];
+        if( index[a] == stop[a] ) break;
+        next[a] += delta[a];
+        }
+    return found_a_hit;
+    }
+
+bool grid::Inside( const Vec3 &P ) const
+    {
+    for( unsigned i = 0; i < NumChildren(); i++ )
+        {
+        if( GetChild(i)->Inside( P ) ) return true;
+        }
+    return false;
+    }
+
+Interval grid::GetSlab( const Vec3 &v ) const
+    {
+    Interval I = Interval::Null();
+    for( unsigned i = 0; i < NumChildren(); i++ )
+        I << GetChild(i)->GetSlab(v);
+    return I;
+    }
+
+// Estimate the cost of intersecting a ray with the grid as the cost of the
+// cells along a typical path through it: a ray crosses roughly half of the
+// cells along each axis, and tests the children of each cell it visits.
+double grid::Cost() const
+    {
+    double child_cost = 0.0;
+    for( unsigned i = 0; i < NumChildren(); i++ )
+        child_cost += GetChild(i)->Cost();
+    if( cell_start.empty() ) return child_cost;
+    const double num_cells = double( res[0] ) * res[1] * res[2];
+    const double per_cell  = child_cost * items.size() / ( num_cells * ( NumChildren() > 0 ? NumChildren() : 1 ) );
+    return 0.5 * ( res[0] + res[1] + res[2] ) * ( 1.0 + per_cell );
+    }
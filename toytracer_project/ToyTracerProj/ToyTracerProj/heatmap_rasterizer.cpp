@@ -0,0 +1,215 @@
+/***************************************************************************
+* heatmap_rasterizer.cpp    (rasterizer plugin)                            *
+*                                                                          *
+* A debugging rasterizer that shows where the time goes in a slow image.   *
+* It renders the image as the basic_rasterizer does, one pixel at a time   *
+* in a single thread, but also records for each pixel:                     *
+*                                                                          *
+*    steps  the aggregate nodes (or grid cells) visited,                   *
+*    tests  the primitive intersection tests,                              *
+*    depth  the deepest generation of ray cast (the depth of the ray tree) *
+*    time   the wall-clock time spent on the pixel, in microseconds.       *
+*                                                                          *
+* Each is written next to the image as a false-colour PPM heatmap (e.g.    *
+* scene1.steps.ppm) and as a raw buffer of floats in PFM format (e.g.      *
+* scene1.steps.pfm).  The colours run from black through blue, cyan,       *
+* green and yellow to red at the 99th percentile; brighter pixels are      *
+* white.  The steps, tests and depth come from the render statistics, so   *
+* the toytracer must be compiled with TOYTRACER_STATS defined to record    *
+* them; otherwise only the time is recorded.  Usage:                       *
+*                                                                          *
+*    rasterizer heatmap_rasterizer [samples N]                             *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Reports its progress to the caller, row by row.            *
+*   10/18/2026  Parameters it does not take are rejected.                  *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include "toytracer.h"
+#include "ppm_image.h"
+#include "params.h"
+#include "util.h"
+#include "trace.h"
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+
+struct heatmap_rasterizer : public Rasterizer {
+    heatmap_rasterizer() { num_samples = 1; }
+    heatmap_rasterizer( unsigned samples ) { num_samples = samples; }
+    virtual ~heatmap_rasterizer() {}
+    virtual bool Rasterize( string fname, const Camera &, const Scene &, const Scene &, const bool &doMotionBlur, RenderProgress * = NULL ) const;
+    virtual Plugin *ReadString( const string &params );
+    virtual string MyName() const { return "heatmap_rasterizer"; }
+    unsigned num_samples; // Rays per pixel.
+    };
+
+REGISTER_PLUGIN( heatmap_rasterizer );
+
+Plugin *heatmap_rasterizer::ReadString( const string &params )
+    {
+    ParamReader get( params );
+    if( get["rasterizer"] && get[MyName()] )
+        {
+        unsigned samples = 1;
+        string extra;
+        if( get["samples"] ) get[samples];
+        if( get.Word( extra ) ) return NULL; // A parameter it does not take.
+        if( samples == 0 ) samples = 1;
+        return new heatmap_rasterizer( samples );
+        }
+    return NULL;
+    }
+
+// The false colours, from the smallest value to the 99th percentile.
+static const Color heat[] = {
+    Color( 0.0, 0.0, 0.0 ), // Black.
+    Color( 0.0, 0.0, 1.0 ), // Blue.
+    Color( 0.0, 1.0, 1.0 ), // Cyan.
+    Color( 0.0, 1.0, 0.0 ), // Green.
+    Color( 1.0, 1.0, 0.0 ), // Yellow.
+    Color( 1.0, 0.0, 0.0 )  // Red.
+    };
+
+static const unsigned num_heat = sizeof( heat ) / sizeof( heat[0] );
+
+static Pixel HeatColor( double x )
+    {
+    if( x > 1.0 ) return Pixel( 255, 255, 255 );
+    if( !( x > 0.0 ) ) x = 0.0;
+    const double s = x * ( num_heat - 1 );
+    const unsigned i = min( unsigned( s ), num_heat - 2 );
+    const double f = s - i;
+    const Color c( ( 1.0 - f ) * heat[i] + f * heat[i+1] );
+    return Pixel( channel( 255 * c.red ), channel( 255 * c.green ), channel( 255 * c.blue ) );
+    }
+
+// Write the values as a greyscale PFM image: a short text header followed by
+// the floats, little-endian (indicated by the negative scale), with the
+// rows ordered from the bottom of the image to the top.
+static bool WritePFM( const string &file_name, const vector<float> &values, int width, int height )
+    {
+    std::ofstream out( file_name.c_str(), std::ios::binary );
+    if( !out ) return false;
+    out << "Pf\n" << width << " " << height << "\n-1.0\n";
+    for( int i = height - 1; i >= 0; i-- )
+        out.write( (const char *)&values[ i * width ], width * sizeof(float) );
+    return !out.fail();
+    }
+
+// Write both the false-colour heatmap and the raw values of one measurement.
+static bool WriteHeatmap( const string &base_name, const string &what, const vector<float> &values, int width, int height )
+    {
+    // Scale by the 99th percentile, so that a few outliers do not leave the
+    // rest of the map dark.
+    vector<float> sorted( values );
+    const size_t k = ( sorted.size() * 99 ) / 100;
+    std::nth_element( sorted.begin(), sorted.begin() + k, sorted.end() );
+    const double top = sorted[k];
+    const double low = *std::min_element( values.begin(), values.end() );
+
+    PPM_Image I( width, height );
+    for( int i = 0; i < height; i++ )
+    for( int j = 0; j < width;  j++ )
+        {
+        const double v = values[ i * width + j ];
+        I(i,j) = HeatColor( top > low ? ( v - low ) / ( top - low ) : 0.0 );
+        }
+
+    const string name = base_name + "." + what;
+    cout << "    " << name << ".ppm: " << low << " (black) to " << top << " (red)" << endl;
+    return I.Write( name + ".ppm" ) && WritePFM( name + ".pfm", values, width, height );
+    }
+
+bool heatmap_rasterizer::Rasterize( string file_name, const Camera &cam, const Scene &scene, const Scene &scene2, const bool &doMotionBlur, RenderProgress *progress ) const
+    {
+    const string base_name( file_name );
+    file_name += ".ppm";
+
+    if( !Overwrite_PPM_Image( file_name ) )
+        {
+        cerr << "Error: Could not open file " << file_name << " for writing." << endl;
+        return false;
+        }
+
+    PPM_Image I( cam.x_res, cam.y_res );
+
+    Ray ray;
+    ray.origin     = cam.eye;     // All initial rays originate from the eye.
+    ray.type       = primary_ray; // Cast by the rasterizer.
+    ray.generation = 1;           // Rays cast from the eye are first-generation.
+
+    // Compute the camera basis exactly as the basic_rasterizer does.
+
+    const Vec3 G ( Unit( cam.lookat - cam.eye ) );
+    const Vec3 U ( Unit( cam.up / G ) );
+    const Vec3 R ( Unit( G ^ U ) );
+    const Vec3 O ( cam.vpdist * G + cam.x_win.min * R + cam.y_win.max * U );
+    const Vec3 dR( Len( cam.x_win ) * R / cam.x_res );
+    const Vec3 dU( Len( cam.y_win ) * U / cam.y_res );
+
+    const unsigned num_pixels = cam.x_res * cam.y_res;
+    vector<float> steps( num_pixels );
+    vector<float> tests( num_pixels );
+    vector<float> depth( num_pixels );
+    vector<float> time ( num_pixels );
+
+    // The counters of this thread are sampled before and after each pixel.
+    // The deepest generation is tracked per pixel, then folded back in.
+    RenderStats &stats = ThreadStats();
+    unsigned deepest = stats.depth;
+
+    cout << "Rendering heatmaps, line 0";
+    for( unsigned i = 0; i < cam.y_res; i++ )
+        {
+        cout << rubout( i ) << (i+1);
+        cout.flush();
+        for( unsigned j = 0; j < cam.x_res; j++ )
+            {
+            const RenderStats before( stats );
+            stats.depth = 0;
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            Color color;
+            for( unsigned s = 0; s < num_samples; s++ )
+                {
+                const double x = num_samples > 1 ? rand( 0, 1 ) : 0.5;
+                const double y = num_samples > 1 ? rand( 0, 1 ) : 0.5;
+                ray.direction = Unit( O + ( j + x ) * dR - ( i + y ) * dU );
+                STAT_ADD( stat_primary_rays, doMotionBlur ? 2 : 1 );
+                if( doMotionBlur ) color += 0.15 * scene.Trace( ray ) + 0.85 * scene2.Trace( ray );
+                else color += scene.Trace( ray );
+                }
+            I(i,j) = ToneMap( color / num_samples );
+
+            const std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+            const unsigned k = i * cam.x_res + j;
+            steps[k] = float( stats.count[ stat_node_visits ] - before.count[ stat_node_visits ] );
+            tests[k] = float( stats.Tests() - before.Tests() );
+            depth[k] = float( stats.depth );
+            time [k] = float( std::chrono::duration<double, std::micro>( stop - start ).count() );
+            deepest  = max( deepest, stats.depth );
+            }
+        if( progress != NULL ) progress->Report( i + 1, cam.y_res, "rows" );
+        }
+    stats.depth = deepest;
+
+    cout << "\nWriting image file " << file_name << "... ";
+    cout.flush();
+    TraceSpan span( "write images" );
+    I.Write( file_name );
+    cout << "done." << endl;
+
+    cout << "Writing heatmaps:" << endl;
+    bool ok = WriteHeatmap( base_name, "time", time, cam.x_res, cam.y_res );
+    if( STATS_ENABLED )
+        {
+        ok = WriteHeatmap( base_name, "steps", steps, cam.x_res, cam.y_res ) && ok;
+        ok = WriteHeatmap( base_name, "tests", tests, cam.x_res, cam.y_res ) && ok;
+        ok = WriteHeatmap( base_name, "depth", depth, cam.x_res, cam.y_res ) && ok;
+        }
+    else cout << "    (compile with TOYTRACER_STATS for the steps, tests & depth)" << endl;
+    if( !ok ) cerr << "Error: Could not write the heatmaps of " << base_name << endl;
+    return true;
+    }
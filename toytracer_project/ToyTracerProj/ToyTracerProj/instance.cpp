@@ -0,0 +1,163 @@
+/***************************************************************************
+* instance.cpp   (aggregate & primitive object plugins)                    *
+*                                                                          *
+* Instancing allows a single piece of geometry to appear many times in a   *
+* scene, each time with its own affine transformation, without copying     *
+* it.  The geometry is defined once, as a named "prototype":               *
+*                                                                          *
+*    begin prototype NAME [aggregate parameters]                           *
+*    ...                                                                   *
+*    end                                                                   *
+*                                                                          *
+* The children of the prototype are placed in an aggregate of their own,   *
+* an abvh by default, or the aggregate named by the remaining parameters   *
+* (e.g. "begin prototype tree kdtree").  The prototype itself is not part  *
+* of the scene.  Each line of the form                                     *
+*                                                                          *
+*    instance NAME (matrix)                                                *
+*                                                                          *
+* then places a copy of the prototype, transformed by the given 3x4        *
+* matrix.  Instances are primitives, so the enclosing aggregate builds its *
+* hierarchy over the boxes of the instances, while all the instances of a  *
+* prototype share its one hierarchy.  A prototype must be defined before   *
+* it is instanced, in the same sdf file; prototypes of other scenes (such  *
+* as the second scene of a blur) cannot be instanced.  Emitters within a   *
+* prototype are not treated as lights.                                     *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Prototypes are freed as they are forgotten.                *
+*   10/18/2026  Prototypes are forgotten as each scene is started.         *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include <map>
+#include "toytracer.h"
+#include "util.h"
+#include "params.h"
+#include "transform.h"
+
+struct prototype : public Aggregate {
+    prototype() { object = NULL; }
+    prototype( const string &name_, Aggregate *agg ) { name = name_; object = agg; }
+   ~prototype() {}
+    virtual bool Intersect( const Ray &ray, HitInfo &hitinfo ) const { return object->Intersect( ray, hitinfo ); }
+    virtual void IntersectBatch( const RayBatch &b, const unsigned *a, unsigned n, HitInfo *h ) const { object->IntersectBatch( b, a, n, h ); }
+    virtual bool Inside( const Vec3 &P ) const { return object->Inside( P ); }
+    virtual Interval GetSlab( const Vec3 &v ) const { return object->GetSlab( v ); }
+    virtual Plugin *ReadString( const string &params );
+    virtual string MyName() const { return "prototype"; }
+    virtual void AddChild( Object *obj ) { object->AddChild( obj ); }
+    virtual void Close();
+    virtual unsigned NumChildren() const { return object->NumChildren(); }
+    virtual const Object *GetChild( unsigned i ) const { return object->GetChild(i); }
+    virtual bool Prototype() const { return true; }
+    virtual double Cost() const { return object->Cost(); }
+    string     name;
+    Aggregate *object; // Holds the geometry.
+    AABB       box;    // Bounding box of the geometry.
+    };
+
+struct instance : public transform {
+    instance() {}
+    instance( const Mat3x4 &, const prototype * );
+   ~instance() {}
+    virtual Interval GetSlab( const Vec3 & ) const;
+    virtual Plugin *ReadString( const string &params );
+    virtual string MyName() const { return "instance"; }
+    virtual plugin_type PluginType() const { return primitive_plugin; }
+    virtual void Close() {}
+    };
+
+REGISTER_PLUGIN( prototype );
+REGISTER_PLUGIN( instance );
+
+// All the prototypes that have been defined in the scene being built, by
+// name.  The prototypes are owned here rather than by the scene, which
+// holds only the aggregates within them.
+static std::map< string, const prototype* > prototypes;
+
+void ForgetPrototypes()
+    {
+    std::map< string, const prototype* >::iterator i;
+    for( i = prototypes.begin(); i != prototypes.end(); ++i ) delete i->second;
+    prototypes.clear();
+    }
+
+Plugin *prototype::ReadString( const string &params )
+    {
+    ParamReader get( params );
+    string name;
+    if( get["begin"] && get[MyName()] && get.Word( name ) )
+        {
+        // Any remaining parameters describe the aggregate to hold the geometry.
+        string agg, word;
+        while( get.Word( word ) ) agg += " " + word;
+        if( agg.empty() ) agg = " abvh";
+        Plugin *plg = Instance_of_Plugin( ( "begin" + agg ).c_str() );
+        if( plg == NULL || plg->PluginType() != aggregate_plugin )
+            {
+            cerr << "Error: prototype " << name << " has no aggregate named" << agg << endl;
+            return NULL;
+            }
+        return new prototype( name, (Aggregate*)plg );
+        }
+    return NULL;
+    }
+
+void prototype::Close()
+    {
+    // The geometry is complete, so it can be instanced from now on.
+    object->material = material;
+    object->shader   = shader;
+    object->envmap   = envmap;
+    // The children now belong to the aggregate, which outlives this
+    // prototype in the scenes that instance it.
+    for( unsigned i = 0; i < object->children.size(); i++ ) object->children[i]->parent = object;
+    object->Close();
+    box = GetBox( *object );
+    const prototype *&entry = prototypes[ name ];
+    delete entry;  // A prototype defined again replaces the earlier one.
+    entry = this;
+    }
+
+instance::instance( const Mat3x4 &M, const prototype *proto ) : transform( M )
+    {
+    object = proto->object;
+    box    = proto->box;
+    }
+
+Plugin *instance::ReadString( const string &params )
+    {
+    ParamReader get( params );
+    string name;
+    Mat3x4 M;
+    if( get[MyName()] && get.Word( name ) && get[M] )
+        {
+        std::map< string, const prototype* >::const_iterator iter = prototypes.find( name );
+        if( iter == prototypes.end() )
+            {
+            cerr << "Error: instance of undefined prototype " << name << endl;
+            return NULL;
+            }
+        return new instance( M, iter->second );
+        }
+    return NULL;
+    }
+
+// Bound the instance using the box of the prototype, rather than asking the
+// prototype for the slab, which would visit every primitive of the prototype
+// for every instance.  The slab encloses the eight transformed corners.
+Interval instance::GetSlab( const Vec3 &v ) const
+    {
+    const Interval *sides[] = { &box.X, &box.Y, &box.Z };
+    Interval I = Interval::Null();
+    for( int corner = 0; corner < 8; corner++ )
+        {
+        const Vec3 P(
+            ( corner & 1 ) ? sides[0]->max : sides[0]->min,
+            ( corner & 2 ) ? sides[1]->max : sides[1]->min,
+            ( corner & 4 ) ? sides[2]->max : sides[2]->min );
+        I << ( v * ( matrix * P ) );
+        }
+    return I / ( v * v );
+    }
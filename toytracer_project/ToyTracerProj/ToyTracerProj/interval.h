@@ -8,6 +8,7 @@
 * view window) and boxes (such as axis-aligned bounding boxes).            *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Endpoints are reals (float or double).                     *
 *   12/10/2004  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -21,8 +22,8 @@ struct Interval { // An interval of real numbers.
     inline Interval( double a ) { min = a; max = a; }
     inline Interval( double a, double b ) { min = a; max = b; }
     static inline Interval Null();
-    double min;
-    double max;
+    real min;
+    real max;
     };
 
 inline double Len( const Interval &I )
@@ -0,0 +1,325 @@
+/***************************************************************************
+* irradiance_cache.cpp                                                     *
+*                                                                          *
+* Sparse caching of diffuse irradiance with gradient-based interpolation.  *
+* Each record is computed by casting an M x N stratified hemisphere of     *
+* cosine-distributed rays.  The same rays yield the rotational and         *
+* translational gradients of the irradiance (Ward & Heckbert, 1992),       *
+* which are used to extrapolate the record to nearby points.  A record     *
+* is valid wherever Ward's weight exceeds 1/a, which confines it to a      *
+* sphere of radius a * R about its position.  Records are blended by that  *
+* weight less 1/a (Tabellion & Lamorlette, 2004), which falls to zero at   *
+* the edge of the sphere, so that no record's region shows a hard edge.    *
+* The records are stored in the octree nodes that are roughly the size of  *
+* that sphere.  Nodes and records are only ever added, and each is         *
+* published atomically once complete, so lookups by many rendering         *
+* threads proceed without a lock; only insertions are serialized.          *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Lookups take no lock, as the octree only ever grows.       *
+*   10/18/2026  Weights fall to zero at the edge of a record's region.     *
+*   10/18/2026  Made safe for use by several rendering threads at once.    *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include "irradiance_cache.h"
+#include "util.h"
+#include <atomic>
+
+static const unsigned max_octree_depth = 16;
+
+struct irradiance_entry {   // A record in the list of a node.
+    IrradianceRecord  rec;
+    irradiance_entry *next; // The record added before it, if any.
+    };
+
+// The children and the list of records are published with release stores,
+// once complete, and read with acquire loads, so that readers need no lock.
+// Records are added at the head of the list, so a reader sees either the
+// list before the addition or after it.
+struct irradiance_node {
+    irradiance_node();
+   ~irradiance_node();
+    std::atomic<irradiance_node*>  child[8];
+    std::atomic<irradiance_entry*> records; // Most recently added first.
+    };
+
+irradiance_node::irradiance_node()
+    {
+    for( int i = 0; i < 8; i++ ) child[i] = NULL;
+    records = NULL;
+    }
+
+irradiance_node::~irradiance_node()
+    {
+    for( int i = 0; i < 8; i++ ) delete child[i].load();
+    irradiance_entry *e = records.load();
+    while( e != NULL )
+        {
+        irradiance_entry *next = e->next;
+        delete e;
+        e = next;
+        }
+    }
+
+// Return the box of the given octant of a node.  Bit 0 of the octant selects
+// the upper half in x, bit 1 the upper half in y, and bit 2 the upper half in z.
+static AABB Octant( const AABB &box, int i )
+    {
+    const Vec3 C( Center( box ) );
+    return AABB(
+        ( i & 1 ) ? Interval( C.x, box.X.max ) : Interval( box.X.min, C.x ),
+        ( i & 2 ) ? Interval( C.y, box.Y.max ) : Interval( box.Y.min, C.y ),
+        ( i & 4 ) ? Interval( C.z, box.Z.max ) : Interval( box.Z.min, C.z )
+        );
+    }
+
+static bool Overlap( const AABB &a, const AABB &b )
+    {
+    return a.X.min <= b.X.max && b.X.min <= a.X.max &&
+           a.Y.min <= b.Y.max && b.Y.min <= a.Y.max &&
+           a.Z.min <= b.Z.max && b.Z.min <= a.Z.max;
+    }
+
+static inline double Channel( const Color &c, int i )
+    {
+    return i == 0 ? c.red : ( i == 1 ? c.green : c.blue );
+    }
+
+IrradianceCache::IrradianceCache( const AABB &box, unsigned samples, double a )
+    {
+    // Ward & Heckbert recommend roughly Pi times as many divisions in phi as in theta.
+    theta_cells = (unsigned)( sqrt( samples / Pi ) + 0.5 );
+    if( theta_cells < 2 ) theta_cells = 2;
+    phi_cells = (unsigned)( Pi * theta_cells + 0.5 );
+    bounds   = box;
+    accuracy = a;
+    const double diag = Length( box.MaxCorner() - box.MinCorner() );
+    min_radius  = 0.001 * diag;
+    max_radius  = 0.1 * diag;
+    num_records = 0;
+    root = new irradiance_node;
+    }
+
+IrradianceCache::~IrradianceCache()
+    {
+    delete root;
+    }
+
+// Return the irradiance at P, either by interpolating the existing records,
+// or by sampling the hemisphere and adding a new record if none is valid here.
+// The octree is locked only while it is searched or modified, so that other
+// threads can use the cache while the hemisphere is being sampled.
+Color IrradianceCache::Irradiance( const Scene &scene, const Vec3 &P, const Vec3 &N, const Ray &ray )
+    {
+    Color E;
+    if( Lookup( P, N, E ) ) return E;
+    IrradianceRecord rec;
+    Sample( scene, P, N, ray, rec );
+    Insert( rec );
+    return rec.E;
+    }
+
+// Interpolate the irradiance at P from all records whose weight exceeds 1/a,
+// extrapolating each record using its gradients, and weighting it by the
+// excess of its weight over 1/a.  Ward's weight alone jumps from 1/a to zero
+// at the edge of a record's region, leaving a visible seam.  Only the nodes on the path
+// from the root to the leaf containing P need be examined, as each record is
+// stored in every node that its region of validity overlaps.  No lock is
+// taken, as nothing a reader can reach is ever changed or removed.
+bool IrradianceCache::Lookup( const Vec3 &P, const Vec3 &N, Color &E ) const
+    {
+    double w_sum = 0.0;
+    Color  sum;
+    AABB box( bounds );
+    const irradiance_node *node = root;
+    while( node != NULL )
+        {
+        for( const irradiance_entry *entry = node->records.load( std::memory_order_acquire ); entry != NULL; entry = entry->next )
+            {
+            const IrradianceRecord &rec = entry->rec;
+            const Vec3 delta( P - rec.P );
+
+            // Ward's weighting function, combining distance and the change in normal.
+            double nn = 1.0 - N * rec.N;
+            if( nn < 0.0 ) nn = 0.0;
+            const double denom = Length( delta ) / rec.R + sqrt( nn );
+            const double w = ( denom > 1.0E-10 ? 1.0 / denom : 1.0E10 ) - 1.0 / accuracy;
+            if( w <= 0.0 ) continue;
+
+            // Reject records that are in front of P, as they may see occluders that P does not.
+            if( delta * ( 0.5 * ( N + rec.N ) ) < -0.01 * rec.R ) continue;
+
+            // Extrapolate the record to P using its gradients.
+            const Vec3 twist( rec.N ^ N );
+            double e[3];
+            for( int c = 0; c < 3; c++ )
+                {
+                e[c] = Channel( rec.E, c ) + twist * rec.rot_grad[c] + delta * rec.trans_grad[c];
+                if( e[c] < 0.0 ) e[c] = 0.0;
+                }
+            sum   += w * Color( e[0], e[1], e[2] );
+            w_sum += w;
+            }
+
+        // Descend into the octant containing P, if there is one.
+        if( !::Inside( P, box ) ) break;
+        const Vec3 C( Center( box ) );
+        const int octant = ( P.x > C.x ? 1 : 0 ) | ( P.y > C.y ? 2 : 0 ) | ( P.z > C.z ? 4 : 0 );
+        node = node->child[ octant ].load( std::memory_order_acquire );
+        box  = Octant( box, octant );
+        }
+
+    if( w_sum == 0.0 ) return false;
+    E = sum / w_sum;
+    return true;
+    }
+
+// Add a copy of the record to every node that its region of validity overlaps, at
+// the depth where the nodes are about the same size as that region.
+static void Add( irradiance_node *node, const AABB &box, const AABB &rec_box, double rec_diag2,
+                 unsigned depth, vector<irradiance_node*> &nodes )
+    {
+    if( depth == max_octree_depth || LengthSquared( box.MaxCorner() - box.MinCorner() ) < 4.0 * rec_diag2 )
+        {
+        nodes.push_back( node );
+        return;
+        }
+    for( int i = 0; i < 8; i++ )
+        {
+        const AABB child_box( Octant( box, i ) );
+        if( !Overlap( child_box, rec_box ) ) continue;
+        irradiance_node *child = node->child[i].load( std::memory_order_relaxed );
+        if( child == NULL )
+            {
+            child = new irradiance_node;
+            node->child[i].store( child, std::memory_order_release );
+            }
+        Add( child, child_box, rec_box, rec_diag2, depth + 1, nodes );
+        }
+    }
+
+void IrradianceCache::Insert( const IrradianceRecord &rec )
+    {
+    const double r = accuracy * rec.R;
+    const Vec3 D( r, r, r );
+    AABB rec_box;
+    rec_box << ( rec.P - D );
+    rec_box << ( rec.P + D );
+
+    // Records that are not within the octree bounds are kept at the root.
+    // Writers are serialized, but readers carry on (see irradiance_node).
+    std::lock_guard<std::mutex> guard( lock );
+    vector<irradiance_node*> nodes;
+    if( ::Inside( rec.P, bounds ) ) Add( root, bounds, rec_box, 12.0 * r * r, 0, nodes );
+    else nodes.push_back( root );
+
+    // Each node owns its own copy so that the octree can be deleted recursively.
+    for( unsigned i = 0; i < nodes.size(); i++ )
+        {
+        irradiance_entry *e = new irradiance_entry;
+        e->rec  = rec;
+        e->next = nodes[i]->records.load( std::memory_order_relaxed );
+        nodes[i]->records.store( e, std::memory_order_release );
+        }
+    num_records++;
+    }
+
+// Compute a new record at P by sampling the hemisphere about N with a stratified
+// set of cosine-distributed rays.  The irradiance is the average radiance times Pi.
+// The gradients follow from how the radiance changes across the strata.
+void IrradianceCache::Sample( const Scene &scene, const Vec3 &P, const Vec3 &N, const Ray &ray,
+                              IrradianceRecord &rec ) const
+    {
+    static const double epsilon = RayEps;
+    const unsigned M = theta_cells;
+    const unsigned K = phi_cells;
+    const Vec3 W( Unit( N ) );
+    const Vec3 U( Unit( OrthogonalTo( W ) ) );
+    const Vec3 V( W ^ U );
+    vector<Color>  L( M * K ); // Radiance in each stratum.
+    vector<double> R( M * K ); // Distance to the surface seen in each stratum.
+    vector<double> sin_theta( M );
+    double inv_dist_sum = 0.0;
+
+    Ray r;
+    r.origin     = P + epsilon * W;
+    r.type       = indirect_ray;
+    r.generation = ray.generation + 1;
+
+    for( unsigned j = 0; j < M; j++ )
+    for( unsigned k = 0; k < K; k++ )
+        {
+        const double s2  = ( j + rand( 0, 1 ) ) / M; // sin^2 theta is uniform for cosine weighting.
+        const double st  = sqrt( s2 );
+        const double ct  = sqrt( 1.0 - s2 );
+        const double phi = TwoPi * ( k + rand( 0, 1 ) ) / K;
+        r.direction = Unit( st * cos( phi ) * U + st * sin( phi ) * V + ct * W );
+        double d = Infinity;
+        STAT_COUNT( stat_indirect_rays );
+        L[ j * K + k ] = scene.Trace( r, &d );
+        R[ j * K + k ] = d;
+        inv_dist_sum  += 1.0 / d;
+        if( k == 0 ) sin_theta[j] = st;
+        }
+
+    rec.P = P;
+    rec.N = W;
+
+    // The validity radius is the harmonic mean distance to the surfaces seen.
+    rec.R = inv_dist_sum > 0.0 ? ( M * K ) / inv_dist_sum : max_radius;
+    if( rec.R < min_radius ) rec.R = min_radius;
+    if( rec.R > max_radius ) rec.R = max_radius;
+
+    double E[3] = { 0, 0, 0 };
+    for( int c = 0; c < 3; c++ )
+        {
+        rec.rot_grad  [c] = Vec3( 0, 0, 0 );
+        rec.trans_grad[c] = Vec3( 0, 0, 0 );
+        }
+
+    for( unsigned k = 0; k < K; k++ )
+        {
+        const double phi  = TwoPi * ( k + 0.5 ) / K;
+        const double phi_ = TwoPi * k / K;        // Boundary between strata k-1 and k.
+        const Vec3 u_k ( cos( phi ) * U + sin( phi ) * V );
+        const Vec3 v_k ( -sin( phi ) * U + cos( phi ) * V );
+        const Vec3 v_k_( -sin( phi_ ) * U + cos( phi_ ) * V );
+        const unsigned km = ( k + K - 1 ) % K;
+        for( unsigned j = 0; j < M; j++ )
+            {
+            const Color &Ljk = L[ j * K + k ];
+            const double st  = sin_theta[j];
+            const double tan_theta = st / sqrt( max( 1.0E-12, 1.0 - st * st ) );
+            const double sin_lo = sqrt( double( j     ) / M ); // sin theta_j-
+            const double sin_hi = sqrt( double( j + 1 ) / M ); // sin theta_j+
+            for( int c = 0; c < 3; c++ )
+                {
+                const double l = Channel( Ljk, c );
+                E[c] += l;
+                rec.rot_grad[c] += ( -tan_theta * l ) * v_k;
+
+                // Change in radiance across the boundary in phi.
+                const double dphi = l - Channel( L[ j * K + km ], c );
+                rec.trans_grad[c] += ( ( sin_hi - sin_lo ) / min( R[ j * K + k ], R[ j * K + km ] ) * dphi ) * v_k_;
+
+                // Change in radiance across the boundary in theta.
+                if( j > 0 )
+                    {
+                    const double cos2 = 1.0 - sin_lo * sin_lo;
+                    const double dtheta = l - Channel( L[ ( j - 1 ) * K + k ], c );
+                    rec.trans_grad[c] += ( ( TwoPi / K ) * sin_lo * cos2 /
+                        min( R[ j * K + k ], R[ ( j - 1 ) * K + k ] ) * dtheta ) * u_k;
+                    }
+                }
+            }
+        }
+
+    const double scale = Pi / ( M * K );
+    for( int c = 0; c < 3; c++ )
+        {
+        E[c] *= scale;
+        rec.rot_grad[c] *= scale;
+        }
+    rec.E = Color( E[0], E[1], E[2] );
+    }
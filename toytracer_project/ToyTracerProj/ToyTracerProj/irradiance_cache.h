@@ -0,0 +1,54 @@
+/***************************************************************************
+* irradiance_cache.h                                                       *
+*                                                                          *
+* The irradiance cache stores sparse samples of the diffuse irradiance     *
+* arriving at surfaces, along with its rotational and translational        *
+* gradients, and interpolates between them.  A full hemisphere of rays is  *
+* cast only at points where no existing record is valid.  This is the      *
+* method of Ward, Rubinstein & Clear (1988) with the gradients of Ward &   *
+* Heckbert (1992).  Records are kept in an octree so that only nearby      *
+* records need be examined for each lookup.                                *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Lookups take no lock, as the octree only ever grows.       *
+*   10/18/2026  Made safe for use by several rendering threads at once.    *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#ifndef __IRRADIANCE_CACHE_INCLUDED__
+#define __IRRADIANCE_CACHE_INCLUDED__
+
+#include <mutex>
+#include "toytracer.h"
+
+struct IrradianceRecord {  // One cached irradiance sample.
+    Vec3   P;              // Position of the sample.
+    Vec3   N;              // Surface normal at the sample.
+    Color  E;              // Irradiance at P.
+    Vec3   rot_grad[3];    // Rotational gradient of each color channel.
+    Vec3   trans_grad[3];  // Translational gradient of each color channel.
+    double R;              // Harmonic mean distance to the surfaces seen from P.
+    };
+
+struct irradiance_node;    // A node of the octree holding the records.
+
+struct IrradianceCache {
+    IrradianceCache( const AABB &bounds, unsigned samples, double accuracy );
+   ~IrradianceCache();
+    Color Irradiance( const Scene &, const Vec3 &P, const Vec3 &N, const Ray &ray );
+    bool  Lookup( const Vec3 &P, const Vec3 &N, Color &E ) const;
+    void  Insert( const IrradianceRecord & );
+    void  Sample( const Scene &, const Vec3 &P, const Vec3 &N, const Ray &ray, IrradianceRecord & ) const;
+    unsigned NumRecords() const { return num_records; }
+    AABB     bounds;       // Region of space covered by the octree.
+    unsigned theta_cells;  // Number of strata in the polar angle (M).
+    unsigned phi_cells;    // Number of strata in the azimuthal angle (N).
+    double   accuracy;     // Ward's "a"; smaller values give more records.
+    double   min_radius;   // Clamp on the validity radius of a record.
+    double   max_radius;
+    unsigned num_records;
+    irradiance_node *root;
+    std::mutex lock;       // Serializes Insert; Lookup needs no lock (see irradiance_cache.cpp).
+    };
+
+#endif
@@ -0,0 +1,650 @@
+/***************************************************************************
+* kdtree.cpp   (aggregate object plugin)                                   *
+*                                                                          *
+* The "kdtree" object is a kd-tree built with the surface area heuristic   *
+* (SAH), using the O(n log n) event sweep of Wald & Havran.  The estimated *
+* cost of each child, as reported by its Cost method, is used to weight    *
+* the children, so expensive objects are isolated more aggressively than   *
+* cheap ones.  Nodes are packed into 8 bytes each.  Usage:                 *
+*                                                                          *
+*    begin kdtree [stack] [compare]                                        *
+*                                                                          *
+* By default rays are traced without a stack by following "ropes" that     *
+* link each face of a leaf to the neighbouring sub-tree; "stack" selects   *
+* conventional stack-based traversal instead.  "compare" reports the       *
+* estimated cost of tracing a ray through the tree, along with that of an  *
+* abvh built over the same children, so the two can be compared.           *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Frees the abvh built for "compare".                        *
+*   10/18/2026  Added Rebuild, for children that have moved.               *
+*   10/18/2026  Uses the reciprocal direction cached in the ray.           *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include "toytracer.h"
+#include "util.h"
+#include "params.h"
+#include <algorithm>
+#include <cstring>
+
+// Costs used by the SAH, in the same units as Object::Cost; that is,
+// relative to a single ray-box test.  Stepping through an interior node is
+// charged as much as a box test (cheaper settings made deeper trees that
+// were slower to build and no faster to trace), and splits that leave one
+// side empty are favoured slightly since they cut away empty space.
+static const double   traversal_cost = 1.0;
+static const double   empty_bonus    = 0.2;
+static const unsigned max_depth      = 60;
+static const unsigned mailbox_size   = 16; // Must be a power of two.
+static const unsigned no_rope        = ~0u;
+
+// A node of the tree packs into 8 bytes.  The low two bits of "flags" give
+// the split axis, or 3 for a leaf.  The remaining bits of an interior node
+// give the index of the child above the split; the child below always
+// immediately follows its parent.  A leaf holds the index of its kd_leaf.
+struct kd_node {
+    union {
+        float    split; // Position of the splitting plane.
+        unsigned leaf;  // Index into the leaves.
+        };
+    unsigned flags;
+    inline bool     IsLeaf() const { return ( flags & 3 ) == 3; }
+    inline unsigned Axis  () const { return flags & 3; }
+    inline unsigned Above () const { return flags >> 2; }
+    };
+
+// Everything needed to intersect a leaf, and to leave it by way of a rope.
+// Rope 2a leads out of the face of the box with the smaller value along
+// axis a, and rope 2a+1 out of the face with the larger value.
+struct kd_leaf {
+    unsigned first; // The leaf holds items [first,first+count).
+    unsigned count;
+    unsigned rope[6];
+    AABB     box;
+    };
+
+// An event is the position at which a child starts or ends along one of
+// the axes, or a position at which it is "planar" (i.e. flat along that axis).
+enum { event_end = 0, event_planar = 1, event_start = 2 };
+
+struct kd_event {
+    double   pos;
+    unsigned obj;
+    unsigned char axis;
+    unsigned char type;
+    };
+
+// Events are sorted by position, then axis, so that all the events on the
+// same candidate plane are contiguous, and ends precede starts.
+static inline bool operator<( const kd_event &a, const kd_event &b )
+    {
+    if( a.pos  != b.pos  ) return a.pos  < b.pos;
+    if( a.axis != b.axis ) return a.axis < b.axis;
+    return a.type < b.type;
+    }
+
+// The box of a child as seen from the current node of the build, which is
+// its own box clipped to the voxels it has been split into.
+struct kd_box {
+    double lo[3];
+    double hi[3];
+    };
+
+enum { both_sides = 0, left_only = 1, right_only = 2 };
+
+struct kdtree : public Aggregate {
+    kdtree( bool ropes_ = true, bool compare_ = false ) { ropes = ropes_; compare = compare_; bbox = AABB::Null(); sah_cost = 0.0; depth = 0; }
+   ~kdtree() {}
+    virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual bool Inside( const Vec3 & ) const;
+    virtual Interval GetSlab( const Vec3 & ) const;
+    virtual Plugin *ReadString( const string &params );
+    virtual string MyName() const { return "kdtree"; }
+    virtual void Close();
+    virtual void Rebuild();
+    virtual double Cost() const;
+    unsigned Build( vector<kd_event> &events, const kd_box &voxel, unsigned depth );
+    unsigned MakeLeaf( const vector<kd_event> &events );
+    void Finish( unsigned node, const kd_box &voxel, const unsigned rope[], unsigned depth );
+    bool TraverseStack( const Ray &ray, Interval I, HitInfo & ) const;
+    bool TraverseRopes( const Ray &ray, Interval I, HitInfo & ) const;
+    bool ropes;      // Use stackless traversal.
+    bool compare;    // Report the estimated cost along with that of an abvh.
+    AABB bbox;       // Bounds of all the bounded children.
+    double sah_cost; // Surface-area weighted cost of all the nodes.
+    unsigned depth;  // The depth of the deepest leaf; the root has depth 1.
+    vector<kd_node>  nodes;
+    vector<kd_leaf>  leaves;
+    vector<unsigned> items;     // Indices of the children in each leaf.
+    vector<unsigned> unbounded; // Children that cannot be placed in the tree.
+    vector<double>   costs;     // Used only while building.
+    vector<unsigned char> side;
+    vector<kd_box>   clip;
+    };
+
+REGISTER_PLUGIN( kdtree );
+
+Plugin *kdtree::ReadString( const string &params )
+    {
+    ParamReader get( params );
+    if( get["begin"] && get[MyName()] )
+        {
+        bool stack   = false;
+        bool compare = false;
+        for(;;)
+            {
+            if( get["stack"]   ) { stack   = true; continue; }
+            if( get["compare"] ) { compare = true; continue; }
+            break;
+            }
+        return new kdtree( !stack, compare );
+        }
+    return NULL;
+    }
+
+// The tree stores its splitting planes in single precision, so the boxes of
+// the children are rounded outward to the nearest floats.  Every candidate
+// plane is then exactly representable, and no child is ever placed on the
+// wrong side of a plane due to rounding.
+static float RoundDown( double x )
+    {
+    float f = float( x );
+    if( double( f ) <= x ) return f;
+    unsigned bits;
+    memcpy( &bits, &f, sizeof( bits ) );
+    if( f > 0.0f ) bits--;
+    else if( f < 0.0f ) bits++;
+    else bits = 0x80000001u; // The negative float closest to zero.
+    memcpy( &f, &bits, sizeof( f ) );
+    return f;
+    }
+
+static inline float RoundUp( double x )
+    {
+    return -RoundDown( -x );
+    }
+
+static inline double Area( const kd_box &b )
+    {
+    const double dx = b.hi[0] - b.lo[0];
+    const double dy = b.hi[1] - b.lo[1];
+    const double dz = b.hi[2] - b.lo[2];
+    return 2.0 * ( dx * dy + dy * dz + dz * dx );
+    }
+
+// Append the events of a child whose box (as seen from the current node) is b.
+static void AddEvents( unsigned obj, const kd_box &b, vector<kd_event> &events )
+    {
+    for( unsigned char a = 0; a < 3; a++ )
+        {
+        kd_event e;
+        e.obj  = obj;
+        e.axis = a;
+        if( b.lo[a] == b.hi[a] )
+            {
+            e.pos  = b.lo[a];
+            e.type = event_planar;
+            events.push_back( e );
+            }
+        else
+            {
+            e.pos  = b.lo[a];
+            e.type = event_start;
+            events.push_back( e );
+            e.pos  = b.hi[a];
+            e.type = event_end;
+            events.push_back( e );
+            }
+        }
+    }
+
+// Each child has exactly one start or planar event along the x-axis, so
+// those events enumerate the children of a node.
+static inline bool Enumerates( const kd_event &e )
+    {
+    return e.axis == 0 && e.type != event_end;
+    }
+
+unsigned kdtree::MakeLeaf( const vector<kd_event> &events )
+    {
+    kd_leaf leaf;
+    leaf.first = items.size();
+    for( unsigned i = 0; i < events.size(); i++ )
+        {
+        if( Enumerates( events[i] ) ) items.push_back( events[i].obj );
+        }
+    leaf.count = items.size() - leaf.first;
+    kd_node node;
+    node.leaf  = leaves.size();
+    node.flags = 3;
+    leaves.push_back( leaf );
+    nodes.push_back( node );
+    return nodes.size() - 1;
+    }
+
+// Build the sub-tree for the children whose sorted events are given, within
+// the given voxel, and return the index of its root.  The SAH is evaluated
+// for every candidate plane in a single sweep over the events, keeping
+// track of the cost of the children to either side of the plane along each
+// axis.  The events are then split between the two sides without sorting
+// them again; only the children that straddle the plane, which are clipped
+// to each side, generate new events.  The event list is consumed.
+unsigned kdtree::Build( vector<kd_event> &events, const kd_box &voxel, unsigned level )
+    {
+    unsigned count = 0;
+    double leaf_cost = 0.0;
+    for( unsigned i = 0; i < events.size(); i++ )
+        {
+        if( Enumerates( events[i] ) ) { count++; leaf_cost += costs[ events[i].obj ]; }
+        }
+    const double area = Area( voxel );
+    if( level > depth ) depth = level;
+    if( count <= 1 || level >= max_depth || area <= 0.0 )
+        {
+        sah_cost += area * leaf_cost;
+        return MakeLeaf( events );
+        }
+
+    // Sweep the candidate planes, in order, along all three axes at once.
+    double left [] = { 0.0, 0.0, 0.0 };
+    double right[] = { leaf_cost, leaf_cost, leaf_cost };
+    double best_cost  = leaf_cost;
+    double best_pos   = 0.0;
+    unsigned best_axis = 0;
+    bool planar_left = false;
+    bool found = false;
+    for( unsigned i = 0; i < events.size(); )
+        {
+        const double   p = events[i].pos;
+        const unsigned a = events[i].axis;
+        double ending = 0.0, planar = 0.0, starting = 0.0;
+        for( ; i < events.size() && events[i].pos == p && events[i].axis == a && events[i].type == event_end;    i++ ) ending   += costs[ events[i].obj ];
+        for( ; i < events.size() && events[i].pos == p && events[i].axis == a && events[i].type == event_planar; i++ ) planar   += costs[ events[i].obj ];
+        for( ; i < events.size() && events[i].pos == p && events[i].axis == a && events[i].type == event_start;  i++ ) starting += costs[ events[i].obj ];
+        right[a] -= planar + ending;
+        if( voxel.lo[a] < p && p < voxel.hi[a] )
+            {
+            kd_box L( voxel ); L.hi[a] = p;
+            kd_box R( voxel ); R.lo[a] = p;
+            const double PL = Area( L ) / area;
+            const double PR = Area( R ) / area;
+            for( int s = 0; s < 2; s++ )
+                {
+                // Try the children lying within the plane on either side.
+                const double CL = left [a] + ( s == 0 ? planar : 0.0 );
+                const double CR = right[a] + ( s == 1 ? planar : 0.0 );
+                double cost = PL * CL + PR * CR;
+                if( CL <= 0.0 || CR <= 0.0 ) cost *= 1.0 - empty_bonus;
+                cost += traversal_cost;
+                if( cost < best_cost )
+                    {
+                    best_cost   = cost;
+                    best_pos    = p;
+                    best_axis   = a;
+                    planar_left = s == 0;
+                    found       = true;
+                    }
+                }
+            }
+        left[a] += starting + planar;
+        }
+    if( !found )
+        {
+        sah_cost += area * leaf_cost;
+        return MakeLeaf( events );
+        }
+
+    // Classify the children as lying entirely to the left of the plane,
+    // entirely to the right, or straddling it (the default).
+    const unsigned a = best_axis;
+    const double   p = best_pos;
+    for( unsigned i = 0; i < events.size(); i++ )
+        {
+        const kd_event &e = events[i];
+        if( e.axis != a ) continue;
+        if( e.type == event_end && e.pos <= p ) side[ e.obj ] = left_only;
+        else if( e.type == event_start && e.pos >= p ) side[ e.obj ] = right_only;
+        else if( e.type == event_planar )
+            {
+            if( e.pos < p || ( e.pos == p && planar_left ) ) side[ e.obj ] = left_only;
+            else side[ e.obj ] = right_only;
+            }
+        }
+
+    // Hand the events of one-sided children to that side, preserving their
+    // order, and recover the boxes of the straddling children.
+    vector<kd_event> left_events, right_events;
+    vector<unsigned> straddling;
+    left_events .reserve( events.size() );
+    right_events.reserve( events.size() );
+    for( unsigned i = 0; i < events.size(); i++ )
+        {
+        const kd_event &e = events[i];
+        switch( side[ e.obj ] )
+            {
+            case left_only : left_events .push_back( e ); break;
+            case right_only: right_events.push_back( e ); break;
+            default:
+                if( Enumerates( e ) ) straddling.push_back( e.obj );
+                if( e.type != event_end   ) clip[ e.obj ].lo[ e.axis ] = e.pos;
+                if( e.type != event_start ) clip[ e.obj ].hi[ e.axis ] = e.pos;
+                break;
+            }
+        }
+    for( unsigned i = 0; i < events.size(); i++ ) side[ events[i].obj ] = both_sides;
+    vector<kd_event>().swap( events );
+
+    // Clip the straddling children to either side of the plane, and merge
+    // their new events into the sorted events of each side.
+    vector<kd_event> new_left, new_right;
+    for( unsigned i = 0; i < straddling.size(); i++ )
+        {
+        kd_box L( clip[ straddling[i] ] ); L.hi[a] = p;
+        kd_box R( clip[ straddling[i] ] ); R.lo[a] = p;
+        AddEvents( straddling[i], L, new_left  );
+        AddEvents( straddling[i], R, new_right );
+        }
+    std::sort( new_left .begin(), new_left .end() );
+    std::sort( new_right.begin(), new_right.end() );
+    vector<kd_event> merged( left_events.size() + new_left.size() );
+    std::merge( left_events.begin(), left_events.end(), new_left.begin(), new_left.end(), merged.begin() );
+    merged.swap( left_events );
+    merged.resize( right_events.size() + new_right.size() );
+    std::merge( right_events.begin(), right_events.end(), new_right.begin(), new_right.end(), merged.begin() );
+    merged.swap( right_events );
+    vector<kd_event>().swap( merged );
+
+    // The child below the plane immediately follows its parent.
+    kd_node node;
+    node.split = float( p );
+    node.flags = a;
+    nodes.push_back( node );
+    const unsigned index = nodes.size() - 1;
+    sah_cost += area * traversal_cost;
+    kd_box L( voxel ); L.hi[a] = p;
+    kd_box R( voxel ); R.lo[a] = p;
+    Build( left_events, L, level + 1 );
+    const unsigned above = Build( right_events, R, level + 1 );
+    nodes[ index ].flags = a | ( above << 2 );
+    return index;
+    }
+
+// Record the box of each leaf, and the ropes leading out of each of its
+// faces.  A rope leads to the smallest sub-tree that covers the entire face,
+// which is the sibling of the nearest ancestor split along that face.
+void kdtree::Finish( unsigned n, const kd_box &voxel, const unsigned rope[], unsigned level )
+    {
+    const kd_node &node = nodes[n];
+    if( node.IsLeaf() )
+        {
+        kd_leaf &leaf = leaves[ node.leaf ];
+        for( int f = 0; f < 6; f++ ) leaf.rope[f] = rope[f];
+        leaf.box = AABB(
+            Interval( voxel.lo[0], voxel.hi[0] ),
+            Interval( voxel.lo[1], voxel.hi[1] ),
+            Interval( voxel.lo[2], voxel.hi[2] ) );
+        return;
+        }
+    const unsigned a = node.Axis();
+    unsigned below_rope[6], above_rope[6];
+    for( int f = 0; f < 6; f++ ) below_rope[f] = above_rope[f] = rope[f];
+    below_rope[ 2 * a + 1 ] = node.Above();
+    above_rope[ 2 * a     ] = n + 1;
+    kd_box L( voxel ); L.hi[a] = node.split;
+    kd_box R( voxel ); R.lo[a] = node.split;
+    Finish( n + 1, L, below_rope, level + 1 );
+    Finish( node.Above(), R, above_rope, level + 1 );
+    }
+
+void kdtree::Close()
+    {
+    const unsigned n = NumChildren();
+    vector<kd_event> events;
+    events.reserve( 6 * n );
+    costs.resize( n );
+    kd_box root;
+    for( int a = 0; a < 3; a++ ) { root.lo[a] = Infinity; root.hi[a] = -Infinity; }
+    for( unsigned i = 0; i < n; i++ )
+        {
+        const AABB box( GetBox( *GetChild(i) ) );
+        if( IsNull( box ) ) continue;
+        if( !( Len( box.X ) < Infinity && Len( box.Y ) < Infinity && Len( box.Z ) < Infinity ) )
+            {
+            // Children that extend to infinity are tested by every ray.
+            unbounded.push_back( i );
+            continue;
+            }
+        const double lo[] = { box.X.min, box.Y.min, box.Z.min };
+        const double hi[] = { box.X.max, box.Y.max, box.Z.max };
+        kd_box b;
+        for( int a = 0; a < 3; a++ )
+            {
+            b.lo[a] = RoundDown( lo[a] );
+            b.hi[a] = RoundUp  ( hi[a] );
+            if( b.lo[a] < root.lo[a] ) root.lo[a] = b.lo[a];
+            if( b.hi[a] > root.hi[a] ) root.hi[a] = b.hi[a];
+            }
+        costs[i] = GetChild(i)->Cost();
+        AddEvents( i, b, events );
+        }
+    sah_cost = 0.0;
+    depth = 0;
+    if( !events.empty() )
+        {
+        std::sort( events.begin(), events.end() );
+        side.assign( n, both_sides );
+        clip.resize( n );
+        Build( events, root, 1 );
+        const unsigned rope[] = { no_rope, no_rope, no_rope, no_rope, no_rope, no_rope };
+        Finish( 0, root, rope, 1 );
+        bbox = AABB(
+            Interval( root.lo[0], root.hi[0] ),
+            Interval( root.lo[1], root.hi[1] ),
+            Interval( root.lo[2], root.hi[2] ) );
+        sah_cost /= Area( root );
+        }
+    vector<double>().swap( costs );
+    vector<unsigned char>().swap( side );
+    vector<kd_box>().swap( clip );
+
+    if( compare )
+        {
+        // Build an abvh over the same children so that the estimated costs
+        // of the two can be compared.  Neither packs its children, so both
+        // use the same estimates for the children themselves.
+        cout << "kdtree: " << nodes.size() << " nodes, " << leaves.size() << " leaves, "
+             << items.size() << " references, depth " << depth
+             << ", estimated cost " << Cost() << endl;
+        Plugin *plg = Instance_of_Plugin( "begin abvh unpacked" );
+        if( plg != NULL && plg->PluginType() == aggregate_plugin )
+            {
+            Aggregate *bvh = (Aggregate*)plg;
+            for( unsigned i = 0; i < n; i++ ) bvh->AddChild( children[i] );
+            bvh->Close();
+            cout << "abvh:   estimated cost " << bvh->Cost() << endl;
+            }
+        delete plg;  // Frees the hierarchy only; the children are ours.
+        }
+    }
+
+// Some of the children have moved, so build the tree again from scratch.
+void kdtree::Rebuild()
+    {
+    bbox = AABB::Null();
+    nodes.clear();
+    leaves.clear();
+    items.clear();
+    unbounded.clear();
+    Close();
+    }
+
+// Find the leaf containing the point on the ray at distance t by descending
+// from node n.  The choice at each node is made by comparing distances
+// along the ray, computed exactly as the leaves compute their exit
+// distances, so a ray that leaves one leaf always lands in the neighbouring
+// leaf, and ties go to the side the ray is heading towards.
+static inline unsigned Descend( const vector<kd_node> &nodes, unsigned n, double t,
+                                const double Q[], const double R[], const double inv[] )
+    {
+    for(;;)
+        {
+        const kd_node &node = nodes[n];
+        STAT_COUNT( stat_node_visits );
+        if( node.IsLeaf() ) return n;
+        const unsigned a = node.Axis();
+        const double split = node.split;
+        bool below;
+        if( R[a] > 0.0 )      below = t <  ( split - Q[a] ) * inv[a];
+        else if( R[a] < 0.0 ) below = t >= ( split - Q[a] ) * inv[a];
+        else                  below = Q[a] < split;
+        n = below ? n + 1 : node.Above();
+        }
+    }
+
+bool kdtree::TraverseRopes( const Ray &ray, Interval I, HitInfo &hitinfo ) const
+    {
+    const double *inv = ray.inv_dir;
+    const double Q[] = { ray.origin.x, ray.origin.y, ray.origin.z };
+    const double R[] = { ray.direction.x, ray.direction.y, ray.direction.z };
+    unsigned mailbox[ mailbox_size ];
+    for( unsigned m = 0; m < mailbox_size; m++ ) mailbox[m] = ~0u;
+    bool found_a_hit = false;
+    double t = I.min;
+    unsigned n = 0;
+    for(;;)
+        {
+        n = Descend( nodes, n, t, Q, R, inv );
+        const kd_leaf &leaf = leaves[ nodes[n].leaf ];
+        for( unsigned k = leaf.first; k < leaf.first + leaf.count; k++ )
+            {
+            const unsigned i = items[k];
+            unsigned &slot = mailbox[ i & ( mailbox_size - 1 ) ];
+            if( slot == i ) continue; // Already tested in another leaf.
+            slot = i;
+            const Object *obj = GetChild(i);
+            if( obj != hitinfo.ignore && obj->Intersect( ray, hitinfo ) ) found_a_hit = true;
+            }
+
+        // Leave the leaf through the face the ray reaches first.
+        const double lo[] = { leaf.box.X.min, leaf.box.Y.min, leaf.box.Z.min };
+        const double hi[] = { leaf.box.X.max, leaf.box.Y.max, leaf.box.Z.max };
+        double exit = Infinity;
+        unsigned face = 0;
+        for( unsigned a = 0; a < 3; a++ )
+            {
+            if( R[a] == 0.0 ) continue;
+            const bool up = R[a] > 0.0;
+            const double s = ( ( up ? hi[a] : lo[a] ) - Q[a] ) * inv[a];
+            if( s < exit ) { exit = s; face = 2 * a + up; }
+            }
+        if( hitinfo.distance <= exit || exit >= I.max ) break;
+        n = leaf.rope[ face ];
+        if( n == no_rope ) break;
+        t = exit;
+        }
+    return found_a_hit;
+    }
+
+bool kdtree::TraverseStack( const Ray &ray, Interval I, HitInfo &hitinfo ) const
+    {
+    const double *inv = ray.inv_dir;
+    const double Q[] = { ray.origin.x, ray.origin.y, ray.origin.z };
+    const double R[] = { ray.direction.x, ray.direction.y, ray.direction.z };
+    unsigned mailbox[ mailbox_size ];
+    for( unsigned m = 0; m < mailbox_size; m++ ) mailbox[m] = ~0u;
+    struct { unsigned node; double t_min, t_max; } stack[ max_depth ];
+    unsigned top = 0;
+    bool found_a_hit = false;
+    unsigned n = 0;
+    double t_min = I.min;
+    double t_max = I.max;
+    for(;;)
+        {
+        // Descend to the nearest leaf, deferring the far side of each split
+        // that the ray crosses within the current interval.
+        while( !nodes[n].IsLeaf() )
+            {
+            const kd_node &node = nodes[n];
+            STAT_COUNT( stat_node_visits );
+            const unsigned a = node.Axis();
+            const double split = node.split;
+            const double t = ( split - Q[a] ) * inv[a];
+            const bool below_first = Q[a] < split || ( Q[a] == split && R[a] <= 0.0 );
+            const unsigned first  = below_first ? n + 1 : node.Above();
+            const unsigned second = below_first ? node.Above() : n + 1;
+            if( !( t <= t_max ) || t <= 0.0 ) n = first;
+            else if( t < t_min ) n = second;
+            else
+                {
+                stack[ top ].node  = second;
+                stack[ top ].t_min = t;
+                stack[ top ].t_max = t_max;
+                top++;
+                n = first;
+                t_max = t;
+                }
+            }
+        STAT_COUNT( stat_node_visits );
+        const kd_leaf &leaf = leaves[ nodes[n].leaf ];
+        for( unsigned k = leaf.first; k < leaf.first + leaf.count; k++ )
+            {
+            const unsigned i = items[k];
+            unsigned &slot = mailbox[ i & ( mailbox_size - 1 ) ];
+            if( slot == i ) continue; // Already tested in another leaf.
+            slot = i;
+            const Object *obj = GetChild(i);
+            if( obj != hitinfo.ignore && obj->Intersect( ray, hitinfo ) ) found_a_hit = true;
+            }
+        if( hitinfo.distance <= t_max || top == 0 ) break;
+        top--;
+        n     = stack[ top ].node;
+        t_min = stack[ top ].t_min;
+        t_max = stack[ top ].t_max;
+        if( hitinfo.distance < t_min ) break;
+        }
+    return found_a_hit;
+    }
+
+bool kdtree::Intersect( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    bool found_a_hit = false;
+    for( unsigned i = 0; i < unbounded.size(); i++ )
+        {
+        const Object *obj = GetChild( unbounded[i] );
+        if( obj != hitinfo.ignore && obj->Intersect( ray, hitinfo ) ) found_a_hit = true;
+        }
+    Interval I;
+    if( nodes.empty() || !Hit( ray, bbox, I, hitinfo.distance ) ) return found_a_hit;
+    if( ropes ? TraverseRopes( ray, I, hitinfo ) : TraverseStack( ray, I, hitinfo ) ) found_a_hit = true;
+    return found_a_hit;
+    }
+
+bool kdtree::Inside( const Vec3 &P ) const
+    {
+    for( unsigned i = 0; i < NumChildren(); i++ )
+        {
+        if( GetChild(i)->Inside( P ) ) return true;
+        }
+    return false;
+    }
+
+Interval kdtree::GetSlab( const Vec3 &v ) const
+    {
+    Interval I = Interval::Null();
+    for( unsigned i = 0; i < NumChildren(); i++ )
+        I << GetChild(i)->GetSlab(v);
+    return I;
+    }
+
+// The expected cost of tracing a ray that hits the bounding box of the
+// tree: each node is visited with probability proportional to its surface
+// area, at the cost of one plane test for an interior node, or the costs of
+// its children for a leaf.
+double kdtree::Cost() const
+    {
+    double cost = sah_cost;
+    for( unsigned i = 0; i < unbounded.size(); i++ )
+        cost += GetChild( unbounded[i] )->Cost();
+    return cost;
+    }
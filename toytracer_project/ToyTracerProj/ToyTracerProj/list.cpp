@@ -8,6 +8,8 @@
 * amounts to brute-force ray tracing.                                      *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Spheres & triangles are packed four at a time on Close.    *
+*   10/18/2026  Added batched intersection.                                *
 *   10/16/2004  Changed the way the bounding box is computed.              *
 *   10/16/2004  Added more documentation, and call to "Inverse" function.  *
 *   10/06/2004  Initial coding.                                            *
@@ -16,6 +18,7 @@
 #include "toytracer.h"
 #include "util.h"
 #include "params.h"
+#include "packed.h"
 
 // Define the actual List object as a sub-class of the "Aggregate" class.
 // This sub-class must define all the necessary virtual methods as well as
@@ -23,16 +26,19 @@
 // (ALL access to this object will be through these virtual methods.)
 
 struct List : public Aggregate { 
-    List() { bbox = AABB::Null(); }
+    List( bool pack = true ) { bbox = AABB::Null(); packed = pack; }
    ~List();
     virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual void IntersectBatch( const RayBatch &, const unsigned *, unsigned, HitInfo * ) const;
     virtual bool Inside( const Vec3 & ) const;
     virtual Interval GetSlab( const Vec3 & ) const;
     virtual Plugin *ReadString( const string &params );
     virtual string MyName() const { return "List"; }
     virtual void AddChild( Object * );
+    virtual void Close();
     virtual double Cost() const;
     AABB bbox;
+    bool packed; // Pack spheres & triangles for SIMD intersection.
     };
 
 // Register the new object with the toytracer.  When this module is linked in, the 
@@ -54,8 +60,9 @@ Plugin *List::ReadString( const string &params )
     // Every aggregate object should look for a "begin" preceeding its name.
     // An aggregate can also accept additional parameters on this line (e.g. the
     // size of a uniform grid, maximum depth of a BSP tree, etc.).  It is recommended
-    // that missing parameters default to something reasonable.
-    if( get["begin"] && get[MyName()] ) return new List();
+    // that missing parameters default to something reasonable.  Here the only
+    // parameter is "unpacked", which leaves every child as a separate object.
+    if( get["begin"] && get[MyName()] ) return new List( !get["unpacked"] );
     return NULL;
     }
 
@@ -88,6 +95,34 @@ bool List::Intersect( const Ray &ray, HitInfo &hitinfo ) const
     return found_a_hit;
     }
 
+void List::IntersectBatch( const RayBatch &batch, const unsigned *active, unsigned n, HitInfo *hits ) const
+    {
+    // Remove the rays that miss the bounding box from the batch, then hand
+    // the remaining rays to each child in turn.  This way each child is visited
+    // once per batch rather than once per ray.
+    vector<unsigned> live;
+    live.reserve( n );
+    for( unsigned k = 0; k < n; k++ )
+        {
+        if( Hit( batch.rays[ active[k] ], bbox ) ) live.push_back( active[k] );
+        }
+    if( live.empty() ) return;
+
+    vector<unsigned> subset;
+    for( unsigned c = 0; c < NumChildren(); c++ )
+        {
+        const Object *obj = GetChild(c);
+
+        // Rays that are to ignore this child must be left out of its batch.
+        subset.clear();
+        for( unsigned k = 0; k < live.size(); k++ )
+            {
+            if( hits[ live[k] ].ignore != obj ) subset.push_back( live[k] );
+            }
+        if( !subset.empty() ) obj->IntersectBatch( batch, &subset[0], subset.size(), hits );
+        }
+    }
+
 bool List::Inside( const Vec3 &P ) const
     {
     // If the point is not inside the bounding box of the list, then
@@ -134,7 +169,9 @@ void List::AddChild( Object *obj )
     bbox << GetBox( *obj );  // Grow the bounding box.
     }
 
-
-
-
-
+void List::Close()
+    {
+    // Replace groups of spheres and triangles with packed objects that test
+    // a ray against four primitives at once.
+    if( packed ) PackPrimitives( children );
+    }
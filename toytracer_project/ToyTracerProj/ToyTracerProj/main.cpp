@@ -3,34 +3,268 @@
 *                                                                          *
 * This is the main program for the "toytracer".  It reads in the camera    *
 * and scene from a file, then invokes the rasterizer, which casts all the  *
-* initial rays and writes the resulting image to a file.                   *
+* initial rays and writes the resulting image to a file.  Usage:           *
+*                                                                          *
+*    toytracer [scene NAME] [blur NAME] [output NAME] [res WxH | width N]  *
+*              [spp N] [threads N] [tile N] [rasterizer NAME]              *
+*              [aggregate NAME] [stats FILE] [trace FILE]                  *
+*              [animate FILE [frames N[-M]] [jobs N]]                      *
+*                                                                          *
+*    scene       the sdf file to render, without the extension (by default *
+*                scenes/scene1); the word "scene" may be left out;         *
+*    blur        a second scene, blended with the first as motion blur;    *
+*    output      the image to write, without the extension (by default     *
+*                the name of the scene, with "_blur" if blurred);          *
+*    res, width  the resolution of the image, overriding the scene's; a    *
+*                width alone keeps the aspect ratio of the scene;          *
+*    spp         the rays per pixel;                                       *
+*    threads     the rendering threads, and                                *
+*    tile        the width of a tile in pixels, for rasterizers that use   *
+*                them (the wavefront_rasterizer);                          *
+*    rasterizer  the rasterizer to use instead of the scene's;             *
+*    aggregate   the aggregate to hold the scene's top-level objects,      *
+*                instead of the one named in the sdf file (e.g. abvh);     *
+*    stats       where to write the render statistics, if they are         *
+*                compiled in (by default OUTPUT.stats.json);               *
+*    trace       where to write a timeline of the render, in Chrome trace  *
+*                format (or set the environment variable TOYTRACER_TRACE); *
+*    animate     render a sequence of frames, keyed by the given animation *
+*                file (see animation.h), instead of a single image;        *
+*    frames      the frame, or range of frames, to render (by default all  *
+*                of them);                                                 *
+*    jobs        the frames to render at once, if only the camera moves    *
+*                (by default enough to keep every core busy).              *
+*                                                                          *
+* If spp, threads or tile is given, the rasterizer is created anew with    *
+* just those parameters; a rasterizer that does not take one of them (the  *
+* basic_rasterizer takes no threads or tile) is an error.  Instead of      *
+* rendering, the toytracer can also run one of its tools: "toytracer bench *
+* ...", "micro ...", "compare ...", "golden ...", "serve ..." or "request  *
+* ...".                                                                    *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Options with missing or malformed values are errors.       *
+*   10/18/2026  Options the rasterizer does not take are an error.         *
+*   10/18/2026  Added the serve & request commands.                        *
+*   10/18/2026  Added the animate, frames & jobs options.                  *
+*   10/18/2026  Render settings now come from the command line.            *
+*   10/18/2026  Added the compare & golden commands.                       *
+*   10/18/2026  Runs the microbenchmarks when the first argument is micro. *
+*   10/18/2026  Runs the benchmark suite when the first argument is bench. *
+*   10/18/2026  Writes a timeline if TOYTRACER_TRACE names a file.         *
+*   10/18/2026  Times rendering & reports the render statistics.           *
 *   10/04/2005  Updated for 2005 graphics class.                           *
 *   10/10/2004  Print registered objects, get optional file name from argv.*
 *   04/03/2003  Main program now defines scene geometry.                   *
 *   04/01/2003  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <sstream>
 #include "toytracer.h"
+#include "params.h"
+#include "util.h"
+#include "trace.h"
+#include "bench.h"
+#include "microbench.h"
+#include "compare.h"
+#include "animation.h"
+#include "server.h"
 
 static const string DefaultScene = "scenes/scene1";
 
-int main( int argc, char *argv[] )
+// Everything that can be set from the command line.  Zeros and empty
+// strings mean "as the scene says".
+struct render_options {
+    string   scene;
+    string   blur_scene;
+    string   output;
+    unsigned x_res;
+    unsigned y_res;
+    unsigned width;
+    unsigned samples;
+    unsigned threads;
+    unsigned tile;
+    string   rasterizer;
+    string   aggregate;
+    string   stats_file;
+    string   trace_file;
+    string   animation;
+    bool     all_frames;
+    unsigned first_frame;
+    unsigned last_frame;
+    unsigned jobs;
+    };
+
+static void PrintUsage( ostream &out )
     {
-    Scene  scene;
-	Scene scene2;
-    Camera camera;
+    out << "Usage: toytracer [scene NAME] [blur NAME] [output NAME] [res WxH | width N]\n"
+        << "                 [spp N] [threads N] [tile N] [rasterizer NAME]\n"
+        << "                 [aggregate NAME] [stats FILE] [trace FILE]\n"
+        << "                 [animate FILE [frames N[-M]] [jobs N]]\n"
+        << "   or: toytracer bench|micro|compare|golden|serve|request [options]" << endl;
+    }
 
-	//whether or not to do motion blur
-	bool doMotionBlur = false;
+// Remove the extension, if it is the given one.
+static string Strip( const string &name, const string &ext )
+    {
+    if( name.size() > ext.size() && name.compare( name.size() - ext.size(), ext.size(), ext ) == 0 )
+        return name.substr( 0, name.size() - ext.size() );
+    return name;
+    }
 
-	//if motion blur is not done, this toggles whether or not to render scene 2 instead
-	bool renderScene2 = false; 
+// Read a whole word as an unsigned number, with nothing before or after
+// its digits.
+static bool Unsigned( const string &word, unsigned &x )
+    {
+    if( word.empty() || word.find_first_not_of( "0123456789" ) != string::npos ) return false;
+    x = (unsigned)strtoul( word.c_str(), NULL, 10 );
+    return true;
+    }
 
-	string fname = "scenes/scene1";
-	string fname2 = "scenes/scene2";
-	string output_fname = "scenes/scene_1_2_blur";
+// Read the option of the given name, and the word that follows it.  An
+// option given without a value is described in "bad", to be reported.
+static bool Option( ParamReader &get, const char *name, string &value, string &bad )
+    {
+    // Every argument ends with a blank, so this matches whole words only.
+    if( !get[ string( name ) + " " ] ) return false;
+    if( get.Word( value ) ) return true;
+    bad = string( name ) + " must be followed by a value";
+    return false;
+    }
+
+// As above, for an option whose value is an unsigned number.
+static bool Option( ParamReader &get, const char *name, unsigned &value, string &bad )
+    {
+    string word;
+    if( !Option( get, name, word, bad ) ) return false;
+    if( Unsigned( word, value ) ) return true;
+    bad = string( name ) + " must be followed by a number, not " + word;
+    return false;
+    }
+
+static bool ParseOptions( int argc, char *argv[], render_options &opt )
+    {
+    opt.x_res = opt.y_res = opt.width = 0;
+    opt.samples = opt.threads = opt.tile = 0;
+    opt.first_frame = opt.last_frame = opt.jobs = 0;
+    opt.all_frames = true;
+
+    string args;
+    for( int i = 0; i < argc; i++ ) args += string( argv[i] ) + " ";
+    ParamReader get( args );
+
+    // As of old, the scene may be given on its own as the first argument.
+    static const char *keywords[] = { "scene", "blur", "output", "res", "width", "spp", "threads",
+                                      "tile", "rasterizer", "aggregate", "stats", "trace", "animate",
+                                      "frames", "jobs" };
+    bool keyword = false;
+    for( unsigned k = 0; k < sizeof( keywords ) / sizeof( keywords[0] ); k++ )
+        keyword |= ( argc > 0 && string( argv[0] ) == keywords[k] );
+    if( argc > 0 && !keyword ) get.Word( opt.scene );
+
+    string res;
+    string frames;
+    string bad;  // Describes an option whose value is missing or malformed.
+    while( bad.empty() )
+        {
+        if( Option( get, "scene",      opt.scene,      bad ) ) continue;
+        if( Option( get, "blur",       opt.blur_scene, bad ) ) continue;
+        if( Option( get, "output",     opt.output,     bad ) ) continue;
+        if( Option( get, "res",        res,            bad ) ) continue;
+        if( Option( get, "width",      opt.width,      bad ) ) continue;
+        if( Option( get, "spp",        opt.samples,    bad ) ) continue;
+        if( Option( get, "threads",    opt.threads,    bad ) ) continue;
+        if( Option( get, "tile",       opt.tile,       bad ) ) continue;
+        if( Option( get, "rasterizer", opt.rasterizer, bad ) ) continue;
+        if( Option( get, "aggregate",  opt.aggregate,  bad ) ) continue;
+        if( Option( get, "stats",      opt.stats_file, bad ) ) continue;
+        if( Option( get, "trace",      opt.trace_file, bad ) ) continue;
+        if( Option( get, "animate",    opt.animation,  bad ) ) continue;
+        if( Option( get, "frames",     frames,         bad ) ) continue;
+        if( Option( get, "jobs",       opt.jobs,       bad ) ) continue;
+        break;
+        }
+    if( !bad.empty() )
+        {
+        cerr << "Error: " << bad << endl;
+        return false;
+        }
+    string extra;
+    if( get.Word( extra ) )
+        {
+        cerr << "Error: unrecognized argument " << extra << endl;
+        return false;
+        }
+    const size_t x = res.find( 'x' );
+    if( !res.empty() && ( x == string::npos || !Unsigned( res.substr( 0, x ), opt.x_res ) ||
+        !Unsigned( res.substr( x + 1 ), opt.y_res ) || opt.x_res == 0 || opt.y_res == 0 ) )
+        {
+        cerr << "Error: the resolution must be given as WxH, not " << res << endl;
+        return false;
+        }
+    if( !frames.empty() )
+        {
+        // A range must have both ends, as in 3-7; "3-" is an error.
+        const size_t dash = frames.find( '-' );
+        bool valid;
+        if( dash == string::npos )
+            {
+            valid = Unsigned( frames, opt.first_frame );
+            opt.last_frame = opt.first_frame;
+            }
+        else valid = Unsigned( frames.substr( 0, dash ), opt.first_frame ) &&
+                     Unsigned( frames.substr( dash + 1 ), opt.last_frame );
+        opt.all_frames = false;
+        if( !valid || opt.last_frame < opt.first_frame )
+            {
+            cerr << "Error: the frames must be given as N or N-M, not " << frames << endl;
+            return false;
+            }
+        }
+    if( !opt.animation.empty() && !opt.blur_scene.empty() )
+        {
+        cerr << "Error: an animation cannot be blended with a second scene." << endl;
+        return false;
+        }
+
+    if( opt.scene.empty() ) opt.scene = DefaultScene;
+    opt.scene      = Strip( opt.scene, ".sdf" );
+    opt.blur_scene = Strip( opt.blur_scene, ".sdf" );
+    if( opt.output.empty() ) opt.output = opt.scene + ( opt.blur_scene.empty() ? "" : "_blur" );
+    opt.output = Strip( opt.output, ".ppm" );
+    return true;
+    }
+
+// Replace the top-level aggregate of the scene with a new one of the named
+// kind, holding the same objects.  Aggregates nested within it are kept.
+static bool ReplaceAggregate( Scene &scene, const string &name )
+    {
+    Aggregate *old = dynamic_cast<Aggregate *>( scene.object );
+    Plugin *plg = Instance_of_Plugin( ( "begin " + name ).c_str() );
+    if( old == NULL || plg == NULL || plg->PluginType() != aggregate_plugin || ((Aggregate *)plg)->Prototype() )
+        {
+        cerr << "Error: Could not replace the scene's aggregate with " << name << endl;
+        return false;
+        }
+    Aggregate *agg = (Aggregate *)plg;
+    agg->material = old->material;
+    agg->shader   = old->shader;
+    agg->envmap   = old->envmap;
+    for( unsigned i = 0; i < old->children.size(); i++ ) agg->AddChild( old->children[i] );
+    TraceSpan span( "close " + name, "build" );
+    agg->Close();
+    scene.object = agg;
+    return true;
+    }
+
+int main( int argc, char *argv[] )
+    {
+    Scene  scene;
+    Scene  scene2;
+    Camera camera;
 
     // Print out a banner with the current version number of the software.
 
@@ -38,12 +272,60 @@ int main( int argc, char *argv[] )
          << TOYTRACER_MAJOR_VERSION << "." << TOYTRACER_MINOR_VERSION
          << " ****" << endl;
 
+    // Some commands run tools instead of rendering: "toytracer bench ..." runs
+    // the benchmark suite, "toytracer micro ..." the microbenchmarks of the
+    // kernels, "toytracer compare ..." compares two images, "toytracer
+    // golden ..." checks the shipped scenes against their golden images, and
+    // "toytracer serve ..." runs a render server, to which "toytracer request
+    // ..." sends jobs.
+
+    if( argc > 1 )
+        {
+        const string command( argv[1] );
+        int code = -1;
+        if( command == "bench"   ) code = RunBenchmarks     ( argc - 2, argv + 2 );
+        if( command == "micro"   ) code = RunMicrobenchmarks( argc - 2, argv + 2 );
+        if( command == "compare" ) code = RunCompare        ( argc - 2, argv + 2 );
+        if( command == "golden"  ) code = RunGolden         ( argc - 2, argv + 2 );
+        if( command == "serve"   ) code = RunServer         ( argc - 2, argv + 2 );
+        if( command == "request" ) code = RunRequest        ( argc - 2, argv + 2 );
+        if( command == "help" || command == "-h" || command == "--help" )
+            {
+            PrintUsage( cout );
+            code = no_errors;
+            }
+        if( code >= 0 )
+            {
+            DestroyRegisteredPlugins();
+            return code;
+            }
+        }
+
+    render_options opt;
+    if( !ParseOptions( argc - 1, argv + 1, opt ) )
+        {
+        PrintUsage( cerr );
+        return error_bad_arguments;
+        }
+    const bool doMotionBlur = !opt.blur_scene.empty();
+
     // Print out the names of all the types of objects that are registered before
     // reading in the sdf file.  This list should be the first thing to check if
     // the file is not parsed correctly.
 
     PrintRegisteredPlugins( cout );
 
+    // If a trace file is named (on the command line or by the environment
+    // variable TOYTRACER_TRACE), record the phases of the render and write
+    // them to it, in Chrome trace format.
+
+    if( opt.trace_file.empty() && getenv( "TOYTRACER_TRACE" ) != NULL ) opt.trace_file = getenv( "TOYTRACER_TRACE" );
+    if( !opt.trace_file.empty() )
+        {
+        StartTrace();
+        SetTraceThreadName( "main" );
+        }
+
     // There must be at least one builder plugin to build the scene (usually by reading
     // it from a file).  Find the first that is not a "default" builder, if there is one.
     // Otherwise, use the default builder.
@@ -55,65 +337,122 @@ int main( int argc, char *argv[] )
         return error_no_builder;
         }
 
-    // Set the file name to a default, but substitute the argument given on the
-	// command line if there is one.
-    //tring fname = DefaultScene;
-    //if( argc > 1 ) fname = argv[1];
-	
-    // Invoke the builder to construct the scene.
+    // Invoke the builder to construct the scene, and the second scene if it is
+    // to be blended in as motion blur.
+
+        {
+        TraceSpan span( "build scene" );
+        if( !builder->BuildScene( opt.scene, camera, scene ) ||
+            ( doMotionBlur && !builder->BuildScene( opt.blur_scene, camera, scene2 ) ) )
+            {
+            cerr << "Error encountered while building scene." << endl;
+            return error_building_scene;
+            }
+        if( !opt.aggregate.empty() )
+            {
+            if( !ReplaceAggregate( scene, opt.aggregate ) ) return error_building_scene;
+            if( doMotionBlur && !ReplaceAggregate( scene2, opt.aggregate ) ) return error_building_scene;
+            }
+        }
+
+    // Override the resolution of the scene, if asked.  A width alone keeps the
+    // aspect ratio.
 
-	if(doMotionBlur || !renderScene2){
-		if( !builder->BuildScene( fname, camera, scene ) )
+    if( opt.x_res > 0 )
         {
-			cerr << "Error encountered while building scene." << endl;
-			return error_building_scene;
+        camera.x_res = opt.x_res;
+        camera.y_res = opt.y_res;
         }
-	}
-	if(doMotionBlur || renderScene2){
-		if( !builder->BuildScene( fname2, camera, scene2 ) )
+    else if( opt.width > 0 )
         {
-			cerr << "Error encountered while building scene." << endl;
-			return error_building_scene;
+        camera.y_res = unsigned( max( 1.0, double( camera.y_res ) * opt.width / camera.x_res + 0.5 ) );
+        camera.x_res = opt.width;
         }
-	}
 
-    // If a rasterizer was not specified by the builder, look to see if one has
-    // been registered.
+    // Use the rasterizer named on the command line, or else the one specified by
+    // the builder, or else one that has been registered.  If any of its
+    // parameters were given, create it anew with them.
+
+    string rasterizer_name( opt.rasterizer );
+    if( rasterizer_name.empty() && scene.rasterize != NULL ) rasterizer_name = scene.rasterize->MyName();
+    if( !opt.rasterizer.empty() || opt.samples > 0 || opt.threads > 0 || opt.tile > 0 )
+        {
+        if( rasterizer_name.empty() )
+            {
+            Plugin *plg = LookupPlugin( rasterizer_plugin );
+            if( plg != NULL ) rasterizer_name = plg->MyName();
+            }
+        std::stringstream line;
+        line << "rasterizer " << rasterizer_name;
+        if( opt.samples > 0 ) line << " samples " << opt.samples;
+        if( opt.tile    > 0 ) line << " tile "    << opt.tile;
+        if( opt.threads > 0 ) line << " threads " << opt.threads;
+        Plugin *plg = Instance_of_Plugin( line.str().c_str() );
+        if( plg == NULL || plg->PluginType() != rasterizer_plugin )
+            {
+            cerr << "Error: Could not create the rasterizer \"" << line.str() << "\"" << endl;
+            if( opt.threads > 0 || opt.tile > 0 )
+                cerr << "Only rasterizers that use tiles (the wavefront_rasterizer) take threads & tile." << endl;
+            return error_no_rasterizer;
+            }
+        scene.rasterize = (Rasterizer *)plg;
+        }
 
     if( scene.rasterize == NULL )
         {
         scene.rasterize = (Rasterizer *)LookupPlugin( rasterizer_plugin );
         if( scene.rasterize == NULL )
-            {  
+            {
             cerr << "No rasterizer plugin was found." << endl;
             return error_no_rasterizer;
             }
         }
 
-    // Generate the image using the rasterizer that was either specified by
-    // the builder or supplied by default.
-
-	if(doMotionBlur){
-		if( !scene.rasterize->Rasterize( output_fname, camera, scene, scene2,true ) )
-		{
-			cerr << "Error encountered while rasterizing." << endl;
-			return error_rasterizing_image;
-		}
-	}else if(renderScene2){
-		if( !scene.rasterize->Rasterize( fname2, camera, scene2, scene,false ) )
-		{
-			cerr << "Error encountered while rasterizing." << endl;
-			return error_rasterizing_image;
-		}
-	}else{
-		if( !scene.rasterize->Rasterize( fname, camera, scene, scene2,false ) )
-		{
-			cerr << "Error encountered while rasterizing." << endl;
-			return error_rasterizing_image;
-		}
-	}
+    // Read the keys of the animation, if there is one.  The scene has been
+    // built just once, and is shared by all the frames.
+
+    Animation anim;
+    if( !opt.animation.empty() )
+        {
+        if( !ReadAnimation( opt.animation, camera, scene, anim ) ) return error_reading_input_file;
+        if( opt.all_frames ) opt.last_frame = anim.frames - 1;
+        }
+
+    // Generate the image, or the frames of the animation, using the rasterizer.
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        {
+        TraceSpan span( "rasterize" );
+        const bool ok = opt.animation.empty() ?
+            scene.rasterize->Rasterize( opt.output, camera, scene, doMotionBlur ? scene2 : scene, doMotionBlur ) :
+            RenderAnimation( opt.output, anim, scene, opt.first_frame, opt.last_frame, opt.jobs );
+        if( !ok )
+            {
+            cerr << "Error encountered while rasterizing." << endl;
+            return error_rasterizing_image;
+            }
+        }
+
+    // Report the statistics gathered while rendering, if they were compiled in,
+    // and save them alongside the image (or where asked).
+
+    const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    if( STATS_ENABLED )
+        {
+        const string stats_fname = opt.stats_file.empty() ? opt.output + ".stats.json" : opt.stats_file;
+        PrintStats( cout, seconds );
+        if( !WriteStats( stats_fname, seconds ) )
+            cerr << "Error: Could not write " << stats_fname << endl;
+        }
+    else if( !opt.stats_file.empty() )
+        cerr << "Warning: the render statistics are only kept if compiled with TOYTRACER_STATS." << endl;
+
+    if( !opt.trace_file.empty() )
+        {
+        if( WriteTrace( opt.trace_file ) ) cout << "Wrote the timeline to " << opt.trace_file << endl;
+        else cerr << "Error: Could not write " << opt.trace_file << endl;
+        }
 
     DestroyRegisteredPlugins();
     return no_errors;
     }
-
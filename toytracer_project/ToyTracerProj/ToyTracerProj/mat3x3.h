@@ -4,6 +4,7 @@
 * Mat3x3 is a 3x3 matrix class, with associated operators.                 *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Entries are reals; Inverse works in double precision.      *
 *   10/16/2004  Added ^ operator for multiplying by the transpose.         *
 *   10/10/2004  Added Inverse function.                                    *
 *   04/07/2003  Initial coding.                                            *
@@ -18,12 +19,12 @@ struct Mat3x3 {
     inline Mat3x3();
     inline Mat3x3( const Mat3x3 &M ) { *this = M; }
     inline ~Mat3x3() {}
-    inline       double &operator()( int i, int j )       { return m[i][j]; }
-    inline const double &operator()( int i, int j ) const { return m[i][j]; }
+    inline       real &operator()( int i, int j )       { return m[i][j]; }
+    inline const real &operator()( int i, int j ) const { return m[i][j]; }
     inline static Mat3x3 Identity();
     inline Vec3 row( int i ) const { return Vec3( m[i][0], m[i][1], m[i][2] ); }
     inline Vec3 col( int j ) const { return Vec3( m[0][j], m[1][j], m[2][j] ); }
-    double m[3][3];
+    real m[3][3];
     };
 
 inline Mat3x3::Mat3x3()
@@ -129,10 +130,38 @@ inline Mat3x3 Transpose( const Mat3x3 &M )
     return W;
     }
 
+// The inverse is the transposed adjoint divided by the determinant.  It is
+// computed in double precision even when the entries are single precision,
+// as it is sensitive to round-off when M is nearly singular.
+inline void Inverse( const Mat3x3 &M, double W[3][3] )
+    {
+    double m[3][3];
+    for( int i = 0; i < 3; i++ )
+    for( int j = 0; j < 3; j++ ) m[i][j] = M(i,j);
+    const double d =
+        m[0][0] * ( m[1][1] * m[2][2] - m[1][2] * m[2][1] )
+      - m[0][1] * ( m[1][0] * m[2][2] - m[1][2] * m[2][0] )
+      + m[0][2] * ( m[1][0] * m[2][1] - m[1][1] * m[2][0] );
+    const double c = 1 / d;
+    W[0][0] = c * ( m[1][1] * m[2][2] - m[1][2] * m[2][1] );
+    W[1][0] = c * ( m[1][2] * m[2][0] - m[1][0] * m[2][2] );
+    W[2][0] = c * ( m[1][0] * m[2][1] - m[1][1] * m[2][0] );
+    W[0][1] = c * ( m[0][2] * m[2][1] - m[0][1] * m[2][2] );
+    W[1][1] = c * ( m[0][0] * m[2][2] - m[0][2] * m[2][0] );
+    W[2][1] = c * ( m[0][1] * m[2][0] - m[0][0] * m[2][1] );
+    W[0][2] = c * ( m[0][1] * m[1][2] - m[0][2] * m[1][1] );
+    W[1][2] = c * ( m[0][2] * m[1][0] - m[0][0] * m[1][2] );
+    W[2][2] = c * ( m[0][0] * m[1][1] - m[0][1] * m[1][0] );
+    }
+
 inline Mat3x3 Inverse( const Mat3x3 &M )
     {
-    double d = det( M );
-    return Transpose( Adjoint( M ) ) / d;
+    double W[3][3];
+    Inverse( M, W );
+    Mat3x3 A;
+    for( int i = 0; i < 3; i++ )
+    for( int j = 0; j < 3; j++ ) A(i,j) = W[i][j];
+    return A;
     }
 
 inline Mat3x3 Mat3x3::Identity()
@@ -7,6 +7,7 @@
 * each vector it is multiplied with.                                       *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Inverse is found in double precision.                      *
 *   10/10/2004  Added Inverse function.                                    *
 *   10/06/2004  Initial coding.                                            *
 *                                                                          *
@@ -77,8 +78,19 @@ inline Mat3x4 operator/( const Mat3x4 &M, double c )
 
 inline Mat3x4 Inverse( const Mat3x4 &M )
     {
-    Mat3x3 W( Inverse( M.mat ) );
-    return Mat3x4( W, -( W * M.vec ) );
+    // Both the linear part and the translation are found in double precision.
+    double W[3][3];
+    Inverse( M.mat, W );
+    const double x = M.vec.x, y = M.vec.y, z = M.vec.z;
+    Mat3x4 A;
+    for( int i = 0; i < 3; i++ )
+    for( int j = 0; j < 3; j++ ) A.mat(i,j) = W[i][j];
+    A.vec = -Vec3(
+        W[0][0] * x + W[0][1] * y + W[0][2] * z,
+        W[1][0] * x + W[1][1] * y + W[1][2] * z,
+        W[2][0] * x + W[2][1] * y + W[2][2] * z
+        );
+    return A;
     }
 
 inline Mat3x4 Mat3x4::Identity()
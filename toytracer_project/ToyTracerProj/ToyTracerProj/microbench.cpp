@@ -0,0 +1,702 @@
+/***************************************************************************
+* microbench.cpp                                                           *
+*                                                                          *
+* The microbenchmark harness.  It is run as                                *
+*                                                                          *
+*    toytracer micro [filter TEXT] [rays N] [hits f1,f2,...] [repeat N]    *
+*                    [seed N] [csv FILE]                                   *
+*                                                                          *
+* Only the benchmarks whose names contain the filter text are run.  Each   *
+* intersector is given N rays (1000000 by default), generated in advance   *
+* from the seed, for each of the hit fractions (0, 0.5 and 1 by default).  *
+* The rays start outside the object and are aimed at random points within  *
+* its bounding box.  The object itself sorts them into those that hit and  *
+* those that miss, and then the required numbers of each are shuffled      *
+* together, so the branches taken are as unpredictable as they would be    *
+* in a real scene.  (A flat object such as a triangle is missed by most    *
+* rays aimed at its box, so it may take a while to find the hits.)         *
+*                                                                          *
+* The rays are run through the kernel once to warm the caches, then timed  *
+* "repeat" times (5 by default).  The median time per test is reported,    *
+* with the fastest, and the millions of tests per second.  For the packed  *
+* objects, a test is one ray against four primitives; for the vector math, *
+* it is one vector, whether done alone or four at a time.  On Linux, the   *
+* branch instructions and misses are counted by the hardware performance   *
+* counters, if the kernel allows it, and reported per test; elsewhere      *
+* those columns are left blank.  The results are also written as CSV if a  *
+* file is named, one row per benchmark and hit fraction, so that they can  *
+* be compared from one commit to the next.                                 *
+*                                                                          *
+* After the timings, the accuracy cases give the same rays to each         *
+* version of an object (e.g. the torus, with & without "closed_form"),     *
+* and report the largest & RMS distance of their hits from the surface.    *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Benchmarks both triangle kernels, packed & not.            *
+*   10/18/2026  Reports the residuals of the torus root finders.           *
+*   10/18/2026  Benchmarks the watertight triangle kernel.                 *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include "microbench.h"
+#include "bench.h"
+#include "params.h"
+#include "packed.h"
+#include "util.h"
+#include "vec3x4.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock micro_clock;
+
+static const unsigned batch_size   = 16;   // Rays per batch, as in a 4x4 block of pixels.
+static const unsigned math_vectors = 1024; // Small enough that the math runs from the cache.
+
+// The ways in which a kernel is driven.
+enum micro_mode {
+    mode_intersect,    // Object::Intersect, one ray at a time.
+    mode_batch,        // Object::IntersectBatch, on batches of rays.
+    mode_hit,          // Hit( ray, box ).
+    mode_hit_interval, // Hit( ray, box, interval ).
+    mode_math          // Vector math, with no rays.
+    };
+
+// Everything a kernel needs, all prepared before it is timed.
+struct micro_data {
+    const Object    *object;
+    AABB             box;
+    vector<Ray>      rays;
+    vector<RayBatch> batches;
+    vector<HitInfo>  hits;     // For the batches.
+    vector<double>   x, y, z;  // Vectors for the math, in structure-of-arrays form.
+    vector<double>   u, v, w;
+    Mat3x4           M;
+    unsigned         tests;    // Tests made by one run of a kernel.
+    };
+
+// A kernel returns a count or sum that depends on all its work, so that
+// none of it can be optimized away.  For the intersectors, it is the number
+// of rays that hit.
+typedef double (*micro_kernel)( const micro_data & );
+
+struct micro_benchmark {
+    const char  *name;
+    micro_mode   mode;
+    const char  *objects; // The object as sdf lines, separated by ';'.  Several are packed.
+    micro_kernel kernel;
+    };
+
+static double IntersectKernel( const micro_data &data )
+    {
+    unsigned count = 0;
+    for( unsigned i = 0; i < data.rays.size(); i++ )
+        {
+        HitInfo hitinfo;
+        hitinfo.ignore   = NULL;
+        hitinfo.distance = Infinity;
+        if( data.object->Intersect( data.rays[i], hitinfo ) ) count++;
+        }
+    return count;
+    }
+
+static double BatchKernel( const micro_data &data )
+    {
+    unsigned active[ batch_size ];
+    for( unsigned i = 0; i < batch_size; i++ ) active[i] = i;
+    HitInfo *hits = const_cast<HitInfo *>( &data.hits[0] );
+    unsigned count = 0;
+    for( unsigned b = 0; b < data.batches.size(); b++ )
+        {
+        const RayBatch &batch = data.batches[b];
+        const unsigned n = batch.Size();
+        for( unsigned i = 0; i < n; i++ )
+            {
+            hits[i].object   = NULL;
+            hits[i].distance = Infinity;
+            }
+        data.object->IntersectBatch( batch, active, n, hits );
+        for( unsigned i = 0; i < n; i++ ) if( hits[i].object != NULL ) count++;
+        }
+    return count;
+    }
+
+static double HitKernel( const micro_data &data )
+    {
+    unsigned count = 0;
+    for( unsigned i = 0; i < data.rays.size(); i++ )
+        {
+        if( Hit( data.rays[i], data.box ) ) count++;
+        }
+    return count;
+    }
+
+static double HitIntervalKernel( const micro_data &data )
+    {
+    unsigned count = 0;
+    for( unsigned i = 0; i < data.rays.size(); i++ )
+        {
+        Interval I;
+        if( Hit( data.rays[i], data.box, I ) ) count++;
+        }
+    return count;
+    }
+
+// The vector math is run over the same small arrays again and again, until
+// "tests" vectors have been processed.
+
+static inline Vec3 GetVec( const vector<double> &x, const vector<double> &y, const vector<double> &z, unsigned i )
+    {
+    return Vec3( x[i], y[i], z[i] );
+    }
+
+static inline Vec3x4 GetVec4( const vector<double> &x, const vector<double> &y, const vector<double> &z, unsigned i )
+    {
+    return Vec3x4::Load( &x[i], &y[i], &z[i] );
+    }
+
+static double Sum( const Double4 &a )
+    {
+    double v[4];
+    a.Store( v );
+    return v[0] + v[1] + v[2] + v[3];
+    }
+
+static double Sum( const Vec3x4 &A )
+    {
+    return Sum( A.x + A.y + A.z );
+    }
+
+static double DotKernel( const micro_data &d )
+    {
+    double sum = 0.0;
+    for( unsigned t = 0; t < d.tests; t += math_vectors )
+    for( unsigned i = 0; i < math_vectors; i++ )
+        sum += GetVec( d.x, d.y, d.z, i ) * GetVec( d.u, d.v, d.w, i );
+    return sum;
+    }
+
+static double Dot4Kernel( const micro_data &d )
+    {
+    Double4 sum( 0.0 );
+    for( unsigned t = 0; t < d.tests; t += math_vectors )
+    for( unsigned i = 0; i < math_vectors; i += 4 )
+        sum = sum + GetVec4( d.x, d.y, d.z, i ) * GetVec4( d.u, d.v, d.w, i );
+    return Sum( sum );
+    }
+
+static double CrossKernel( const micro_data &d )
+    {
+    Vec3 sum( 0, 0, 0 );
+    for( unsigned t = 0; t < d.tests; t += math_vectors )
+    for( unsigned i = 0; i < math_vectors; i++ )
+        sum += GetVec( d.x, d.y, d.z, i ) ^ GetVec( d.u, d.v, d.w, i );
+    return sum.x + sum.y + sum.z;
+    }
+
+static double Cross4Kernel( const micro_data &d )
+    {
+    Vec3x4 sum( Vec3( 0, 0, 0 ) );
+    for( unsigned t = 0; t < d.tests; t += math_vectors )
+    for( unsigned i = 0; i < math_vectors; i += 4 )
+        sum = sum + ( GetVec4( d.x, d.y, d.z, i ) ^ GetVec4( d.u, d.v, d.w, i ) );
+    return Sum( sum );
+    }
+
+static double UnitKernel( const micro_data &d )
+    {
+    Vec3 sum( 0, 0, 0 );
+    for( unsigned t = 0; t < d.tests; t += math_vectors )
+    for( unsigned i = 0; i < math_vectors; i++ )
+        sum += Unit( GetVec( d.x, d.y, d.z, i ) );
+    return sum.x + sum.y + sum.z;
+    }
+
+static double Unit4Kernel( const micro_data &d )
+    {
+    Vec3x4 sum( Vec3( 0, 0, 0 ) );
+    for( unsigned t = 0; t < d.tests; t += math_vectors )
+    for( unsigned i = 0; i < math_vectors; i += 4 )
+        sum = sum + Unit( GetVec4( d.x, d.y, d.z, i ) );
+    return Sum( sum );
+    }
+
+static double TransformKernel( const micro_data &d )
+    {
+    Vec3 sum( 0, 0, 0 );
+    for( unsigned t = 0; t < d.tests; t += math_vectors )
+    for( unsigned i = 0; i < math_vectors; i++ )
+        sum += d.M * GetVec( d.x, d.y, d.z, i );
+    return sum.x + sum.y + sum.z;
+    }
+
+static double Transform4Kernel( const micro_data &d )
+    {
+    Vec3x4 sum( Vec3( 0, 0, 0 ) );
+    for( unsigned t = 0; t < d.tests; t += math_vectors )
+    for( unsigned i = 0; i < math_vectors; i += 4 )
+        sum = sum + d.M * GetVec4( d.x, d.y, d.z, i );
+    return Sum( sum );
+    }
+
+static const micro_benchmark benchmarks[] = {
+    { "sphere",            mode_intersect,    "sphere (0,0,0) 1", IntersectKernel },
+    { "sphere_batch",      mode_batch,        "sphere (0,0,0) 1", BatchKernel },
+    { "packed_spheres",    mode_intersect,    "sphere (-0.5,-0.5,0) 0.45; sphere (0.5,-0.5,0) 0.45; sphere (-0.5,0.5,0) 0.45; sphere (0.5,0.5,0) 0.45", IntersectKernel },
+    { "triangle",          mode_intersect,    "triangle (-1,-1,0) (1,-1,0) (0,1,0)", IntersectKernel },
+    { "triangle_edges",    mode_intersect,    "triangle (-1,-1,0) (1,-1,0) (0,1,0) edges", IntersectKernel },
+    { "packed_triangles",  mode_intersect,    "triangle (-1,-1,0) (0,-1,0) (-1,0,0); triangle (0,-1,0) (1,-1,0) (0,0,0); triangle (-1,0,0) (0,0,0) (-1,1,0); triangle (0,0,0) (1,0,0) (0,1,0)", IntersectKernel },
+    { "packed_triangles_edges", mode_intersect, "triangle (-1,-1,0) (0,-1,0) (-1,0,0) edges; triangle (0,-1,0) (1,-1,0) (0,0,0) edges; triangle (-1,0,0) (0,0,0) (-1,1,0) edges; triangle (0,0,0) (1,0,0) (0,1,0) edges", IntersectKernel },
+    { "quad",              mode_intersect,    "quad (-1,-1,0) (1,-1,0) (1,1,0) (-1,1,0)", IntersectKernel },
+    { "block",             mode_intersect,    "block (-1,-1,-1) (1,1,1)", IntersectKernel },
+    { "cylinder",          mode_intersect,    "cylinder", IntersectKernel },
+    { "cone",              mode_intersect,    "cone", IntersectKernel },
+    { "torus",             mode_intersect,    "torus 1 0.35", IntersectKernel },
+    { "torus_closed_form", mode_intersect,    "torus 1 0.35 closed_form", IntersectKernel },
+    { "torus_batch",       mode_batch,        "torus 1 0.35", BatchKernel },
+    { "aabb_hit",          mode_hit,          "block (-1,-1,-1) (1,1,1)", HitKernel },
+    { "aabb_hit_interval", mode_hit_interval, "block (-1,-1,-1) (1,1,1)", HitIntervalKernel },
+    { "vec3_dot",          mode_math,         NULL, DotKernel },
+    { "vec3x4_dot",        mode_math,         NULL, Dot4Kernel },
+    { "vec3_cross",        mode_math,         NULL, CrossKernel },
+    { "vec3x4_cross",      mode_math,         NULL, Cross4Kernel },
+    { "vec3_unit",         mode_math,         NULL, UnitKernel },
+    { "vec3x4_unit",       mode_math,         NULL, Unit4Kernel },
+    { "mat3x4_vec3",       mode_math,         NULL, TransformKernel },
+    { "mat3x4_vec3x4",     mode_math,         NULL, Transform4Kernel }
+    };
+
+static const unsigned num_benchmarks = sizeof( benchmarks ) / sizeof( benchmarks[0] );
+
+// The distance of P from the surface of "torus 1 0.35", as used below.
+static double TorusResidual( const Vec3 &P )
+    {
+    return fabs( sqrt( sqr( sqrt( P.x * P.x + P.y * P.y ) - 1.0 ) + P.z * P.z ) - 0.35 );
+    }
+
+// The accuracy cases give the same rays to each version of an object, and
+// report how far their hits lie from the true surface.  The rays are made
+// with the first version, so the hit fractions are those it finds.
+struct micro_accuracy {
+    const char *name;
+    const char *objects[2]; // The versions compared.
+    const char *labels[2];  // The names of the versions.
+    double (*residual)( const Vec3 & );
+    };
+
+static const micro_accuracy accuracy_cases[] = {
+    { "torus_residual", { "torus 1 0.35", "torus 1 0.35 closed_form" }, { "sturm", "closed_form" }, TorusResidual }
+    };
+
+static const unsigned num_accuracy_cases = sizeof( accuracy_cases ) / sizeof( accuracy_cases[0] );
+
+// The branch instructions & misses of this thread, counted by the hardware,
+// if the operating system allows them to be read.
+struct branch_counters {
+    branch_counters();
+   ~branch_counters();
+    bool Available() const { return leader >= 0; }
+    void Start();
+    void Stop();
+    unsigned long long branches;
+    unsigned long long misses;
+    int leader; // The file descriptors of the counters, or -1.
+    int member;
+    };
+
+#ifdef __linux__
+
+static int OpenCounter( unsigned long long config, int group )
+    {
+    perf_event_attr attr;
+    memset( &attr, 0, sizeof( attr ) );
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof( attr );
+    attr.config         = config;
+    attr.disabled       = ( group < 0 );
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP;
+    return int( syscall( __NR_perf_event_open, &attr, 0, -1, group, 0 ) );
+    }
+
+branch_counters::branch_counters()
+    {
+    branches = 0;
+    misses   = 0;
+    member   = -1;
+    leader   = OpenCounter( PERF_COUNT_HW_BRANCH_INSTRUCTIONS, -1 );
+    if( leader < 0 ) return;
+    member = OpenCounter( PERF_COUNT_HW_BRANCH_MISSES, leader );
+    if( member < 0 ) { close( leader ); leader = -1; }
+    }
+
+branch_counters::~branch_counters()
+    {
+    if( member >= 0 ) close( member );
+    if( leader >= 0 ) close( leader );
+    }
+
+void branch_counters::Start()
+    {
+    if( leader < 0 ) return;
+    ioctl( leader, PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP );
+    ioctl( leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+    }
+
+void branch_counters::Stop()
+    {
+    if( leader < 0 ) return;
+    ioctl( leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP );
+    unsigned long long values[3]; // The number of counters, then their values.
+    if( read( leader, values, sizeof( values ) ) == ssize_t( sizeof( values ) ) )
+        {
+        branches = values[1];
+        misses   = values[2];
+        }
+    }
+
+#else
+
+branch_counters::branch_counters() { branches = 0; misses = 0; leader = -1; member = -1; }
+branch_counters::~branch_counters() {}
+void branch_counters::Start() {}
+void branch_counters::Stop() {}
+
+#endif
+
+static vector<string> Split( const string &list, char separator )
+    {
+    vector<string> words;
+    std::stringstream in( list );
+    string word;
+    while( std::getline( in, word, separator ) ) if( !word.empty() ) words.push_back( word );
+    return words;
+    }
+
+// Create the object of a benchmark from its sdf lines.  Several objects are
+// packed into one.  Returns NULL if any line is not understood.
+static Object *MakeObject( const char *lines )
+    {
+    vector<Object *> objects;
+    const vector<string> line( Split( lines, ';' ) );
+    for( unsigned i = 0; i < line.size(); i++ )
+        {
+        Plugin *plg = Instance_of_Plugin( line[i].c_str() );
+        if( plg == NULL || plg->PluginType() != primitive_plugin ) return NULL;
+        objects.push_back( (Object *)plg );
+        }
+    if( objects.size() > 1 ) PackPrimitives( objects );
+    return objects.size() == 1 ? objects[0] : NULL;
+    }
+
+// Does the ray hit the object (or its box), as the kernel sees it?
+static bool Hits( micro_mode mode, const micro_data &data, const Ray &ray )
+    {
+    if( mode == mode_hit || mode == mode_hit_interval ) return Hit( ray, data.box );
+    HitInfo hitinfo;
+    hitinfo.ignore   = NULL;
+    hitinfo.distance = Infinity;
+    return data.object->Intersect( ray, hitinfo );
+    }
+
+// Generate n rays of which the given fraction hit, as nearly as can be
+// found in a reasonable number of tries.  Returns the fraction that hit.
+static double MakeRays( micro_mode mode, micro_data &data, unsigned n, double fraction, bench_random &random )
+    {
+    const Vec3   center( Center( data.box ) );
+    const Vec3   half( 0.5 * ( data.box.MaxCorner() - data.box.MinCorner() ) );
+    const double radius = 4.0 * Length( half ) + 1.0;
+    const unsigned want_hits = unsigned( fraction * n + 0.5 );
+
+    vector<Ray> hits, misses;
+    hits.reserve( want_hits );
+    misses.reserve( n - want_hits );
+    for( unsigned tries = 0; tries < 50u * n && ( hits.size() < want_hits || misses.size() < n - want_hits ); tries++ )
+        {
+        Ray ray;
+        ray.origin = center + radius * Unit( random.Point( 1.0 ) );
+        const Vec3 target( random( -1.2, 1.2 ) * half.x, random( -1.2, 1.2 ) * half.y, random( -1.2, 1.2 ) * half.z );
+        ray.direction = Unit( center + target - ray.origin );
+        ray.Prepare();
+        if( Hits( mode, data, ray ) ) { if( hits.size() < want_hits ) hits.push_back( ray ); }
+        else if( misses.size() < n - want_hits ) misses.push_back( ray );
+        }
+
+    // Make up any shortfall of misses with rays that point away from the
+    // object, and of hits with copies of those that were found.
+    for( unsigned i = misses.size(); i < n - want_hits; i++ )
+        {
+        Ray ray;
+        ray.origin    = center + radius * Unit( random.Point( 1.0 ) );
+        ray.direction = Unit( ray.origin - center );
+        ray.Prepare();
+        misses.push_back( ray );
+        }
+    for( unsigned i = 0; !hits.empty() && hits.size() < want_hits; i++ ) hits.push_back( hits[i] );
+
+    // Shuffle the hits & misses together.
+    data.rays = hits;
+    data.rays.insert( data.rays.end(), misses.begin(), misses.end() );
+    for( unsigned i = data.rays.size(); i > 1; i-- ) std::swap( data.rays[i-1], data.rays[ random.Next() % i ] );
+    return data.rays.empty() ? 0.0 : double( hits.size() ) / data.rays.size();
+    }
+
+// Intersect each ray with the object, and print the largest & the RMS
+// distance of the hits from the surface.
+static void ReportResiduals( const string &name, const Object *object, const vector<Ray> &rays, double (*residual)( const Vec3 & ) )
+    {
+    double   largest = 0.0, sum = 0.0;
+    unsigned hits = 0;
+    for( unsigned i = 0; i < rays.size(); i++ )
+        {
+        HitInfo hitinfo;
+        hitinfo.ignore   = NULL;
+        hitinfo.distance = Infinity;
+        if( !object->Intersect( rays[i], hitinfo ) ) continue;
+        const double r = residual( rays[i].origin + hitinfo.distance * rays[i].direction );
+        largest = max( largest, r );
+        sum += r * r;
+        hits++;
+        }
+    cout << std::left << std::setw(34) << name << std::right << std::setw(10) << hits
+         << std::scientific << std::setprecision(2)
+         << std::setw(12) << largest
+         << std::setw(12) << ( hits > 0 ? sqrt( sum / hits ) : 0.0 ) << endl;
+    cout << std::fixed;
+    }
+
+static void MakeBatches( micro_data &data )
+    {
+    data.batches.assign( ( data.rays.size() + batch_size - 1 ) / batch_size, RayBatch() );
+    for( unsigned i = 0; i < data.rays.size(); i++ ) data.batches[ i / batch_size ].Add( data.rays[i] );
+    data.hits.resize( batch_size );
+    }
+
+static void MakeVectors( micro_data &data, bench_random &random )
+    {
+    vector<double> *arrays[] = { &data.x, &data.y, &data.z, &data.u, &data.v, &data.w };
+    for( unsigned a = 0; a < 6; a++ )
+        {
+        arrays[a]->resize( math_vectors );
+        for( unsigned i = 0; i < math_vectors; i++ ) (*arrays[a])[i] = random( -1.0, 1.0 );
+        }
+    data.M = Translate( 1, 2, 3 ) * Mat3x4( Rotate_Z( 0.3 ) * Rotate_X( 0.7 ) * Scale( 2, 2, 2 ) );
+    }
+
+struct micro_result {
+    double ns;       // The median time per test.
+    double min_ns;   // The fastest time per test.
+    double branches; // Per test, or negative if not counted.
+    double misses;
+    double value;    // Returned by the kernel.
+    };
+
+static micro_result Measure( micro_kernel kernel, const micro_data &data, unsigned repeat, branch_counters &counters )
+    {
+    micro_result result;
+    result.value = kernel( data ); // Warm up the caches & branch predictors.
+    vector<double> ns;
+    unsigned long long branches = 0, misses = 0;
+    for( unsigned r = 0; r < repeat; r++ )
+        {
+        counters.Start();
+        const micro_clock::time_point start = micro_clock::now();
+        result.value = kernel( data );
+        const double seconds = std::chrono::duration<double>( micro_clock::now() - start ).count();
+        counters.Stop();
+        ns.push_back( seconds * 1.0E9 / data.tests );
+        branches += counters.branches;
+        misses   += counters.misses;
+        }
+    std::sort( ns.begin(), ns.end() );
+    result.ns       = ns[ ns.size() / 2 ];
+    result.min_ns   = ns[0];
+    result.branches = counters.Available() ? double( branches ) / repeat / data.tests : -1.0;
+    result.misses   = counters.Available() ? double( misses   ) / repeat / data.tests : -1.0;
+    return result;
+    }
+
+int RunMicrobenchmarks( int argc, char *argv[] )
+    {
+    string args;
+    for( int i = 0; i < argc; i++ ) args += string( argv[i] ) + " ";
+    ParamReader get( args );
+
+    string   filter, hit_list, csv_name;
+    unsigned num_rays = 1000000;
+    unsigned repeat   = 5;
+    unsigned seed     = 1;
+    for(;;)
+        {
+        if( get["filter"] && get.Word( filter   ) ) continue;
+        if( get["rays"]   && get[num_rays]        ) continue;
+        if( get["hits"]   && get.Word( hit_list ) ) continue;
+        if( get["repeat"] && get[repeat]          ) continue;
+        if( get["seed"]   && get[seed]            ) continue;
+        if( get["csv"]    && get.Word( csv_name ) ) continue;
+        break;
+        }
+    string extra;
+    if( get.Word( extra ) || num_rays == 0 || repeat == 0 )
+        {
+        cerr << "Usage: toytracer micro [filter TEXT] [rays N] [hits f1,f2,...] [repeat N]\n"
+             << "                       [seed N] [csv FILE]" << endl;
+        return error_bad_arguments;
+        }
+
+    vector<double> fractions;
+    const vector<string> words( Split( hit_list.empty() ? "0,0.5,1" : hit_list, ',' ) );
+    for( unsigned i = 0; i < words.size(); i++ ) fractions.push_back( min( 1.0, max( 0.0, atof( words[i].c_str() ) ) ) );
+
+    std::ofstream csv;
+    if( !csv_name.empty() )
+        {
+        csv.open( csv_name.c_str() );
+        if( !csv )
+            {
+            cerr << "Error: Could not open file " << csv_name << " for writing." << endl;
+            return error_opening_image_file;
+            }
+        csv << "benchmark,hit_fraction,tests,ns_per_test,min_ns_per_test,mtests_per_s,branches_per_test,branch_misses_per_test" << endl;
+        }
+
+    branch_counters counters;
+    if( !counters.Available() ) cout << "(The branch counters cannot be read on this system.)" << endl;
+    cout << std::left << std::setw(34) << "Benchmark" << std::right
+         << std::setw(6)  << "hits"
+         << std::setw(10) << "ns/test"
+         << std::setw(10) << "min ns"
+         << std::setw(10) << "Mtests/s"
+         << std::setw(12) << "branches"
+         << std::setw(10) << "misses"
+         << std::setw(8)  << "miss %" << endl;
+    cout << std::fixed;
+
+    for( unsigned b = 0; b < num_benchmarks; b++ )
+        {
+        const micro_benchmark &bm = benchmarks[b];
+        if( !filter.empty() && string( bm.name ).find( filter ) == string::npos ) continue;
+
+        bench_random random( seed * 2654435761u + b );
+        micro_data data;
+        data.object = NULL;
+        if( bm.objects != NULL )
+            {
+            Object *obj = MakeObject( bm.objects );
+            if( obj == NULL )
+                {
+                cerr << "Warning: could not create the object of " << bm.name << endl;
+                continue;
+                }
+            data.object = obj;
+            data.box    = GetBox( *obj );
+            }
+
+        // The math has no rays, so it is run once, with no hit fraction.
+        const unsigned runs = bm.mode == mode_math ? 1 : fractions.size();
+        for( unsigned f = 0; f < runs; f++ )
+            {
+            double fraction = -1.0;
+            if( bm.mode == mode_math )
+                {
+                MakeVectors( data, random );
+                data.tests = max( math_vectors, num_rays / math_vectors * math_vectors );
+                }
+            else
+                {
+                fraction = MakeRays( bm.mode, data, num_rays, fractions[f], random );
+                if( bm.mode == mode_batch ) MakeBatches( data );
+                data.tests = data.rays.size();
+                }
+
+            const micro_result r( Measure( bm.kernel, data, repeat, counters ) );
+
+            std::stringstream name;
+            name << bm.name;
+            if( fraction >= 0.0 ) name << "/hits:" << fractions[f];
+            cout << std::left << std::setw(34) << name.str() << std::right << std::setprecision(2) << std::setw(6);
+            if( fraction >= 0.0 ) cout << fraction; else cout << "";
+            cout << std::setw(10) << r.ns
+                 << std::setw(10) << r.min_ns
+                 << std::setw(10) << 1.0E3 / r.ns;
+            if( r.branches >= 0.0 )
+                {
+                cout << std::setw(12) << r.branches << std::setw(10) << r.misses
+                     << std::setw(8) << ( r.branches > 0.0 ? 100.0 * r.misses / r.branches : 0.0 );
+                }
+            cout << endl;
+
+            // The intersectors return the number of rays that hit, which
+            // should agree with Intersect (or Hit) one ray at a time.
+            if( fraction >= 0.0 && r.value != floor( fraction * data.tests + 0.5 ) )
+                cout << "    note: " << r.value << " of the " << data.tests << " rays hit, not "
+                     << floor( fraction * data.tests + 0.5 ) << endl;
+
+            if( csv.is_open() )
+                {
+                csv << bm.name << ",";
+                if( fraction >= 0.0 ) csv << fraction;
+                csv << "," << data.tests << "," << r.ns << "," << r.min_ns << "," << 1.0E3 / r.ns << ",";
+                if( r.branches >= 0.0 ) csv << r.branches << "," << r.misses;
+                else csv << ",";
+                csv << endl;
+                }
+            }
+        delete data.object;
+        }
+
+    bool heading = false;
+    for( unsigned c = 0; c < num_accuracy_cases; c++ )
+        {
+        const micro_accuracy &ac = accuracy_cases[c];
+        if( !filter.empty() && string( ac.name ).find( filter ) == string::npos ) continue;
+        if( !heading )
+            {
+            cout << endl << std::left << std::setw(34) << "Accuracy" << std::right
+                 << std::setw(10) << "hits"
+                 << std::setw(12) << "max resid"
+                 << std::setw(12) << "rms resid" << endl;
+            heading = true;
+            }
+        Object *objects[2];
+        for( unsigned k = 0; k < 2; k++ ) objects[k] = MakeObject( ac.objects[k] );
+        if( objects[0] == NULL || objects[1] == NULL )
+            {
+            cerr << "Warning: could not create the objects of " << ac.name << endl;
+            delete objects[0];
+            delete objects[1];
+            continue;
+            }
+        bench_random random( seed * 2654435761u + num_benchmarks + c );
+        micro_data data;
+        data.object = objects[0];
+        data.box    = GetBox( *objects[0] );
+        for( unsigned f = 0; f < fractions.size(); f++ )
+            {
+            MakeRays( mode_intersect, data, num_rays, fractions[f], random );
+            for( unsigned k = 0; k < 2; k++ )
+                {
+                std::stringstream name;
+                name << ac.name << "/hits:" << fractions[f] << " " << ac.labels[k];
+                ReportResiduals( name.str(), objects[k], data.rays, ac.residual );
+                }
+            }
+        delete objects[0];
+        delete objects[1];
+        }
+
+    cout.unsetf( std::ios::fixed );
+    if( csv.is_open() ) cout << "Wrote " << csv_name << endl;
+    return no_errors;
+    }
@@ -0,0 +1,30 @@
+/***************************************************************************
+* microbench.h                                                             *
+*                                                                          *
+* Microbenchmarks of the hot kernels: each primitive's Intersect method,   *
+* the batched and packed intersectors, the ray-box Hit functions, and the  *
+* four-lane vector math.  Each intersector is fed a large set of rays,     *
+* generated in advance so that a chosen fraction of them hit, and the      *
+* harness reports the time per test, the throughput, and (where the        *
+* hardware counters can be read) the branch misses per test, so that a     *
+* regression in any one kernel is visible on its own.                      *
+*                                                                          *
+* The harness is run by "toytracer micro [options]"; see microbench.cpp.   *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#ifndef __MICROBENCH_INCLUDED__
+#define __MICROBENCH_INCLUDED__
+
+#include "toytracer.h"
+
+// Run the microbenchmarks, given the arguments that follow "micro" on the
+// command line.  Returns one of the error codes of main.
+extern int RunMicrobenchmarks(
+    int argc,
+    char *argv[]
+    );
+
+#endif
@@ -0,0 +1,474 @@
+/***************************************************************************
+* packed.cpp                                                               *
+*                                                                          *
+* Packed spheres and triangles.  Each packed object holds up to four       *
+* primitives of one type in structure-of-arrays form, and intersects a     *
+* ray with all of them at once.  Spheres use the same quadratic as the     *
+* sphere object.  Triangles are packed with others of the same kernel:     *
+* "edges" triangles use the Moller-Trumbore test with the edge vectors     *
+* precomputed, and watertight ones the watertight test, with every step    *
+* rounded to single precision exactly as in triangle.cpp, so that a ray    *
+* hits the same triangles whether or not they are packed.  Unused lanes    *
+* never report a hit.                                                      *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Packs watertight triangles, with the same watertight test. *
+*   10/18/2026  Added PackedObjects.                                       *
+*   10/18/2026  Kernels are written in terms of Vec3x4.                    *
+*   10/18/2026  Hits are finalized by the original objects.                *
+*   10/18/2026  Packed triangles return barycentric coords in uv.          *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include "packed.h"
+#include "vec3x4.h"
+#include "util.h"
+#include <algorithm>
+
+static const unsigned lanes = 4;
+
+// Each lane in use counts as a test of the original primitive.
+DEFINE_PRIMITIVE_STAT( sphere_tests, "sphere" );
+DEFINE_PRIMITIVE_STAT( triangle_tests, "triangle" );
+
+// Return the nearest of the lanes whose bits are set.
+static inline unsigned Nearest( int bits, const double *s )
+    {
+    unsigned best = lanes;
+    for( unsigned i = 0; i < lanes; i++ )
+        {
+        if( ( bits & ( 1 << i ) ) && ( best == lanes || s[i] < s[best] ) ) best = i;
+        }
+    return best;
+    }
+
+// The bits of the lanes holding the object to be ignored, if any.
+static inline int Ignored( const Object * const *prim, const Object *ignore )
+    {
+    int bits = 0;
+    if( ignore != NULL )
+        {
+        for( unsigned i = 0; i < lanes; i++ ) if( prim[i] == ignore ) bits |= 1 << i;
+        }
+    return bits;
+    }
+
+struct PackedSpheres : public Primitive {
+    PackedSpheres();
+    virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual bool Inside( const Vec3 & ) const;
+    virtual Interval GetSlab( const Vec3 & ) const;
+    virtual Plugin *ReadString( const string & ) { return NULL; }
+    virtual string MyName() const { return "packed spheres"; }
+    virtual double Cost() const { return 1.5; }
+    void Add( const Object *obj, const Vec3 &center, double radius );
+    double cx[lanes], cy[lanes], cz[lanes]; // Centers.
+    double r2[lanes];                        // Squared radii.
+    double radius[lanes];
+    const Object *prim[lanes];               // The original sphere objects.
+    unsigned count;                          // Number of lanes in use.
+    };
+
+PackedSpheres::PackedSpheres()
+    {
+    count = 0;
+    for( unsigned i = 0; i < lanes; i++ )
+        {
+        cx[i] = cy[i] = cz[i] = 0.0;
+        r2[i] = radius[i] = 0.0;
+        prim[i] = NULL;
+        }
+    }
+
+void PackedSpheres::Add( const Object *obj, const Vec3 &center, double r )
+    {
+    cx[count] = center.x;
+    cy[count] = center.y;
+    cz[count] = center.z;
+    r2[count] = r * r;
+    radius[count] = r;
+    prim[count] = obj;
+    count++;
+    }
+
+bool PackedSpheres::Intersect( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    STAT_PRIMITIVE_TESTS( sphere_tests, count );
+    const Vec3x4  A( Vec3x4( ray.origin ) - Vec3x4::Load( cx, cy, cz ) );
+    const Vec3x4  R( ray.direction );
+    const Double4 zero( 0.0 );
+
+    // Half the linear coefficient, and the discriminant over four.
+    const Double4 b( A * R );
+    const Double4 discr( b * b - ( A * A - Double4::Load( r2 ) ) );
+    const Double4 radical( sqrt( max( discr, zero ) ) );
+
+    // Take the smaller root if it is in front of the origin, otherwise the larger.
+    const Double4 s0( zero - b - radical );
+    const Double4 s1( zero - b + radical );
+    const Double4 s ( Select( s0 > zero, s0, s1 ) );
+    const Double4 hit( ( discr >= zero ) & ( s > zero ) & ( s <= Double4( hitinfo.distance ) ) );
+
+    int bits = Bits( hit ) & ( ( 1 << count ) - 1 ) & ~Ignored( prim, hitinfo.ignore );
+    if( bits == 0 ) return false;
+
+    double dist[lanes];
+    s.Store( dist );
+    const unsigned i = Nearest( bits, dist );
+    hitinfo.distance = dist[i];
+    hitinfo.object   = prim[i];
+    return true;
+    }
+
+bool PackedSpheres::Inside( const Vec3 &P ) const
+    {
+    for( unsigned i = 0; i < count; i++ )
+        if( prim[i]->Inside( P ) ) return true;
+    return false;
+    }
+
+Interval PackedSpheres::GetSlab( const Vec3 &v ) const
+    {
+    Interval I = Interval::Null();
+    for( unsigned i = 0; i < count; i++ ) I << prim[i]->GetSlab( v );
+    return I;
+    }
+
+struct PackedTriangles : public Primitive {
+    PackedTriangles();
+    virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual bool Inside( const Vec3 & ) const { return false; }
+    virtual Interval GetSlab( const Vec3 & ) const;
+    virtual Plugin *ReadString( const string & ) { return NULL; }
+    virtual string MyName() const { return "packed triangles"; }
+    virtual double Cost() const { return 1.5; }
+    void Add( const Object *obj, const Vec3 &A, const Vec3 &B, const Vec3 &C );
+    double ax[lanes], ay[lanes], az[lanes]; // First vertex.
+    double ux[lanes], uy[lanes], uz[lanes]; // Edge from the first to the second vertex.
+    double vx[lanes], vy[lanes], vz[lanes]; // Edge from the first to the third vertex.
+    const Object *prim[lanes];               // The original triangle objects.
+    unsigned count;                          // Number of lanes in use.
+    };
+
+PackedTriangles::PackedTriangles()
+    {
+    count = 0;
+    for( unsigned i = 0; i < lanes; i++ )
+        {
+        ax[i] = ay[i] = az[i] = 0.0;
+        ux[i] = uy[i] = uz[i] = 0.0;
+        vx[i] = vy[i] = vz[i] = 0.0;
+        prim[i] = NULL;
+        }
+    }
+
+void PackedTriangles::Add( const Object *obj, const Vec3 &A, const Vec3 &B, const Vec3 &C )
+    {
+    const Vec3 U( B - A );
+    const Vec3 V( C - A );
+    ax[count] = A.x; ay[count] = A.y; az[count] = A.z;
+    ux[count] = U.x; uy[count] = U.y; uz[count] = U.z;
+    vx[count] = V.x; vy[count] = V.y; vz[count] = V.z;
+    prim[count] = obj;
+    count++;
+    }
+
+// The Moller-Trumbore test, four triangles at a time.  The barycentric coords
+// (b1,b2) and distance s are found by Cramer's rule, sharing the cross products
+// P = R x V and Q = T x U between the three determinants.
+bool PackedTriangles::Intersect( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    STAT_PRIMITIVE_TESTS( triangle_tests, count );
+    const Vec3x4  R( ray.direction );
+    const Vec3x4  U( Vec3x4::Load( ux, uy, uz ) );
+    const Vec3x4  V( Vec3x4::Load( vx, vy, vz ) );
+    const Double4 zero( 0.0 ), one( 1.0 );
+
+    const Vec3x4  P( R ^ V );
+    const Double4 det( U * P );
+    const Double4 inv( one / det ); // Infinite or NaN for parallel rays; these fail all tests below.
+
+    const Vec3x4  T( Vec3x4( ray.origin ) - Vec3x4::Load( ax, ay, az ) );
+    const Double4 b1( ( T * P ) * inv );
+
+    const Vec3x4  Q( T ^ U );
+    const Double4 b2( ( R * Q ) * inv );
+    const Double4 s ( ( V * Q ) * inv );
+
+    const Double4 hit( ( b1 >= zero ) & ( b2 >= zero ) & ( b1 + b2 <= one ) &
+                       ( s > zero ) & ( s <= Double4( hitinfo.distance ) ) );
+
+    int bits = Bits( hit ) & ( ( 1 << count ) - 1 ) & ~Ignored( prim, hitinfo.ignore );
+    if( bits == 0 ) return false;
+
+    double dist[lanes], u[lanes], v[lanes];
+    s .Store( dist );
+    b1.Store( u );
+    b2.Store( v );
+    const unsigned i = Nearest( bits, dist );
+    hitinfo.distance = dist[i];
+    hitinfo.uv       = Vec2( u[i], v[i] );
+    hitinfo.object   = prim[i];
+    return true;
+    }
+
+Interval PackedTriangles::GetSlab( const Vec3 &v ) const
+    {
+    Interval I = Interval::Null();
+    for( unsigned i = 0; i < count; i++ ) I << prim[i]->GetSlab( v );
+    return I;
+    }
+
+struct PackedWatertight : public Primitive {
+    PackedWatertight();
+    virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual bool Inside( const Vec3 & ) const { return false; }
+    virtual Interval GetSlab( const Vec3 & ) const;
+    virtual Plugin *ReadString( const string & ) { return NULL; }
+    virtual string MyName() const { return "packed watertight triangles"; }
+    virtual double Cost() const { return 1.5; }
+    void Add( const Object *obj, const Vec3 &A, const Vec3 &B, const Vec3 &C, const Vec3 &N );
+    double v[3][3][lanes];     // Coordinate a of vertex i of each lane is v[i][a].
+    double n[3][lanes];        // Unit normal.
+    const Object *prim[lanes]; // The original triangle objects.
+    unsigned count;            // Number of lanes in use.
+    };
+
+PackedWatertight::PackedWatertight()
+    {
+    count = 0;
+    for( unsigned i = 0; i < lanes; i++ )
+        {
+        for( int k = 0; k < 3; k++ ) v[k][0][i] = v[k][1][i] = v[k][2][i] = n[k][i] = 0.0;
+        prim[i] = NULL;
+        }
+    }
+
+void PackedWatertight::Add( const Object *obj, const Vec3 &A, const Vec3 &B, const Vec3 &C, const Vec3 &N )
+    {
+    const Vec3 *P[] = { &A, &B, &C };
+    for( int k = 0; k < 3; k++ )
+        {
+        v[k][0][count] = P[k]->x;
+        v[k][1][count] = P[k]->y;
+        v[k][2][count] = P[k]->z;
+        }
+    n[0][count] = N.x;
+    n[1][count] = N.y;
+    n[2][count] = N.z;
+    prim[count] = obj;
+    count++;
+    }
+
+// Round to the precision of "real", in which the arithmetic on the
+// coordinates of rays is done.
+static inline Double4 Real( const Double4 &a )
+    {
+#ifdef TOYTRACER_SINGLE_PRECISION
+    return Single( a );
+#else
+    return a;
+#endif
+    }
+
+// The watertight test of triangle.cpp, four triangles at a time.  The lanes
+// hold the floats of the triangles in double precision, and every operation
+// that the original performs in single precision is rounded by Single, which
+// makes each lane's result exactly that of the original, including the plane
+// test that precedes it and the exact recomputation of an edge function that
+// is zero.  Rays hitting a shared edge therefore still hit one of the
+// triangles, whether or not the triangles are packed.
+bool PackedWatertight::Intersect( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    STAT_PRIMITIVE_TESTS( triangle_tests, count );
+    const Double4 zero( 0.0 );
+    const Double4 max_dist( hitinfo.distance );
+    int bits = ( ( 1 << count ) - 1 ) & ~Ignored( prim, hitinfo.ignore );
+
+    // Reject the triangles behind the origin or beyond the closest hit, using
+    // their planes alone, as Triangle::Intersect does.
+    const Double4 nx( Double4::Load( n[0] ) ), ny( Double4::Load( n[1] ) ), nz( Double4::Load( n[2] ) );
+    const Double4 num( Real( Real( Real( nx * Real( Double4::Load( v[0][0] ) - Double4( ray.origin.x ) ) )
+                                 + Real( ny * Real( Double4::Load( v[0][1] ) - Double4( ray.origin.y ) ) ) )
+                                 + Real( nz * Real( Double4::Load( v[0][2] ) - Double4( ray.origin.z ) ) ) ) );
+    const Double4 den( Real( Real( Real( nx * Double4( ray.direction.x ) ) + Real( ny * Double4( ray.direction.y ) ) )
+                                 + Real( nz * Double4( ray.direction.z ) ) ) );
+    bits &= ~Bits( ( Real( num * den ) <= zero ) | ( abs( num ) > max_dist * abs( den ) ) );
+    if( bits == 0 ) return false;
+
+    // Translate & shear the vertices.
+    const int kx = ray.shear_axis[0];
+    const int ky = ray.shear_axis[1];
+    const int kz = ray.shear_axis[2];
+    const Double4 Sx( ray.shear[0] ), Sy( ray.shear[1] ), Sz( ray.shear[2] );
+    const Double4 O[] = { Single( Double4( ray.origin.x ) ), Single( Double4( ray.origin.y ) ), Single( Double4( ray.origin.z ) ) };
+    Double4 x[3], y[3], z[3];
+    for( int i = 0; i < 3; i++ )
+        {
+        const Double4 dz( Single( Double4::Load( v[i][kz] ) - O[kz] ) );
+        x[i] = Single( Single( Double4::Load( v[i][kx] ) - O[kx] ) - Single( Sx * dz ) );
+        y[i] = Single( Single( Double4::Load( v[i][ky] ) - O[ky] ) - Single( Sy * dz ) );
+        z[i] = Single( Sz * dz );
+        }
+
+    // The barycentric coordinates, scaled by det, are the 2D edge functions.
+    // Where one is zero, all three are recomputed with the products exact.
+    Double4 bA( Single( Single( x[2] * y[1] ) - Single( y[2] * x[1] ) ) );
+    Double4 bB( Single( Single( x[0] * y[2] ) - Single( y[0] * x[2] ) ) );
+    Double4 bC( Single( Single( x[1] * y[0] ) - Single( y[1] * x[0] ) ) );
+    const Double4 redo( ( bA == zero ) | ( bB == zero ) | ( bC == zero ) );
+    if( Bits( redo ) & bits )
+        {
+        bA = Select( redo, Single( x[2] * y[1] - y[2] * x[1] ), bA );
+        bB = Select( redo, Single( x[0] * y[2] - y[0] * x[2] ), bB );
+        bC = Select( redo, Single( x[1] * y[0] - y[1] * x[0] ), bC );
+        }
+    const Double4 outside( ( ( bA < zero ) | ( bB < zero ) | ( bC < zero ) ) &
+                           ( ( bA > zero ) | ( bB > zero ) | ( bC > zero ) ) );
+
+    // The distance, scaled by det, must lie within (0, hitinfo.distance].
+    const Double4 det ( Single( Single( bA + bB ) + bC ) );
+    const Double4 dist( Single( Single( Single( bA * z[0] ) + Single( bB * z[1] ) ) + Single( bC * z[2] ) ) );
+    const Double4 sign( Select( det < zero, Double4( -1.0 ), Double4( 1.0 ) ) );
+    bits &= ~Bits( outside | ( det == zero ) | ( sign * dist <= zero ) | ( sign * dist > max_dist * ( sign * det ) ) );
+    if( bits == 0 ) return false;
+
+    const Double4 inv( Double4( 1.0 ) / det );
+    double s[lanes], u[lanes], w[lanes];
+    ( dist * inv ).Store( s );
+    ( bB   * inv ).Store( u );
+    ( bC   * inv ).Store( w );
+    const unsigned i = Nearest( bits, s );
+    hitinfo.distance = s[i];
+    hitinfo.uv       = Vec2( u[i], w[i] );
+    hitinfo.object   = prim[i];
+    return true;
+    }
+
+Interval PackedWatertight::GetSlab( const Vec3 &v ) const
+    {
+    Interval I = Interval::Null();
+    for( unsigned i = 0; i < count; i++ ) I << prim[i]->GetSlab( v );
+    return I;
+    }
+
+// Spread the low ten bits of x out so that there are two zero bits between each.
+static unsigned Spread( unsigned x )
+    {
+    x &= 0x3FF;
+    x = ( x | ( x << 16 ) ) & 0x030000FF;
+    x = ( x | ( x <<  8 ) ) & 0x0300F00F;
+    x = ( x | ( x <<  4 ) ) & 0x030C30C3;
+    x = ( x | ( x <<  2 ) ) & 0x09249249;
+    return x;
+    }
+
+struct packable {
+    Object  *obj;
+    unsigned code; // Morton code of the center, used to keep nearby primitives together.
+    Vec3     center;
+    double   radius;
+    Vec3     A, B, C, N;
+    bool     watertight;
+    bool operator<( const packable &p ) const { return code < p.code; }
+    };
+
+static void MortonCodes( vector<packable> &prims, const AABB &box )
+    {
+    const Vec3 lo( box.MinCorner() );
+    const Vec3 size( box.MaxCorner() - box.MinCorner() );
+    for( unsigned i = 0; i < prims.size(); i++ )
+        {
+        const Vec3 P( Center( GetBox( *prims[i].obj ) ) );
+        const unsigned x = size.x > 0.0 ? unsigned( 1023.0 * ( P.x - lo.x ) / size.x ) : 0;
+        const unsigned y = size.y > 0.0 ? unsigned( 1023.0 * ( P.y - lo.y ) / size.y ) : 0;
+        const unsigned z = size.z > 0.0 ? unsigned( 1023.0 * ( P.z - lo.z ) / size.z ) : 0;
+        prims[i].code = Spread( x ) | ( Spread( y ) << 1 ) | ( Spread( z ) << 2 );
+        }
+    std::sort( prims.begin(), prims.end() );
+    }
+
+// Copy the fields that the original object carries to the packed object.
+static void Inherit( Object *packed, const Object *obj )
+    {
+    packed->material = obj->material;
+    packed->shader   = obj->shader;
+    packed->envmap   = obj->envmap;
+    packed->parent   = obj->parent;
+    }
+
+void PackPrimitives( vector<Object*> &objects )
+    {
+    vector<packable> spheres;
+    vector<packable> triangles;  // Using the "edges" kernel.
+    vector<packable> watertight;
+    vector<Object*>  others;
+    AABB box( AABB::Null() );
+    for( unsigned i = 0; i < objects.size(); i++ )
+        {
+        packable p;
+        p.obj = objects[i];
+        if( SphereGeometry( p.obj, p.center, p.radius ) ) spheres.push_back( p );
+        else if( TriangleGeometry( p.obj, p.A, p.B, p.C, p.N, p.watertight ) )
+            ( p.watertight ? watertight : triangles ).push_back( p );
+        else { others.push_back( p.obj ); continue; }
+        box << GetBox( *p.obj );
+        }
+    MortonCodes( spheres  , box );
+    MortonCodes( triangles, box );
+    MortonCodes( watertight, box );
+
+    // Pack consecutive runs of four.  A lone primitive at the end of a run is
+    // left as it is, since packing it would gain nothing.
+    objects = others;
+    for( unsigned i = 0; i < spheres.size(); i += lanes )
+        {
+        const unsigned n = min( lanes, spheres.size() - i );
+        if( n == 1 ) { objects.push_back( spheres[i].obj ); continue; }
+        PackedSpheres *pack = new PackedSpheres;
+        for( unsigned k = i; k < i + n; k++ ) pack->Add( spheres[k].obj, spheres[k].center, spheres[k].radius );
+        Inherit( pack, spheres[i].obj );
+        objects.push_back( pack );
+        }
+    for( unsigned i = 0; i < triangles.size(); i += lanes )
+        {
+        const unsigned n = min( lanes, triangles.size() - i );
+        if( n == 1 ) { objects.push_back( triangles[i].obj ); continue; }
+        PackedTriangles *pack = new PackedTriangles;
+        for( unsigned k = i; k < i + n; k++ ) pack->Add( triangles[k].obj, triangles[k].A, triangles[k].B, triangles[k].C );
+        Inherit( pack, triangles[i].obj );
+        objects.push_back( pack );
+        }
+    for( unsigned i = 0; i < watertight.size(); i += lanes )
+        {
+        const unsigned n = min( lanes, watertight.size() - i );
+        if( n == 1 ) { objects.push_back( watertight[i].obj ); continue; }
+        PackedWatertight *pack = new PackedWatertight;
+        for( unsigned k = i; k < i + n; k++ ) pack->Add( watertight[k].obj, watertight[k].A, watertight[k].B, watertight[k].C, watertight[k].N );
+        Inherit( pack, watertight[i].obj );
+        objects.push_back( pack );
+        }
+    }
+
+unsigned PackedObjects( const Object *obj, const Object *prims[4] )
+    {
+    const PackedSpheres *S = dynamic_cast<const PackedSpheres *>( obj );
+    if( S != NULL )
+        {
+        for( unsigned i = 0; i < S->count; i++ ) prims[i] = S->prim[i];
+        return S->count;
+        }
+    const PackedTriangles *T = dynamic_cast<const PackedTriangles *>( obj );
+    if( T != NULL )
+        {
+        for( unsigned i = 0; i < T->count; i++ ) prims[i] = T->prim[i];
+        return T->count;
+        }
+    const PackedWatertight *W = dynamic_cast<const PackedWatertight *>( obj );
+    if( W != NULL )
+        {
+        for( unsigned i = 0; i < W->count; i++ ) prims[i] = W->prim[i];
+        return W->count;
+        }
+    return 0;
+    }
@@ -0,0 +1,59 @@
+/***************************************************************************
+* packed.h                                                                 *
+*                                                                          *
+* Packed primitives gather up to four spheres or four triangles into a     *
+* single object whose geometry is stored in structure-of-arrays form, so   *
+* that a ray can be tested against all four at once using SIMD             *
+* instructions (see simd.h).  A packed object is not a plugin; it is       *
+* created by aggregates from their children when they are closed.  When a  *
+* ray hits one of the lanes, the HitInfo reports the original object, so   *
+* shaders, materials, and lights are unaffected by the packing.            *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Triangles of both kernels are packed, each with its own.   *
+*   10/18/2026  Only triangles using the "edges" kernel are packed.        *
+*   10/18/2026  Added PackedObjects, so packed scenes can be freed.        *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#ifndef __PACKED_INCLUDED__
+#define __PACKED_INCLUDED__
+
+#include "toytracer.h"
+
+// Replace the spheres and triangles in the list of objects with packed
+// objects holding up to four of them each.  Primitives that are close
+// together are packed together.  All other objects are left as they are.
+extern void PackPrimitives(
+    vector<Object*> &objects
+    );
+
+// Fill in the original primitives held by a packed object, and return their
+// number.  Returns zero if the object is not a packed object.
+extern unsigned PackedObjects(
+    const Object *obj,
+    const Object *prims[4]
+    );
+
+// These are supplied by the sphere and triangle modules so that the geometry
+// of those objects can be packed.  Each returns false if the object is not of
+// the corresponding type.  Triangles also report their unit normal and
+// whether they use the watertight kernel, as they are packed only with
+// others of the same kernel, and tested exactly as they would be alone.
+
+extern bool SphereGeometry(
+    const Object *obj,
+    Vec3   &center,
+    double &radius
+    );
+
+extern bool TriangleGeometry(
+    const Object *obj,
+    Vec3 &A,
+    Vec3 &B,
+    Vec3 &C,
+    Vec3 &N,
+    bool &watertight
+    );
+
+#endif
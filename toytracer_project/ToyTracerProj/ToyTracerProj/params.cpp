@@ -11,6 +11,9 @@
 * returned as the function value.                                          *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  A number at the end of the string is removed, too.         *
+*   10/18/2026  Values are read as doubles in either precision.            *
+*   10/18/2026  Added Word, for reading names.                             *
 *   10/04/2005  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -34,8 +37,10 @@ bool ParamReader::operator[]( string field )
 
 bool ParamReader::operator[]( Color &c )
     {
-    if( sscanf( params.c_str(), " [ %lf , %lf , %lf ]", &c.red, &c.green, &c.blue ) == 3 )
+    double r, g, b;
+    if( sscanf( params.c_str(), " [ %lf , %lf , %lf ]", &r, &g, &b ) == 3 )
         {
+        c = Color( r, g, b );
         int len = 1 + params.find( "]", 0 );
         params.erase( 0, len );
         return true;
@@ -45,8 +50,10 @@ bool ParamReader::operator[]( Color &c )
 
 bool ParamReader::operator[]( Vec3 &v )
     {
-    if( sscanf( params.c_str(), " ( %lf , %lf , %lf )", &v.x, &v.y, &v.z ) == 3 )
+    double x, y, z;
+    if( sscanf( params.c_str(), " ( %lf , %lf , %lf )", &x, &y, &z ) == 3 )
         {
+        v = Vec3( x, y, z );
         int len = 1 + params.find( ")", 0 );
         params.erase( 0, len );
         return true;
@@ -56,8 +63,10 @@ bool ParamReader::operator[]( Vec3 &v )
 
 bool ParamReader::operator[]( Vec2 &v )
     {
-    if( sscanf( params.c_str(), " ( %lf , %lf )", &v.x, &v.y ) == 2 )
+    double x, y;
+    if( sscanf( params.c_str(), " ( %lf , %lf )", &x, &y ) == 2 )
         {
+        v = Vec2( x, y );
         int len = 1 + params.find( ")", 0 );
         params.erase( 0, len );
         return true;
@@ -67,8 +76,10 @@ bool ParamReader::operator[]( Vec2 &v )
 
 bool ParamReader::operator[]( Interval &I )
     {
-    if( sscanf( params.c_str(), " ( %lf , %lf )", &I.min, &I.max ) == 2 )
+    double a, b;
+    if( sscanf( params.c_str(), " ( %lf , %lf )", &a, &b ) == 2 )
         {
+        I = Interval( a, b );
         int len = 1 + params.find( ")", 0 );
         params.erase( 0, len );
         return true;
@@ -81,8 +92,7 @@ bool ParamReader::operator[]( double &x )
     SkipBlanks();
     if( sscanf( params.c_str(), "%lf", &x ) == 1 )
         {
-        int len = 1 + params.find( " ", 0 );
-        if( len > 1 ) params.erase( 0, len );
+        params.erase( 0, params.find_first_of( " \t\r\n" ) ); // To the end, if nothing follows.
         return true;
         }
     return false;
@@ -93,8 +103,7 @@ bool ParamReader::operator[]( unsigned &x )
     SkipBlanks();
     if( sscanf( params.c_str(), "%u", &x ) == 1 )
         {
-        int len = 1 + params.find( " ", 0 );
-        if( len > 1 ) params.erase( 0, len );
+        params.erase( 0, params.find_first_of( " \t\r\n" ) ); // To the end, if nothing follows.
         return true;
         }
     return false;
@@ -103,15 +112,19 @@ bool ParamReader::operator[]( unsigned &x )
 bool ParamReader::operator[]( Mat3x4 &M )
     {
     // Read the given string followed by a 3x4 matrix, in row order, enclosed in parens.
+    double m[3][4];
     int count = sscanf(
         params.c_str(),
         " ( %lf , %lf , %lf , %lf ; %lf , %lf , %lf , %lf ; %lf , %lf , %lf , %lf ) ",
-        &M.mat(0,0), &M.mat(0,1), &M.mat(0,2), &M.vec.x, 
-        &M.mat(1,0), &M.mat(1,1), &M.mat(1,2), &M.vec.y,
-        &M.mat(2,0), &M.mat(2,1), &M.mat(2,2), &M.vec.z
+        &m[0][0], &m[0][1], &m[0][2], &m[0][3], 
+        &m[1][0], &m[1][1], &m[1][2], &m[1][3],
+        &m[2][0], &m[2][1], &m[2][2], &m[2][3]
         );
     if( count == 12 )
         {
+        for( int i = 0; i < 3; i++ )
+        for( int j = 0; j < 3; j++ ) M.mat(i,j) = m[i][j];
+        M.vec = Vec3( m[0][3], m[1][3], m[2][3] );
         int len = 1 + params.find( ")", 0 );
         params.erase( 0, len );
         return true;
@@ -119,3 +132,14 @@ bool ParamReader::operator[]( Mat3x4 &M )
     return false;
     }
 
+
+bool ParamReader::Word( string &word )
+    {
+    // Read a single word, such as a name, which ends at the first blank.
+    SkipBlanks();
+    const size_t len = params.find_first_of( " \t\r\n" );
+    word = params.substr( 0, len );
+    if( word.empty() ) return false;
+    params.erase( 0, word.length() );
+    return true;
+    }
@@ -4,6 +4,7 @@
 * A tool for reading parameter strings from sdf files.                     *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Added Word, for reading names.                             *
 *   10/04/2005  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -27,6 +28,7 @@ class ParamReader {
         bool operator[]( unsigned & );
         bool operator[]( Interval & ); 
         bool operator[]( Mat3x4   & );
+        bool Word( string & ); // Strips off the next run of non-blank characters.
     private:
         void SkipBlanks();
         string params;
@@ -7,6 +7,7 @@
 * image.                                                                   *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Read frees the old pixels with delete[].                   *
 *   10/21/2005  File i/o now based on ofstream.                            *
 *   04/01/2003  Initial coding.                                            *
 *                                                                          *
@@ -65,7 +66,7 @@ bool PPM_Image::Read( string file_name )
     if( type  != "P6" ) return false;
     if( depth !=  255 ) return false;
 
-    delete pixels;
+    delete[] pixels;
     pixels = new Pixel[ width * height ];
     Pixel *p = pixels;
 
@@ -5,6 +5,7 @@
 * simple flat quad with no normal vector interpolation.                    *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Point & normal are now filled in by FinalizeHit.           *
 *   10/23/2004  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -16,6 +17,7 @@ struct Quad : public Primitive {
     Quad() {}
     Quad( const Vec3 &A, const Vec3 &B, const Vec3 &C, const Vec3 &D );
     virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual void FinalizeHit( const Ray &ray, HitInfo & ) const;
     virtual bool Inside( const Vec3 & ) const { return false; }
     virtual Interval GetSlab( const Vec3 & ) const;
     virtual int GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const;
@@ -29,6 +31,7 @@ struct Quad : public Primitive {
     };
 
 REGISTER_PLUGIN( Quad );
+DEFINE_PRIMITIVE_STAT( tests, "quad" );
 
 Plugin *Quad::ReadString( const string &params ) // Read params from string.
     {
@@ -77,6 +80,7 @@ Interval Quad::GetSlab( const Vec3 &v ) const
 
 bool Quad::Intersect( const Ray &ray, HitInfo &hitinfo ) const
     {
+    STAT_PRIMITIVE_TEST( tests );
     // Compute the point of intersection with the plane containing the quad.
     // Report a miss if the ray does not hit this plane.
 
@@ -94,16 +98,21 @@ bool Quad::Intersect( const Ray &ray, HitInfo &hitinfo ) const
     if( (( P - C ) ^ Ecd) * N < 0.0 ) return false;
     if( (( P - D ) ^ Eda) * N < 0.0 ) return false;
 
-    // We have an actual hit.  Fill in all the geometric information so
-    // that the shader can shade this point.
+    // We have an actual hit.  The point and normal are filled in later by
+    // FinalizeHit, if this turns out to be the closest hit.
 
     hitinfo.distance = s;
-    hitinfo.point    = P; 
-    hitinfo.normal   = N;
     hitinfo.object   = this;
     return true;
     }
 
+// Fill in all the geometric information so that the shader can shade this point.
+void Quad::FinalizeHit( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    hitinfo.point  = ray.origin + hitinfo.distance * ray.direction;
+    hitinfo.normal = N;
+    }
+
 // This function generates nxn stratified samples over the surface of the quad.
 // The weight of each sample is the quad area / n^2, times the area-to-solid-angle
 // conversion factor of cos(theta)/r^2, where theta is the incident angle on the
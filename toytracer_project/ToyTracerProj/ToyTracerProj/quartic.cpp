@@ -9,10 +9,13 @@
 * Mathematical Monthly, Vol. 48, 327-328, 1941.                            *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Added SolveQuartics, a batched SIMD solver.                *
+*   10/18/2026  Added SmallestRoot, based on Sturm sequences.              *
 *   10/11/2005  Rewritten, starting from the 2004 C-code by Raoul Rausch.  *
 *                                                                          *
 ***************************************************************************/
 #include "quartic.h"
+#include "simd.h"
 #include "util.h"
 
 static const double
@@ -186,20 +189,330 @@ int SolveQuartic( double a0, double a1, double a2, double a3, double a4, roots &
     return R.num;
     }
 
+// The remaining functions solve quartics four at a time, one per lane of a
+// Double4.  Wherever the scalar solver branches, both alternatives are computed
+// for all lanes and the appropriate one is selected for each.  Cube roots and
+// the cosine of a third of an arc-cosine (the two transcendental functions
+// the closed-form solution needs) are computed by iteration, as there are no
+// SIMD versions of the standard functions.  All loops continue only until
+// every lane has converged.
 
+static const int max_polish = 20;
 
+static inline bool Converged( const Double4 &x, const Double4 &dx, const Double4 &done )
+    {
+    return Bits( done | ( abs( dx ) <= Double4( 1.0e-15 ) * abs( x ) ) ) == 0xF;
+    }
 
+// The real cube root of each lane, by Halley's method.  The starting point,
+// |z|^(3/8), is within a factor of |z|^(1/24) of the root, and each step
+// at least halves the error.
+static Double4 Cbrt( const Double4 &z )
+    {
+    const Double4 zero( 0.0 ), two( 2.0 );
+    const Double4 Z( abs( z ) );
+    const Double4 root4( sqrt( sqrt( Z ) ) );
+    const Double4 done( Z == zero );
+    Double4 y( sqrt( root4 * root4 * root4 ) );
+    for( int i = 0; i < max_polish; i++ )
+        {
+        const Double4 y3( y * y * y );
+        const Double4 dy( Select( done, zero, y * ( Z - y3 ) / ( two * y3 + Z ) ) );
+        y = y + dy;
+        if( Converged( y, dy, done ) ) break;
+        }
+    return Select( z < zero, zero - y, y );
+    }
 
+// The cosine of one third of the arc-cosine of each lane, which must lie
+// within [-1,1].  This is the largest root of 4c^3 - 3c - x = 0, to which
+// Newton's method converges monotonically from the starting point.
+static Double4 CosAcos3( const Double4 &x )
+    {
+    const Double4 one( 1.0 ), three( 3.0 ), four( 4.0 ), twelve( 12.0 ), zero( 0.0 );
+    const Double4 done( x <= Double4( -1.0 ) );
+    Double4 c( Double4( 0.5 ) + sqrt( max( one + x, zero ) * Double4( 1.0 / 6.0 ) ) );
+    for( int i = 0; i < max_polish; i++ )
+        {
+        const Double4 dc( Select( done, zero, ( x - c * ( four * c * c - three ) ) / ( twelve * c * c - three ) ) );
+        c = c + dc;
+        if( Converged( c, dc, done ) ) break;
+        }
+    return c;
+    }
 
+// Solve four quartics, following SolveQuartic exactly: the largest root of the
+// resolvent cubic leads to the roots of the quartic.
+static void SolveQuartic4( const double *a[], double *r[] )
+    {
+    const Double4 zero( 0.0 ), one( 1.0 ), two( 2.0 ), four( 4.0 ), half( 0.5 );
 
+    // Make the quartic monic, then depress it: x = y + sh gives y^4 + p y^2 + q y + r.
+    const Double4 inv( one / Double4::Load( a[4] ) );
+    const Double4 b3( Double4::Load( a[3] ) * inv );
+    const Double4 b2( Double4::Load( a[2] ) * inv );
+    const Double4 b1( Double4::Load( a[1] ) * inv );
+    const Double4 b0( Double4::Load( a[0] ) * inv );
+    const Double4 b3_2( b3 * b3 );
+    const Double4 p( b2 - Double4( 3.0 / 8.0 ) * b3_2 );
+    const Double4 q( b1 - half * b3 * b2 + Double4( 1.0 / 8.0 ) * b3_2 * b3 );
+    const Double4 rr( b0 - Double4( 0.25 ) * b3 * b1 + Double4( 1.0 / 16.0 ) * b3_2 * b2 - Double4( 3.0 / 256.0 ) * b3_2 * b3_2 );
+    const Double4 sh( zero - Double4( 0.25 ) * b3 );
 
+    // The resolvent cubic, m^3 + A m^2 + B m + C, depressed by m = t - A/3 to
+    // give t^3 + P t + Q, whose discriminant determines whether the largest root
+    // is given by the trigonometric form or by Cardano's formula.
+    const Double4 A( Double4( -0.5 ) * p );
+    const Double4 B( zero - rr );
+    const Double4 C( Double4( 0.125 ) * ( four * p * rr - q * q ) );
+    const Double4 P( B - A * A * Double4( 1.0 / 3.0 ) );
+    const Double4 Q( Double4( 2.0 / 27.0 ) * A * A * A - A * B * Double4( 1.0 / 3.0 ) + C );
+    const Double4 P3( P * Double4( 1.0 / 3.0 ) );
+    const Double4 Q2( Q * half );
+    const Double4 dis( Q2 * Q2 + P3 * P3 * P3 );
 
+    // Either form is skipped entirely when no lane needs it.
+    const Double4 three_real( dis < zero );
+    const int lanes = Bits( three_real );
+    Double4 t( zero );
+    if( lanes != 0 )
+        {
+        const Double4 rad( sqrt( max( zero - P3, zero ) ) );
+        const Double4 cosine( Select( three_real, ( zero - Q2 ) / ( rad * rad * rad ), zero ) );
+        t = two * rad * CosAcos3( max( min( cosine, one ), Double4( -1.0 ) ) );
+        }
+    if( lanes != 0xF )
+        {
+        const Double4 sq( sqrt( max( dis, zero ) ) );
+        t = Select( three_real, t, Cbrt( zero - Q2 + sq ) + Cbrt( zero - Q2 - sq ) );
+        }
+    const Double4 m( t - A * Double4( 1.0 / 3.0 ) );
 
+    // The roots of the quartic.  Where c4 or c5 is negative, the square root
+    // produces a NaN, and so do the roots that depend on it.
+    const Double4 c1( two * m - p );
+    const Double4 c2( sqrt( c1 ) );
+    const Double4 c3( q / ( two * c2 ) );
+    const Double4 c4( sqrt( c1 - four * ( m + c3 ) ) );
+    const Double4 c5( sqrt( c1 - four * ( m - c3 ) ) );
+    Double4 x[] = {
+        half * ( c2 - c4 ) + sh,
+        half * ( zero - c2 - c5 ) + sh,
+        half * ( c2 + c4 ) + sh,
+        half * ( c5 - c2 ) + sh
+        };
 
+    // Polish the roots with Newton's method, applied to the monic quartic.
+    // Steps are taken only where the derivative is non-zero and the residual
+    // is reduced, which leaves double roots (and NaNs) as they are.
+    for( int k = 0; k < 4; k++ )
+        {
+        for( int i = 0; i < 2; i++ )
+            {
+            const Double4 y( x[k] );
+            const Double4 f ( (( ( y + b3 ) * y + b2 ) * y + b1 ) * y + b0 );
+            const Double4 df( ( ( four * y + Double4( 3.0 ) * b3 ) * y + two * b2 ) * y + b1 );
+            const Double4 z( y - f / df );
+            const Double4 g( (( ( z + b3 ) * z + b2 ) * z + b1 ) * z + b0 );
+            x[k] = Select( ( df != zero ) & ( abs( g ) < abs( f ) ), z, y );
+            }
+        x[k].Store( r[k] );
+        }
+    }
+
+void SolveQuartics( unsigned n, const double *const a[], double *const r[] )
+    {
+    unsigned i = 0;
+    for( ; i + 4 <= n; i += 4 )
+        {
+        const double *a4[] = { a[0] + i, a[1] + i, a[2] + i, a[3] + i, a[4] + i };
+        double *r4[] = { r[0] + i, r[1] + i, r[2] + i, r[3] + i };
+        SolveQuartic4( a4, r4 );
+        }
+    if( i == n ) return;
+
+    // Copy the last few quartics into a full group of four, padded with x^4 - 1.
+    double ca[5][4], cr[4][4];
+    const double *a4[] = { ca[0], ca[1], ca[2], ca[3], ca[4] };
+    double *r4[] = { cr[0], cr[1], cr[2], cr[3] };
+    for( unsigned j = 0; j < 4; j++ )
+    for( int k = 0; k < 5; k++ )
+        ca[k][j] = ( i + j < n ) ? a[k][i+j] : ( k == 4 ? 1.0 : ( k == 0 ? -1.0 : 0.0 ) );
+    SolveQuartic4( a4, r4 );
+    for( unsigned j = 0; i + j < n; j++ )
+    for( int k = 0; k < 4; k++ )
+        r[k][i+j] = cr[k][j];
+    }
+
+// A Sturm sequence for a polynomial p of degree n starts with p and p', each
+// subsequent polynomial being the negated remainder of the previous two.  The
+// number of distinct real roots of p in (a,b] is the number of sign changes
+// in the sequence at a minus the number at b.  Scaling any polynomial by a
+// positive factor does not affect the signs, which is used to avoid division.
+// The unused coefficients (and polynomials) are zero, so that all can be
+// evaluated as quartics, without loops or branches that depend on the degree.
+struct sturm_sequence {
+    sturm_sequence( const double a[], int degree );
+    int    SignChanges( double x ) const;
+    double Value( double x ) const { return Eval( 0, x ); }
+    double Eval( int i, double x ) const;
+    int    num;         // The number of polynomials in the sequence.
+    int    deg[5];      // The degree of each polynomial.
+    double coef[5][5];  // The coefficients of each, starting with the constant.
+    static const int max_degree = 4;
+    };
 
+sturm_sequence::sturm_sequence( const double a[], int degree )
+    {
+    for( int i = 0; i <= max_degree; i++ )
+    for( int j = 0; j <= max_degree; j++ ) coef[i][j] = 0.0;
 
+    // Discard any vanishing leading coefficients.
+    while( degree > 0 && a[degree] == 0.0 ) degree--;
+    deg[0] = degree;
+    for( int j = 0; j <= degree; j++ ) coef[0][j] = a[j];
+    num = 1;
+    if( degree == 0 ) return;
 
-		
-		
+    deg[1] = degree - 1;
+    for( int j = 0; j < degree; j++ ) coef[1][j] = ( j + 1 ) * a[j+1];
+    num = 2;
 
+    while( deg[num-1] > 0 )
+        {
+        const double *u = coef[num-2];
+        const double *v = coef[num-1];
+        const int du = deg[num-2];
+        const int dv = deg[num-1];
 
+        // Divide c^k u by v, where c is the leading coefficient of v, leaving
+        // the remainder in r.  The power k makes the quotient exact without
+        // dividing, and is even so that the signs are unaffected.  Usually the
+        // degree drops by one at each step, so k = 2.
+        const double c = v[dv];
+        double r[5];
+        double scale = 1.0;
+        for( int j = 0; j <= du; j++ ) r[j] = u[j];
+        for( int k = du - dv; k >= 0; k-- )
+            {
+            const double q = r[dv+k];
+            for( int j = 0; j <= dv + k; j++ ) r[j] *= c;
+            for( int j = 0; j <= dv; j++ ) r[j+k] -= q * v[j];
+            scale *= c;
+            }
+        if( ( du - dv ) % 2 == 0 )
+            {
+            for( int j = 0; j < dv; j++ ) r[j] *= c;
+            scale *= c;
+            }
+
+        // Coefficients that are tiny relative to those of u are round-off; if
+        // nothing else remains, u and v share a factor, and the sequence ends
+        // with v.  Both still count each distinct root in (a,b] exactly once.
+        double size = 0.0;
+        for( int j = 0; j <= du; j++ ) size = max( size, fabs( u[j] ) );
+        size *= fabs( scale );
+        int dr = dv - 1;
+        while( dr >= 0 && fabs( r[dr] ) <= 1.0e-12 * size ) dr--;
+        if( dr < 0 ) break;
+
+        for( int j = 0; j <= dr; j++ ) coef[num][j] = -r[j];
+        deg[num++] = dr;
+        }
+    }
+
+double sturm_sequence::Eval( int i, double x ) const
+    {
+    const double *c = coef[i];
+    return c[0] + x * ( c[1] + x * ( c[2] + x * ( c[3] + x * c[4] ) ) );
+    }
+
+int sturm_sequence::SignChanges( double x ) const
+    {
+    // A zero takes the sign of its predecessor, so that it is skipped.  This
+    // avoids branches, whose outcomes are all but random.
+    int  changes = 0;
+    bool last = Eval( 0, x ) < 0.0;
+    for( int i = 1; i <= max_degree; i++ )
+        {
+        const double y = Eval( i, x );
+        const bool negative = ( y < 0.0 ) | ( ( y == 0.0 ) & last );
+        changes += negative != last;
+        last = negative;
+        }
+    return changes;
+    }
+
+// Find the smallest root in (lo,hi] by first bisecting the interval, guided by
+// the Sturm sequence, until it contains only that root.  If the polynomial then
+// changes sign over the interval, the root is refined by Newton's method,
+// falling back to bisection whenever a step would leave the interval.  If not,
+// the root has even multiplicity, and bisection using the Sturm sequence
+// continues until the interval is negligibly small.
+bool SmallestRoot( const double a[], int degree, double lo, double hi, double &x )
+    {
+    static const int    max_iterations = 100;
+    static const double tolerance = 1.0e-12;
+
+    const sturm_sequence S( a, degree );
+    if( S.deg[0] == 0 ) return false;
+
+    int lo_changes = S.SignChanges( lo );
+    const int hi_changes = S.SignChanges( hi );
+    if( lo_changes <= hi_changes ) return false; // No roots in (lo,hi].
+
+    // Isolate the smallest root.
+    int count = lo_changes - hi_changes;
+    for( int i = 0; count > 1 && i < max_iterations; i++ )
+        {
+        const double mid = 0.5 * ( lo + hi );
+        const int mid_changes = S.SignChanges( mid );
+        if( mid_changes < lo_changes ) { hi = mid; count = lo_changes - mid_changes; }
+        else { lo = mid; lo_changes = mid_changes; }
+        }
+
+    const double f_lo = S.Value( lo );
+    const double f_hi = S.Value( hi );
+    if( f_lo * f_hi > 0.0 )
+        {
+        // A root of even multiplicity (or a cluster of roots too close together
+        // to separate).  Narrow the interval while it still contains a root.
+        for( int i = 0; hi - lo > tolerance * ( 1.0 + fabs( hi ) ) && i < max_iterations; i++ )
+            {
+            const double mid = 0.5 * ( lo + hi );
+            const int mid_changes = S.SignChanges( mid );
+            if( mid_changes < lo_changes ) hi = mid;
+            else { lo = mid; lo_changes = mid_changes; }
+            }
+
+        // Round-off in the Sturm sequence can also report a root where there
+        // is none, so confirm that the polynomial vanishes here, relative to
+        // the size of its terms.
+        x = hi;
+        double size = 0.0;
+        for( int j = S.deg[0]; j >= 0; j-- ) size = size * fabs( x ) + fabs( S.coef[0][j] );
+        return fabs( S.Value( x ) ) <= 1.0e-8 * size;
+        }
+
+    // Safeguarded Newton iteration, starting from the low end of the interval.
+    // The interval [lo,hi] always brackets the root, shrinking with each step.
+    x = lo;
+    for( int i = 0; i < max_iterations; i++ )
+        {
+        double f  = a[degree];
+        double df = 0.0;
+        for( int j = degree - 1; j >= 0; j-- )
+            {
+            df = df * x + f;
+            f  = f  * x + a[j];
+            }
+        if( f == 0.0 ) break;
+        if( ( f < 0.0 ) == ( f_lo < 0.0 ) ) lo = x; else hi = x;
+        double next = ( df != 0.0 ) ? x - f / df : lo;
+        if( next <= lo || next >= hi ) next = 0.5 * ( lo + hi );
+        const bool done = fabs( next - x ) <= tolerance * ( 1.0 + fabs( x ) );
+        x = next;
+        if( done ) break;
+        }
+    return true;
+    }
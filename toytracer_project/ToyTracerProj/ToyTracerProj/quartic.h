@@ -8,7 +8,18 @@
 * algorithm is based on a paper by J. E. Hacke, published in the American  *
 * Mathematical Monthly, Vol. 48, 327-328, 1941.                            *
 *                                                                          *
+* SmallestRoot takes a different approach: it finds only the smallest root *
+* within a given interval, isolating it with a Sturm sequence and then     *
+* refining it numerically.  When only that root is needed (e.g. for ray    *
+* intersection) this is much more accurate than the closed-form solution.  *
+*                                                                          *
+* SolveQuartics applies the closed-form solution to many quartics at once, *
+* four at a time using SIMD instructions, with the branches on the         *
+* discriminants replaced by selecting among results computed for all.      *
+*                                                                          *
 * History:                                                                 *
+*   10/18/2026  Added SolveQuartics, a batched SIMD solver.                *
+*   10/18/2026  Added SmallestRoot, based on Sturm sequences.              *
 *   10/11/2005  Rewritten, starting from the 2004 C-code by Raoul Rausch.  *
 *                                                                          *
 ***************************************************************************/
@@ -50,6 +61,29 @@ extern int SolveQuartic(
     roots &R
     );
 
+// Find the real roots of n quartic polynomials at once.  The coefficients
+// are given in structure-of-arrays form: a[k][i] is the coefficient of degree k
+// of the i'th quartic, and the leading coefficients a[4][i] must be non-zero.
+// The roots of the i'th quartic are returned in r[0][i] through r[3][i], in no
+// particular order.  Roots that are not real are returned as NaN, so that any
+// comparison involving them is false.
+extern void SolveQuartics(
+    unsigned n,              // The number of quartics.
+    const double *const a[], // The five arrays of coefficients.
+    double *const r[]        // The four arrays of roots.
+    );
+
+// Find the smallest real root of the polynomial with the given coefficients
+// that lies in the interval (lo,hi].  The return value indicates whether there
+// is such a root.  Roots of even multiplicity (e.g. tangencies) are found too.
+extern bool SmallestRoot(
+    const double a[], // The coefficients, where a[0] is the constant coefficient.
+    int    degree,    // The degree of the polynomial; at most four.
+    double lo,        // The lower end of the interval, which is excluded.
+    double hi,        // The upper end of the interval, which is included.
+    double &x         // The root, if one is found.
+    );
+
 // Evaluate a quadratic polynomial at x using Horner's rule.
 inline double Horner( double x, double a, double b, double c )
     {
@@ -7,6 +7,9 @@
 * some ray tracing algorithms.                                             *
 *                                                                          *                                                                        
 * History:                                                                 *
+*   10/18/2026  Rays also cache the shear of the watertight triangle test. *
+*   10/18/2026  Rays cache the reciprocals & signs of their directions.    *
+*   10/18/2026  Added RayBatch for intersecting many rays at once.         *
 *   12/11/2004  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -38,6 +41,11 @@ struct Ray {            // A ray in R3.
 	double ref_index;	//ref index of current material the ray is inside
     unsigned generation; // How deep in the ray tree.  1 == generated from eye.
     const Object *from;  // The object from which the ray was cast.
+    inline void Prepare();
+    double inv_dir[3];   // Reciprocals of the direction components (see Prepare).
+    int    sign[3];      // 1 where the direction component is negative, else 0.
+    int    shear_axis[3]; // The axes kx, ky & kz of the watertight triangle test.
+    float  shear[3];      // Its shear constants Sx, Sy & Sz.
     };
 
 inline Ray::Ray()
@@ -46,6 +54,7 @@ inline Ray::Ray()
     type = generic_ray;
     from = NULL;
 	ref_index = 1.0;
+    Prepare();
     }
 
 inline Ray::Ray( const Ray &r )
@@ -56,8 +65,81 @@ inline Ray::Ray( const Ray &r )
     type       = r.type;;
     from       = r.from;
 	ref_index = 1.0;
+    for( int a = 0; a < 3; a++ )
+        {
+        inv_dir[a] = r.inv_dir[a];
+        sign   [a] = r.sign   [a];
+        shear_axis[a] = r.shear_axis[a];
+        shear     [a] = r.shear     [a];
+        }
     }
 
+// Cache the reciprocals of the direction components, and which of them are
+// negative, for the ray-box (slab) tests.  This must be done whenever the
+// direction changes, before the ray is intersected with anything.  Scene::Cast
+// and RayBatch::Add do so for the rays they are given, and transforms for the
+// rays they map into the canonical space.  A zero component has an infinite
+// reciprocal, whose sign follows that of the zero.  The permutation & shear
+// that map the direction onto the positive z-axis are cached too, for the
+// watertight triangle test (see triangle.cpp), which would otherwise find
+// them again for every triangle.  z is the dominant axis of the direction,
+// and x & y are swapped if it is negative, to preserve the winding.
+inline void Ray::Prepare()
+    {
+    inv_dir[0] = 1.0 / direction.x;
+    inv_dir[1] = 1.0 / direction.y;
+    inv_dir[2] = 1.0 / direction.z;
+    sign[0] = inv_dir[0] < 0.0;
+    sign[1] = inv_dir[1] < 0.0;
+    sign[2] = inv_dir[2] < 0.0;
+
+    const float D[] = { float( direction.x ), float( direction.y ), float( direction.z ) };
+    int kz = 0;
+    if( fabs( D[1] ) > fabs( D[kz] ) ) kz = 1;
+    if( fabs( D[2] ) > fabs( D[kz] ) ) kz = 2;
+    int kx = ( kz + 1 ) % 3;
+    int ky = ( kx + 1 ) % 3;
+    if( D[kz] < 0.0f ) { const int k = kx; kx = ky; ky = k; }
+    shear_axis[0] = kx;
+    shear_axis[1] = ky;
+    shear_axis[2] = kz;
+    shear[2] = 1.0f / D[kz];
+    shear[0] = D[kx] * shear[2];
+    shear[1] = D[ky] * shear[2];
+    }
+
+
+// A RayBatch holds a group of rays that are intersected with the scene
+// together (e.g. all the primary rays of a tile).  The origins and
+// directions are duplicated in structure-of-arrays form so that batched
+// intersectors can stream through them.  Intersectors are handed a list
+// of indices of the "active" rays in the batch, which is how aggregates
+// cull rays as they descend.
+struct RayBatch {
+    RayBatch() {}
+   ~RayBatch() {}
+    inline void Clear();
+    inline void Add( const Ray &r );
+    inline unsigned Size() const { return rays.size(); }
+    vector<Ray>    rays;       // The rays, as given.
+    vector<double> Qx, Qy, Qz; // Ray origins.
+    vector<double> Rx, Ry, Rz; // Ray directions.
+    };
+
+inline void RayBatch::Clear()
+    {
+    rays.clear();
+    Qx.clear(); Qy.clear(); Qz.clear();
+    Rx.clear(); Ry.clear(); Rz.clear();
+    }
+
+inline void RayBatch::Add( const Ray &r )
+    {
+    rays.push_back( r );
+    rays.back().Prepare();
+    Qx.push_back( r.origin.x    ); Qy.push_back( r.origin.y    ); Qz.push_back( r.origin.z    );
+    Rx.push_back( r.direction.x ); Ry.push_back( r.direction.y ); Rz.push_back( r.direction.z );
+    }
 
 // Compute the reflected ray given the incident ray (i.e. directed
 // toward the surface), and the normal to the surface.  The normal
@@ -7,6 +7,14 @@
 * the sceen.                                                               *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Prototypes are no longer part of the scene.                *
+*   10/18/2026  Cast & CastBatch clear the shadow rays cast for the hit.   *
+*   10/18/2026  Added Destroy, for scenes that do not last the whole run.  *
+*   10/18/2026  Cast prepares the ray for the ray-box tests.               *
+*   10/18/2026  Cast finalizes the closest hit.                            *
+*   10/18/2026  Cast applies the pending transforms of the hit.            *
+*   10/18/2026  Added CastBatch; split Shade & Miss out of Trace.          *
+*   10/18/2026  Trace optionally returns the distance to the hit.          *
 *   09/29/2005  Updated for 2005 graphics class.                           *
 *   10/16/2004  Check for "ignored" object in "Cast".                      *
 *   09/29/2004  Updated for Fall 2004 class.                               *
@@ -14,7 +22,10 @@
 *   04/01/2003  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
+#include <set>
 #include "toytracer.h"
+#include "transform.h"
+#include "packed.h"
 
 static const Color
     default_background_color  = Color( 0.15, 0.25, 0.35 ),
@@ -38,27 +49,74 @@ Scene::Scene()
 bool Scene::Cast( const Ray &ray, HitInfo &hitinfo ) const
     {
     if( object == NULL || object == hitinfo.ignore ) return false;
-    if( object->Intersect( ray, hitinfo ) )
+    hitinfo.frame_object = NULL;
+    hitinfo.blocked = NULL; // Its shadow rays are yet to be cast.
+    STAT_DEPTH( ray.generation );
+    Ray r( ray );
+    r.Prepare(); // Cache the reciprocal direction for the ray-box tests.
+    if( object->Intersect( r, hitinfo ) )
         {
-        hitinfo.ray = ray; // Save the ray in world coordinates.
+        hitinfo.Finalize( ray ); // Fill in the point & normal in world coordinates.
+        hitinfo.ray = ray;       // Save the ray in world coordinates.
         return true;
 	    }
     return false;
     }
 
+// Intersect defers computing the point and normal of a hit until the closest
+// hit is known, as most hits are superseded by closer ones.  The hit must be
+// finalized in the space of the object that was hit, so the ray is first
+// mapped through each transform that the hit passed through (outermost
+// first), and the point and normal are then mapped back out again.  The
+// normal is normalized only if some transform could have changed its length.
+
+void HitInfo::Finalize( const Ray &ray )
+    {
+    if( object == NULL ) return;
+    if( frame_object != object ) // Not hit through any transform.
+        {
+        frames   = 0;
+        finished = false;
+        }
+    if( !finished )
+        {
+        Ray c_ray( ray );
+        const double d = distance;
+        for( unsigned i = frames; i > 0; i-- )
+            {
+            const Ray r( c_ray );
+            double stretch;
+            frame[i-1]->ToCanonical( r, c_ray, stretch );
+            distance *= stretch;
+            }
+        object->FinalizeHit( c_ray, *this );
+        distance = d;
+        }
+    bool normalize = false;
+    for( unsigned i = 0; i < frames; i++ )
+        {
+        if( frame[i]->ToParent( *this ) ) normalize = true;
+        }
+    if( normalize ) normal = Unit( normal );
+    frames = 0;
+    frame_object = NULL;
+    }
+
 // Trace is the most fundamental of all the ray tracing functions.  It
 // answers the query "What color do I see looking along the given ray
 // in the current scene?"  This is an inherently recursive process, as
 // trace may again be called as a result of the ray hitting a reflecting
 // object.  To prevent the possibility of infinite recursion, a maximum
-// depth is placed on the resulting ray tree.
+// depth is placed on the resulting ray tree.  If "distance" is given, the
+// distance to the surface that was hit (or Infinity) is returned there.
 
-Color Scene::Trace( const Ray &ray ) const
+Color Scene::Trace( const Ray &ray, double *distance ) const
     {
     Color   color;               // The color to return.
     HitInfo hitinfo;             // Holds info to pass to shader.
     hitinfo.ignore = NULL;       // Don't ignore any objects.
     hitinfo.distance = Infinity; // Follow the full ray.
+    if( distance != NULL ) *distance = Infinity;
 
     if( ray.generation > max_tree_depth )
         {
@@ -67,27 +125,145 @@ Color Scene::Trace( const Ray &ray ) const
         }
     else if( Cast( ray, hitinfo ) )
         {
+        if( distance != NULL ) *distance = hitinfo.distance;
         if( hitinfo.object == NULL ) return Green;
-        // The ray hits an object, so shade the point that the ray hit.
-        // Cast has put all necessary information for Shade into "hitinfo".
-        // Use the shader associated with the object, if there is one.
-        Shader *shader = hitinfo.object->shader;
-        if( shader != NULL )
-             color = shader->Shade( *this, hitinfo );   // Use the associated shader.
-        else color = hitinfo.object->material->diffuse; // Use the diffuse color.
-        }
-    else 
-        {
-        // The ray has failed to hit anything.  Use the environment map
-        // associated with the scene to determine the color (if there is one).
-        // If no envmap was specified, use the default background color.
-        const Envmap *env = envmap;
-        if( ray.from != NULL && ray.from->envmap != NULL ) env = ray.from->envmap;
-        if( env != NULL ) 
-             color = env->Shade( hitinfo.ray ); // Use the associated env.
-        else color = default_background_color;  // Use the default color.
+        color = Shade( hitinfo );
         }
+    else color = Miss( ray );
     
     return color;
     }
 
+// Shade the point that a ray hit.  Cast has put all necessary information
+// for Shade into "hitinfo".  Use the shader associated with the object, if
+// there is one.
+
+Color Scene::Shade( const HitInfo &hitinfo ) const
+    {
+    Shader *shader = hitinfo.object->shader;
+    STAT_COUNT( stat_shader_calls );
+    if( shader != NULL )
+         return shader->Shade( *this, hitinfo );   // Use the associated shader.
+    else return hitinfo.object->material->diffuse; // Use the diffuse color.
+    }
+
+// The ray has failed to hit anything.  Use the environment map associated
+// with the scene to determine the color (if there is one).  If no envmap
+// was specified, use the default background color.
+
+Color Scene::Miss( const Ray &ray ) const
+    {
+    const Envmap *env = envmap;
+    if( ray.from != NULL && ray.from->envmap != NULL ) env = ray.from->envmap;
+    if( env != NULL ) 
+         return env->Shade( ray );          // Use the associated env.
+    else return default_background_color;   // Use the default color.
+    }
+
+// CastBatch is the batched form of Cast.  Each ray of the batch is
+// intersected with the scene, and the closest hit is returned in the
+// corresponding element of "hits".  The "ignore" and "distance" fields of
+// each HitInfo are respected as in Cast.  A ray has hit something if and
+// only if the "object" field of its HitInfo is non-NULL afterwards.
+
+void Scene::CastBatch( const RayBatch &batch, HitInfo *hits ) const
+    {
+    const unsigned n = batch.Size();
+    vector<unsigned> active;
+    active.reserve( n );
+    for( unsigned i = 0; i < n; i++ )
+        {
+        hits[i].object = NULL;
+        hits[i].frame_object = NULL;
+        hits[i].blocked = NULL;
+        if( object != NULL && object != hits[i].ignore ) active.push_back( i );
+        }
+    if( active.empty() ) return;
+    object->IntersectBatch( batch, &active[0], active.size(), hits );
+    for( unsigned i = 0; i < n; i++ )
+        {
+        if( hits[i].object == NULL ) continue;
+        hits[i].Finalize( batch.rays[i] );
+        hits[i].ray = batch.rays[i]; // Save the ray in world coordinates.
+        }
+    }
+
+// This is the default finalizer, which is used by any object that fills in
+// the normal itself as part of Intersect.  Only the point is computed here.
+
+void Object::FinalizeHit( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    hitinfo.point = ray.origin + hitinfo.distance * ray.direction;
+    }
+
+// This is the default batched intersector, which is used by any object that
+// does not supply its own.  It simply intersects each of the active rays in
+// turn.  Objects that can amortize work over many rays (e.g. aggregates that
+// cull the batch against their bounding volumes) should override it.
+
+void Object::IntersectBatch( const RayBatch &batch, const unsigned *active, unsigned n, HitInfo *hits ) const
+    {
+    for( unsigned k = 0; k < n; k++ )
+        {
+        const unsigned i = active[k];
+        Intersect( batch.rays[i], hits[i] );
+        }
+    }
+
+// Add the object to the set, along with everything it holds.  Objects
+// shared by several others, such as the geometry of a prototype, are added
+// only once.  The prototype itself is not part of the scene; its instances
+// refer directly to the aggregate within it.
+
+static void Gather( Object *obj, std::set<Object*> &objects )
+    {
+    if( obj == NULL || !objects.insert( obj ).second ) return;
+    const Object *prims[4];
+    const unsigned n = PackedObjects( obj, prims );
+    for( unsigned i = 0; i < n; i++ ) Gather( const_cast<Object *>( prims[i] ), objects );
+    transform *T = dynamic_cast<transform *>( obj );
+    if( T != NULL ) Gather( T->object, objects );
+    Aggregate *agg = dynamic_cast<Aggregate *>( obj );
+    if( agg != NULL )
+        {
+        for( unsigned i = 0; i < agg->children.size(); i++ ) Gather( agg->children[i], objects );
+        }
+    }
+
+// Free everything that the builder created for the scene.  Most of the
+// toytracer builds one scene and lets it go when the program ends, but a
+// scene that is replaced while the program runs (as in the render server)
+// must be freed here.  The objects do not own one another, as materials &
+// shaders are shared, so all that can be reached is gathered first, and
+// each is deleted once.  The geometry of a prototype that was never
+// instanced cannot be reached, and is not freed.
+
+void Scene::Destroy()
+    {
+    std::set<Object*> objects;
+    Gather( object, objects );
+    for( unsigned i = 0; i < lights.size(); i++ ) Gather( lights[i], objects );
+
+    std::set<Material*> all_materials( materials.begin(), materials.end() );
+    std::set<Plugin*>   plugins;
+    std::set<Object*>::iterator i;
+    for( i = objects.begin(); i != objects.end(); ++i )
+        {
+        all_materials.insert( (*i)->material );
+        plugins.insert( (*i)->shader );
+        plugins.insert( (*i)->envmap );
+        }
+    plugins.insert( envmap );
+    plugins.insert( rasterize );
+    all_materials.erase( NULL );
+    plugins.erase( NULL );
+
+    for( i = objects.begin(); i != objects.end(); ++i ) delete *i;
+    for( std::set<Material*>::iterator m = all_materials.begin(); m != all_materials.end(); ++m ) delete *m;
+    for( std::set<Plugin*>::iterator p = plugins.begin(); p != plugins.end(); ++p ) delete *p;
+    object    = NULL;
+    envmap    = NULL;
+    rasterize = NULL;
+    lights.clear();
+    materials.clear();
+    }
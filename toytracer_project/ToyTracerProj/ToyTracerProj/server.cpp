@@ -0,0 +1,800 @@
+/***************************************************************************
+* server.cpp                                                               *
+*                                                                          *
+* The render server and its client.  Usage:                                *
+*                                                                          *
+*    toytracer serve [socket PATH] [workers N] [cache N]                   *
+*                                                                          *
+*    socket   the Unix-domain socket to listen on (toytracer.sock);        *
+*    workers  the jobs to render at once (one per hardware thread);        *
+*    cache    the most scenes to keep built (8), dropping the least        *
+*             recently used beyond that;                                   *
+*                                                                          *
+*    toytracer request [socket PATH] JSON [JSON ...]                       *
+*                                                                          *
+* sends each JSON line to the server, and prints its replies until each    *
+* job is done.  Scenes are built one at a time, under a lock, since the    *
+* builder & the plugins it creates are not meant to run in parallel; the   *
+* built scenes are then only read, so any number of jobs can render them   *
+* at once.  A scene dropped from the cache stays usable by jobs already    *
+* running, and is freed when the last of them is done.  A scene is rebuilt *
+* when its sdf file changes, as judged by the time it was last modified    *
+* (to the nanosecond, where the file system records it) & its size.        *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Sends the progress of each job as it renders.              *
+*   10/18/2026  Scenes dropped from the cache are freed.                   *
+*   10/18/2026  Reads arrays of strings, as in the status reply.           *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "server.h"
+#include "params.h"
+#include "util.h"
+#include "trace.h"
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+static const char    *default_socket   = "toytracer.sock";
+static const unsigned default_cache    = 8;
+static const unsigned max_request_line = 65536; // Longer lines are rejected.
+static const double   progress_interval = 0.25;  // Least seconds between progress events of a job.
+
+typedef std::chrono::steady_clock server_clock;
+
+static double Seconds( const server_clock::time_point &start )
+    {
+    return std::chrono::duration<double>( server_clock::now() - start ).count();
+    }
+
+// A value within a request or a reply.  These are flat JSON objects, whose
+// values are strings, numbers, booleans (read as 1 or 0), or arrays of
+// numbers or strings.  A number is kept as an array of one.
+struct json_value {
+    json_value() { is_string = false; }
+    bool   is_string;
+    string text;
+    vector<double> numbers;
+    vector<string> strings;
+    };
+
+typedef std::map<string, json_value> json_object;
+
+// Quote the string for JSON.
+static string Quote( const string &s )
+    {
+    std::stringstream out;
+    out << '"';
+    for( unsigned i = 0; i < s.size(); i++ )
+        {
+        const unsigned char c = s[i];
+        if( c == '"' || c == '\\' ) out << '\\' << c;
+        else if( c == '\n' ) out << "\\n";
+        else if( c == '\t' ) out << "\\t";
+        else if( c < 0x20 )
+            {
+            char code[8];
+            sprintf( code, "\\u%04x", c );
+            out << code;
+            }
+        else out << c;
+        }
+    out << '"';
+    return out.str();
+    }
+
+// A small reader for the flat objects of the requests.
+struct json_reader {
+    json_reader( const string &s ) { text = s; pos = 0; }
+    void SkipBlanks() { while( pos < text.size() && isspace( (unsigned char)text[pos] ) ) pos++; }
+    bool Next( char c ) { SkipBlanks(); if( pos < text.size() && text[pos] == c ) { pos++; return true; } return false; }
+    bool String( string & );
+    bool Number( double & );
+    bool Value( json_value & );
+    bool Object( json_object & );
+    string   text;
+    unsigned pos;
+    };
+
+bool json_reader::String( string &s )
+    {
+    if( !Next( '"' ) ) return false;
+    s.clear();
+    while( pos < text.size() && text[pos] != '"' )
+        {
+        char c = text[ pos++ ];
+        if( c == '\\' && pos < text.size() )
+            {
+            c = text[ pos++ ];
+            if( c == 'n' ) c = '\n';
+            else if( c == 't' ) c = '\t';
+            else if( c == 'u' )
+                {
+                // Only characters of one byte are kept; others become '?'.
+                const unsigned code = pos + 4 <= text.size() ? strtoul( text.substr( pos, 4 ).c_str(), NULL, 16 ) : 0;
+                pos += 4;
+                c = code < 0x80 ? char( code ) : '?';
+                }
+            }
+        s += c;
+        }
+    return pos++ < text.size();
+    }
+
+bool json_reader::Number( double &x )
+    {
+    SkipBlanks();
+    const char *start = text.c_str() + pos;
+    char *end;
+    x = strtod( start, &end );
+    if( end == start ) return false;
+    pos += end - start;
+    return true;
+    }
+
+bool json_reader::Value( json_value &v )
+    {
+    SkipBlanks();
+    if( pos < text.size() && text[pos] == '"' )
+        {
+        v.is_string = true;
+        return String( v.text );
+        }
+    if( text.compare( pos, 4, "true"  ) == 0 ) { pos += 4; v.numbers.assign( 1, 1.0 ); return true; }
+    if( text.compare( pos, 5, "false" ) == 0 ) { pos += 5; v.numbers.assign( 1, 0.0 ); return true; }
+    double x;
+    string s;
+    if( Next( '[' ) )
+        {
+        if( Next( ']' ) ) return true;
+        do  {
+            SkipBlanks();
+            if( pos < text.size() && text[pos] == '"' )
+                {
+                if( !String( s ) ) return false;
+                v.strings.push_back( s );
+                }
+            else if( Number( x ) ) v.numbers.push_back( x );
+            else return false;
+            } while( Next( ',' ) );
+        return Next( ']' );
+        }
+    if( !Number( x ) ) return false;
+    v.numbers.push_back( x );
+    return true;
+    }
+
+bool json_reader::Object( json_object &obj )
+    {
+    if( !Next( '{' ) ) return false;
+    if( Next( '}' ) ) return true;
+    do  {
+        string key;
+        json_value v;
+        if( !String( key ) || !Next( ':' ) || !Value( v ) ) return false;
+        obj[ key ] = v;
+        } while( Next( ',' ) );
+    if( !Next( '}' ) ) return false;
+    SkipBlanks();
+    return pos == text.size();
+    }
+
+static bool ParseRequest( const string &line, json_object &obj )
+    {
+    json_reader reader( line );
+    return reader.Object( obj );
+    }
+
+// Look up a string, a number, or an array of three numbers in the request.
+// Each returns false, leaving its argument alone, if the key is absent or of
+// the wrong kind.
+static bool GetString( const json_object &obj, const char *key, string &s )
+    {
+    json_object::const_iterator i = obj.find( key );
+    if( i == obj.end() || !i->second.is_string ) return false;
+    s = i->second.text;
+    return true;
+    }
+
+static bool GetNumber( const json_object &obj, const char *key, double &x )
+    {
+    json_object::const_iterator i = obj.find( key );
+    if( i == obj.end() || i->second.is_string || i->second.numbers.size() != 1 ) return false;
+    x = i->second.numbers[0];
+    return true;
+    }
+
+static bool GetVec3( const json_object &obj, const char *key, Vec3 &v )
+    {
+    json_object::const_iterator i = obj.find( key );
+    if( i == obj.end() || i->second.is_string || i->second.numbers.size() != 3 ) return false;
+    v = Vec3( i->second.numbers[0], i->second.numbers[1], i->second.numbers[2] );
+    return true;
+    }
+
+// Remove the extension, if it is the given one.
+static string Strip( const string &name, const string &ext )
+    {
+    if( name.size() > ext.size() && name.compare( name.size() - ext.size(), ext.size(), ext ) == 0 )
+        return name.substr( 0, name.size() - ext.size() );
+    return name;
+    }
+
+#ifdef _WIN32
+
+int RunServer( int, char *[] )
+    {
+    cerr << "Error: The render server needs Unix-domain sockets, which are not used on Windows." << endl;
+    return error_bad_arguments;
+    }
+
+int RunRequest( int, char *[] )
+    {
+    cerr << "Error: The render server needs Unix-domain sockets, which are not used on Windows." << endl;
+    return error_bad_arguments;
+    }
+
+#else
+
+// Write all of the line, followed by a newline.  Returns false if the other
+// end has gone.
+static bool SendLine( int fd, const string &line )
+    {
+    const string data( line + "\n" );
+    unsigned sent = 0;
+    while( sent < data.size() )
+        {
+        const ssize_t n = send( fd, data.c_str() + sent, data.size() - sent, 0 );
+        if( n <= 0 ) return false;
+        sent += unsigned( n );
+        }
+    return true;
+    }
+
+// Read the next line into "line", without its newline, keeping whatever
+// follows it in "pending".  Returns false at the end of the stream, or if
+// the line is too long.
+static bool ReceiveLine( int fd, string &pending, string &line )
+    {
+    for(;;)
+        {
+        const size_t end = pending.find( '\n' );
+        if( end != string::npos )
+            {
+            line = pending.substr( 0, end );
+            pending.erase( 0, end + 1 );
+            return true;
+            }
+        if( pending.size() > max_request_line ) return false;
+        char buffer[4096];
+        const ssize_t n = recv( fd, buffer, sizeof( buffer ), 0 );
+        if( n <= 0 ) return false;
+        pending.append( buffer, n );
+        }
+    }
+
+static bool SocketAddress( const string &path, sockaddr_un &addr )
+    {
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+    if( path.size() >= sizeof( addr.sun_path ) )
+        {
+        cerr << "Error: The socket path " << path << " is too long." << endl;
+        return false;
+        }
+    strcpy( addr.sun_path, path.c_str() );
+    return true;
+    }
+
+// A client of the server.  Replies to its jobs may come from any worker, so
+// each line is sent under the lock.  The socket is closed once neither the
+// thread reading the client's requests nor any of its jobs needs it, so that
+// its number cannot be reused for another client while replies are due.
+struct connection {
+    connection( int fd_ ) { fd = fd_; }
+   ~connection() { close( fd ); }
+    void Send( const string &line ) { std::lock_guard<std::mutex> guard( lock ); SendLine( fd, line ); }
+    int        fd;
+    std::mutex lock;
+    };
+
+// A scene built by the server, along with the camera of its sdf file.  It
+// is freed when neither the cache nor any job holds it.
+struct cached_scene {
+   ~cached_scene() { scene.Destroy(); }
+    string   name;
+    timespec mtime;       // When the sdf file was last modified, ...
+    off_t    size;        // ... & its size, to tell when it has changed.
+    Scene    scene;
+    Camera   camera;
+    unsigned last_used;   // When the scene was last asked for, by the cache's clock.
+    double   build_time;  // Seconds taken to read & build it.
+    };
+
+struct render_job {
+    string      id;
+    json_object request;
+    std::shared_ptr<connection> client;
+    };
+
+struct server_state {
+    server_state() { stopping = false; readers = 0; clock = 0; capacity = default_cache; listener = -1; }
+    std::mutex              lock;      // Guards the queue, "stopping" & the clients.
+    std::condition_variable ready;     // Signalled when a job is queued, or on stopping.
+    std::condition_variable hung_up;   // Signalled when a client's reader finishes.
+    std::deque<render_job>  queue;
+    bool                    stopping;
+    unsigned                readers;   // Threads reading clients' requests.
+    vector< std::weak_ptr<connection> > clients;
+    std::mutex              build_lock; // Guards the cache, and serializes building.
+    std::map< string, std::shared_ptr<cached_scene> > cache;
+    unsigned                clock;
+    unsigned                capacity;
+    int                     listener;
+    };
+
+// A line of the reply to a job, given the rest of its fields.
+static string Event( const string &id, const char *event, const string &fields = "" )
+    {
+    return "{\"id\":" + Quote( id ) + ",\"event\":\"" + event + "\"" + fields + "}";
+    }
+
+// Sends the rasterizer's progress through a job to its client, as "progress"
+// events.  A large image finishes rows far faster than anyone reads them, so
+// besides the last, at most one is sent every progress_interval seconds.
+// Reports may come from any of the rasterizer's threads.
+struct job_progress : public RenderProgress {
+    job_progress( connection &c, const string &job_id );
+    virtual void Report( unsigned done, unsigned total, const char *units );
+    connection &client;
+    string      id;
+    std::mutex  lock;   // Guards "sent" & "last".
+    bool        sent;   // Whether any progress has been sent yet.
+    server_clock::time_point last; // When it was last sent.
+    };
+
+job_progress::job_progress( connection &c, const string &job_id ) : client( c )
+    {
+    id   = job_id;
+    sent = false;
+    }
+
+void job_progress::Report( unsigned done, unsigned total, const char *units )
+    {
+    std::lock_guard<std::mutex> guard( lock );
+    if( sent && done < total && Seconds( last ) < progress_interval ) return;
+    sent = true;
+    last = server_clock::now();
+    std::stringstream fields;
+    fields << ",\"completed\":" << done << ",\"total\":" << total << ",\"units\":" << Quote( units );
+    client.Send( Event( id, "progress", fields.str() ) );
+    }
+
+// Find the scene in the cache, or build it.  The scene is rebuilt if its sdf
+// file has been modified since it was cached.  Must be called with the build
+// lock held.
+static std::shared_ptr<cached_scene> GetScene( server_state &state, const string &name, bool &cached, string &error )
+    {
+    struct stat info;
+    if( stat( ( name + ".sdf" ).c_str(), &info ) != 0 )
+        {
+        error = "Could not find " + name + ".sdf";
+        return std::shared_ptr<cached_scene>();
+        }
+    state.clock++;
+    std::map< string, std::shared_ptr<cached_scene> >::iterator i = state.cache.find( name );
+    cached = i != state.cache.end() && i->second->size == info.st_size
+          && i->second->mtime.tv_sec  == info.st_mtim.tv_sec
+          && i->second->mtime.tv_nsec == info.st_mtim.tv_nsec;
+    if( cached )
+        {
+        i->second->last_used = state.clock;
+        return i->second;
+        }
+
+    Builder *builder = (Builder *)LookupPlugin( builder_plugin );
+    if( builder == NULL )
+        {
+        error = "No builder plugin was found.";
+        return std::shared_ptr<cached_scene>();
+        }
+    std::shared_ptr<cached_scene> entry( new cached_scene );
+    entry->name      = name;
+    entry->mtime     = info.st_mtim;
+    entry->size      = info.st_size;
+    entry->last_used = state.clock;
+    const server_clock::time_point start = server_clock::now();
+        {
+        TraceSpan span( "build " + name, "build" );
+        if( !builder->BuildScene( name, entry->camera, entry->scene ) )
+            {
+            error = "Could not build the scene " + name;
+            return std::shared_ptr<cached_scene>();
+            }
+        }
+    entry->build_time = Seconds( start );
+    state.cache[ name ] = entry;
+
+    // Drop the least recently used scenes beyond the capacity of the cache.
+    while( state.cache.size() > state.capacity )
+        {
+        std::map< string, std::shared_ptr<cached_scene> >::iterator oldest = state.cache.begin();
+        for( i = state.cache.begin(); i != state.cache.end(); ++i )
+            if( i->second->last_used < oldest->second->last_used ) oldest = i;
+        state.cache.erase( oldest );
+        }
+    return entry;
+    }
+
+static void RunJob( server_state &state, render_job &job )
+    {
+    connection &client = *job.client;
+    const json_object &request = job.request;
+    string scene_name, output;
+    if( !GetString( request, "scene", scene_name ) || !GetString( request, "output", output ) )
+        {
+        client.Send( Event( job.id, "error", ",\"message\":\"A job needs a scene and an output.\"" ) );
+        return;
+        }
+    scene_name = Strip( scene_name, ".sdf" );
+    output     = Strip( output, ".ppm" );
+    client.Send( Event( job.id, "started" ) );
+    TraceSpan span( "job " + job.id, "server" );
+
+    // Fetch the scene, and create the rasterizer if the job changes it.
+    // Both use the plugins, so both are done under the build lock.
+    double spp = 0.0;
+    string rasterizer_name;
+    GetNumber( request, "spp", spp );
+    GetString( request, "rasterizer", rasterizer_name );
+    std::shared_ptr<cached_scene> entry;
+    Rasterizer *rasterizer = NULL;
+    Rasterizer *created = NULL;
+    bool cached = false;
+    string error;
+        {
+        std::lock_guard<std::mutex> guard( state.build_lock );
+        entry = GetScene( state, scene_name, cached, error );
+        if( entry != NULL )
+            {
+            rasterizer = entry->scene.rasterize;
+            if( rasterizer == NULL ) rasterizer = (Rasterizer *)LookupPlugin( rasterizer_plugin );
+            if( spp >= 1.0 || !rasterizer_name.empty() )
+                {
+                if( rasterizer_name.empty() && rasterizer != NULL ) rasterizer_name = rasterizer->MyName();
+                std::stringstream line;
+                line << "rasterizer " << rasterizer_name;
+                if( spp >= 1.0 ) line << " samples " << unsigned( spp );
+                Plugin *plg = Instance_of_Plugin( line.str().c_str() );
+                if( plg != NULL && plg->PluginType() == rasterizer_plugin ) created = (Rasterizer *)plg;
+                else delete plg;
+                rasterizer = created;
+                if( rasterizer == NULL ) error = "Could not create the rasterizer " + rasterizer_name;
+                }
+            else if( rasterizer == NULL ) error = "No rasterizer plugin was found.";
+            }
+        }
+    if( entry == NULL || rasterizer == NULL )
+        {
+        client.Send( Event( job.id, "error", ",\"message\":" + Quote( error ) ) );
+        return;
+        }
+    std::stringstream scene_fields;
+    scene_fields << ",\"scene\":" << Quote( scene_name ) << ",\"cached\":" << ( cached ? "true" : "false" )
+                 << ",\"build_s\":" << ( cached ? 0.0 : entry->build_time );
+    client.Send( Event( job.id, "scene", scene_fields.str() ) );
+
+    // The camera of the sdf file, with the job's changes.  A width or height
+    // alone keeps the aspect ratio.
+    Camera camera( entry->camera );
+    double width = 0.0, height = 0.0;
+    GetNumber( request, "width",  width  );
+    GetNumber( request, "height", height );
+    GetVec3  ( request, "eye",    camera.eye    );
+    GetVec3  ( request, "lookat", camera.lookat );
+    GetVec3  ( request, "up",     camera.up     );
+    GetNumber( request, "vpdist", camera.vpdist );
+    const double aspect = double( camera.y_res ) / camera.x_res;
+    if( width  >= 1.0 ) camera.x_res = unsigned( width );
+    if( height >= 1.0 ) camera.y_res = unsigned( height );
+    if( width  >= 1.0 && height < 1.0 ) camera.y_res = unsigned( max( 1.0, width * aspect + 0.5 ) );
+    if( height >= 1.0 && width  < 1.0 ) camera.x_res = unsigned( max( 1.0, height / aspect + 0.5 ) );
+
+    std::stringstream render_fields;
+    render_fields << ",\"width\":" << camera.x_res << ",\"height\":" << camera.y_res
+                  << ",\"rasterizer\":" << Quote( rasterizer->MyName() );
+    client.Send( Event( job.id, "rendering", render_fields.str() ) );
+
+    job_progress progress( client, job.id );
+    const server_clock::time_point start = server_clock::now();
+    const bool ok = rasterizer->Rasterize( output, camera, entry->scene, entry->scene, false, &progress );
+    const double seconds = Seconds( start );
+    delete created;
+    if( !ok )
+        {
+        client.Send( Event( job.id, "error", ",\"message\":\"The image could not be rendered.\"" ) );
+        return;
+        }
+    std::stringstream done_fields;
+    done_fields << ",\"output\":" << Quote( output + ".ppm" ) << ",\"render_s\":" << seconds;
+    client.Send( Event( job.id, "done", done_fields.str() ) );
+    }
+
+// Each worker runs jobs from the queue until the server stops and the queue
+// is empty.
+static void Worker( server_state *state, unsigned index )
+    {
+    std::stringstream name;
+    name << "worker " << index;
+    SetTraceThreadName( name.str() );
+    for(;;)
+        {
+        render_job job;
+            {
+            std::unique_lock<std::mutex> guard( state->lock );
+            while( state->queue.empty() && !state->stopping ) state->ready.wait( guard );
+            if( state->queue.empty() ) return;
+            job = state->queue.front();
+            state->queue.pop_front();
+            }
+        RunJob( *state, job );
+        }
+    }
+
+static void ReadRequests( server_state *state, std::shared_ptr<connection> client );
+
+// Read the client's requests, queueing its jobs, until it hangs up.  The
+// server waits for every reader to finish before it stops.
+static void ServeClient( server_state *state, std::shared_ptr<connection> client )
+    {
+    ReadRequests( state, client );
+    std::lock_guard<std::mutex> guard( state->lock );
+    state->readers--;
+    state->hung_up.notify_all();
+    }
+
+static void ReadRequests( server_state *state, std::shared_ptr<connection> client )
+    {
+    string pending, line;
+    unsigned count = 0;
+    while( ReceiveLine( client->fd, pending, line ) )
+        {
+        if( line.find_first_not_of( " \t\r" ) == string::npos ) continue;
+        json_object request;
+        if( !ParseRequest( line, request ) )
+            {
+            client->Send( Event( "", "error", ",\"message\":" + Quote( "Could not parse the request " + line ) ) );
+            continue;
+            }
+        string command;
+        GetString( request, "command", command );
+        if( command == "status" )
+            {
+            std::stringstream fields;
+                {
+                std::lock_guard<std::mutex> guard( state->lock );
+                fields << ",\"queued\":" << state->queue.size();
+                }
+                {
+                std::lock_guard<std::mutex> guard( state->build_lock );
+                fields << ",\"cached\":[";
+                std::map< string, std::shared_ptr<cached_scene> >::const_iterator i;
+                for( i = state->cache.begin(); i != state->cache.end(); ++i )
+                    fields << ( i == state->cache.begin() ? "" : "," ) << Quote( i->first );
+                fields << "]";
+                }
+            client->Send( Event( "", "status", fields.str() ) );
+            continue;
+            }
+        if( command == "shutdown" )
+            {
+            std::lock_guard<std::mutex> guard( state->lock );
+            state->stopping = true;
+            state->ready.notify_all();
+            shutdown( state->listener, SHUT_RDWR ); // Wakes the accepting thread.
+            continue;
+            }
+        if( !command.empty() )
+            {
+            client->Send( Event( "", "error", ",\"message\":" + Quote( "Unknown command " + command ) ) );
+            continue;
+            }
+
+        // Jobs are named by the client, or else numbered by their connection.
+        render_job job;
+        job.request = request;
+        job.client  = client;
+        double number;
+        if( !GetString( request, "id", job.id ) )
+            {
+            std::stringstream id;
+            if( GetNumber( request, "id", number ) ) id << number;
+            else id << ++count;
+            job.id = id.str();
+            }
+        std::stringstream fields;
+            {
+            std::lock_guard<std::mutex> guard( state->lock );
+            if( state->stopping )
+                {
+                client->Send( Event( job.id, "error", ",\"message\":\"The server is shutting down.\"" ) );
+                continue;
+                }
+            state->queue.push_back( job );
+            fields << ",\"position\":" << state->queue.size();
+            client->Send( Event( job.id, "queued", fields.str() ) );
+            state->ready.notify_one();
+            }
+        }
+    }
+
+int RunServer( int argc, char *argv[] )
+    {
+    string args;
+    for( int i = 0; i < argc; i++ ) args += string( argv[i] ) + " ";
+    ParamReader get( args );
+
+    string   path( default_socket );
+    unsigned workers  = 0;
+    unsigned capacity = default_cache;
+    for(;;)
+        {
+        if( get["socket"]  && get.Word( path ) ) continue;
+        if( get["workers"] && get[workers]     ) continue;
+        if( get["cache"]   && get[capacity]    ) continue;
+        break;
+        }
+    string extra;
+    if( get.Word( extra ) || capacity == 0 )
+        {
+        cerr << "Usage: toytracer serve [socket PATH] [workers N] [cache N]" << endl;
+        return error_bad_arguments;
+        }
+    if( workers == 0 ) workers = std::thread::hardware_concurrency();
+    if( workers == 0 ) workers = 1;
+
+    sockaddr_un addr;
+    if( !SocketAddress( path, addr ) ) return error_bad_arguments;
+    const int listener = socket( AF_UNIX, SOCK_STREAM, 0 );
+    unlink( path.c_str() ); // Left behind by an earlier server, perhaps.
+    if( listener < 0 || bind( listener, (sockaddr *)&addr, sizeof( addr ) ) != 0 || listen( listener, 16 ) != 0 )
+        {
+        cerr << "Error: Could not listen on " << path << endl;
+        if( listener >= 0 ) close( listener );
+        return error_opening_input_file;
+        }
+    signal( SIGPIPE, SIG_IGN ); // A client that hangs up early must not stop the server.
+
+    server_state state;
+    state.capacity = capacity;
+    state.listener = listener;
+    vector<std::thread> pool;
+    for( unsigned t = 0; t < workers; t++ ) pool.push_back( std::thread( Worker, &state, t ) );
+    cout << "Serving on " << path << " with " << workers << " worker" << ( workers > 1 ? "s" : "" )
+         << ", caching up to " << capacity << " scene" << ( capacity > 1 ? "s" : "" ) << "." << endl;
+
+    // Accept clients until told to shut down.  Clients that have gone are
+    // forgotten as new ones arrive.
+    for(;;)
+        {
+        const int fd = accept( listener, NULL, NULL );
+        std::lock_guard<std::mutex> guard( state.lock );
+        if( state.stopping )
+            {
+            if( fd >= 0 ) close( fd );
+            break;
+            }
+        if( fd < 0 ) continue;
+        unsigned live = 0;
+        for( unsigned c = 0; c < state.clients.size(); c++ )
+            if( !state.clients[c].expired() ) state.clients[ live++ ] = state.clients[c];
+        state.clients.resize( live );
+        std::shared_ptr<connection> client( new connection( fd ) );
+        state.clients.push_back( client );
+        state.readers++;
+        std::thread( ServeClient, &state, client ).detach();
+        }
+
+    // Finish the queued jobs, then hang up on the clients.
+    cout << "Shutting down." << endl;
+    for( unsigned t = 0; t < pool.size(); t++ ) pool[t].join();
+        {
+        std::unique_lock<std::mutex> guard( state.lock );
+        for( unsigned c = 0; c < state.clients.size(); c++ )
+            {
+            std::shared_ptr<connection> client( state.clients[c].lock() );
+            if( client != NULL ) shutdown( client->fd, SHUT_RDWR );
+            }
+        while( state.readers > 0 ) state.hung_up.wait( guard );
+        }
+    close( listener );
+    unlink( path.c_str() );
+    return no_errors;
+    }
+
+int RunRequest( int argc, char *argv[] )
+    {
+    // The requests are JSON, which may hold blanks, so each argument is
+    // taken whole rather than through a ParamReader.
+    string path( default_socket );
+    int first = 0;
+    if( argc >= 2 && string( argv[0] ) == "socket" )
+        {
+        path  = argv[1];
+        first = 2;
+        }
+    if( first >= argc )
+        {
+        cerr << "Usage: toytracer request [socket PATH] JSON [JSON ...]" << endl;
+        return error_bad_arguments;
+        }
+
+    sockaddr_un addr;
+    if( !SocketAddress( path, addr ) ) return error_bad_arguments;
+    const int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( fd < 0 || connect( fd, (sockaddr *)&addr, sizeof( addr ) ) != 0 )
+        {
+        cerr << "Error: Could not connect to " << path << endl;
+        if( fd >= 0 ) close( fd );
+        return error_opening_input_file;
+        }
+
+    // Every request but a shutdown ends with one reply of "done", "error"
+    // or "status".
+    unsigned awaited = 0;
+    for( int i = first; i < argc; i++ )
+        {
+        json_object request;
+        string command;
+        if( ParseRequest( argv[i], request ) && GetString( request, "command", command ) && command == "shutdown" ) {}
+        else awaited++;
+        SendLine( fd, argv[i] );
+        }
+
+    string pending, line;
+    int code = no_errors;
+    while( awaited > 0 && ReceiveLine( fd, pending, line ) )
+        {
+        cout << line << endl;
+        json_object reply;
+        string event;
+        if( !ParseRequest( line, reply ) || !GetString( reply, "event", event ) )
+            {
+            // A reply that cannot be read is counted as a failed request,
+            // rather than waited on forever.
+            cerr << "Error: Could not read the reply " << line << endl;
+            code = error_rasterizing_image;
+            awaited--;
+            continue;
+            }
+        if( event == "error" ) code = error_rasterizing_image;
+        if( event == "done" || event == "error" || event == "status" ) awaited--;
+        }
+    close( fd );
+    if( awaited > 0 )
+        {
+        cerr << "Error: The server hung up before replying to every request." << endl;
+        code = error_rasterizing_image;
+        }
+    return code;
+    }
+
+#endif
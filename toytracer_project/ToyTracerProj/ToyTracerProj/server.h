@@ -0,0 +1,52 @@
+/***************************************************************************
+* server.h                                                                 *
+*                                                                          *
+* A render server, for pipelines that render the same few scenes many      *
+* times.  It listens on a Unix-domain socket and keeps each scene it has   *
+* built, keyed by the path of its sdf file and the time the file was last  *
+* modified, so that later jobs on the scene skip reading & building it.    *
+* Jobs are run by a pool of worker threads.                                *
+*                                                                          *
+* Clients send jobs as JSON objects, one per line, such as                 *
+*                                                                          *
+*    {"id":"a1", "scene":"scenes/scene1", "output":"out/a1", "width":200,  *
+*     "spp":4, "eye":[5,-2,2.8]}                                           *
+*                                                                          *
+* where "scene" and "output" are required, and "width", "height", "spp",   *
+* "rasterizer", "eye", "lookat", "up" & "vpdist" override the sdf file (a  *
+* width or height alone keeps the aspect ratio).  The server replies with  *
+* a line of JSON at each step of the job: "queued", "started", "scene"     *
+* (saying whether it was cached), "rendering", then "progress" (the rows   *
+* or tiles "completed" of the "total", a few times a second), and then     *
+* "done" or "error".                                                       *
+* The lines {"command":"status"} and {"command":"shutdown"} report on the  *
+* queue & cache, and stop the server once the queued jobs are done.        *
+*                                                                          *
+* The server is run by "toytracer serve [options]", and jobs can be sent   *
+* to it by "toytracer request [socket PATH] JSON ...".  See server.cpp.    *
+* Unix-domain sockets are not used on Windows, so there both commands just *
+* report an error.                                                         *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Jobs report their progress as they render.                 *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#ifndef __SERVER_INCLUDED__
+#define __SERVER_INCLUDED__
+
+#include "toytracer.h"
+
+// Run "toytracer serve" or "toytracer request", given the arguments that
+// follow the command.  Each returns one of the error codes of main.
+extern int RunServer(
+    int argc,
+    char *argv[]
+    );
+
+extern int RunRequest(
+    int argc,
+    char *argv[]
+    );
+
+#endif
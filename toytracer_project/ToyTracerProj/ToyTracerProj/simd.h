@@ -0,0 +1,182 @@
+/***************************************************************************
+* simd.h                                                                   *
+*                                                                          *
+* The Double4 structure holds four doubles that are operated upon in       *
+* parallel, one per "lane".  It is used by the packed intersection         *
+* kernels, which test a single ray against four primitives at once.  On    *
+* processors with AVX the four lanes occupy a single 256-bit register; on  *
+* all other x86 processors (SSE2) they occupy a pair of 128-bit registers. *
+* Elsewhere the lanes are simply processed one after another.              *
+*                                                                          *
+* Comparisons return a Double4 whose lanes are either all ones or all      *
+* zeros, which can be combined with "&", "|", and Select, or reduced to    *
+* four bits (one per lane) with Bits.                                      *
+*                                                                          *
+* MulAdd and MulSub compute a * b + c and a * b - c.  They use fused       *
+* multiply-add instructions when the processor has them (FMA), which       *
+* round only once; otherwise they are a multiply followed by an add.       *
+*                                                                          *
+* Single rounds each lane to single precision.  A sum, difference or       *
+* product of floats, computed in double precision and then rounded by      *
+* Single, is exactly the float result, so kernels written for floats can   *
+* be run four at a time with identical results.                            *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Added Single.                                              *
+*   10/18/2026  Added MulAdd & MulSub.                                     *
+*   10/18/2026  Added abs, "==", and "!=".                                 *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#ifndef __SIMD_INCLUDED__
+#define __SIMD_INCLUDED__
+
+#if defined(__AVX__)
+#define SIMD_AVX
+#include <immintrin.h>
+#if defined(__FMA__) || defined(__AVX2__)
+#define SIMD_FMA
+#endif
+#elif defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <cmath>
+
+struct Double4 {
+    inline Double4() {}
+    inline Double4( double x );             // Broadcast x to all four lanes.
+    inline static Double4 Load( const double *p ); // Load four consecutive doubles.
+    inline void Store( double *p ) const;   // Store four consecutive doubles.
+#if defined(SIMD_AVX)
+    inline Double4( __m256d a ) : v( a ) {}
+    __m256d v;
+#elif defined(SIMD_SSE2)
+    inline Double4( __m128d a, __m128d b ) : lo( a ), hi( b ) {}
+    __m128d lo, hi;
+#else
+    double v[4];
+#endif
+    };
+
+#if defined(SIMD_AVX)
+
+inline Double4::Double4( double x ) { v = _mm256_set1_pd( x ); }
+inline Double4 Double4::Load( const double *p ) { return Double4( _mm256_loadu_pd( p ) ); }
+inline void Double4::Store( double *p ) const { _mm256_storeu_pd( p, v ); }
+
+inline Double4 operator+( const Double4 &a, const Double4 &b ) { return _mm256_add_pd( a.v, b.v ); }
+inline Double4 operator-( const Double4 &a, const Double4 &b ) { return _mm256_sub_pd( a.v, b.v ); }
+inline Double4 operator*( const Double4 &a, const Double4 &b ) { return _mm256_mul_pd( a.v, b.v ); }
+inline Double4 operator/( const Double4 &a, const Double4 &b ) { return _mm256_div_pd( a.v, b.v ); }
+inline Double4 operator&( const Double4 &a, const Double4 &b ) { return _mm256_and_pd( a.v, b.v ); }
+inline Double4 operator|( const Double4 &a, const Double4 &b ) { return _mm256_or_pd ( a.v, b.v ); }
+inline Double4 operator<( const Double4 &a, const Double4 &b ) { return _mm256_cmp_pd( a.v, b.v, _CMP_LT_OQ ); }
+inline Double4 operator<=( const Double4 &a, const Double4 &b ) { return _mm256_cmp_pd( a.v, b.v, _CMP_LE_OQ ); }
+inline Double4 operator>( const Double4 &a, const Double4 &b ) { return _mm256_cmp_pd( a.v, b.v, _CMP_GT_OQ ); }
+inline Double4 operator>=( const Double4 &a, const Double4 &b ) { return _mm256_cmp_pd( a.v, b.v, _CMP_GE_OQ ); }
+inline Double4 operator==( const Double4 &a, const Double4 &b ) { return _mm256_cmp_pd( a.v, b.v, _CMP_EQ_OQ ); }
+inline Double4 operator!=( const Double4 &a, const Double4 &b ) { return _mm256_cmp_pd( a.v, b.v, _CMP_NEQ_UQ ); }
+inline Double4 sqrt( const Double4 &a ) { return _mm256_sqrt_pd( a.v ); }
+inline Double4 min ( const Double4 &a, const Double4 &b ) { return _mm256_min_pd( a.v, b.v ); }
+inline Double4 max ( const Double4 &a, const Double4 &b ) { return _mm256_max_pd( a.v, b.v ); }
+inline Double4 Select( const Double4 &mask, const Double4 &a, const Double4 &b ) { return _mm256_blendv_pd( b.v, a.v, mask.v ); }
+inline int     Bits( const Double4 &mask ) { return _mm256_movemask_pd( mask.v ); }
+inline Double4 Single( const Double4 &a ) { return _mm256_cvtps_pd( _mm256_cvtpd_ps( a.v ) ); }
+#if defined(SIMD_FMA)
+inline Double4 MulAdd( const Double4 &a, const Double4 &b, const Double4 &c ) { return _mm256_fmadd_pd( a.v, b.v, c.v ); }
+inline Double4 MulSub( const Double4 &a, const Double4 &b, const Double4 &c ) { return _mm256_fmsub_pd( a.v, b.v, c.v ); }
+#endif
+
+#elif defined(SIMD_SSE2)
+
+inline Double4::Double4( double x ) { lo = hi = _mm_set1_pd( x ); }
+inline Double4 Double4::Load( const double *p ) { return Double4( _mm_loadu_pd( p ), _mm_loadu_pd( p + 2 ) ); }
+inline void Double4::Store( double *p ) const { _mm_storeu_pd( p, lo ); _mm_storeu_pd( p + 2, hi ); }
+
+#define SIMD_BINARY( op, intrinsic ) \
+    inline Double4 op( const Double4 &a, const Double4 &b ) { return Double4( intrinsic( a.lo, b.lo ), intrinsic( a.hi, b.hi ) ); }
+
+SIMD_BINARY( operator+ , _mm_add_pd   )
+SIMD_BINARY( operator- , _mm_sub_pd   )
+SIMD_BINARY( operator* , _mm_mul_pd   )
+SIMD_BINARY( operator/ , _mm_div_pd   )
+SIMD_BINARY( operator& , _mm_and_pd   )
+SIMD_BINARY( operator| , _mm_or_pd    )
+SIMD_BINARY( operator< , _mm_cmplt_pd )
+SIMD_BINARY( operator<=, _mm_cmple_pd )
+SIMD_BINARY( operator> , _mm_cmpgt_pd )
+SIMD_BINARY( operator>=, _mm_cmpge_pd )
+SIMD_BINARY( operator==, _mm_cmpeq_pd )
+SIMD_BINARY( operator!=, _mm_cmpneq_pd )
+SIMD_BINARY( min       , _mm_min_pd   )
+SIMD_BINARY( max       , _mm_max_pd   )
+
+#undef SIMD_BINARY
+
+inline Double4 sqrt( const Double4 &a ) { return Double4( _mm_sqrt_pd( a.lo ), _mm_sqrt_pd( a.hi ) ); }
+inline Double4 Select( const Double4 &mask, const Double4 &a, const Double4 &b )
+    {
+    return Double4(
+        _mm_or_pd( _mm_and_pd( mask.lo, a.lo ), _mm_andnot_pd( mask.lo, b.lo ) ),
+        _mm_or_pd( _mm_and_pd( mask.hi, a.hi ), _mm_andnot_pd( mask.hi, b.hi ) ) );
+    }
+inline int Bits( const Double4 &mask ) { return _mm_movemask_pd( mask.lo ) | ( _mm_movemask_pd( mask.hi ) << 2 ); }
+inline Double4 Single( const Double4 &a ) { return Double4( _mm_cvtps_pd( _mm_cvtpd_ps( a.lo ) ), _mm_cvtps_pd( _mm_cvtpd_ps( a.hi ) ) ); }
+
+#else
+
+// In the portable version a lane of a mask is 1.0 if true and 0.0 if false.
+
+inline Double4::Double4( double x ) { v[0] = v[1] = v[2] = v[3] = x; }
+inline Double4 Double4::Load( const double *p ) { Double4 a; for( int i = 0; i < 4; i++ ) a.v[i] = p[i]; return a; }
+inline void Double4::Store( double *p ) const { for( int i = 0; i < 4; i++ ) p[i] = v[i]; }
+
+#define SIMD_BINARY( op, expr ) \
+    inline Double4 op( const Double4 &a, const Double4 &b ) \
+        { Double4 c; for( int i = 0; i < 4; i++ ) { const double x = a.v[i], y = b.v[i]; c.v[i] = ( expr ); } return c; }
+
+SIMD_BINARY( operator+ , x + y )
+SIMD_BINARY( operator- , x - y )
+SIMD_BINARY( operator* , x * y )
+SIMD_BINARY( operator/ , x / y )
+SIMD_BINARY( operator& , ( x != 0.0 && y != 0.0 ) ? 1.0 : 0.0 )
+SIMD_BINARY( operator| , ( x != 0.0 || y != 0.0 ) ? 1.0 : 0.0 )
+SIMD_BINARY( operator< , x <  y ? 1.0 : 0.0 )
+SIMD_BINARY( operator<=, x <= y ? 1.0 : 0.0 )
+SIMD_BINARY( operator> , x >  y ? 1.0 : 0.0 )
+SIMD_BINARY( operator>=, x >= y ? 1.0 : 0.0 )
+SIMD_BINARY( operator==, x == y ? 1.0 : 0.0 )
+SIMD_BINARY( operator!=, x != y ? 1.0 : 0.0 )
+SIMD_BINARY( min       , x < y ? x : y )
+SIMD_BINARY( max       , x > y ? x : y )
+
+#undef SIMD_BINARY
+
+inline Double4 sqrt( const Double4 &a ) { Double4 c; for( int i = 0; i < 4; i++ ) c.v[i] = std::sqrt( a.v[i] ); return c; }
+inline Double4 Select( const Double4 &mask, const Double4 &a, const Double4 &b )
+    {
+    Double4 c;
+    for( int i = 0; i < 4; i++ ) c.v[i] = mask.v[i] != 0.0 ? a.v[i] : b.v[i];
+    return c;
+    }
+inline int Bits( const Double4 &mask )
+    {
+    int bits = 0;
+    for( int i = 0; i < 4; i++ ) if( mask.v[i] != 0.0 ) bits |= 1 << i;
+    return bits;
+    }
+inline Double4 Single( const Double4 &a ) { Double4 c; for( int i = 0; i < 4; i++ ) c.v[i] = float( a.v[i] ); return c; }
+
+#endif
+
+// The absolute value of each lane.
+inline Double4 abs( const Double4 &a ) { return max( a, Double4( 0.0 ) - a ); }
+
+#if !defined(SIMD_FMA)
+inline Double4 MulAdd( const Double4 &a, const Double4 &b, const Double4 &c ) { return a * b + c; }
+inline Double4 MulSub( const Double4 &a, const Double4 &b, const Double4 &c ) { return a * b - c; }
+#endif
+
+#endif
@@ -17,17 +17,23 @@
 * falls on the positive part of the ray, and if so, which is closer.       *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Point & normal are now filled in by FinalizeHit.           *
+*   10/18/2026  Geometry made available for packing.                       *
+*   10/18/2026  Added batched intersection.                                *
 *   10/10/2004  Broken out of objects.C file.                              *
 *                                                                          *
 ***************************************************************************/
 #include "toytracer.h"
 #include "util.h"
 #include "params.h"
+#include "packed.h"
 
 struct Sphere : public Primitive {
     Sphere() {}
     Sphere( const Vec3 &center, double radius );
     virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual void IntersectBatch( const RayBatch &, const unsigned *, unsigned, HitInfo * ) const;
+    virtual void FinalizeHit( const Ray &ray, HitInfo & ) const;
     virtual bool Inside( const Vec3 &P ) const { return dist( P, center ) <= radius; } 
     virtual Interval GetSlab( const Vec3 & ) const;
     virtual int GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const;
@@ -42,6 +48,7 @@ struct Sphere : public Primitive {
 // the toytracer will automatically recognize the sphere object.
 
 REGISTER_PLUGIN( Sphere );
+DEFINE_PRIMITIVE_STAT( tests, "sphere" );
 
 
 Sphere::Sphere( const Vec3 &cent, double rad )
@@ -51,6 +58,17 @@ Sphere::Sphere( const Vec3 &cent, double rad )
     radius2 = rad * rad;
     }
 
+// Return the center and radius if the object is a sphere.  This allows the
+// aggregates to pack spheres together (see packed.cpp).
+bool SphereGeometry( const Object *obj, Vec3 &center, double &radius )
+    {
+    const Sphere *sphere = dynamic_cast<const Sphere*>( obj );
+    if( sphere == NULL ) return false;
+    center = sphere->center;
+    radius = sphere->radius;
+    return true;
+    }
+
 Plugin *Sphere::ReadString( const string &params ) // Reads params from a string.
     {
     Vec3 cent;
@@ -69,6 +87,7 @@ Interval Sphere::GetSlab( const Vec3 &v ) const
 
 bool Sphere::Intersect( const Ray &ray, HitInfo &hitinfo ) const
     {
+    STAT_PRIMITIVE_TEST( tests );
     const Vec3 A( ray.origin - center );
     const Vec3 R( ray.direction );
     const double b = 2.0 * ( A * R );
@@ -100,16 +119,47 @@ bool Sphere::Intersect( const Ray &ray, HitInfo &hitinfo ) const
         if( s > hitinfo.distance ) return false;
         }
 
-    // We have an actual hit.  Fill in all the geometric information so
-    // that the shader can shade this point.
+    // We have an actual hit.  The point and normal are filled in later by
+    // FinalizeHit, if this turns out to be the closest hit.
 
     hitinfo.distance = s;
-    hitinfo.point    = ray.origin + s * R;
-    hitinfo.normal   = Unit( hitinfo.point - center );
     hitinfo.object   = this;
     return true;
     }
 
+// Fill in all the geometric information so that the shader can shade this point.
+void Sphere::FinalizeHit( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    hitinfo.point  = ray.origin + hitinfo.distance * ray.direction;
+    hitinfo.normal = Unit( hitinfo.point - center );
+    }
+
+// This is the same computation as Intersect, but streamed over the origins
+// and directions of the batch, which are stored as structure-of-arrays.
+// Here "b" is half the linear coefficient of the quadratic, which saves a
+// few multiplications.
+void Sphere::IntersectBatch( const RayBatch &batch, const unsigned *active, unsigned n, HitInfo *hits ) const
+    {
+    STAT_PRIMITIVE_TESTS( tests, n );
+    for( unsigned k = 0; k < n; k++ )
+        {
+        const unsigned i = active[k];
+        const double Ax = batch.Qx[i] - center.x;
+        const double Ay = batch.Qy[i] - center.y;
+        const double Az = batch.Qz[i] - center.z;
+        const double b  = Ax * batch.Rx[i] + Ay * batch.Ry[i] + Az * batch.Rz[i];
+        const double discr = b * b - ( Ax * Ax + Ay * Ay + Az * Az - radius2 );
+        if( discr < 0.0 ) continue;
+        const double radical = sqrt( discr );
+        double s = -b - radical;
+        if( s <= 0.0 ) s = -b + radical;
+        if( s <= 0.0 || s > hits[i].distance ) continue;
+
+        hits[i].distance = s;
+        hits[i].object   = this;
+        }
+    }
+
 int Sphere::GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const
     {
     int count = 0;
@@ -0,0 +1,215 @@
+/***************************************************************************
+* stats.cpp                                                                *
+*                                                                          *
+* The per-thread blocks of render counters, and the functions that merge   *
+* and report them.  See stats.h.                                           *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Blocks of threads that exit are retired & freed.           *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include "stats.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+static const char *counter_names[ num_stat_counters ] = {
+    "primary_rays",
+    "shadow_rays",
+    "reflection_rays",
+    "refraction_rays",
+    "indirect_rays",
+    "box_tests",
+    "node_visits",
+    "shader_calls"
+    };
+
+// The names of the primitive counters are registered during static
+// initialization, so they are kept in plain arrays, which are zeroed before
+// any constructors run.
+static const char *primitive_names[ max_primitive_stats ];
+static unsigned    num_primitive_stats;
+
+// The blocks of counters of the threads that are running, one per thread,
+// and the sum of those of the threads that have exited.  All are guarded by
+// the lock; the counters themselves are written only by their own threads.
+static std::mutex            stats_lock;
+static vector<RenderStats *> all_stats;
+static RenderStats           retired_stats;
+
+STATS_THREAD_LOCAL RenderStats *thread_stats = NULL;
+
+// Counters written by different threads are kept on separate cache lines.
+struct PaddedStats : public RenderStats {
+    char padding[ 64 ];
+    };
+
+void RenderStats::Clear()
+    {
+    for( unsigned i = 0; i < num_stat_counters;   i++ ) count[i] = 0;
+    for( unsigned i = 0; i < max_primitive_stats; i++ ) primitive[i] = 0;
+    depth = 0;
+    }
+
+RenderStats &RenderStats::operator+=( const RenderStats &s )
+    {
+    for( unsigned i = 0; i < num_stat_counters;   i++ ) count[i] += s.count[i];
+    for( unsigned i = 0; i < max_primitive_stats; i++ ) primitive[i] += s.primitive[i];
+    if( s.depth > depth ) depth = s.depth;
+    return *this;
+    }
+
+unsigned long long RenderStats::Rays() const
+    {
+    return count[ stat_primary_rays    ] + count[ stat_shadow_rays   ] +
+           count[ stat_reflection_rays ] + count[ stat_refraction_rays ] +
+           count[ stat_indirect_rays   ];
+    }
+
+unsigned long long RenderStats::Tests() const
+    {
+    unsigned long long n = 0;
+    for( unsigned i = 0; i < num_primitive_stats; i++ ) n += primitive[i];
+    return n;
+    }
+
+// Called as a thread that has counted anything exits.  Its counts are added
+// into the retired total, and its block is freed.
+static void RetireThreadStats( RenderStats *stats )
+    {
+    std::lock_guard<std::mutex> guard( stats_lock );
+    retired_stats += *stats;
+    for( unsigned i = 0; i < all_stats.size(); i++ )
+        {
+        if( all_stats[i] != stats ) continue;
+        all_stats[i] = all_stats.back();
+        all_stats.pop_back();
+        break;
+        }
+    delete static_cast<PaddedStats *>( stats );
+    thread_stats = NULL;
+    }
+
+// A thread-local variable with a destructor is not available in VS2012, so
+// the block of each thread is also stored under a key whose destructor the
+// system calls as the thread exits: a fiber-local slot on Windows, and a
+// pthread key elsewhere.
+#ifdef _WIN32
+static VOID WINAPI ThreadExit( PVOID stats ) { if( stats != NULL ) RetireThreadStats( (RenderStats *)stats ); }
+static DWORD exit_key = FlsAlloc( ThreadExit );
+static void WatchThreadExit( RenderStats *stats ) { FlsSetValue( exit_key, stats ); }
+#else
+static void ThreadExit( void *stats ) { RetireThreadStats( (RenderStats *)stats ); }
+static pthread_key_t exit_key;
+static int exit_key_made = pthread_key_create( &exit_key, ThreadExit );
+static void WatchThreadExit( RenderStats *stats ) { pthread_setspecific( exit_key, stats ); }
+#endif
+
+RenderStats &NewThreadStats()
+    {
+    RenderStats *stats = new PaddedStats;
+        {
+        std::lock_guard<std::mutex> guard( stats_lock );
+        all_stats.push_back( stats );
+        }
+    thread_stats = stats;
+    WatchThreadExit( stats );
+    return *stats;
+    }
+
+unsigned RegisterPrimitiveStat( const char *name )
+    {
+    // Plugins sharing a name (e.g. the packed variants) share a counter.
+    for( unsigned i = 0; i < num_primitive_stats; i++ )
+        {
+        if( string( primitive_names[i] ) == name ) return i;
+        }
+    if( num_primitive_stats == max_primitive_stats )
+        {
+        return max_primitive_stats - 1; // Lump any excess into the last counter.
+        }
+    primitive_names[ num_primitive_stats ] = name;
+    return num_primitive_stats++;
+    }
+
+RenderStats MergedStats()
+    {
+    std::lock_guard<std::mutex> guard( stats_lock );
+    RenderStats sum( retired_stats );
+    for( unsigned i = 0; i < all_stats.size(); i++ ) sum += *all_stats[i];
+    return sum;
+    }
+
+void ResetStats()
+    {
+    std::lock_guard<std::mutex> guard( stats_lock );
+    retired_stats.Clear();
+    for( unsigned i = 0; i < all_stats.size(); i++ ) all_stats[i]->Clear();
+    }
+
+static double Rate( unsigned long long n, double seconds )
+    {
+    return seconds > 0.0 ? n / seconds : 0.0;
+    }
+
+void PrintStats( ostream &out, double seconds )
+    {
+    if( !STATS_ENABLED ) return;
+    const RenderStats s( MergedStats() );
+    const unsigned long long rays = s.Rays();
+    const unsigned long long prims = s.Tests();
+    out << "Render statistics (" << seconds << " seconds):" << endl;
+    for( unsigned i = 0; i < num_stat_counters; i++ )
+        {
+        out << "    " << std::setw(20) << std::left << counter_names[i]
+            << std::setw(14) << std::right << s.count[i] << endl;
+        }
+    for( unsigned i = 0; i < num_primitive_stats; i++ )
+        {
+        if( s.primitive[i] == 0 ) continue;
+        out << "    " << std::setw(20) << std::left << ( string( primitive_names[i] ) + "_tests" )
+            << std::setw(14) << std::right << s.primitive[i] << endl;
+        }
+    out << "    max ray depth       " << s.depth << endl;
+    out << "    rays/s              " << Rate( rays, seconds ) << endl;
+    out << "    box tests/s         " << Rate( s.count[ stat_box_tests ], seconds ) << endl;
+    out << "    primitive tests/s   " << Rate( prims, seconds ) << endl;
+    if( rays > 0 )
+        {
+        out << "    nodes/ray           " << double( s.count[ stat_node_visits ] ) / rays << endl;
+        out << "    primitive tests/ray " << double( prims ) / rays << endl;
+        }
+    }
+
+bool WriteStats( const string &file_name, double seconds )
+    {
+    if( !STATS_ENABLED ) return false;
+    std::ofstream out( file_name.c_str() );
+    if( !out ) return false;
+    const RenderStats s( MergedStats() );
+    const unsigned long long rays = s.Rays();
+    const unsigned long long prims = s.Tests();
+    out << "{\n";
+    out << "  \"seconds\": " << seconds << ",\n";
+    out << "  \"rays\": " << rays << ",\n";
+    for( unsigned i = 0; i < num_stat_counters; i++ )
+        out << "  \"" << counter_names[i] << "\": " << s.count[i] << ",\n";
+    out << "  \"max_depth\": " << s.depth << ",\n";
+    out << "  \"primitive_tests\": {";
+    for( unsigned i = 0, n = 0; i < num_primitive_stats; i++ )
+        out << ( n++ > 0 ? ", " : " " ) << "\"" << primitive_names[i] << "\": " << s.primitive[i];
+    out << " },\n";
+    out << "  \"rays_per_second\": " << Rate( rays, seconds ) << ",\n";
+    out << "  \"box_tests_per_second\": " << Rate( s.count[ stat_box_tests ], seconds ) << ",\n";
+    out << "  \"primitive_tests_per_second\": " << Rate( prims, seconds ) << ",\n";
+    out << "  \"nodes_per_ray\": " << ( rays > 0 ? double( s.count[ stat_node_visits ] ) / rays : 0.0 ) << "\n";
+    out << "}\n";
+    return !out.fail();
+    }
@@ -0,0 +1,128 @@
+/***************************************************************************
+* stats.h                                                                  *
+*                                                                          *
+* Render statistics: counts of the rays cast (by kind), ray-box tests,     *
+* aggregate nodes visited, primitive intersection tests (by plugin), and   *
+* shader invocations, along with the depth of the deepest ray tree.        *
+* Statistics are gathered only when the toytracer is compiled with         *
+* TOYTRACER_STATS defined; otherwise the counting macros expand to         *
+* nothing, and cost nothing.                                               *
+*                                                                          *
+* Each thread increments its own block of counters, found through a        *
+* thread-local pointer, so counting requires neither locks nor atomic      *
+* operations.  When a thread exits, its counts are added into a retired    *
+* total and its block is freed, so the threads started for each job or     *
+* frame leave nothing behind.  The blocks are merged, under a lock, when   *
+* the statistics are reported; the counts of threads still rendering may   *
+* be read part way through an update, so report once rendering is done.    *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Blocks of threads that exit are retired & freed.           *
+*   10/18/2026  Added the depth of the deepest ray tree.                   *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#ifndef __STATS_INCLUDED__
+#define __STATS_INCLUDED__
+
+#include "base.h"
+
+// The counters, other than those for the primitive tests.
+enum stat_counter {
+    stat_primary_rays,     // Rays cast from the eye by a rasterizer.
+    stat_shadow_rays,      // Rays cast towards lights.
+    stat_reflection_rays,  // Rays cast in the mirror direction.
+    stat_refraction_rays,  // Rays cast through translucent objects.
+    stat_indirect_rays,    // Rays cast to sample indirect illumination.
+    stat_box_tests,        // Ray-box tests (see aabb.cpp).
+    stat_node_visits,      // Nodes or cells of aggregates visited, per ray or packet.
+    stat_shader_calls,     // Surfaces shaded.
+    num_stat_counters
+    };
+
+static const unsigned max_primitive_stats = 32; // Primitive types counted separately.
+
+struct RenderStats {  // One block of counters.
+    RenderStats() { Clear(); }
+    void Clear();
+    RenderStats &operator+=( const RenderStats & );
+    unsigned long long Rays() const;  // All rays, of whatever kind.
+    unsigned long long Tests() const; // All primitive tests, of whatever type.
+    unsigned long long count    [ num_stat_counters   ];
+    unsigned long long primitive[ max_primitive_stats ];
+    unsigned depth;                   // Largest generation of any ray cast.
+    };
+
+#if defined(_MSC_VER)
+#define STATS_THREAD_LOCAL __declspec(thread)
+#else
+#define STATS_THREAD_LOCAL __thread
+#endif
+
+// The counters of the calling thread, which are created the first time that
+// the thread counts anything.
+extern STATS_THREAD_LOCAL RenderStats *thread_stats;
+
+extern RenderStats &NewThreadStats(
+    );
+
+inline RenderStats &ThreadStats()
+    {
+    RenderStats *stats = thread_stats;
+    return stats != NULL ? *stats : NewThreadStats();
+    }
+
+inline void StatDepth( unsigned generation )
+    {
+    RenderStats &stats = ThreadStats();
+    if( generation > stats.depth ) stats.depth = generation;
+    }
+
+// Return the index of the counter for tests against the named kind of
+// primitive.  This is called at startup, via DEFINE_PRIMITIVE_STAT.
+extern unsigned RegisterPrimitiveStat(
+    const char *name
+    );
+
+// The sum of the counters of all threads.
+extern RenderStats MergedStats(
+    );
+
+// Zero the counters of all threads (e.g. before rendering another image).
+extern void ResetStats(
+    );
+
+// Write a summary of the merged counters, including the rates given the
+// time spent rendering in seconds.  Nothing is written if statistics were not
+// compiled in.
+extern void PrintStats(
+    ostream &out,
+    double seconds
+    );
+
+// Write the merged counters and rates as a JSON object.  Returns false if the
+// file could not be written, or if statistics were not compiled in.
+extern bool WriteStats(
+    const string &file_name,
+    double seconds
+    );
+
+#ifdef TOYTRACER_STATS
+#define STATS_ENABLED true
+#define STAT_COUNT( counter ) ( ThreadStats().count[ counter ]++ )
+#define STAT_ADD( counter, n ) ( ThreadStats().count[ counter ] += (n) )
+#define STAT_DEPTH( generation ) ( StatDepth( generation ) )
+#define DEFINE_PRIMITIVE_STAT( var, name ) static const unsigned var = RegisterPrimitiveStat( name );
+#define STAT_PRIMITIVE_TEST( var ) ( ThreadStats().primitive[ var ]++ )
+#define STAT_PRIMITIVE_TESTS( var, n ) ( ThreadStats().primitive[ var ] += (n) )
+#else
+#define STATS_ENABLED false
+#define STAT_COUNT( counter ) ((void)0)
+#define STAT_ADD( counter, n ) ((void)0)
+#define STAT_DEPTH( generation ) ((void)0)
+#define DEFINE_PRIMITIVE_STAT( var, name )
+#define STAT_PRIMITIVE_TEST( var ) ((void)0)
+#define STAT_PRIMITIVE_TESTS( var, n ) ((void)0)
+#endif
+
+#endif
@@ -3,10 +3,25 @@
 *                                                                          *
 * The "torus" primitive object is situated on the x-y plane.  It has two   *
 * parameters: the major radius (denoted by "a") and the minor radius       *
-* (denoted by "b").  The ray-torus intersection test is performed          *
-* analytically using a closed-form quartic polynomial root finder.         *
+* (denoted by "b").  The ray-torus intersection test finds the smallest    *
+* root of a quartic polynomial.  By default the ray is first clipped to    *
+* the bounding box, with the origin moved to the point of entry, and only  *
+* the smallest root within the box is isolated (see SmallestRoot), which   *
+* is far more accurate than solving the quartic, especially for distant    *
+* rays, and eliminates speckles on the surface.  The original              *
+* closed-form solver can be selected instead by the "closed_form" keyword: *
+*                                                                          *
+*    torus a b [closed_form]                                               *
+*                                                                          *
+* Batches of rays are instead clipped & translated in the same way, and    *
+* then all of their quartics are solved at once by SolveQuartics.          *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  The slabs bound the torus in every direction.              *
+*   10/18/2026  The quartic is always set up in double precision.          *
+*   10/18/2026  Point & normal are now filled in by FinalizeHit.           *
+*   10/18/2026  Added batched intersection using the SIMD quartic solver.  *
+*   10/18/2026  Roots isolated within the bounding box.                    *
 *   10/12/2005  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -17,8 +32,14 @@
 
 struct torus : public Primitive {
     torus() {}
-    torus( double major_radius, double minor_radius );
+    torus( double major_radius, double minor_radius, bool closed_form = false );
     virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual void IntersectBatch( const RayBatch &, const unsigned *, unsigned, HitInfo * ) const;
+    bool IntersectClosedForm( const Ray &ray, HitInfo & ) const;
+    void Quartic( const Ray &ray, double t, double coeff[] ) const;
+    bool Hit( double s, HitInfo & ) const;
+    virtual void FinalizeHit( const Ray &ray, HitInfo & ) const;
+    bool Clip( const Ray &ray, double max_dist, Interval &I ) const;
     virtual bool Inside( const Vec3 &P ) const; 
     virtual Interval GetSlab( const Vec3 & ) const;
     virtual int GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const;
@@ -31,11 +52,13 @@ struct torus : public Primitive {
     double rad;  // a + b
     double rad2; // rad * rad 
     AABB   bbox;
+    bool   closed_form; // Solve the full quartic rather than isolating a root.
     };
 
 REGISTER_PLUGIN( torus );
+DEFINE_PRIMITIVE_STAT( tests, "torus" );
 
-torus::torus( double major_radius, double minor_radius )
+torus::torus( double major_radius, double minor_radius, bool closed )
     {
     // Pre-compute the often-used values that depend only on the parameters.
     a    = major_radius;
@@ -44,19 +67,22 @@ torus::torus( double major_radius, double minor_radius )
     rad  = a + b;
     rad2 = rad * rad;
     bbox = AABB( Interval( -rad, rad ), Interval( -rad, rad ), Interval( -b, b ) );
+    closed_form = closed;
     }
 
 Plugin *torus::ReadString( const string &params ) // Reads params from a string.
     {
     double ra, rb;
     ParamReader get( params );
-    if( get[MyName()] && get[ra] && get[rb] ) return new torus( ra, rb );
+    if( get[MyName()] && get[ra] && get[rb] ) return new torus( ra, rb, get["closed_form"] );
     return NULL;
     }
 
 Interval torus::GetSlab( const Vec3 &v ) const
     {
-    double d = a * ( v.x * v.x + v.y * v.y ) / ( v * v ) + b / Length(v);
+    // The central circle of radius a reaches a * |(v.x, v.y)| along v, and the
+    // tube extends it by b * |v|.
+    const double d = ( a * sqrt( v.x * v.x + v.y * v.y ) + b * Length(v) ) / ( v * v );
     return Interval( -d, d );
     }
 
@@ -72,12 +98,67 @@ bool torus::Inside( const Vec3 &P ) const
     return dist( P, Q ) <= b;
     }
 
-bool torus::Intersect( const Ray &ray, HitInfo &hitinfo ) const
+// Set up the quartic polynomial that results from plugging the ray equation
+// into the implicit equation of the torus.  That is,
+//
+//   || P  -  a Q(P) || = b    (implicit euqation of torus.)
+//
+//    P  =  Q + R s            (parametric form of a ray.)
+//
+// where Q(P) is the closest point to P that is on the unit-radius circle,
+// centered at the origin, in the x-y plane.  The function Q is given by
+//
+//    Q(P)  =  ( Px, Py, 0 ) / sqrt( Px Px  +  Py Py )
+//
+// When the radical are removed via squaring, the result is a quartic
+// equation in s, the distance along the ray to the point of intersection.
+// The coefficients are returned in ascending order, starting with the constant.
+// The ray origin is first moved a distance t along the ray.  All of this is
+// done in double precision, even when Vec3 holds floats, since the constant
+// coefficient suffers heavy cancellation.
+//
+void torus::Quartic( const Ray &ray, double t, double coeff[] ) const
+    {
+    const double Qx = ray.origin.x + t * ray.direction.x;
+    const double Qy = ray.origin.y + t * ray.direction.y;
+    const double Qz = ray.origin.z + t * ray.direction.z;
+    const double Rz = ray.direction.z;
+    const double QQ = Qx * Qx + Qy * Qy + Qz * Qz;
+    const double QR = Qx * ray.direction.x + Qy * ray.direction.y + Qz * Rz;
+    const double a2 = a * a;
+    coeff[0] = sqr( QQ - a2b2 ) - 4.0 * a2 * ( b * b - Qz * Qz );        // Constant
+    coeff[1] = 4.0 * QR * ( QQ - a2b2 ) + 8.0 * a2 * Qz * Rz;            // Linear
+    coeff[2] = 2.0 * ( QQ - a2b2 ) + 4.0 * ( QR * QR + a2 * Rz * Rz );   // Quadratic
+    coeff[3] = 4.0 * QR;                                                 // Cubic
+    coeff[4] = 1.0;                                                      // Quartic
+    }
+
+// Record a hit at distance s along the ray.  The point and normal are filled
+// in by FinalizeHit, if this turns out to be the closest hit.
+bool torus::Hit( double s, HitInfo &hitinfo ) const
+    {
+    hitinfo.distance = s;
+    hitinfo.object   = this;
+    return true;
+    }
+
+void torus::FinalizeHit( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    // Compute the actual point of intersection using the distance.
+    const Vec3 P( ray.origin + hitinfo.distance * ray.direction );
+    hitinfo.point  = P;
+    hitinfo.normal = Unit( P - a * Unit( P.x, P.y, 0.0 ) ); 
+    }
+
+// Rays cast from the surface itself (e.g. shadow rays) have a root at zero,
+// which round-off can move to either side.  Roots closer than this to the
+// origin are therefore ignored; otherwise they show up as speckles.
+static const double min_distance = RayEps;
+
+// Find the part of the ray within the bounding box, no farther than max_dist.
+// Returns false if the ray misses the torus trivially.
+bool torus::Clip( const Ray &ray, double max_dist, Interval &I ) const
     {
-    // THINGS TO DO: Should reposition the ray origin to the intersection
-    // with the bounding box.  This will increase the accuracy of the root
-    // finder.
-    roots rts;
     const Vec3 R( ray.direction );
     const Vec3 Q( ray.origin    );
 
@@ -95,55 +176,106 @@ bool torus::Intersect( const Ray &ray, HitInfo &hitinfo ) const
         }
 
     // See if the ray trivially misses the infinite bounding cylinder.
-    // If not, the results of this computation will be used for root finding.
     const double qq = Q.x * Q.x + Q.y * Q.y;
     const double qr = Q.x * R.x + Q.y * R.y;
     if( qr > 0.0 && qq >= rad2 ) return false;
 
-    // Perform a bounding-box test.
-    if( !Hit( ray, bbox ) ) return false;
+    return ::Hit( ray, bbox, I, max_dist );
+    }
 
-    const double QQ = qq + Q.z * Q.z;
-    const double QR = qr + Q.z * R.z;
-    const double a2 = a * a;
+bool torus::Intersect( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    STAT_PRIMITIVE_TEST( tests );
+    if( closed_form ) return IntersectClosedForm( ray, hitinfo );
 
-    // Set up and solve the quartic polynomial that results from plugging
-    // the ray equation into the implicit equation of the torus.  That is,
-    //
-    //   || P  -  a Q(P) || = b    (implicit euqation of torus.)
-    //
-    //    P  =  Q + R s            (parametric form of a ray.)
-    //
-    // where Q(P) is the closest point to P that is on the unit-radius circle,
-    // centered at the origin, in the x-y plane.  The function Q is given by
-    //
-    //    Q(P)  =  ( Px, Py, 0 ) / sqrt( Px Px  +  Py Py )
-    //
-    // When the radical are removed via squaring, the result is a quartic
-    // equation in s, the distance along the ray to the point of intersection.
-    //
-    SolveQuartic(
-        sqr( QQ - a2b2 ) - 4.0 * a2 * ( b * b - Q.z * Q.z ),      // Constant
-        4.0 * QR * ( QQ - a2b2 ) + 8.0 * a2 * Q.z * R.z,          // Linear
-        2.0 * ( QQ - a2b2 ) + 4.0 * ( QR * QR + a2 * R.z * R.z ), // Quadratic
-        4.0 * QR,                                                 // Cubic
-        1.0,                                                      // Quartic
-        rts // The real roots returned by the solver.
-        );
+    // Clip the ray to the bounding box.  Moving the origin to the entry point
+    // keeps the coefficients of the quartic small, which avoids catastrophic
+    // cancellation for distant rays.  Only the smallest root in the box is
+    // needed, which SmallestRoot finds without solving for the others.
+    Interval I;
+    if( !Clip( ray, hitinfo.distance, I ) ) return false;
+
+    double coeff[5];
+    Quartic( ray, I.min, coeff );
+    double s;
+    if( !SmallestRoot( coeff, 4, max( 0.0, min_distance - I.min ), I.max - I.min, s ) ) return false;
+
+    // As before, a hit must be strictly closer than the closest hit so far.
+    s += I.min;
+    if( s >= hitinfo.distance ) return false;
+    return Hit( s, hitinfo );
+    }
+
+// The rays are clipped and translated as in Intersect, and their quartics
+// are gathered into groups, each of which is solved by SolveQuartics.  Only
+// then is the smallest root within the box selected for each ray.
+void torus::IntersectBatch( const RayBatch &batch, const unsigned *active, unsigned n, HitInfo *hits ) const
+    {
+    if( closed_form ) { Object::IntersectBatch( batch, active, n, hits ); return; }
+    STAT_PRIMITIVE_TESTS( tests, n );
+
+    static const unsigned group_size = 64;
+    double   coeff[5][ group_size ];
+    double   root [4][ group_size ];
+    Interval clip [ group_size ];
+    unsigned index[ group_size ];
+    double *const a[] = { coeff[0], coeff[1], coeff[2], coeff[3], coeff[4] };
+    double *const r[] = { root[0], root[1], root[2], root[3] };
+
+    for( unsigned k = 0; k < n; )
+        {
+        // Gather the next group of rays that reach the bounding box.
+        unsigned count = 0;
+        for( ; k < n && count < group_size; k++ )
+            {
+            const unsigned i = active[k];
+            const Ray &ray = batch.rays[i];
+            if( !Clip( ray, hits[i].distance, clip[count] ) ) continue;
+            double c[5];
+            Quartic( ray, clip[count].min, c );
+            for( int j = 0; j < 5; j++ ) coeff[j][count] = c[j];
+            index[count++] = i;
+            }
+        if( count == 0 ) continue;
+
+        SolveQuartics( count, a, r );
+
+        // Roots that are not real are NaN, and fail every comparison.
+        for( unsigned j = 0; j < count; j++ )
+            {
+            const double lo = max( 0.0, min_distance - clip[j].min );
+            double s = clip[j].max - clip[j].min;
+            bool found = false;
+            for( int m = 0; m < 4; m++ )
+                {
+                if( root[m][j] > lo && root[m][j] <= s ) { s = root[m][j]; found = true; }
+                }
+            HitInfo &hit = hits[ index[j] ];
+            s += clip[j].min;
+            if( found && s < hit.distance ) Hit( s, hit );
+            }
+        }
+    }
+
+// The original test, which solves the quartic in closed form for all of its
+// roots, using the ray as given.
+bool torus::IntersectClosedForm( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    // Perform the trivial reject & bounding-box tests.
+    Interval I;
+    if( !Clip( ray, Infinity, I ) ) return false;
+
+    double coeff[5];
+    Quartic( ray, 0.0, coeff );
+
+    roots rts;
+    SolveQuartic( coeff[0], coeff[1], coeff[2], coeff[3], coeff[4], rts );
 
     // If the smallest positive root is larger than the distance already
     // in hitinfo, then we do not consider it a hit.
     double s = hitinfo.distance;
     if( !rts.MinPositiveRoot( s ) ) return false;
-
-    // Compute the actual point of intersection using the distance.
-    Vec3 P( ray.origin + s * R );
-
-    hitinfo.distance = s;
-    hitinfo.point    = P;
-    hitinfo.normal   = Unit( P - a * Unit( P.x, P.y, 0.0 ) ); 
-    hitinfo.object   = this;
-    return true;
+    return Hit( s, hitinfo );
     }
 
 int torus::GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const
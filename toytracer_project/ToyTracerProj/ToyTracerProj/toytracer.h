@@ -6,6 +6,16 @@
 * fundamental structures needed by the ray tracer.                         *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Added Shader::SecondaryRays.                               *
+*   10/18/2026  Rasterizers can report their progress (RenderProgress).    *
+*   10/18/2026  Added Shader::ShadowRay & HitInfo::blocked.                *
+*   10/18/2026  Added Scene::Destroy.                                      *
+*   10/18/2026  Added Rebuild to Aggregate & Threads to Rasterizer.        *
+*   10/18/2026  Includes stats.h, for the render statistics.               *
+*   10/18/2026  Added FinalizeHit; Intersect records only the distance.    *
+*   10/18/2026  Added the pending transforms (frames) to HitInfo.          *
+*   10/18/2026  Added Prototype to Aggregate, for instancing.              *
+*   10/18/2026  Added batched intersection (IntersectBatch & CastBatch).   *
 *   10/18/2005  Added Item & Primitive base classes.
 *   09/29/2005  Now supports more plugins, including shaders.              *
 *   10/10/2004  Added Aggregate sub-class & REGISTER_OBJECT macro.         *
@@ -32,6 +42,7 @@
 #include "aabb.h"         // Defines a 3D axis-aligned bounding box.
 #include "ray.h"          // Defines rays in 3-space: origin, direction, etc.
 #include "plugins.h"      // Defines functions for accessing plugins.
+#include "stats.h"        // Defines the render statistics counters.
 
 struct Material {         // Surface material for shading.
     Color  diffuse;       // Diffuse color.
@@ -45,14 +56,28 @@ struct Material {         // Surface material for shading.
     long   type;          // Reserved for future use.
     };
 
+// Intersect records only the distance to a hit, the object, and whatever
+// the object needs to finish the job (the "part" that was hit, or uv).  The
+// point & normal are filled in by FinalizeHit once the closest hit is known.
+// Transformed objects record the transforms that the hit passed through, as
+// the hit must be finalized in the space of the object, then mapped back.
+static const unsigned max_hit_frames = 8;
+
 struct HitInfo {          // Records all info at ray-object intersection.
     const Object *ignore; // One object in scene to ignore (used by Cast).
     const Object *object; // The object that was hit (set by Intersect).
     double  distance;     // Distance to hit (used & reset by Intersect).
-    Vec3    point;        // ray-object intersection point (set by Intersect).
-    Vec3    normal;       // Surface normal (set by Intersect).
-    Vec2    uv;           // Texture coordinates (set by intersect).
+    Vec3    point;        // ray-object intersection point (set by FinalizeHit).
+    Vec3    normal;       // Surface normal (set by FinalizeHit).
+    Vec2    uv;           // Texture coordinates (set by Intersect or FinalizeHit).
+    int     part;         // Which part of the object was hit (set by Intersect).
     Ray     ray;          // The ray that hit the surface (set by Cast).
+    const Object *frame[max_hit_frames]; // Transforms the hit passed through, innermost first.
+    unsigned frames;      // Number of transforms in "frame".
+    bool    finished;     // Point & normal already set in the space of frame[0].
+    const Object *frame_object; // The object hit that the frames belong to (set by transforms).
+    const char *blocked;  // If not NULL, whether the shadow ray to each light was blocked (see Shader::ShadowRay).
+    void Finalize( const Ray &ray ); // Fill in point & normal in the space of the ray.
     };
 
 struct Sample {           // A point and weight returned from a sampling algorithm.
@@ -74,14 +99,19 @@ struct Camera {           // Defines the position of the eye/camera.
 struct Scene {
     Scene();
    ~Scene() { lights.clear(); }
-    Color Trace( const Ray &ray ) const;
+    Color Trace( const Ray &ray, double *distance = NULL ) const;
     bool  Cast ( const Ray &ray, HitInfo &hitinfo ) const;
+    void  CastBatch( const RayBatch &batch, HitInfo *hits ) const;
+    Color Shade( const HitInfo &hitinfo ) const; // Color of a surface that was hit.
+    Color Miss ( const Ray &ray ) const;         // Color seen by a ray that hits nothing.
+    void  Destroy();  // Free the objects, materials & plugins made by the builder.
     virtual const Object *GetLight( unsigned i ) const { return lights[i]; } 
     virtual unsigned NumLights() const { return lights.size(); }
     Envmap     *envmap;      // Global environment map, if ray hits nothing. 
     Object     *object;      // A single primitve or an aggregate object.
     Rasterizer *rasterize;   // This casts all primary rays & makes the image.
     vector<Object*> lights;  // All objects that are emitters.  
+    vector<Material*> materials; // All made by the builder, some no longer used.
     unsigned max_tree_depth; // Limit on depth of the ray tree.
     };
 
@@ -89,6 +119,21 @@ struct Shader : Plugin {  // Each object has an associated shader.
     Shader() {}
     virtual ~Shader() {}
     virtual Color Shade( const Scene &scene, const HitInfo &hitinfo ) const = 0;
+    // A shader that casts a single shadow ray toward each light may return it
+    // here, so that a rasterizer can cast the shadow rays of many hits as one
+    // batch per light.  Whether each was blocked is then passed to Shade in
+    // hitinfo.blocked, and the shader casts none itself.  It must answer alike
+    // for every light of a hit; false means it casts its own (or none).
+    virtual bool ShadowRay( const Scene &, const HitInfo &, unsigned light, Ray & ) const { return false; }
+    // A shader whose color is that of the surface plus weighted colors seen
+    // along secondary rays (such as reflected & refracted rays) may return
+    // those parts here, so that a rasterizer can trace the secondary rays of
+    // many hits as one batch per bounce.  The color of the surface is returned
+    // in "color", and each ray is appended to "rays" & its weight to "weights".
+    // The color that Shade would return is then "color" plus each weight times
+    // the color seen along its ray, up to rounding.  False means that the hit
+    // must be shaded by Shade, which traces its own rays.
+    virtual bool SecondaryRays( const Scene &, const HitInfo &, Color &color, vector<Ray> &rays, vector<Color> &weights ) const { return false; }
     virtual plugin_type PluginType() const { return shader_plugin; }
     };
 
@@ -103,10 +148,14 @@ struct Object : Plugin { // Base class for all objects that can be ray traced.
     Object() { material = 0; shader = 0; envmap = 0; parent = 0; }
     virtual ~Object() {}
     virtual bool Intersect( const Ray &ray, HitInfo & ) const = 0;
+    virtual void IntersectBatch( const RayBatch &, const unsigned *active, unsigned n, HitInfo * ) const;
     virtual unsigned GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, unsigned n ) const { return 0; }
     virtual bool Inside( const Vec3 & ) const = 0;
     virtual Interval GetSlab( const Vec3 & ) const = 0;
     virtual double Cost() const { return 1.0; }
+    virtual void FinalizeHit( const Ray &ray, HitInfo & ) const; // Fill in point & normal.
+    virtual void ToCanonical( const Ray &ray, Ray &c_ray, double &stretch ) const { c_ray = ray; stretch = 1.0; }
+    virtual bool ToParent( HitInfo & ) const { return false; } // Map a hit out of the canonical space.
     Material  *material;
     Shader    *shader;
     Envmap    *envmap;
@@ -124,6 +173,8 @@ struct Aggregate : Object {  // Base class for all Aggregate objects.
     virtual ~Aggregate() { children.clear(); }
     virtual void AddChild( Object *obj ) { children.push_back( obj ); }
     virtual void Close() {} // Called when all children have been added.
+    virtual void Rebuild() {} // Called after children have moved, once closed.
+    virtual bool Prototype() const { return false; } // Geometry for instances only.
     virtual unsigned NumChildren() const { return children.size(); }
     virtual const Object *GetChild( unsigned i ) const { return children[i]; } 
     virtual plugin_type PluginType() const { return aggregate_plugin; }
@@ -141,6 +192,13 @@ struct Builder : Plugin {  // Creates the scene to be rendered.
     virtual plugin_type PluginType() const { return builder_plugin; }
     };
 
+struct RenderProgress {  // Told how far a rasterizer has got with an image.
+    virtual ~RenderProgress() {}
+    // Called as each row (or tile) is finished, possibly from several rendering
+    // threads, with the number finished so far and the total.
+    virtual void Report( unsigned done, unsigned total, const char *units ) = 0;
+    };
+
 struct Rasterizer : Plugin {  // The rasterizer creates all the primary rays.
     Rasterizer() {}
     virtual ~Rasterizer() {}
@@ -149,8 +207,10 @@ struct Rasterizer : Plugin {  // The rasterizer creates all the primary rays.
         const Camera &camera, // Defines the view.
         const Scene &scene,    // Global scene description: object, envmap, etc.
 		const Scene &scene2,
-		const bool &doMotionBlur
+		const bool &doMotionBlur,
+        RenderProgress *progress = NULL // Told of each row or tile finished, if not NULL.
         ) const = 0;
+    virtual unsigned Threads() const { return 1; } // Threads used for one image.
     virtual plugin_type PluginType() const { return rasterizer_plugin; }
     };
 
@@ -0,0 +1,150 @@
+/***************************************************************************
+* trace.cpp                                                                *
+*                                                                          *
+* The per-thread logs of timed spans, and the Chrome trace JSON writer.    *
+* See trace.h.                                                             *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include "trace.h"
+#include "stats.h"  // For STATS_THREAD_LOCAL.
+
+typedef std::chrono::steady_clock trace_clock;
+
+struct trace_event {
+    string      name;
+    const char *category;
+    int         index;
+    double      start;    // Microseconds since StartTrace.
+    double      duration; // Microseconds.
+    };
+
+struct trace_log {   // The spans recorded by one thread.
+    unsigned            tid;
+    string              thread_name;
+    vector<trace_event> events;
+    };
+
+static bool                    trace_enabled = false;
+static trace_clock::time_point trace_start;
+static std::mutex              trace_lock;  // Guards "all_logs".
+static vector<trace_log *>     all_logs;
+
+static STATS_THREAD_LOCAL trace_log *thread_log = NULL;
+
+static trace_log &ThreadLog()
+    {
+    if( thread_log == NULL )
+        {
+        trace_log *log = new trace_log;
+        std::lock_guard<std::mutex> guard( trace_lock );
+        log->tid = all_logs.size();
+        std::stringstream name;
+        name << "thread " << log->tid;
+        log->thread_name = name.str();
+        all_logs.push_back( log );
+        thread_log = log;
+        }
+    return *thread_log;
+    }
+
+static double Now()
+    {
+    return std::chrono::duration<double, std::micro>( trace_clock::now() - trace_start ).count();
+    }
+
+void StartTrace()
+    {
+    trace_start   = trace_clock::now();
+    trace_enabled = true;
+    }
+
+bool TraceEnabled()
+    {
+    return trace_enabled;
+    }
+
+void SetTraceThreadName( const string &name )
+    {
+    ThreadLog().thread_name = name;
+    }
+
+TraceSpan::TraceSpan( const char *name_, const char *category_, int index_ )
+    : category( category_ ), index( index_ )
+    {
+    start = -1.0;
+    if( !trace_enabled ) return;
+    name  = name_;
+    start = Now();
+    }
+
+TraceSpan::TraceSpan( const string &name_, const char *category_, int index_ )
+    : category( category_ ), index( index_ )
+    {
+    start = -1.0;
+    if( !trace_enabled ) return;
+    name  = name_;
+    start = Now();
+    }
+
+TraceSpan::~TraceSpan()
+    {
+    if( start < 0.0 ) return;
+    trace_event event;
+    event.name     = name;
+    event.category = category;
+    event.index    = index;
+    event.start    = start;
+    event.duration = Now() - start;
+    ThreadLog().events.push_back( event );
+    }
+
+// Write a string as a JSON string literal.
+static void Quote( ostream &out, const string &s )
+    {
+    out << '"';
+    for( unsigned i = 0; i < s.size(); i++ )
+        {
+        const char c = s[i];
+        if( c == '"' || c == '\\' ) out << '\\' << c;
+        else if( (unsigned char)c < 0x20 ) out << ' ';
+        else out << c;
+        }
+    out << '"';
+    }
+
+bool WriteTrace( const string &file_name )
+    {
+    std::ofstream out( file_name.c_str() );
+    if( !out ) return false;
+    out.setf( std::ios::fixed );
+    out.precision( 3 );
+    std::lock_guard<std::mutex> guard( trace_lock );
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for( unsigned t = 0; t < all_logs.size(); t++ )
+        {
+        const trace_log &log = *all_logs[t];
+        out << ( t > 0 ? ",\n" : "" )
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << log.tid << ",\"args\":{\"name\":";
+        Quote( out, log.thread_name );
+        out << "}}";
+        for( unsigned i = 0; i < log.events.size(); i++ )
+            {
+            const trace_event &e = log.events[i];
+            out << ",\n{\"name\":";
+            Quote( out, e.name );
+            out << ",\"cat\":\"" << e.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << log.tid
+                << ",\"ts\":" << e.start << ",\"dur\":" << e.duration;
+            if( e.index >= 0 ) out << ",\"args\":{\"index\":" << e.index << "}";
+            out << "}";
+            }
+        }
+    out << "\n]}\n";
+    return !out.fail();
+    }
@@ -0,0 +1,57 @@
+/***************************************************************************
+* trace.h                                                                  *
+*                                                                          *
+* A timeline of the phases of a render (reading the scene, closing each    *
+* aggregate, rendering each tile, writing the image, etc.), recorded per   *
+* thread by scoped timers and exported in the Chrome trace event format.   *
+* The resulting JSON file can be opened in chrome://tracing or Perfetto to *
+* see where the time goes, and how evenly the work is spread among the     *
+* rendering threads.                                                       *
+*                                                                          *
+* A TraceSpan records the interval from its construction to its            *
+* destruction, so spans nest naturally with the scopes that declare them.  *
+* Nothing is recorded (and the clock is not read) until StartTrace is      *
+* called.  Each thread appends to its own log, found through a             *
+* thread-local pointer; the logs are gathered by WriteTrace, which must be *
+* called only when no other threads are running.                           *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#ifndef __TRACE_INCLUDED__
+#define __TRACE_INCLUDED__
+
+#include "base.h"
+
+// Begin recording spans.  Times are measured from this call.
+extern void StartTrace(
+    );
+
+// Whether StartTrace has been called.
+extern bool TraceEnabled(
+    );
+
+// Name the calling thread in the timeline.  Unnamed threads are called
+// "thread N", in the order in which they first record a span.
+extern void SetTraceThreadName(
+    const string &name
+    );
+
+// Write all the spans recorded so far as Chrome trace JSON.  Returns false
+// if the file could not be written.
+extern bool WriteTrace(
+    const string &file_name
+    );
+
+struct TraceSpan {
+    TraceSpan( const char   *name, const char *category = "phase", int index = -1 );
+    TraceSpan( const string &name, const char *category = "phase", int index = -1 );
+   ~TraceSpan();
+    string      name;
+    const char *category;
+    int         index;    // Shown as an argument of the span if non-negative.
+    double      start;    // Microseconds since StartTrace, or negative if not recording.
+    };
+
+#endif
@@ -6,82 +6,246 @@
 * allows arbitrary affine transformations to be applied to any object.     * 
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Accepts an optional name.  The matrix can be replaced.     *
+*   10/18/2026  Rays mapped to the canonical space are prepared for the    *
+*               ray-box tests.                                             *
+*   10/18/2026  Hits are finalized in the space of the object hit.         *
+*   10/18/2026  Special cases for rigid, uniform & translation matrices,   *
+*               and the hit is mapped back only once it is final.          *
+*   10/18/2026  Declaration moved to transform.h.                          *
+*   10/18/2026  Added batched intersection.                                *
 *   10/03/2005  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
 #include "toytracer.h"
 #include "util.h"
 #include "params.h"
-
-// Define the transform object as a sub-class of the "Aggregate" class.
-// This sub-class must define all the necessary virtual methods as well as
-// any special data members that are specific to this type of object.
-// (ALL access to this object will be through these virtual methods.)
-
-struct transform : public Aggregate { 
-    transform() {}
-    transform( const Mat3x4 & );
-   ~transform() {}
-    virtual bool Intersect( const Ray &ray, HitInfo & ) const;
-    virtual bool Inside( const Vec3 & ) const;
-    virtual Interval GetSlab( const Vec3 & ) const;
-    virtual Plugin *ReadString( const string &params );
-    virtual string MyName() const { return "transform"; }
-    virtual void AddChild( Object * );
-    virtual int GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const;
-    virtual double Cost() const { return object == NULL ? 1.0 : object->Cost(); }
-    Mat3x4 matrix;
-    Mat3x4 inverse;
-    Object *object;
-    };
+#include "transform.h"
 
 REGISTER_PLUGIN( transform );
 
 transform::transform( const Mat3x4 &mat )
+    {
+    object = NULL;
+    const Interval all( -Infinity, Infinity );
+    box = AABB( all, all, all ); // Until the object is known.
+    SetMatrix( mat );
+    }
+
+void transform::SetMatrix( const Mat3x4 &mat )
     {
     // Store the original matrix along with its inverse.  We will need both
     // matrices for transforming points and normals from one space to the other.
     matrix  = mat;
     inverse = Inverse( mat );
-    object  = NULL;
+
+    // Classify the matrix so that the common cases can skip work for every
+    // ray.  The linear part A is a rotation times a scale factor s exactly
+    // when the columns of A are orthogonal and all of length s, which is when
+    // the transpose of A times A is s^2 times the identity.
+    const double tol = 1.0E-12;
+    const Mat3x3 G( Transpose( mat.mat ) * mat.mat );
+    const double s2 = ( G(0,0) + G(1,1) + G(2,2) ) / 3.0;
+    bool conformal = s2 > 0.0;
+    bool identity  = true;
+    for( int i = 0; i < 3; i++ )
+    for( int j = 0; j < 3; j++ )
+        {
+        const double delta = ( i == j ) ? 1.0 : 0.0;
+        if( fabs( G(i,j) - delta * s2 ) > tol * s2 ) conformal = false;
+        if( fabs( mat.mat(i,j) - delta ) > tol ) identity = false;
+        }
+    scale = 1.0;
+    if( !conformal ) kind = general;
+    else if( identity ) kind = translation;
+    else if( fabs( s2 - 1.0 ) <= tol ) kind = rigid;
+    else
+        {
+        kind  = uniform;
+        scale = sqrt( s2 );
+        }
     }
 
 Plugin *transform::ReadString( const string &params )
     {
     Mat3x4 M;
     ParamReader get( params );
-    if( get["begin"] && get[MyName()] && get[M] ) return new transform( M );
+    if( get["begin"] && get[MyName()] && get[M] )
+        {
+        transform *t = new transform( M );
+        if( get["name"] ) get.Word( t->name );
+        return t;
+        }
     return NULL;
     }
 
+// Transform the given ray back into the canonical space.  The stretch is
+// the factor by which distances along the ray grow in the canonical space.
+// Only a general matrix requires the direction to be re-normalized.
+void transform::ToCanonical( const Ray &ray, Ray &c_ray, double &stretch ) const
+    {
+    switch( kind )
+        {
+        case translation:
+            c_ray.origin    = ray.origin + inverse.vec;
+            c_ray.direction = ray.direction;
+            stretch = 1.0;
+            break;
+        case rigid:
+            c_ray.origin    = inverse * ray.origin;
+            c_ray.direction = inverse.mat * ray.direction;
+            stretch = 1.0;
+            break;
+        case uniform:
+            c_ray.origin    = inverse * ray.origin;
+            c_ray.direction = ( inverse.mat * ray.direction ) * scale;
+            stretch = 1.0 / scale;
+            break;
+        default:
+            {
+            const Vec3 c_dir = inverse.mat * ray.direction;
+            stretch = Length( c_dir );
+            c_ray.origin    = inverse * ray.origin;
+            c_ray.direction = c_dir / stretch;
+            }
+        }
+    c_ray.Prepare();
+    }
+
+// Map the point and normal of a hit from the canonical space into the space
+// of the parent.  Normals transform by the inverse transpose of the matrix,
+// which is the matrix itself for a rotation, up to scale.  Returns true if
+// the length of the normal has changed, so that it must be re-normalized.
+bool transform::ToParent( HitInfo &hitinfo ) const
+    {
+    switch( kind )
+        {
+        case translation:
+            hitinfo.point = hitinfo.point + matrix.vec;
+            return false;
+        case rigid:
+            hitinfo.point  = matrix * hitinfo.point;
+            hitinfo.normal = matrix.mat * hitinfo.normal;
+            return false;
+        case uniform:
+            hitinfo.point  = matrix * hitinfo.point;
+            hitinfo.normal = ( matrix.mat * hitinfo.normal ) / scale;
+            return false;
+        default:
+            hitinfo.point  = matrix * hitinfo.point;
+            hitinfo.normal = inverse.mat ^ hitinfo.normal;
+            return true;
+        }
+    }
+
+// A closer hit has been found within the object.  Rather than mapping the
+// point and normal out of the canonical space now, which is wasted if a still
+// closer hit turns up later, add this transform to the frames of the hit.  If
+// the hit came directly from a primitive, rather than through a transform
+// nested within this one, then it has no frames yet.  If there is no room
+// for another frame, the hit is finalized in the canonical space right away,
+// using the canonical ray, and it then has only this frame.
+void transform::Record( const Ray &c_ray, HitInfo &hitinfo ) const
+    {
+    bool finished = false;
+    if( hitinfo.frame_object != hitinfo.object ) hitinfo.frames = 0;
+    else if( hitinfo.frames < max_hit_frames ) finished = hitinfo.finished;
+    else
+        {
+        hitinfo.Finalize( c_ray );
+        finished = true;
+        }
+    hitinfo.frame[ hitinfo.frames++ ] = this;
+    hitinfo.finished     = finished;
+    hitinfo.frame_object = hitinfo.object;
+    }
+
 bool transform::Intersect( const Ray &ray, HitInfo &hitinfo ) const
     {
     // Transform the given ray back into the canonical space and perform
-    // the intersection test there.  When the hit point and normal are found
-    // in the canonical space, map them back into the transformed space.
+    // the intersection test there, using the caller's hitinfo with the
+    // distance scaled into the canonical space.  It is restored if the ray
+    // misses, as the object then leaves the hitinfo untouched.
     Ray c_ray( ray ); // Ray inverse-transformed into the canonical space.
-    HitInfo c_hit;    // Hit information obtained in the canonical space.
-    Vec3 c_dir      = inverse.mat * ray.direction;
-    double stretch  = Length( c_dir ); 
-    c_ray.origin    = inverse * ray.origin;
-    c_ray.direction = c_dir / stretch;
-    c_hit.ignore    = hitinfo.ignore;
-    c_hit.distance  = hitinfo.distance * stretch;
+    double stretch;
+    ToCanonical( ray, c_ray, stretch );
+    const double  distance     = hitinfo.distance;
+    const Object *frame_object = hitinfo.frame_object;
+    hitinfo.distance     = distance * stretch;
+    hitinfo.frame_object = NULL;
 
     // Intersect the ray in canonical space with the canonical object.
-    if( object->Intersect( c_ray, c_hit ) )
+    if( object->Intersect( c_ray, hitinfo ) )
         {
-        // Transform the hit info from canonical space back to the
-        // original space.
-        hitinfo.distance = c_hit.distance / stretch;
-        hitinfo.point    = matrix * c_hit.point;
-        hitinfo.normal   = Unit( inverse.mat ^ c_hit.normal );
-        hitinfo.object   = c_hit.object;
+        Record( c_ray, hitinfo );
+        hitinfo.distance /= stretch;
         return true;
         }
+    hitinfo.distance     = distance;
+    hitinfo.frame_object = frame_object;
     return false;
     }
 
+void transform::IntersectBatch( const RayBatch &batch, const unsigned *active, unsigned n, HitInfo *hits ) const
+    {
+    // Transform the rays back into the canonical space, exactly as in Intersect.
+    // Only those that hit the bounding box of the canonical object are gathered
+    // into a new batch, which is then intersected with the object all at once.
+    RayBatch c_batch;
+    vector<HitInfo>  c_hits;
+    vector<unsigned> index;
+    vector<double>   stretch;
+    for( unsigned k = 0; k < n; k++ )
+        {
+        const unsigned i = active[k];
+        const Ray &ray = batch.rays[i];
+        Ray c_ray( ray );
+        double s;
+        ToCanonical( ray, c_ray, s );
+        if( !Hit( c_ray, box, hits[i].distance * s ) ) continue;
+        c_batch.Add( c_ray );
+        index.push_back( i );
+        stretch.push_back( s );
+        }
+    if( index.empty() ) return;
+
+    const unsigned count = index.size();
+    vector<unsigned> c_active( count );
+    c_hits.resize( count );
+    for( unsigned k = 0; k < count; k++ )
+        {
+        c_hits[k].ignore   = hits[ index[k] ].ignore;
+        c_hits[k].object   = NULL;
+        c_hits[k].distance = hits[ index[k] ].distance * stretch[k];
+        c_hits[k].frame_object = NULL;
+        c_active[k] = k;
+        }
+    object->IntersectBatch( c_batch, &c_active[0], count, &c_hits[0] );
+
+    // Pass the closer hits back, along with their frames.
+    for( unsigned k = 0; k < count; k++ )
+        {
+        const HitInfo &c_hit = c_hits[k];
+        if( c_hit.object == NULL ) continue;
+        HitInfo &hitinfo = hits[ index[k] ];
+        hitinfo.distance = c_hit.distance;
+        hitinfo.object   = c_hit.object;
+        hitinfo.point    = c_hit.point;
+        hitinfo.normal   = c_hit.normal;
+        hitinfo.uv       = c_hit.uv;
+        hitinfo.part     = c_hit.part;
+        hitinfo.frame_object = c_hit.frame_object;
+        if( c_hit.frame_object == c_hit.object )
+            {
+            hitinfo.frames   = c_hit.frames;
+            hitinfo.finished = c_hit.finished;
+            for( unsigned f = 0; f < c_hit.frames; f++ ) hitinfo.frame[f] = c_hit.frame[f];
+            }
+        Record( c_batch.rays[k], hitinfo );
+        hitinfo.distance /= stretch[k];
+        }
+    }
+
 bool transform::Inside( const Vec3 &P ) const
     {
     // Map the point P back into the canonical space and call the
@@ -123,6 +287,13 @@ void transform::AddChild( Object *obj )
     object = obj;
     }
 
+void transform::Close()
+    {
+    // The object is complete, so its bounding box can be found.  This is
+    // used to cull batches of rays before they are handed to the object.
+    if( object != NULL ) box = GetBox( *object );
+    }
+
 int transform::GetSamples( const Vec3 &, const Vec3 &, Sample *, int ) const
     {
     cerr << "Error: Getting samples from a transformed object is not implemented."
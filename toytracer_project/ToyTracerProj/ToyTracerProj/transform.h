@@ -0,0 +1,69 @@
+/***************************************************************************
+* transform.h                                                              *
+*                                                                          *
+* The "transform" object applies an affine transformation to a single      *
+* child object.  It is declared here, rather than within transform.cpp,    *
+* so that other objects that place geometry by means of a matrix (such as  *
+* instances of prototypes) can share its implementation.                   *
+*                                                                          *
+* A transform may be given a name, as in "begin transform (...) name arm", *
+* so that it can be found and moved later, as by an animation.             *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Added ForgetPrototypes, so each scene has its own.         *
+*   10/18/2026  Added names, SetMatrix & Rebuild, for animation.           *
+*   10/18/2026  Hits are finalized in the space of the object hit.         *
+*   10/18/2026  Special cases for rigid, uniform & translation matrices.   *
+*   10/18/2026  Split off from transform.cpp.                              *
+*                                                                          *
+***************************************************************************/
+#ifndef __TRANSFORM_INCLUDED__
+#define __TRANSFORM_INCLUDED__
+
+#include "toytracer.h"
+
+// Define the transform object as a sub-class of the "Aggregate" class.
+// This sub-class must define all the necessary virtual methods as well as
+// any special data members that are specific to this type of object.
+// (ALL access to this object will be through these virtual methods.)
+
+struct transform : public Aggregate {
+    transform() { object = NULL; kind = general; scale = 1.0; }
+    transform( const Mat3x4 & );
+   ~transform() {}
+    virtual bool Intersect( const Ray &ray, HitInfo & ) const;
+    virtual void IntersectBatch( const RayBatch &, const unsigned *, unsigned, HitInfo * ) const;
+    virtual bool Inside( const Vec3 & ) const;
+    virtual Interval GetSlab( const Vec3 & ) const;
+    virtual Plugin *ReadString( const string &params );
+    virtual string MyName() const { return "transform"; }
+    virtual void AddChild( Object * );
+    virtual void Close();
+    virtual void Rebuild() { Close(); }
+    virtual int GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const;
+    virtual double Cost() const { return object == NULL ? 1.0 : object->Cost(); }
+    virtual void ToCanonical( const Ray &ray, Ray &c_ray, double &stretch ) const;
+    virtual bool ToParent( HitInfo & ) const;
+    void Record( const Ray &c_ray, HitInfo & ) const;
+    void SetMatrix( const Mat3x4 & ); // The aggregates above must then be rebuilt.
+    enum matrix_kind {   // The cheapest way to apply the matrix.
+        translation,     // The linear part is the identity.
+        rigid,           // The linear part is a rotation or reflection.
+        uniform,         // The linear part is a rotation times a scale factor.
+        general          // Anything else, including non-uniform scaling & shear.
+        };
+    Mat3x4  matrix;
+    Mat3x4  inverse;
+    Object *object;
+    AABB    box;     // Bounding box of the object, in the canonical space.
+    matrix_kind kind;
+    double  scale;   // The scale factor of a uniform matrix (1 if rigid).
+    string  name;    // Empty unless the transform was given a name.
+    };
+
+// Forget the prototypes defined so far, so that the instances in the next
+// scene to be built can refer only to the prototypes of that scene.  The
+// builder calls this as it starts each scene.  (See instance.cpp.)
+extern void ForgetPrototypes();
+
+#endif
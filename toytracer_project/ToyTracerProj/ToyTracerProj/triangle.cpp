@@ -2,11 +2,34 @@
 * triangle.cpp    (primitive object plugin)                                *
 *                                                                          *
 * The triangle object is defined by three vertices in R3.  This is a       *
-* simple flat triangle with no normal vector interpolation.  The           *
-* triangle structure is defined to accommodate the barycentric coord       *
-* method of intersecting a ray with a triangle.                            *
+* simple flat triangle with no normal vector interpolation.  Two ray       *
+* intersection kernels are available, selected by an optional keyword      *
+* following the vertices:                                                  *
+*                                                                          *
+*    triangle (A) (B) (C) watertight                                       *
+*    triangle (A) (B) (C) edges                                            *
+*                                                                          *
+* The "watertight" kernel (the default) is that of Woop, Benthin & Wald    *
+* (2013); rays that hit an edge or vertex shared by several triangles are  *
+* guaranteed to hit at least one of them.  The "edges" kernel is the       *
+* Moller-Trumbore test with the two edge vectors precomputed; it is a bit  *
+* faster, but rays can slip between adjacent triangles.  The watertight    *
+* test needs a shear of the ray, which Ray::Prepare finds once per ray.    *
+* Both store the geometry as single-precision floats in 48 bytes, and both *
+* return the barycentric coordinates of the hit (with respect to B and C)  *
+* in uv.  Aggregates that pack their primitives (see packed.cpp) pack the  *
+* triangles of each kernel separately, with a packed version of the same   *
+* test, so packing does not change which triangles a ray hits.             *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  "watertight" is the default again, & is packed too.        *
+*   10/18/2026  "edges" is the default & the only kernel that is packed.   *
+*   10/18/2026  The watertight shear is now found once per ray.            *
+*   10/18/2026  Point & normal are now filled in by FinalizeHit.           *
+*   10/18/2026  Slabs now widen outward for negative coordinates too.      *
+*   10/18/2026  Watertight & precomputed-edge kernels in single precision. *
+*   10/18/2026  Geometry made available for packing.                       *
+*   10/18/2026  Added batched intersection.                                *
 *   10/03/2005  Removed bounding box computation.                          *
 *   10/10/2004  Broken out of objects.C file.                              *
 *                                                                          *
@@ -14,120 +37,227 @@
 #include "toytracer.h"
 #include "util.h"
 #include "params.h"
+#include "packed.h"
 
 struct Triangle : public Primitive {
+    enum kernel_type { watertight, edges };
     Triangle() {}
-    Triangle( const Vec3 &A, const Vec3 &B, const Vec3 &C );
+    Triangle( const Vec3 &A, const Vec3 &B, const Vec3 &C, kernel_type k = watertight );
     virtual bool Intersect( const Ray &ray, HitInfo & ) const;
     virtual bool Inside( const Vec3 & ) const { return false; }
     virtual Interval GetSlab( const Vec3 & ) const;
     virtual int GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const;
     virtual Plugin *ReadString( const string &params );
     virtual string MyName() const { return "triangle"; }
-    Mat3x3 M;    // Inverse of barycentric coord transform.
-    Vec3   N;    // Normal to plane of triangle;
-    double d;    // Distance from origin to plane of triangle.
-    int    axis; // The dominant axis;
-    Vec3   A;
-    Vec3   B;
-    Vec3   C;
+    bool IntersectWatertight( const Ray &ray, HitInfo & ) const;
+    bool IntersectEdges( const Ray &ray, HitInfo & ) const;
+    virtual void FinalizeHit( const Ray &ray, HitInfo & ) const;
+    bool Hit( double s, double b1, double b2, HitInfo & ) const;
+    Vec3 Vertex( int i ) const;
+    float V[3][3]; // Watertight: the three vertices.  Edges: the first vertex & the edges to the others.
+    float N[3];    // Unit normal to the plane of the triangle.
+    kernel_type kernel;
     };
 
+DEFINE_PRIMITIVE_STAT( tests, "triangle" );
+
 Plugin *Triangle::ReadString( const string &params ) // Read params from string.
     {
     ParamReader get( params );
     Vec3 v1, v2, v3;
     if( get[MyName()] && get[v1] && get[v2] && get[v3] )
-        return new Triangle( v1, v2, v3 );
+        {
+        if( get["edges"] ) return new Triangle( v1, v2, v3, edges );
+        return new Triangle( v1, v2, v3, watertight );
+        }
     return NULL;
     }
 
-Triangle::Triangle( const Vec3 &A_, const Vec3 &B_, const Vec3 &C_ )
+// Return the vertices, normal & kernel if the object is a triangle.  This
+// allows the aggregates to pack triangles together (see packed.cpp).  For a
+// watertight triangle they are exactly the floats that its kernel uses.
+bool TriangleGeometry( const Object *obj, Vec3 &A, Vec3 &B, Vec3 &C, Vec3 &N, bool &watertight )
     {
-    A = A_; // Store the vertices.
-    B = B_;
-    C = C_;
-
-    N = Unit( (A - B) ^ (C - B) ); // Compute the normal vector.
-    d = A * N;
-
-    // Determine which axis is the "dominant" axis of the triangle.  That is, which
-    // coordinate axis is closest to being orthogonal to the triangle.
-
-    if( fabs(N.x) >= fabs(N.y) && fabs(N.x) >= fabs(N.z) ) axis = 0;
-    if( fabs(N.y) >= fabs(N.x) && fabs(N.y) >= fabs(N.z) ) axis = 1;
-    if( fabs(N.z) >= fabs(N.x) && fabs(N.z) >= fabs(N.y) ) axis = 2;
-
-   // Set up the matrix for finding the barycentric coordinates.
+    const Triangle *tri = dynamic_cast<const Triangle*>( obj );
+    if( tri == NULL ) return false;
+    A = tri->Vertex(0);
+    B = tri->Vertex(1);
+    C = tri->Vertex(2);
+    N = Vec3( tri->N[0], tri->N[1], tri->N[2] );
+    watertight = tri->kernel == Triangle::watertight;
+    return true;
+    }
 
-    Mat3x3 W;
-    W(0,0) = A.x; W(0,1) = B.x; W(0,2) = C.x;
-    W(1,0) = A.y; W(1,1) = B.y; W(1,2) = C.y;
-    W(2,0) = A.z; W(2,1) = B.z; W(2,2) = C.z;
-    W(axis,0) = 1.0;
-    W(axis,1) = 1.0;
-    W(axis,2) = 1.0;
+Triangle::Triangle( const Vec3 &A, const Vec3 &B, const Vec3 &C, kernel_type k )
+    {
+    kernel = k;
+    const Vec3 U( B - A );
+    const Vec3 W( C - A );
+    const Vec3 *v[] = { &A, &B, &C };
+    if( kernel == edges )
+        {
+        v[1] = &U;
+        v[2] = &W;
+        }
+    for( int i = 0; i < 3; i++ )
+        {
+        V[i][0] = float( v[i]->x );
+        V[i][1] = float( v[i]->y );
+        V[i][2] = float( v[i]->z );
+        }
 
-    // Store the inverse of this matrix.  It will provide an efficient means of
-    // finding the barycentric coordinates of the point of intersection with the
-    // plane containing the triangle.
+    const Vec3 n( Unit( (A - B) ^ (C - B) ) ); // Compute the normal vector.
+    N[0] = float( n.x );
+    N[1] = float( n.y );
+    N[2] = float( n.z );
+    }
 
-    M = Inverse( W );
+// Return one of the vertices, A, B, or C.
+Vec3 Triangle::Vertex( int i ) const
+    {
+    const Vec3 P( V[i][0], V[i][1], V[i][2] );
+    if( kernel == edges && i > 0 ) return Vec3( V[0][0], V[0][1], V[0][2] ) + P;
+    return P;
     }
 
 Interval Triangle::GetSlab( const Vec3 &v ) const
     {
-    const double a = v * A;
-    const double b = v * B;
-    const double c = v * C;
+    const double a = v * Vertex(0);
+    const double b = v * Vertex(1);
+    const double c = v * Vertex(2);
+    // Widen the slab slightly in proportion to the magnitude of each end, so
+    // that it grows outward whatever the sign (and a flat slab stays valid).
+    const double lo = min( a, b, c );
+    const double hi = max( a, b, c );
     return Interval(
-        OneMinusEps * min( a, b, c ),
-        OnePlusEps  * max( a, b, c )
+        lo - MachEps * fabs( lo ),
+        hi + MachEps * fabs( hi )
         ) / ( v * v );
     }
 
 bool Triangle::Intersect( const Ray &ray, HitInfo &hitinfo ) const
     {
-    // Compute the point of intersection with the plane containing the triangle.
-    // Report a miss if the ray does not hit this plane.
+    STAT_PRIMITIVE_TEST( tests );
+
+    // Most triangles tested lie behind the ray origin or beyond the closest hit
+    // found so far.  These are rejected using only the plane of the triangle,
+    // before either kernel is applied: the distance to the plane is num / den.
+    const double num = N[0] * ( V[0][0] - ray.origin.x ) + N[1] * ( V[0][1] - ray.origin.y ) + N[2] * ( V[0][2] - ray.origin.z );
+    const double den = N[0] * ray.direction.x + N[1] * ray.direction.y + N[2] * ray.direction.z;
+    if( num * den <= 0.0 || fabs( num ) > hitinfo.distance * fabs( den ) ) return false;
+
+    if( kernel == edges ) return IntersectEdges( ray, hitinfo );
+    return IntersectWatertight( ray, hitinfo );
+    }
+
+// Record a closer hit.  The barycentric coordinates are kept as the uv, and
+// the point and normal are filled in by FinalizeHit.
+inline bool Triangle::Hit( double s, double b1, double b2, HitInfo &hitinfo ) const
+    {
+    hitinfo.distance = s;
+    hitinfo.uv       = Vec2( b1, b2 );
+    hitinfo.object   = this;
+    return true;
+    }
 
-    const double denom = ray.direction * N;
-    if( fabs(denom) < 1.0E-4 ) return false;
-    const double s = ( d - ray.origin * N ) / denom;
-    if( s <= 0.0 || s > hitinfo.distance ) return false;
-    const Vec3 P = ray.origin + s * ray.direction;
+// Fill in all the geometric information so that the shader can shade the
+// point that was hit.
+void Triangle::FinalizeHit( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    hitinfo.point  = ray.origin + hitinfo.distance * ray.direction;
+    hitinfo.normal = Vec3( N[0], N[1], N[2] );
+    }
 
-    // Create a new vector that is a copy of P, but with one coordinate (corresponding
-    // to the dominant exis) set to 1.  This is the right-hand-side of the equation for
-    // the barycentric coordinates.
+// The watertight test transforms the vertices into a coordinate system in which
+// the ray starts at the origin and points along the positive z-axis.  The test
+// then reduces to 2D edge functions of the sheared vertices, which are evaluated
+// identically for an edge shared by two triangles.  Only when an edge function
+// is exactly zero is it recomputed in double precision, as the sign matters.
+bool Triangle::IntersectWatertight( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    const float O[] = { float( ray.origin.x    ), float( ray.origin.y    ), float( ray.origin.z    ) };
 
-    Vec3 Q = P;
-    switch( axis )
+    // The permutation making z the dominant axis of the ray direction, and the
+    // shear, depend only on the ray, so they are found once by Ray::Prepare.
+    const int kx = ray.shear_axis[0];
+    const int ky = ray.shear_axis[1];
+    const int kz = ray.shear_axis[2];
+    const float Sx = ray.shear[0];
+    const float Sy = ray.shear[1];
+    const float Sz = ray.shear[2];
+
+    // Translate & shear the vertices.
+    float x[3], y[3], z[3];
+    for( int i = 0; i < 3; i++ )
         {
-        case 0: Q.x = 1.0; break;
-        case 1: Q.y = 1.0; break;
-        case 2: Q.z = 1.0; break;
+        const float dz = V[i][kz] - O[kz];
+        x[i] = ( V[i][kx] - O[kx] ) - Sx * dz;
+        y[i] = ( V[i][ky] - O[ky] ) - Sy * dz;
+        z[i] = Sz * dz;
         }
 
-    // Solve for the barycentric coordinates and check their sign.  The ray hits the triangle
-    // if and only of all the barycentric coordinates are positive.
+    // The barycentric coordinates, scaled by det, are the 2D edge functions.
+    float bA = x[2] * y[1] - y[2] * x[1];
+    float bB = x[0] * y[2] - y[0] * x[2];
+    float bC = x[1] * y[0] - y[1] * x[0];
+    if( bA == 0.0f || bB == 0.0f || bC == 0.0f )
+        {
+        bA = float( double( x[2] ) * y[1] - double( y[2] ) * x[1] );
+        bB = float( double( x[0] ) * y[2] - double( y[0] ) * x[2] );
+        bC = float( double( x[1] ) * y[0] - double( y[1] ) * x[0] );
+        }
+    const bool outside = ( ( bA < 0.0f ) | ( bB < 0.0f ) | ( bC < 0.0f ) ) &
+                         ( ( bA > 0.0f ) | ( bB > 0.0f ) | ( bC > 0.0f ) );
 
-    if( M(0,0) * Q.x + M(0,1) * Q.y + M(0,2) * Q.z < 0.0 ) return false;
-    if( M(1,0) * Q.x + M(1,1) * Q.y + M(1,2) * Q.z < 0.0 ) return false;
-    if( M(2,0) * Q.x + M(2,1) * Q.y + M(2,2) * Q.z < 0.0 ) return false;
+    // The distance, scaled by det, must lie within (0, hitinfo.distance].  As in
+    // IntersectEdges, the remaining tests are combined into one branch.
+    const float det  = bA + bB + bC;
+    const float dist = bA * z[0] + bB * z[1] + bC * z[2];
+    const float sign = det < 0.0f ? -1.0f : 1.0f;
+    if( outside | ( det == 0.0f ) | ( sign * dist <= 0.0f ) | ( sign * dist > hitinfo.distance * ( sign * det ) ) ) return false;
 
-    // We have an actual hit.  Fill in all the geometric information so
-    // that the shader can shade this point.
+    const double inv = 1.0 / det;
+    return Hit( dist * inv, bB * inv, bC * inv, hitinfo );
+    }
 
-    hitinfo.distance = s;
-    hitinfo.point    = P; 
-    hitinfo.normal   = N;
-    hitinfo.object   = this;
-    return true;
+// The Moller-Trumbore test.  The barycentric coords (b1,b2) and the distance s
+// are found by Cramer's rule, sharing the cross products P = R x E2 and
+// Q = T x E1 among the three determinants.  The tests are made before dividing
+// by the determinant, whose sign is folded into the numerators.  Most rays fail
+// the first barycentric test, so it alone is a separate branch.  No cutoff is
+// applied to the determinant other than zero, so grazing rays still hit.
+bool Triangle::IntersectEdges( const Ray &ray, HitInfo &hitinfo ) const
+    {
+    const float R [] = { float( ray.direction.x ), float( ray.direction.y ), float( ray.direction.z ) };
+    const float *E1 = V[1];
+    const float *E2 = V[2];
+
+    const float P[] = { R[1] * E2[2] - R[2] * E2[1], R[2] * E2[0] - R[0] * E2[2], R[0] * E2[1] - R[1] * E2[0] };
+    float det = E1[0] * P[0] + E1[1] * P[1] + E1[2] * P[2];
+    if( det == 0.0f ) return false;
+    const float sign = det < 0.0f ? -1.0f : 1.0f;
+    det *= sign;
+
+    const float T[] = {
+        float( ray.origin.x ) - V[0][0],
+        float( ray.origin.y ) - V[0][1],
+        float( ray.origin.z ) - V[0][2] };
+    const float b1 = sign * ( T[0] * P[0] + T[1] * P[1] + T[2] * P[2] );
+    if( b1 < 0.0f || b1 > det ) return false;
+
+    const float Q[] = { T[1] * E1[2] - T[2] * E1[1], T[2] * E1[0] - T[0] * E1[2], T[0] * E1[1] - T[1] * E1[0] };
+    const float b2 = sign * ( R[0] * Q[0] + R[1] * Q[1] + R[2] * Q[2] );
+    const float s  = sign * ( E2[0] * Q[0] + E2[1] * Q[1] + E2[2] * Q[2] );
+    if( ( b2 < 0.0f ) | ( b1 + b2 > det ) | ( s <= 0.0f ) | ( s > hitinfo.distance * det ) ) return false;
+    const double inv = 1.0 / det;
+    return Hit( s * inv, b1 * inv, b2 * inv, hitinfo );
     }
 
 int Triangle::GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n ) const
     {
+    const Vec3 A( Vertex(0) );
+    const Vec3 B( Vertex(1) );
+    const Vec3 C( Vertex(2) );
     int count = 0;
     Vec3    W = (A - B) ^ (C - B);
     double dA = Length( W ) / ( 2.0 * n * n );
@@ -152,4 +282,3 @@ int Triangle::GetSamples( const Vec3 &P, const Vec3 &N, Sample *samples, int n )
 // toytracer will automatically recognize the new objects and read them from sdf files.
 
 REGISTER_PLUGIN( Triangle );
-
@@ -4,10 +4,13 @@
 * Miscellaneous utilities, such as predicates on materials & objects.      *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  rand draws from a generator of each thread's own.          *
+*   10/18/2026  ToneMap moved here from basic_rasterizer.cpp.              *
 *   10/16/2005  Added ToString function for plugin_type.                   *
 *   12/11/2004  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
+#include <atomic>
 #include "toytracer.h"
 #include "util.h"
 
@@ -34,11 +37,28 @@ AABB GetBox( const Object &obj )
     return box;
     }
 
+// The C library's rand keeps a single state for the whole process, which the
+// rendering threads would contend for, so each thread has an xorshift
+// generator of its own.  A thread that has not seeded its generator is given
+// a seed of its own when it first draws a number.
+static STATS_THREAD_LOCAL unsigned random_state = 0;
+static std::atomic<unsigned> random_threads( 0 );
+
+void SeedRandom( unsigned seed )
+    {
+    random_state = ( seed + 1 ) * 2654435769u; // Zero only if the seed is ~0u.
+    if( random_state == 0 ) random_state = 1;
+    }
+
 double rand( double a, double b )
     {
-    double x = float(rand()) / RAND_MAX;
-    if( x < 0.0 ) x = -x;
-    return a + x * ( b - a );
+    if( random_state == 0 ) SeedRandom( random_threads++ );
+    unsigned x = random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    random_state = x;
+    return a + ( b - a ) * ( x / 4294967296.0 );
     }
 
 bool operator==( const Material &a, const Material &b )
@@ -80,6 +100,19 @@ const char *rubout( int i )
     return "\b\b\b\b";
     }
 
-
-
-
+// This is a trivial tone mapper; it merely maps values that are
+// in [0,1] and maps them to integers between 0 and 255.  If the
+// real value is above 1, it merely truncates.  A true tone mapper
+// would attempt to handle very large values nicely, without
+// truncation; that is, it would try to compensate for the fact that
+// displays have a very limited dynamic range.
+Pixel ToneMap( const Color &color )
+    {
+    int red   = (int)floor( 256 * color.red   );
+    int green = (int)floor( 256 * color.green );
+    int blue  = (int)floor( 256 * color.blue  );
+    channel r = (channel)( red   >= 255 ? 255 : red   ); 
+    channel g = (channel)( green >= 255 ? 255 : green ); 
+    channel b = (channel)( blue  >= 255 ? 255 : blue  );
+    return Pixel( r, g, b );
+    }
@@ -4,6 +4,7 @@
 * Miscellaneous utilities, such as predicates on materials & objects.      *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Added SeedRandom; rand keeps a generator per thread.       *
 *   12/11/2004  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -11,6 +12,7 @@
 #define __UTIL_INCLUDED__
 
 #include "toytracer.h"
+#include "ppm_image.h"
 
 inline double sqr( double x )
     {
@@ -73,13 +75,21 @@ extern double max(
     );
 
 extern double rand(    // Return a random number uniformly distributed in [a,b].
-    double a,
+    double a,              // Each thread draws from a generator of its own.
     double b
     );
 
+extern void SeedRandom( // Restart the calling thread's sequence of random numbers.
+    unsigned seed
+    );
+
 extern string ToString(
     plugin_type ptype
     );
 
+extern Pixel ToneMap(  // Map a color to a displayable pixel.
+    const Color &color
+    );
+
 #endif
 
@@ -5,6 +5,7 @@
 * It has all of the obvious operators defined as inline functions.         *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Coordinates are reals (float or double).                   *
 *   04/01/2003  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -16,8 +17,8 @@
 struct Vec2 {
     inline Vec2()                     { x = 0; y = 0; }
     inline Vec2( double a, double b ) { x = a; y = b; }
-    double x;
-    double y;
+    real x;
+    real y;
     };
 
 inline double LengthSquared( const Vec2 &A )
@@ -5,6 +5,7 @@
 * It has all of the obvious operators defined as inline functions.         *
 *                                                                          *
 * History:                                                                 *
+*   10/18/2026  Coordinates are reals (float or double).                   *
 *   04/01/2003  Initial coding.                                            *
 *                                                                          *
 ***************************************************************************/
@@ -16,9 +17,9 @@
 struct Vec3 {
     inline Vec3()                               { x = 0; y = 0; z = 0; }
     inline Vec3( double a, double b, double c ) { x = a; y = b; z = c; }
-    double x;
-    double y;
-    double z;
+    real x;
+    real y;
+    real z;
     };
 
 inline double LengthSquared( const Vec3 &A )
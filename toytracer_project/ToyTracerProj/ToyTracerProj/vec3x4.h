@@ -0,0 +1,120 @@
+/***************************************************************************
+* vec3x4.h                                                                 *
+*                                                                          *
+* Vec3x4 holds four 3D vectors in structure-of-arrays form: one Double4    *
+* (see simd.h) for each coordinate, with each vector occupying one lane.   *
+* It has the same operators as Vec3, so that kernels that process four     *
+* rays or four primitives at once can be written just like their scalar    *
+* counterparts.  The inner and cross products use MulAdd and MulSub, and   *
+* so are fused on processors with FMA.  Mat3x3 and Mat3x4 can also be      *
+* applied to four vectors or points at once.                               *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#ifndef __VEC3X4_INCLUDED__
+#define __VEC3X4_INCLUDED__
+
+#include "simd.h"
+#include "mat3x4.h"
+
+struct Vec3x4 {
+    inline Vec3x4() {}
+    inline Vec3x4( const Double4 &a, const Double4 &b, const Double4 &c ) : x( a ), y( b ), z( c ) {}
+    inline Vec3x4( const Vec3 &A ) : x( A.x ), y( A.y ), z( A.z ) {} // Broadcast A to all four lanes.
+    inline static Vec3x4 Load( const double *x, const double *y, const double *z );
+    inline void Store( double *x, double *y, double *z ) const;
+    Double4 x;
+    Double4 y;
+    Double4 z;
+    };
+
+inline Vec3x4 Vec3x4::Load( const double *px, const double *py, const double *pz )
+    {
+    return Vec3x4( Double4::Load( px ), Double4::Load( py ), Double4::Load( pz ) );
+    }
+
+inline void Vec3x4::Store( double *px, double *py, double *pz ) const
+    {
+    x.Store( px );
+    y.Store( py );
+    z.Store( pz );
+    }
+
+inline Vec3x4 operator+( const Vec3x4 &A, const Vec3x4 &B )
+    {
+    return Vec3x4( A.x + B.x, A.y + B.y, A.z + B.z );
+    }
+
+inline Vec3x4 operator-( const Vec3x4 &A, const Vec3x4 &B )
+    {
+    return Vec3x4( A.x - B.x, A.y - B.y, A.z - B.z );
+    }
+
+inline Vec3x4 operator*( const Double4 &a, const Vec3x4 &A )
+    {
+    return Vec3x4( a * A.x, a * A.y, a * A.z );
+    }
+
+inline Vec3x4 operator*( const Vec3x4 &A, const Double4 &a )
+    {
+    return Vec3x4( a * A.x, a * A.y, a * A.z );
+    }
+
+inline Vec3x4 operator/( const Vec3x4 &A, const Double4 &c )
+    {
+    return Vec3x4( A.x / c, A.y / c, A.z / c );
+    }
+
+inline Double4 operator*( const Vec3x4 &A, const Vec3x4 &B )  // Inner product.
+    {
+    return MulAdd( A.z, B.z, MulAdd( A.y, B.y, A.x * B.x ) );
+    }
+
+inline Vec3x4 operator^( const Vec3x4 &A, const Vec3x4 &B ) // Cross product.
+    {
+    return Vec3x4(
+        MulSub( A.y, B.z, A.z * B.y ),
+        MulSub( A.z, B.x, A.x * B.z ),
+        MulSub( A.x, B.y, A.y * B.x )
+        );
+    }
+
+inline Double4 LengthSquared( const Vec3x4 &A )
+    {
+    return A * A;
+    }
+
+inline Double4 Length( const Vec3x4 &A )
+    {
+    return sqrt( A * A );
+    }
+
+// Normalize all four vectors using a single division per lane.  As with
+// Vec3, a zero vector remains zero.
+inline Vec3x4 Unit( const Vec3x4 &A )
+    {
+    const Double4 d( A * A );
+    const Double4 zero( 0.0 );
+    const Double4 s( Select( d > zero, Double4( 1.0 ) / sqrt( d ), zero ) );
+    return s * A;
+    }
+
+inline Vec3x4 operator*( const Mat3x3 &M, const Vec3x4 &A )
+    {
+    // Transform the four column vectors of A, multiplying on the left by matrix M.
+    return Vec3x4(
+        MulAdd( Double4( M(0,2) ), A.z, MulAdd( Double4( M(0,1) ), A.y, Double4( M(0,0) ) * A.x ) ),
+        MulAdd( Double4( M(1,2) ), A.z, MulAdd( Double4( M(1,1) ), A.y, Double4( M(1,0) ) * A.x ) ),
+        MulAdd( Double4( M(2,2) ), A.z, MulAdd( Double4( M(2,1) ), A.y, Double4( M(2,0) ) * A.x ) )
+        );
+    }
+
+inline Vec3x4 operator*( const Mat3x4 &M, const Vec3x4 &A )
+    {
+    // Transform four points, including the translation.
+    return M.mat * A + Vec3x4( M.vec );
+    }
+
+#endif
@@ -0,0 +1,424 @@
+/***************************************************************************
+* wavefront_rasterizer.cpp    (rasterizer plugin)                          *
+*                                                                          *
+* A rasterizer that processes the image in square tiles, in "wavefront"    *
+* fashion.  All the primary rays of a tile are generated first, then       *
+* intersected with the scene as a single batch via Scene::CastBatch, and   *
+* finally the hits are sorted by shader and material and shaded together.  *
+* This keeps the traversal and shading code (and data) hot in the cache.   *
+* Within a tile the rays are ordered in 4x4 blocks of pixels, so that      *
+* aggregates can traverse them as coherent packets.  The shadow rays of    *
+* the hits are batched too, one batch per light, for shaders that allow    *
+* it (see Shader::ShadowRay); being cast from nearby points toward one     *
+* light, they are also coherent.  Reflected & refracted rays are batched   *
+* too, bounce by bounce, for shaders that allow it (see                    *
+* Shader::SecondaryRays): those of all the hits of a batch form the batch  *
+* of the next bounce, which is cast, shadowed & shaded in the same way.    *
+* The tiles are distributed among several threads.  Usage:                 *
+*                                                                          *
+*    rasterizer wavefront_rasterizer [tile N] [threads N] [samples N]      *
+*                                                                          *
+* where "tile" is the width of a tile in pixels (default 16), "threads" is *
+* the number of rendering threads (default: one per hardware thread), and  *
+* "samples" is the number of jittered rays per pixel (default 1).          *
+*                                                                          *
+* History:                                                                 *
+*   10/18/2026  Reflected & refracted rays are batched, bounce by bounce.  *
+*   10/18/2026  Reports its progress to the caller, tile by tile.          *
+*   10/18/2026  Shadow rays are cast in batches, one per light.            *
+*   10/18/2026  Each tile has its own random numbers, whatever the thread. *
+*   10/18/2026  Parameters it does not take are rejected.                  *
+*   10/18/2026  Reports the number of threads it renders with.             *
+*   10/18/2026  Each tile is timed by a trace span.                        *
+*   10/18/2026  Rays are batched in blocks of pixels for packet traversal. *
+*   10/18/2026  Initial coding.                                            *
+*                                                                          *
+***************************************************************************/
+#include "toytracer.h"
+#include "ppm_image.h"
+#include "params.h"
+#include "util.h"
+#include "trace.h"
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+static const unsigned default_tile_size = 16;
+static const unsigned block_size = 4; // Rays are batched in blocks of 4x4 pixels.
+
+struct wavefront_rasterizer : public Rasterizer {
+    wavefront_rasterizer() {}
+    wavefront_rasterizer( unsigned tile, unsigned threads, unsigned samples );
+    virtual ~wavefront_rasterizer() {}
+    virtual bool Rasterize( string fname, const Camera &, const Scene &, const Scene &, const bool &doMotionBlur, RenderProgress * = NULL ) const;
+    virtual Plugin *ReadString( const string &params );
+    virtual string MyName() const { return "wavefront_rasterizer"; }
+    virtual unsigned Threads() const;
+    unsigned tile_size;
+    unsigned num_threads; // Zero means one per hardware thread.
+    unsigned num_samples; // Rays per pixel.
+    };
+
+REGISTER_PLUGIN( wavefront_rasterizer );
+
+wavefront_rasterizer::wavefront_rasterizer( unsigned tile, unsigned threads, unsigned samples )
+    {
+    tile_size   = tile;
+    num_threads = threads;
+    num_samples = samples;
+    }
+
+unsigned wavefront_rasterizer::Threads() const
+    {
+    unsigned threads = num_threads;
+    if( threads == 0 ) threads = std::thread::hardware_concurrency();
+    if( threads == 0 ) threads = 1;
+    return threads;
+    }
+
+Plugin *wavefront_rasterizer::ReadString( const string &params )
+    {
+    ParamReader get( params );
+    if( get["rasterizer"] && get[MyName()] )
+        {
+        unsigned tile    = default_tile_size;
+        unsigned threads = 0;
+        unsigned samples = 1;
+        for(;;)
+            {
+            if( get["tile"]    && get[tile]    ) continue;
+            if( get["threads"] && get[threads] ) continue;
+            if( get["samples"] && get[samples] ) continue;
+            break;
+            }
+        string extra;
+        if( get.Word( extra ) ) return NULL; // A parameter it does not take.
+        if( tile    == 0 ) tile    = default_tile_size;
+        if( samples == 0 ) samples = 1;
+        return new wavefront_rasterizer( tile, threads, samples );
+        }
+    return NULL;
+    }
+
+// Everything the rendering threads need to know, along with the shared
+// counter from which they draw the next tile to render.
+struct wavefront_job {
+    const wavefront_rasterizer *rast;
+    const Camera *cam;
+    const Scene  *scene;
+    const Scene  *scene2;
+    bool          blur;
+    PPM_Image    *image;
+    Vec3          O, dR, dU;  // Raster origin and increments, as in basic_rasterizer.
+    unsigned      tiles_x;
+    unsigned      tiles_y;
+    std::atomic<unsigned> next_tile;
+    unsigned      tiles_done; // Guarded by "console".
+    RenderProgress *progress; // Told of each tile finished, under "console", if not NULL.
+    std::mutex    console;
+    };
+
+// Orders the rays of a batch so that those hitting the same shader and
+// material are shaded consecutively.  Misses are placed at the end.
+struct by_shader {
+    by_shader( const HitInfo *h ) : hits( h ) {}
+    bool operator()( unsigned a, unsigned b ) const
+        {
+        const Object *A = hits[a].object;
+        const Object *B = hits[b].object;
+        if( A == NULL || B == NULL ) return B == NULL && A != NULL;
+        if( A->shader   != B->shader   ) return A->shader   < B->shader;
+        if( A->material != B->material ) return A->material < B->material;
+        return a < b;
+        }
+    const HitInfo *hits;
+    };
+
+// The shadow rays of a batch of hits, queued light by light.
+struct shadow_queue {
+    vector<RayBatch>          rays;    // The shadow rays toward each light.
+    vector< vector<unsigned> > owner;  // The hit from which each of them was cast.
+    vector<HitInfo>           hits;    // What each shadow ray hit, if anything.
+    vector<char>              blocked; // For each hit, whether each light is blocked.
+    };
+
+// Queue the shadow rays of all the hits whose shaders let them be cast here,
+// then cast those toward each light as one batch.  Each such hit is given
+// the results, so that its shader need not cast them again.
+static void CastShadows( const Scene &scene, const unsigned n, vector<HitInfo> &hits, shadow_queue &queue )
+    {
+    const unsigned lights = scene.NumLights();
+    if( lights == 0 ) return;
+    queue.rays .resize( lights );
+    queue.owner.resize( lights );
+    queue.blocked.resize( n * lights );
+    for( unsigned l = 0; l < lights; l++ )
+        {
+        queue.rays [l].Clear();
+        queue.owner[l].clear();
+        }
+
+    Ray ray;
+    for( unsigned i = 0; i < n; i++ )
+        {
+        const Object *obj = hits[i].object;
+        if( obj == NULL || obj->shader == NULL ) continue;
+        if( !obj->shader->ShadowRay( scene, hits[i], 0, ray ) ) continue;
+        for( unsigned l = 0; l < lights; l++ )
+            {
+            if( l > 0 ) obj->shader->ShadowRay( scene, hits[i], l, ray );
+            queue.rays [l].Add( ray );
+            queue.owner[l].push_back( i );
+            }
+        hits[i].blocked = &queue.blocked[ i * lights ];
+        }
+
+    for( unsigned l = 0; l < lights; l++ )
+        {
+        const unsigned m = queue.rays[l].Size();
+        if( m == 0 ) continue;
+        if( queue.hits.size() < m ) queue.hits.resize( m );
+        for( unsigned k = 0; k < m; k++ )
+            {
+            queue.hits[k].ignore   = NULL;
+            queue.hits[k].distance = Infinity;
+            }
+        STAT_ADD( stat_shadow_rays, m );
+        scene.CastBatch( queue.rays[l], &queue.hits[0] );
+        for( unsigned k = 0; k < m; k++ )
+            queue.blocked[ queue.owner[l][k] * lights + l ] = queue.hits[k].object != NULL;
+        }
+    }
+
+// The rays of one bounce, each with the pixel of the tile whose color it
+// adds to, and the weight of the color that it sees.
+struct bounce {
+    RayBatch         rays;
+    vector<unsigned> pixel;
+    vector<Color>    weight;
+    };
+
+// The buffers of a rendering thread, kept from one batch to the next.
+struct wavefront_buffers {
+    bounce           level[2]; // The secondary rays of this bounce & the next.
+    vector<HitInfo>  hits;
+    vector<unsigned> order;
+    shadow_queue     shadows;
+    vector<Ray>      rays;     // The secondary rays of one hit,
+    vector<Color>    weights;  // and their weights.
+    };
+
+// Cast all the rays of the batch into the scene at once, and then their
+// shadow rays, then shade the hits in coherent order.  The reflected &
+// refracted rays of hits whose shaders let them be traced here (see
+// Shader::SecondaryRays) are gathered into the batch of the next bounce,
+// which is cast & shaded in the same way, until no rays remain.  Each ray
+// adds the color it sees, times its weight, to the sum of its pixel.
+static void ShadeBatch( const Scene &scene, const RayBatch &batch, wavefront_buffers &buf, double weight, vector<Color> &sum )
+    {
+    bounce *cur  = &buf.level[0];
+    bounce *next = &buf.level[1];
+    cur->pixel .clear();
+    cur->weight.clear();
+    for( unsigned i = 0; i < batch.Size(); i++ )
+        {
+        cur->pixel .push_back( i );
+        cur->weight.push_back( Color( weight, weight, weight ) );
+        }
+
+    const RayBatch *rays = &batch; // The primary rays, then those of each bounce.
+    while( rays->Size() > 0 )
+        {
+        const unsigned n = rays->Size();
+        if( buf.hits.size() < n )
+            {
+            buf.hits .resize( n );
+            buf.order.resize( n );
+            }
+        for( unsigned i = 0; i < n; i++ )
+            {
+            buf.hits[i].ignore   = NULL;
+            buf.hits[i].distance = Infinity;
+            buf.order[i] = i;
+            }
+        scene.CastBatch( *rays, &buf.hits[0] );
+        CastShadows( scene, n, buf.hits, buf.shadows );
+        std::sort( buf.order.begin(), buf.order.begin() + n, by_shader( &buf.hits[0] ) );
+
+        next->rays.Clear();
+        next->pixel .clear();
+        next->weight.clear();
+        for( unsigned k = 0; k < n; k++ )
+            {
+            const unsigned i = buf.order[k];
+            const unsigned p = cur->pixel[i];
+            const Color    W = cur->weight[i];
+            const HitInfo &hit = buf.hits[i];
+            if( hit.object == NULL )
+                {
+                sum[p] += W * scene.Miss( rays->rays[i] );
+                continue;
+                }
+            const Shader *shader = hit.object->shader;
+            Color color;
+            buf.rays.clear();
+            buf.weights.clear();
+            if( shader == NULL || !shader->SecondaryRays( scene, hit, color, buf.rays, buf.weights ) )
+                {
+                sum[p] += W * scene.Shade( hit );
+                continue;
+                }
+            STAT_COUNT( stat_shader_calls );
+            sum[p] += W * color;
+            for( unsigned r = 0; r < buf.rays.size(); r++ )
+                {
+                const Color w( W * buf.weights[r] );
+                if( buf.rays[r].generation > scene.max_tree_depth )
+                    {
+                    sum[p] += w * scene.Trace( buf.rays[r] ); // The color for rays too deep; nothing is cast.
+                    continue;
+                    }
+                next->rays.Add( buf.rays[r] );
+                next->pixel .push_back( p );
+                next->weight.push_back( w );
+                }
+            }
+        std::swap( cur, next );
+        rays = &cur->rays;
+        }
+    }
+
+// Each rendering thread repeatedly claims the next unrendered tile until
+// none remain.  Each pixel of a tile is sampled with "num_samples" rays,
+// and each sample forms its own batch.
+static void Worker( wavefront_job *job )
+    {
+    const Camera &cam = *job->cam;
+    const unsigned tile    = job->rast->tile_size;
+    const unsigned samples = job->rast->num_samples;
+    const unsigned num_tiles = job->tiles_x * job->tiles_y;
+    const unsigned max_rays  = tile * tile;
+
+    RayBatch          batch;
+    vector<Color>     sum( max_rays );
+    vector<unsigned>  row( max_rays );
+    vector<unsigned>  col( max_rays );
+    wavefront_buffers buffers;
+
+    Ray ray;
+    ray.origin     = cam.eye;     // All initial rays originate from the eye.
+    ray.type       = primary_ray; // Cast by the rasterizer.
+    ray.generation = 1;           // Rays cast from the eye are first-generation.
+
+    for(;;)
+        {
+        const unsigned t = job->next_tile++;
+        if( t >= num_tiles ) break;
+        TraceSpan span( "tile", "tile", t );
+        SeedRandom( t ); // So that the jitter of a tile is the same whichever thread renders it.
+        const unsigned i0 = ( t / job->tiles_x ) * tile;
+        const unsigned j0 = ( t % job->tiles_x ) * tile;
+        const unsigned i1 = min( i0 + tile, cam.y_res );
+        const unsigned j1 = min( j0 + tile, cam.x_res );
+
+        // List the pixels of the tile block by block, so that consecutive rays
+        // of the batch are coherent enough to be traversed as packets.
+        unsigned n = 0;
+        for( unsigned bi = i0; bi < i1; bi += block_size )
+        for( unsigned bj = j0; bj < j1; bj += block_size )
+        for( unsigned i = bi; i < min( bi + block_size, i1 ); i++ )
+        for( unsigned j = bj; j < min( bj + block_size, j1 ); j++ )
+            {
+            row[n] = i;
+            col[n] = j;
+            sum[n] = Color();
+            n++;
+            }
+
+        for( unsigned s = 0; s < samples; s++ )
+            {
+            batch.Clear();
+            for( unsigned k = 0; k < n; k++ )
+                {
+                const double x = samples > 1 ? rand( 0, 1 ) : 0.5;
+                const double y = samples > 1 ? rand( 0, 1 ) : 0.5;
+                ray.direction = Unit( job->O + ( col[k] + x ) * job->dR - ( row[k] + y ) * job->dU );
+                batch.Add( ray );
+                }
+            STAT_ADD( stat_primary_rays, job->blur ? 2 * n : n );
+            if( job->blur )
+                {
+                ShadeBatch( *job->scene , batch, buffers, 0.15, sum );
+                ShadeBatch( *job->scene2, batch, buffers, 0.85, sum );
+                }
+            else ShadeBatch( *job->scene, batch, buffers, 1.0, sum );
+            }
+
+        PPM_Image &I = *job->image;
+        for( unsigned k = 0; k < n; k++ )
+            I( row[k], col[k] ) = ToneMap( sum[k] / samples );
+
+        std::lock_guard<std::mutex> guard( job->console );
+        cout << rubout( job->tiles_done ) << ( job->tiles_done + 1 );
+        job->tiles_done++;
+        cout.flush();
+        if( job->progress != NULL ) job->progress->Report( job->tiles_done, num_tiles, "tiles" );
+        }
+    }
+
+bool wavefront_rasterizer::Rasterize( string file_name, const Camera &cam, const Scene &scene, const Scene &scene2, const bool &doMotionBlur, RenderProgress *progress ) const
+    {
+    file_name += ".ppm";
+
+    // Make sure the file is accessible by overwriting it now.
+
+    if( !Overwrite_PPM_Image( file_name ) )
+        {
+        cerr << "Error: Could not open file " << file_name << " for writing." << endl;
+        return false;
+        }
+
+    PPM_Image I( cam.x_res, cam.y_res );
+
+    // Compute the camera basis exactly as the basic_rasterizer does.
+
+    const Vec3 G ( Unit( cam.lookat - cam.eye ) );
+    const Vec3 U ( Unit( cam.up / G ) );
+    const Vec3 R ( Unit( G ^ U ) );
+
+    wavefront_job job;
+    job.rast    = this;
+    job.cam     = &cam;
+    job.scene   = &scene;
+    job.scene2  = &scene2;
+    job.blur    = doMotionBlur;
+    job.image   = &I;
+    job.O       = cam.vpdist * G + cam.x_win.min * R + cam.y_win.max * U;
+    job.dR      = Len( cam.x_win ) * R / cam.x_res;
+    job.dU      = Len( cam.y_win ) * U / cam.y_res;
+    job.tiles_x = ( cam.x_res + tile_size - 1 ) / tile_size;
+    job.tiles_y = ( cam.y_res + tile_size - 1 ) / tile_size;
+    job.next_tile  = 0;
+    job.tiles_done = 0;
+    job.progress   = progress;
+
+    const unsigned threads = Threads();
+
+    cout << "Rendering " << job.tiles_x * job.tiles_y << " tiles with "
+         << threads << " thread" << ( threads > 1 ? "s" : "" ) << ", tile 0";
+    cout.flush();
+
+    // The calling thread renders tiles too.
+    vector<std::thread> pool;
+    for( unsigned t = 1; t < threads; t++ ) pool.push_back( std::thread( Worker, &job ) );
+    Worker( &job );
+    for( unsigned t = 0; t < pool.size(); t++ ) pool[t].join();
+
+    cout << "\nWriting image file " << file_name << "... ";
+    cout.flush();
+    TraceSpan span( "write image" );
+    I.Write( file_name );
+    cout << "done." << endl;
+    return true;
+    }